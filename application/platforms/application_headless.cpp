@@ -466,6 +466,68 @@ private:
 };
 }
 
+static Value build_memory_stats(Device &device, unsigned frames, Document::AllocatorType &allocator)
+{
+	static const char *class_names[] = { "small", "medium", "large", "huge" };
+	ArenaAllocatorStats stats[Util::ecast(MemoryClass::Count)];
+	device.get_allocation_stats(stats);
+
+	// NaN and infinity cannot be written as JSON, so rates are 0 if no frames were rendered.
+	const auto per_frame = [frames](uint64_t count) {
+		return frames ? double(count) / double(frames) : 0.0;
+	};
+
+	Value classes(kObjectType);
+	for (int i = 0; i < Util::ecast(MemoryClass::Count); i++)
+	{
+		auto &s = stats[i];
+		Value class_obj(kObjectType);
+		class_obj.AddMember("subBlockSize", s.sub_block_size, allocator);
+		class_obj.AddMember("heapSize", uint64_t(s.sub_block_size) * LegionAllocator::NumSubBlocks, allocator);
+		class_obj.AddMember("heapCount", s.heap_count, allocator);
+		class_obj.AddMember("peakHeapCount", s.peak_heap_count, allocator);
+		class_obj.AddMember("liveBytes", s.live_size, allocator);
+		class_obj.AddMember("peakLiveBytes", s.peak_live_size, allocator);
+		class_obj.AddMember("allocations", s.allocation_count, allocator);
+		class_obj.AddMember("frees", s.free_count, allocator);
+		class_obj.AddMember("heapAllocations", s.heap_allocation_count, allocator);
+		class_obj.AddMember("heapFrees", s.heap_free_count, allocator);
+		class_obj.AddMember("allocationsPerFrame", per_frame(s.allocation_count), allocator);
+		class_obj.AddMember("freesPerFrame", per_frame(s.free_count), allocator);
+		class_obj.AddMember("heapAllocationsPerFrame", per_frame(s.heap_allocation_count), allocator);
+
+		Value size_histogram(kArrayType);
+		for (auto count : s.allocation_size_histogram)
+			size_histogram.PushBack(count, allocator);
+		class_obj.AddMember("allocationSizeHistogram", size_histogram, allocator);
+
+		Value run_histogram(kArrayType);
+		for (auto count : s.longest_free_run_histogram)
+			run_histogram.PushBack(count, allocator);
+		class_obj.AddMember("longestFreeRunHistogram", run_histogram, allocator);
+
+		classes.AddMember(StringRef(class_names[i]), class_obj, allocator);
+	}
+
+	HeapBudget budgets[VK_MAX_MEMORY_HEAPS];
+	device.get_memory_budget(budgets);
+	Value heaps(kArrayType);
+	for (uint32_t i = 0; i < device.get_memory_properties().memoryHeapCount; i++)
+	{
+		Value heap(kObjectType);
+		heap.AddMember("maxSize", uint64_t(budgets[i].max_size), allocator);
+		heap.AddMember("budgetSize", uint64_t(budgets[i].budget_size), allocator);
+		heap.AddMember("trackedUsage", uint64_t(budgets[i].tracked_usage), allocator);
+		heap.AddMember("deviceUsage", uint64_t(budgets[i].device_usage), allocator);
+		heaps.PushBack(heap, allocator);
+	}
+
+	Value memory(kObjectType);
+	memory.AddMember("classes", classes, allocator);
+	memory.AddMember("heaps", heaps, allocator);
+	return memory;
+}
+
 static void print_help()
 {
 	LOGI("[--png-path <path>] [--stat <output.json>]\n"
@@ -589,6 +651,8 @@ int application_main_headless(
 		p->wait_threads();
 		app->get_wsi().get_device().wait_idle();
 		app->get_wsi().get_device().timestamp_log_reset();
+		if (!args.stat.empty())
+			app->get_wsi().get_device().set_allocation_stats_enabled(true);
 
 		LOGI("=== Begin run ===\n");
 
@@ -653,6 +717,9 @@ int application_main_headless(
 					doc.AddMember("performance", report_objs, allocator);
 				}
 
+				doc.AddMember("memory", build_memory_stats(app->get_wsi().get_device(), rendered_frames, allocator),
+				              allocator);
+
 				StringBuffer buffer;
 				PrettyWriter<StringBuffer> writer(buffer);
 				doc.Accept(writer);
@@ -256,6 +256,10 @@ void SceneViewerApplication::read_config(const std::string &path)
 		config.volumetric_fog = doc["volumetricFog"].GetBool();
 	if (doc.HasMember("volumetricDiffuse"))
 		config.volumetric_diffuse = doc["volumetricDiffuse"].GetBool();
+	if (doc.HasMember("cullingHierarchy"))
+		config.culling_hierarchy = doc["cullingHierarchy"].GetBool();
+	if (doc.HasMember("secondaryCommandBuffers"))
+		config.secondary_command_buffers = doc["secondaryCommandBuffers"].GetBool();
 }
 
 SceneViewerApplication::SceneViewerApplication(const std::string &path, const std::string &config_path,
@@ -276,6 +280,7 @@ SceneViewerApplication::SceneViewerApplication(const std::string &path, const st
 	renderer_suite_config.directional_light_vsm = config.directional_light_shadows_vsm;
 
 	scene_loader.load_scene(path);
+	scene_loader.get_scene().set_culling_hierarchy_enabled(config.culling_hierarchy);
 	read_lights();
 
 	scene_transform_manager.init(scene_loader.get_scene());
@@ -942,6 +947,8 @@ void SceneViewerApplication::add_main_pass_deferred(Device &device, const std::s
 		setup.flags = SCENE_RENDERER_DEFERRED_GBUFFER_BIT;
 		if (config.debug_probes)
 			setup.flags |= SCENE_RENDERER_DEBUG_PROBES_BIT;
+		if (config.secondary_command_buffers)
+			setup.flags |= SCENE_RENDERER_SECONDARY_COMMAND_BUFFER_BIT;
 		renderer->set_extra_flush_flags(Renderer::MESH_ASSET_PHASE_2_BIT | Renderer::MESH_ASSET_FORCE_ALL_VISIBLE_BIT);
 		renderer->init(setup);
 		gbuffer.set_render_pass_interface(std::move(renderer));
@@ -1143,6 +1150,8 @@ void SceneViewerApplication::add_shadow_pass(Device &, const std::string &tag)
 	setup.flags = SCENE_RENDERER_DEPTH_BIT;
 	if (config.directional_light_shadows_vsm)
 		setup.flags |= SCENE_RENDERER_SHADOW_VSM_BIT;
+	if (config.secondary_command_buffers)
+		setup.flags |= SCENE_RENDERER_SECONDARY_COMMAND_BUFFER_BIT;
 
 	setup.context = depth_contexts;
 	setup.flags |= SCENE_RENDERER_DEPTH_DYNAMIC_BIT;
@@ -1423,6 +1432,7 @@ void SceneViewerApplication::update_scene(TaskComposer &composer, double frame_t
 
 	constexpr unsigned NumTasks = 8;
 	Threaded::scene_update_cached_transforms(scene, composer, NumTasks);
+	Threaded::scene_update_culling_hierarchy(scene, composer);
 
 	// Perform updates which depend on node transforms.
 	auto &updates = composer.begin_pipeline_stage();
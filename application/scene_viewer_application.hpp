@@ -153,6 +153,8 @@ private:
 		bool ssao = true;
 		bool debug_probes = false;
 		bool ssr = false;
+		bool culling_hierarchy = false;
+		bool secondary_command_buffers = false;
 		PostAAType postaa_type = PostAAType::None;
 	};
 	Config config;
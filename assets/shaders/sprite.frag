@@ -104,6 +104,13 @@ void main()
         color = vec4(1.0, 1.0, 1.0, color.r);
     #endif
 
+    #if defined(VARIANT_BIT_6) && VARIANT_BIT_6
+        // Signed distance field, 0.5 is on the glyph outline. Antialias over one pixel at any scale.
+        float dist = color.r;
+        float dist_width = max(fwidth(dist), 1.0 / 256.0);
+        color = vec4(1.0, 1.0, 1.0, smoothstep(0.5 - dist_width, 0.5 + dist_width, dist));
+    #endif
+
     #if defined(ALPHA_TEST)
         if (color.a < 0.5)
             discard;
@@ -118,6 +118,15 @@ public:
 	virtual void add_entity(Entity &entity) = 0;
 	virtual void remove_entity(const Entity &entity) = 0;
 	virtual void reset() = 0;
+
+	// Changes whenever group membership changes, which also invalidates indices into the group.
+	uint64_t get_generation() const
+	{
+		return generation;
+	}
+
+protected:
+	uint64_t generation = 0;
 };
 
 class EntityPool;
@@ -216,6 +225,7 @@ public:
 			entity_to_index[entity.get_hash()].get() = entities.size();
 			groups.push_back(std::make_tuple(entity.get_component<Ts>()...));
 			entities.push_back(&entity);
+			generation++;
 		}
 	}
 
@@ -231,6 +241,7 @@ public:
 			entity_to_index.erase(entity.get_hash());
 			entities.pop_back();
 			groups.pop_back();
+			generation++;
 		}
 	}
 
@@ -249,6 +260,7 @@ public:
 		groups.clear();
 		entities.clear();
 		entity_to_index.clear();
+		generation++;
 	}
 
 private:
@@ -30,7 +30,8 @@ namespace Granite
 AssetManager::AssetManager()
 {
 	asset_bank.reserve(AssetID::MaxIDs);
-	sorted_assets.reserve(AssetID::MaxIDs);
+	for (auto &budget : class_budget)
+		budget = UINT64_MAX;
 	signal = std::make_unique<TaskSignal>();
 	for (uint64_t i = 0; i < timestamp; i++)
 		signal->signal_increment();
@@ -53,6 +54,7 @@ AssetID AssetManager::register_asset_nolock(FileHandle file, AssetClass asset_cl
 	info->asset_class = asset_class;
 	AssetID ret = info->id;
 	asset_bank[id_count++] = info;
+	mark_plan_dirty(info);
 	if (iface)
 	{
 		iface->set_id_bounds(id_count);
@@ -111,8 +113,11 @@ void AssetManager::set_asset_instantiator_interface(AssetInstantiatorInterface *
 		a->consumed = 0;
 		a->pending_consumed = 0;
 		a->last_used = 0;
+		mark_plan_dirty(a);
 	}
 	total_consumed = 0;
+	for (auto &consumed : class_consumed)
+		consumed = 0;
 
 	iface = iface_;
 	if (iface)
@@ -123,11 +128,21 @@ void AssetManager::set_asset_instantiator_interface(AssetInstantiatorInterface *
 	}
 }
 
+void AssetManager::set_asset_prefetch_interface(AssetPrefetchInterface *iface_)
+{
+	prefetch_iface = iface_;
+}
+
 void AssetManager::mark_used_asset(AssetID id)
 {
 	lru_append.push(id);
 }
 
+void AssetManager::prefetch_asset(AssetID id)
+{
+	prefetch_append.push(id);
+}
+
 bool AssetManager::get_wants_mesh_assets() const
 {
 	return wants_mesh_assets;
@@ -148,12 +163,18 @@ void AssetManager::set_asset_budget_per_iteration(uint64_t cost)
 	transfer_budget_per_iteration = cost;
 }
 
+void AssetManager::set_asset_class_budget(AssetClass asset_class, uint64_t cost)
+{
+	class_budget[Util::ecast(asset_class)] = cost;
+}
+
 bool AssetManager::set_asset_residency_priority(AssetID id, int prio)
 {
 	std::lock_guard<std::mutex> holder{asset_bank_lock};
 	if (id.id >= id_count)
 		return false;
 	asset_bank[id.id]->prio = prio;
+	mark_plan_dirty(asset_bank[id.id]);
 	return true;
 }
 
@@ -162,13 +183,16 @@ void AssetManager::adjust_update(const CostUpdate &update)
 	if (update.id.id < id_count)
 	{
 		auto *a = asset_bank[update.id.id];
-		total_consumed += update.cost - (a->consumed + a->pending_consumed);
+		uint64_t delta = update.cost - (a->consumed + a->pending_consumed);
+		total_consumed += delta;
+		class_consumed[Util::ecast(a->asset_class)] += delta;
 		a->consumed = update.cost;
 		a->pending_consumed = 0;
 
 		// A recently paged in image shouldn't be paged out right away in a situation where we're thrashing,
 		// that'd be very dumb.
 		a->last_used = timestamp;
+		mark_plan_dirty(a);
 	}
 }
 
@@ -177,6 +201,11 @@ uint64_t AssetManager::get_current_total_consumed() const
 	return total_consumed;
 }
 
+uint64_t AssetManager::get_current_class_consumed(AssetClass asset_class) const
+{
+	return class_consumed[Util::ecast(asset_class)];
+}
+
 void AssetManager::update_costs_locked_assets()
 {
 	{
@@ -193,10 +222,139 @@ void AssetManager::update_lru_locked_assets()
 {
 	lru_append.for_each_ranged([this](const AssetID *id, size_t count) {
 		for (size_t i = 0; i < count; i++)
+		{
 			if (id[i].id < id_count)
-				asset_bank[id[i].id]->last_used = timestamp;
+			{
+				auto *a = asset_bank[id[i].id];
+				if (a->last_used != timestamp)
+				{
+					a->last_used = timestamp;
+					mark_plan_dirty(a);
+				}
+			}
+		}
 	});
 	lru_append.clear();
+
+	prefetch_append.for_each_ranged([this](const AssetID *id, size_t count) {
+		for (size_t i = 0; i < count; i++)
+		{
+			if (id[i].id < id_count)
+			{
+				auto *a = asset_bank[id[i].id];
+				if (a->last_used < timestamp - 1)
+				{
+					a->last_used = timestamp - 1;
+					mark_plan_dirty(a);
+				}
+			}
+		}
+	});
+	prefetch_append.clear();
+}
+
+bool AssetManager::PlanOrder::operator()(const AssetInfo *a, const AssetInfo *b) const
+{
+	auto &ka = a->plan_key;
+	auto &kb = b->plan_key;
+
+	if (ka.prio != kb.prio)
+		return ka.prio > kb.prio;
+	else if (ka.last_used != kb.last_used)
+		return ka.last_used > kb.last_used;
+	else if (ka.consumed != kb.consumed)
+		return ka.consumed < kb.consumed;
+	else if (ka.pending_consumed != kb.pending_consumed)
+		return ka.pending_consumed > kb.pending_consumed;
+	else
+		return a->id.id < b->id.id;
+}
+
+void AssetManager::mark_plan_dirty(AssetInfo *a)
+{
+	if (!a->plan_dirty)
+	{
+		a->plan_dirty = true;
+		plan_dirty_assets.push_back(a);
+	}
+}
+
+void AssetManager::unlink_plan(AssetInfo *a)
+{
+	// Must be called before plan_key is modified, the sets are ordered by it.
+	if (a->plan_set == AssetInfo::PlanSet::Candidate)
+		plan_candidates.erase(a);
+	else if (a->plan_set == AssetInfo::PlanSet::Resident)
+		plan_residents[Util::ecast(a->asset_class)].erase(a);
+	a->plan_set = AssetInfo::PlanSet::None;
+}
+
+void AssetManager::update_plan_locked_assets()
+{
+	for (auto *a : plan_dirty_assets)
+	{
+		unlink_plan(a);
+		a->plan_dirty = false;
+		a->plan_key.prio = a->prio;
+		a->plan_key.last_used = a->last_used;
+		a->plan_key.consumed = a->consumed;
+		a->plan_key.pending_consumed = a->pending_consumed;
+
+		if (a->consumed != 0 || a->pending_consumed != 0)
+		{
+			plan_residents[Util::ecast(a->asset_class)].insert(a);
+			a->plan_set = AssetInfo::PlanSet::Resident;
+		}
+		else if (a->prio > 0)
+		{
+			plan_candidates.insert(a);
+			a->plan_set = AssetInfo::PlanSet::Candidate;
+		}
+	}
+	plan_dirty_assets.clear();
+}
+
+AssetManager::AssetInfo *AssetManager::find_release_candidate(const PlanQueue &queue, const AssetInfo *bound) const
+{
+	// Walk from the least important resident, but never past bound or into persistent resources.
+	PlanOrder order;
+	for (auto itr = queue.rbegin(); itr != queue.rend(); ++itr)
+	{
+		auto *a = *itr;
+		if (bound && !order(bound, a))
+			break;
+		if (a->plan_key.prio >= persistent_prio())
+			break;
+
+		// Resources which are still being loaded cannot be released.
+		if (a->consumed)
+			return a;
+	}
+
+	return nullptr;
+}
+
+AssetManager::AssetInfo *AssetManager::find_release_candidate(const AssetInfo *bound) const
+{
+	PlanOrder order;
+	AssetInfo *release = nullptr;
+	for (auto &queue : plan_residents)
+	{
+		auto *a = find_release_candidate(queue, bound);
+		if (a && (!release || order(release, a)))
+			release = a;
+	}
+	return release;
+}
+
+void AssetManager::release_planned_asset(AssetInfo *a)
+{
+	iface->release_asset(a->id);
+	total_consumed -= a->consumed;
+	class_consumed[Util::ecast(a->asset_class)] -= a->consumed;
+	a->consumed = 0;
+	unlink_plan(a);
+	mark_plan_dirty(a);
 }
 
 bool AssetManager::iterate_blocking(ThreadGroup &group, AssetID id)
@@ -224,6 +382,8 @@ bool AssetManager::iterate_blocking(ThreadGroup &group, AssetID id)
 	candidate->pending_consumed = estimate;
 	candidate->last_used = timestamp;
 	total_consumed += estimate;
+	class_consumed[Util::ecast(candidate->asset_class)] += estimate;
+	mark_plan_dirty(candidate);
 
 	// We cannot increment the timestamp here, remember this for later.
 	// We hold a lock on the asset bank here, so this is fine even if called concurrently.
@@ -249,6 +409,10 @@ void AssetManager::iterate(ThreadGroup *group)
 		return;
 	}
 
+	// Hints are pushed through prefetch_asset(), which is lock-free.
+	if (prefetch_iface)
+		prefetch_iface->predict_assets(*this);
+
 	TaskGroupHandle task;
 	if (group)
 	{
@@ -263,68 +427,64 @@ void AssetManager::iterate(ThreadGroup *group)
 	std::lock_guard<std::mutex> holder{asset_bank_lock};
 	update_costs_locked_assets();
 	update_lru_locked_assets();
+	update_plan_locked_assets();
 
-	memcpy(sorted_assets.data(), asset_bank.data(), id_count * sizeof(sorted_assets[0]));
-	std::sort(sorted_assets.data(), sorted_assets.data() + id_count, [](const AssetInfo *a, const AssetInfo *b) -> bool {
-		// High prios come first since they will be activated.
-		// Then we sort by LRU.
-		// High consumption should be moved last, so they are candidates to be paged out if we're over budget.
-		// High pending consumption should be moved early since we don't want to page out resources that
-		// are in the middle of being loaded anyway.
-		// Finally, the ID is used as a tie breaker.
-
-		if (a->prio != b->prio)
-			return a->prio > b->prio;
-		else if (a->last_used != b->last_used)
-			return a->last_used > b->last_used;
-		else if (a->consumed != b->consumed)
-			return a->consumed < b->consumed;
-		else if (a->pending_consumed != b->pending_consumed)
-			return a->pending_consumed > b->pending_consumed;
-		else
-			return a->id.id < b->id.id;
-	});
-
-	size_t release_index = id_count;
 	uint64_t activated_cost_this_iteration = 0;
 	unsigned activation_count = 0;
-	size_t activate_index = 0;
+
+	// Nothing ranked below an asset we released is activated, and nothing ranked above
+	// the last asset we activated is released. This avoids thrashing within one iteration.
+	const AssetInfo *release_bound = nullptr;
+	const AssetInfo *activate_bound = nullptr;
+	PlanOrder order;
+	bool class_exhausted[Util::ecast(AssetClass::Count)] = {};
 
 	// Aim to activate resources as long as we're in budget.
 	// Activate in order from highest priority to lowest.
 	bool can_activate = true;
+	auto itr = plan_candidates.begin();
 	while (can_activate &&
 	       total_consumed < transfer_budget &&
 	       activated_cost_this_iteration < transfer_budget_per_iteration &&
-	       activate_index != release_index)
+	       itr != plan_candidates.end())
 	{
-		auto *candidate = sorted_assets[activate_index];
-		if (candidate->prio <= 0)
+		auto *candidate = *itr;
+		if (release_bound && !order(candidate, release_bound))
 			break;
 
-		// This resource is already active.
-		if (candidate->consumed != 0 || candidate->pending_consumed != 0)
+		if (class_exhausted[Util::ecast(candidate->asset_class)])
 		{
-			activate_index++;
+			++itr;
 			continue;
 		}
 
 		uint64_t estimate = iface->estimate_cost_asset(candidate->id, *candidate->handle);
+		auto &consumed_in_class = class_consumed[Util::ecast(candidate->asset_class)];
+		uint64_t budget_in_class = class_budget[Util::ecast(candidate->asset_class)];
+		bool persistent = candidate->prio >= persistent_prio();
+
+		const auto fits_class = [&]() { return consumed_in_class + estimate <= budget_in_class; };
+		const auto fits = [&]() { return persistent || (total_consumed + estimate <= transfer_budget && fits_class()); };
 
-		can_activate = (total_consumed + estimate <= transfer_budget) || (candidate->prio >= persistent_prio());
-		while (!can_activate && activate_index + 1 != release_index)
+		while (!fits())
 		{
-			auto *release_candidate = sorted_assets[--release_index];
-			if (release_candidate->consumed)
-			{
-				LOGI("Releasing ID %u due to page-in pressure.\n", release_candidate->id.id);
-				iface->release_asset(release_candidate->id);
-				total_consumed -= release_candidate->consumed;
-				release_candidate->consumed = 0;
-			}
-			can_activate = total_consumed + estimate <= transfer_budget;
+			// If the class budget is the problem, only releasing from the same class helps.
+			AssetInfo *release_candidate;
+			if (!fits_class())
+				release_candidate = find_release_candidate(plan_residents[Util::ecast(candidate->asset_class)], candidate);
+			else
+				release_candidate = find_release_candidate(candidate);
+
+			if (!release_candidate)
+				break;
+
+			LOGI("Releasing ID %u due to page-in pressure.\n", release_candidate->id.id);
+			release_planned_asset(release_candidate);
+			release_bound = release_candidate;
 		}
 
+		can_activate = fits();
+
 		if (can_activate)
 		{
 			// We're trivially in budget.
@@ -333,42 +493,54 @@ void AssetManager::iterate(ThreadGroup *group)
 
 			candidate->pending_consumed = estimate;
 			total_consumed += estimate;
+			consumed_in_class += estimate;
 			// Let this run over budget once.
 			// Ensures we can make forward progress no matter what the limit is.
 			activated_cost_this_iteration += estimate;
-			activate_index++;
+			activate_bound = candidate;
+
+			// Becomes a resident in the next update_plan_locked_assets().
+			itr = plan_candidates.erase(itr);
+			candidate->plan_set = AssetInfo::PlanSet::None;
+			mark_plan_dirty(candidate);
+		}
+		else if (total_consumed + estimate <= transfer_budget)
+		{
+			// Only this class is out of budget, other classes can still make progress.
+			class_exhausted[Util::ecast(candidate->asset_class)] = true;
+			can_activate = true;
+			++itr;
 		}
 	}
 
-	// If we're 75% of budget, start garbage collecting non-resident resources ahead of time.
-	const uint64_t low_image_budget = (transfer_budget * 3) / 4;
-
-	const auto should_release = [&]() -> bool {
-		if (release_index == activate_index)
-			return false;
-		if (sorted_assets[release_index - 1]->prio == persistent_prio())
-			return false;
+	// Enforce class budgets, e.g. if they were lowered.
+	for (int asset_class = 0; asset_class < Util::ecast(AssetClass::Count); asset_class++)
+	{
+		while (class_consumed[asset_class] > class_budget[asset_class])
+		{
+			auto *candidate = find_release_candidate(plan_residents[asset_class], activate_bound);
+			if (!candidate)
+				break;
 
-		if (total_consumed > transfer_budget)
-			return true;
-		else if (total_consumed > low_image_budget && sorted_assets[release_index - 1]->prio == 0)
-			return true;
+			LOGI("Releasing ID %u due to class budget.\n", candidate->id.id);
+			release_planned_asset(candidate);
+			candidate->last_used = 0;
+		}
+	}
 
-		return false;
-	};
+	// If we're 75% of budget, start garbage collecting non-resident resources ahead of time.
+	const uint64_t low_image_budget = (transfer_budget * 3) / 4;
 
 	// If we're over budget, deactivate resources.
-	while (should_release())
+	while (total_consumed > low_image_budget)
 	{
-		auto *candidate = sorted_assets[--release_index];
-		if (candidate->consumed)
-		{
-			LOGI("Releasing 0-prio ID %u due to page-in pressure.\n", candidate->id.id);
-			iface->release_asset(candidate->id);
-			total_consumed -= candidate->consumed;
-			candidate->consumed = 0;
-			candidate->last_used = 0;
-		}
+		auto *candidate = find_release_candidate(activate_bound);
+		if (!candidate || (total_consumed <= transfer_budget && candidate->prio != 0))
+			break;
+
+		LOGI("Releasing 0-prio ID %u due to page-in pressure.\n", candidate->id.id);
+		release_planned_asset(candidate);
+		candidate->last_used = 0;
 	}
 
 	if (activated_cost_this_iteration)
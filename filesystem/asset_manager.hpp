@@ -27,7 +27,9 @@
 #include "object_pool.hpp"
 #include "intrusive_hash_map.hpp"
 #include "dynamic_array.hpp"
+#include "enum_cast.hpp"
 #include <vector>
+#include <set>
 #include <mutex>
 #include <memory>
 
@@ -61,7 +63,8 @@ enum class AssetClass
 	// Substitute with mid-gray (0.5, 0.5, 0.5, 1.0) UNORM8.
 	// Somewhat compatible with everything.
 	ImageGeneric,
-	Mesh
+	Mesh,
+	Count
 };
 
 class ThreadGroup;
@@ -90,6 +93,17 @@ public:
 	virtual void latch_handles() = 0;
 };
 
+class AssetPrefetchInterface
+{
+public:
+	virtual ~AssetPrefetchInterface() = default;
+
+	// Called at the start of AssetManager::iterate(), before residency is planned.
+	// Call AssetManager::prefetch_asset() for assets which are likely to be used soon,
+	// e.g. based on camera movement.
+	virtual void predict_assets(AssetManager &manager) = 0;
+};
+
 class AssetManager final : public AssetManagerInterface
 {
 public:
@@ -101,9 +115,12 @@ public:
 
 	void set_asset_instantiator_interface(AssetInstantiatorInterface *iface);
 
-	// We might want to consider different budgets per asset class.
+	void set_asset_prefetch_interface(AssetPrefetchInterface *iface);
+
 	void set_asset_budget(uint64_t cost);
 	void set_asset_budget_per_iteration(uint64_t cost);
+	// Applies in addition to the total budget. Classes are unlimited by default.
+	void set_asset_class_budget(AssetClass asset_class, uint64_t cost);
 
 	// FileHandle is intended to be used with FileSlice or similar here so that we don't need
 	// a ton of open files at once.
@@ -123,12 +140,17 @@ public:
 
 	// May be called concurrently, except when calling iterate().
 	uint64_t get_current_total_consumed() const;
+	uint64_t get_current_class_consumed(AssetClass asset_class) const;
 
 	// May be called concurrently, except when calling iterate().
 	// Intended to be called by asset instantiator interface or similar.
 	// When a resource is actually accessed, this is called.
 	void mark_used_asset(AssetID id);
 
+	// Thread safe. The asset is ranked as if it was used in the previous iteration,
+	// i.e. behind assets which are actually in use, but ahead of anything older.
+	void prefetch_asset(AssetID id);
+
 	// Should be called in applications's constructor to make sure we initialize
 	// the mesh asset pool on device creation.
 	// FIXME: Could be made more flexible if need be.
@@ -145,20 +167,57 @@ private:
 		AssetID id = {};
 		AssetClass asset_class = AssetClass::ImageZeroable;
 		int prio = 0;
+
+		// Snapshot of the ordering state while linked into one of the residency sets.
+		// Only refreshed in update_plan_locked_assets(), so sets stay consistent while the live state changes.
+		struct
+		{
+			int prio;
+			uint64_t last_used;
+			uint64_t consumed;
+			uint64_t pending_consumed;
+		} plan_key = {};
+
+		enum class PlanSet : uint8_t { None, Candidate, Resident };
+		PlanSet plan_set = PlanSet::None;
+		bool plan_dirty = false;
+	};
+
+	// High prios come first since they will be activated.
+	// Then we sort by LRU.
+	// High consumption should be moved last, so they are candidates to be paged out if we're over budget.
+	// High pending consumption should be moved early since we don't want to page out resources that
+	// are in the middle of being loaded anyway.
+	// Finally, the ID is used as a tie breaker.
+	struct PlanOrder
+	{
+		bool operator()(const AssetInfo *a, const AssetInfo *b) const;
 	};
+	using PlanQueue = std::set<AssetInfo *, PlanOrder>;
+
+	// Instead of sorting every asset every iteration, assets are kept ordered and only re-linked when
+	// their priority, consumption or LRU state changes.
+	// Candidates are non-resident assets with positive priority, best first.
+	// Residents are split per class, so class budgets can be enforced without scanning other classes.
+	PlanQueue plan_candidates;
+	PlanQueue plan_residents[Util::ecast(AssetClass::Count)];
+	std::vector<AssetInfo *> plan_dirty_assets;
 
-	Util::DynamicArray<AssetInfo *> sorted_assets;
 	Util::DynamicArray<AssetInfo *> asset_bank;
 	std::mutex asset_bank_lock;
 	Util::ObjectPool<AssetInfo> pool;
 	Util::AtomicAppendBuffer<AssetID> lru_append;
+	Util::AtomicAppendBuffer<AssetID> prefetch_append;
 	Util::IntrusiveHashMapHolder<AssetInfo> file_to_assets;
 
 	AssetInstantiatorInterface *iface = nullptr;
+	AssetPrefetchInterface *prefetch_iface = nullptr;
 	uint32_t id_count = 0;
 	uint64_t total_consumed = 0;
 	uint64_t transfer_budget = 0;
 	uint64_t transfer_budget_per_iteration = 0;
+	uint64_t class_consumed[Util::ecast(AssetClass::Count)] = {};
+	uint64_t class_budget[Util::ecast(AssetClass::Count)];
 	uint64_t timestamp = 1;
 	uint32_t blocking_signals = 0;
 
@@ -178,6 +237,13 @@ private:
 	void update_costs_locked_assets();
 	void update_lru_locked_assets();
 
+	void mark_plan_dirty(AssetInfo *a);
+	void unlink_plan(AssetInfo *a);
+	void update_plan_locked_assets();
+	AssetInfo *find_release_candidate(const PlanQueue &queue, const AssetInfo *bound) const;
+	AssetInfo *find_release_candidate(const AssetInfo *bound) const;
+	void release_planned_asset(AssetInfo *a);
+
 	bool wants_mesh_assets = false;
 };
 }
@@ -24,16 +24,20 @@
 #include "path_utils.hpp"
 #include "logging.hpp"
 #include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <queue>
-
-#define HOST_IP "localhost"
+#include <deque>
+#ifdef GRANITE_NETFS_LZ4
+#include <lz4.h>
+#endif
 
 namespace Granite
 {
 struct FSNotifyCommand : LooperHandler
 {
-	FSNotifyCommand(const string &protocol, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_)), expected(false)
+	FSNotifyCommand(const std::string &protocol, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_)), expected(false)
 	{
 		reply_queue.emplace();
 		auto &reply = reply_queue.back();
@@ -56,15 +60,15 @@ struct FSNotifyCommand : LooperHandler
 	~FSNotifyCommand()
 	{
 		if (!expected)
-			terminate();
+			std::terminate();
 	}
 
-	void set_notify_cb(function<void (const FileNotifyInfo &)> func)
+	void set_notify_cb(std::function<void (const FileNotifyInfo &)> func)
 	{
-		notify_cb = move(func);
+		notify_cb = std::move(func);
 	}
 
-	void push_register_notification(const string &path, promise<FileNotifyHandle> result)
+	void push_register_notification(const std::string &path, std::promise<FileNotifyHandle> result)
 	{
 		if (reply_queue.empty() && socket->get_parent_looper())
 			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
@@ -75,10 +79,10 @@ struct FSNotifyCommand : LooperHandler
 		reply.builder.add_string(path);
 		reply.writer.start(reply.builder.get_buffer());
 
-		replies.push(move(result));
+		replies.push(std::move(result));
 	}
 
-	void push_unregister_notification(FileNotifyHandle handler, promise<FileNotifyHandle> result)
+	void push_unregister_notification(FileNotifyHandle handler, std::promise<FileNotifyHandle> result)
 	{
 		if (reply_queue.empty() && socket->get_parent_looper())
 			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
@@ -89,7 +93,7 @@ struct FSNotifyCommand : LooperHandler
 		reply.builder.add_u64(8);
 		reply.builder.add_u64(uint64_t(handler));
 		reply.writer.start(reply.builder.get_buffer());
-		replies.push(move(result));
+		replies.push(std::move(result));
 	}
 
 	void modify_looper(Looper &looper)
@@ -259,18 +263,18 @@ struct FSNotifyCommand : LooperHandler
 		SocketWriter writer;
 		ReplyBuilder builder;
 	};
-	queue<NotificationReply> reply_queue;
-	queue<promise<FileNotifyHandle>> replies;
-	function<void (const FileNotifyInfo &info)> notify_cb;
-	atomic_bool expected;
+	std::queue<NotificationReply> reply_queue;
+	std::queue<std::promise<FileNotifyHandle>> replies;
+	std::function<void (const FileNotifyInfo &info)> notify_cb;
+	std::atomic_bool expected;
 };
 
 struct FSReadCommand : LooperHandler
 {
 	virtual ~FSReadCommand() = default;
 
-	FSReadCommand(const string &path, NetFSCommand command, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_))
+	FSReadCommand(const std::string &path, NetFSCommand command, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_))
 	{
 		reply_builder.begin();
 		reply_builder.add_u32(command);
@@ -357,52 +361,23 @@ struct FSReadCommand : LooperHandler
 	virtual void parse_reply() = 0;
 };
 
-struct FSReader : FSReadCommand
-{
-	FSReader(const string &path, unique_ptr<Socket> socket_)
-		: FSReadCommand(path, NETFS_READ_FILE, move(socket_))
-	{
-	}
-
-	~FSReader()
-	{
-		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("file read")));
-	}
-
-	void parse_reply() override
-	{
-		got_reply = true;
-		try
-		{
-			result.set_value(reply_builder.consume_buffer());
-		}
-		catch (...)
-		{
-		}
-	}
-
-	promise<vector<uint8_t>> result;
-	bool got_reply = false;
-};
-
 struct FSList : FSReadCommand
 {
-	FSList(const string &path, unique_ptr<Socket> socket_)
-		: FSReadCommand(path, NETFS_LIST, move(socket_))
+	FSList(const std::string &path, std::unique_ptr<Socket> socket_)
+		: FSReadCommand(path, NETFS_LIST, std::move(socket_))
 	{
 	}
 
 	~FSList()
 	{
 		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("List failed")));
+			result.set_exception(std::make_exception_ptr(std::runtime_error("List failed")));
 	}
 
 	void parse_reply() override
 	{
 		uint32_t entries = reply_builder.read_u32();
-		vector<ListEntry> list;
+		std::vector<ListEntry> list;
 		for (uint32_t i = 0; i < entries; i++)
 		{
 			auto path = reply_builder.read_string();
@@ -411,13 +386,13 @@ struct FSList : FSReadCommand
 			switch (type)
 			{
 			case NETFS_FILE_TYPE_PLAIN:
-				list.push_back({ move(path), PathType::File });
+				list.push_back({ std::move(path), PathType::File });
 				break;
 			case NETFS_FILE_TYPE_DIRECTORY:
-				list.push_back({ move(path), PathType::Directory });
+				list.push_back({ std::move(path), PathType::Directory });
 				break;
 			case NETFS_FILE_TYPE_SPECIAL:
-				list.push_back({ move(path), PathType::Special });
+				list.push_back({ std::move(path), PathType::Special });
 				break;
 			}
 		}
@@ -425,21 +400,21 @@ struct FSList : FSReadCommand
 		got_reply = true;
 		try
 		{
-			result.set_value(move(list));
+			result.set_value(std::move(list));
 		}
 		catch (...)
 		{
 		}
 	}
 
-	promise<vector<ListEntry>> result;
+	std::promise<std::vector<ListEntry>> result;
 	bool got_reply = false;
 };
 
 struct FSStat : FSReadCommand
 {
-	FSStat(const string &path, unique_ptr<Socket> socket_)
-		: FSReadCommand(path, NETFS_STAT, move(socket_))
+	FSStat(const std::string &path, std::unique_ptr<Socket> socket_)
+		: FSReadCommand(path, NETFS_STAT, std::move(socket_))
 	{
 	}
 
@@ -447,7 +422,7 @@ struct FSStat : FSReadCommand
 	{
 		// Throw exception instead in calling thread.
 		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("Failed stat")));
+			result.set_exception(std::make_exception_ptr(std::runtime_error("Failed stat")));
 	}
 
 	void parse_reply() override
@@ -488,8 +463,8 @@ struct FSStat : FSReadCommand
 
 struct FSWriteCommand : LooperHandler
 {
-	FSWriteCommand(const string &path, const vector<uint8_t> &buffer, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_))
+	FSWriteCommand(const std::string &path, const std::vector<uint8_t> &buffer, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_))
 	{
 		target_size = buffer.size();
 
@@ -537,7 +512,7 @@ struct FSWriteCommand : LooperHandler
 	~FSWriteCommand()
 	{
 		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("Failed write")));
+			result.set_exception(std::make_exception_ptr(std::runtime_error("Failed write")));
 	}
 
 	bool read_reply(Looper &)
@@ -589,13 +564,205 @@ struct FSWriteCommand : LooperHandler
 	ReplyBuilder result_reply;
 	size_t target_size = 0;
 
-	promise<NetFSError> result;
+	std::promise<NetFSError> result;
 	bool got_reply = false;
 };
 
-NetworkFilesystem::NetworkFilesystem()
+// Persistent connection which pipelines ranged reads.
+// Lives on the looper thread and is recreated on demand if the connection drops.
+struct FSRangeStream : LooperHandler
 {
-	looper_thread = thread(&NetworkFilesystem::looper_entry, this);
+	FSRangeStream(NetworkFilesystem &fs_, std::unique_ptr<Socket> socket_, bool allow_lz4_)
+		: LooperHandler(std::move(socket_)), fs(fs_), allow_lz4(allow_lz4_)
+	{
+		ReplyBuilder builder;
+		builder.add_u32(NETFS_READ_RANGES);
+		outgoing = std::move(builder.get_buffer());
+		begin_reply_header();
+	}
+
+	~FSRangeStream()
+	{
+		for (auto &req : in_flight)
+			req->result.set_exception(std::make_exception_ptr(std::runtime_error("Range read failed")));
+		if (fs.stream == this)
+			fs.stream = nullptr;
+	}
+
+	void submit(const std::shared_ptr<NetworkFilesystem::RangeRequest> &req)
+	{
+		ReplyBuilder builder;
+		builder.add_u32(next_request_id++);
+		builder.add_u32(allow_lz4 ? NETFS_RANGE_ALLOW_LZ4_BIT : 0);
+		builder.add_u64(req->offset);
+		builder.add_u64(req->size);
+		builder.add_string(req->path);
+		auto &buffer = builder.get_buffer();
+
+		if (outgoing_offset == outgoing.size() && socket->get_parent_looper())
+			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
+
+		outgoing.insert(outgoing.end(), buffer.begin(), buffer.end());
+		in_flight.push_back(req);
+	}
+
+	void begin_reply_header()
+	{
+		reply.begin(NetFSRangeReplySize);
+		reader.start(reply.get_buffer());
+		reading_payload = false;
+	}
+
+	bool complete_reply()
+	{
+		if (in_flight.empty() || reply_id != first_in_flight_id)
+		{
+			LOGE("Got out-of-order range reply.\n");
+			return false;
+		}
+
+		auto req = std::move(in_flight.front());
+		in_flight.pop_front();
+		first_in_flight_id++;
+
+		if (reply_error != NETFS_ERROR_OK || reply_size != req->size)
+		{
+			req->result.set_exception(std::make_exception_ptr(std::runtime_error("Range read failed")));
+			return true;
+		}
+
+		if (reply_encoding == NETFS_ENCODING_RAW)
+		{
+			req->result.set_value(std::move(payload));
+		}
+#ifdef GRANITE_NETFS_LZ4
+		else if (reply_encoding == NETFS_ENCODING_LZ4)
+		{
+			std::vector<uint8_t> decoded(reply_size);
+			int ret = LZ4_decompress_safe(reinterpret_cast<const char *>(payload.data()),
+			                              reinterpret_cast<char *>(decoded.data()),
+			                              int(payload.size()), int(decoded.size()));
+			if (ret < 0 || uint64_t(ret) != reply_size)
+				req->result.set_exception(std::make_exception_ptr(std::runtime_error("LZ4 decode failed")));
+			else
+				req->result.set_value(std::move(decoded));
+		}
+#endif
+		else
+		{
+			req->result.set_exception(std::make_exception_ptr(std::runtime_error("Unknown encoding")));
+		}
+
+		payload = {};
+		return true;
+	}
+
+	bool handle_write(Looper &looper)
+	{
+		while (outgoing_offset < outgoing.size())
+		{
+			int ret = socket->write(outgoing.data() + outgoing_offset, outgoing.size() - outgoing_offset);
+			if (ret == Socket::ErrorWouldBlock)
+				return true;
+			else if (ret <= 0)
+				return false;
+			outgoing_offset += ret;
+		}
+
+		outgoing.clear();
+		outgoing_offset = 0;
+		looper.modify_handler(EVENT_IN, *this);
+		return true;
+	}
+
+	bool handle_read()
+	{
+		// Drain as many replies as are available.
+		for (;;)
+		{
+			int ret = reader.process(*socket);
+			if (ret == Socket::ErrorWouldBlock)
+				return true;
+			else if (ret <= 0)
+				return false;
+			else if (!reader.complete())
+				continue;
+
+			if (!reading_payload)
+			{
+				reply_id = reply.read_u32();
+				reply_error = reply.read_u32();
+				reply_encoding = reply.read_u32();
+				reply.read_u32();
+				reply_size = reply.read_u64();
+				uint64_t payload_size = reply.read_u64();
+
+				if (payload_size > NetFSMaxRangeSize)
+					return false;
+
+				fs.bytes_received.fetch_add(NetFSRangeReplySize + payload_size, std::memory_order_relaxed);
+
+				if (payload_size == 0)
+				{
+					if (!complete_reply())
+						return false;
+					begin_reply_header();
+				}
+				else
+				{
+					payload.resize(payload_size);
+					reader.start(payload);
+					reading_payload = true;
+				}
+			}
+			else
+			{
+				if (!complete_reply())
+					return false;
+				begin_reply_header();
+			}
+		}
+	}
+
+	bool handle(Looper &looper, EventFlags flags) override
+	{
+		if (flags & (EVENT_ERROR | EVENT_HANGUP))
+			return false;
+		if ((flags & EVENT_OUT) && !handle_write(looper))
+			return false;
+		if ((flags & EVENT_IN) && !handle_read())
+			return false;
+		return true;
+	}
+
+	NetworkFilesystem &fs;
+	bool allow_lz4;
+
+	std::vector<uint8_t> outgoing;
+	size_t outgoing_offset = 0;
+	std::deque<std::shared_ptr<NetworkFilesystem::RangeRequest>> in_flight;
+	uint32_t next_request_id = 0;
+	uint32_t first_in_flight_id = 0;
+
+	SocketReader reader;
+	ReplyBuilder reply;
+	std::vector<uint8_t> payload;
+	bool reading_payload = false;
+	uint32_t reply_id = 0;
+	uint32_t reply_error = 0;
+	uint32_t reply_encoding = 0;
+	uint64_t reply_size = 0;
+};
+
+NetworkFilesystem::NetworkFilesystem(const NetFSOptions &options_)
+	: options(options_)
+{
+	block_cache.set_total_cost(options.cache_size);
+	cache_hits.store(0, std::memory_order_relaxed);
+	cache_misses.store(0, std::memory_order_relaxed);
+	requests.store(0, std::memory_order_relaxed);
+	bytes_received.store(0, std::memory_order_relaxed);
+	looper_thread = std::thread(&NetworkFilesystem::looper_entry, this);
 }
 
 void NetworkFilesystem::looper_entry()
@@ -603,22 +770,26 @@ void NetworkFilesystem::looper_entry()
 	while (looper.wait_idle(-1) >= 0);
 }
 
+std::unique_ptr<Socket> NetworkFilesystem::connect()
+{
+	return Socket::connect(options.host.c_str(), options.port);
+}
+
 void NetworkFilesystem::setup_notification()
 {
-	auto socket = Socket::connect(HOST_IP, 7070);
+	auto socket = connect();
 	if (!socket)
 		return;
-	notify = new FSNotifyCommand(protocol, move(socket));
+	notify = new FSNotifyCommand(protocol, std::move(socket));
 	notify->set_notify_cb([this](const FileNotifyInfo &info) {
 		signal_notification(info);
 	});
 
 	// Move capture would be nice ...
 	looper.run_in_looper([this]() {
-		looper.register_handler(EVENT_OUT, unique_ptr<FSNotifyCommand>(notify));
+		looper.register_handler(EVENT_OUT, std::unique_ptr<FSNotifyCommand>(notify));
 	});
 }
-
 void NetworkFilesystem::uninstall_notification(FileNotifyHandle handle)
 {
 	if (!notify)
@@ -631,10 +802,10 @@ void NetworkFilesystem::uninstall_notification(FileNotifyHandle handle)
 		return;
 	handlers.erase(itr);
 
-	auto *value = new promise<FileNotifyHandle>;
+	auto *value = new std::promise<FileNotifyHandle>;
 	auto result = value->get_future();
 	looper.run_in_looper([this, value, handle]() {
-		notify->push_unregister_notification(handle, move(*value));
+		notify->push_unregister_notification(handle, std::move(*value));
 		delete value;
 	});
 
@@ -649,16 +820,16 @@ void NetworkFilesystem::uninstall_notification(FileNotifyHandle handle)
 
 void NetworkFilesystem::signal_notification(const FileNotifyInfo &info)
 {
-	lock_guard<mutex> holder{lock};
+	std::lock_guard<std::mutex> holder{lock};
 	pending.push_back(info);
 }
 
 void NetworkFilesystem::poll_notifications()
 {
-	vector<FileNotifyInfo> tmp_pending;
+	std::vector<FileNotifyInfo> tmp_pending;
 	{
-		lock_guard<mutex> holder{lock};
-		swap(tmp_pending, pending);
+		std::lock_guard<std::mutex> holder{lock};
+		std::swap(tmp_pending, pending);
 	}
 
 	for (auto &notification : tmp_pending)
@@ -677,18 +848,18 @@ FileNotifyHandle NetworkFilesystem::install_notification(const std::string &path
 	if (!notify)
 		return -1;
 
-	auto *value = new promise<FileNotifyHandle>;
+	auto *value = new std::promise<FileNotifyHandle>;
 	auto result = value->get_future();
 
 	looper.run_in_looper([this, value, path]() {
-		notify->push_register_notification(path, move(*value));
+		notify->push_register_notification(path, std::move(*value));
 		delete value;
 	});
 
 	try
 	{
 		auto handle = result.get();
-		handlers[handle] = move(func);
+		handlers[handle] = std::move(func);
 		return handle;
 	}
 	catch (...)
@@ -697,18 +868,18 @@ FileNotifyHandle NetworkFilesystem::install_notification(const std::string &path
 	}
 }
 
-vector<ListEntry> NetworkFilesystem::list(const std::string &path)
+std::vector<ListEntry> NetworkFilesystem::list(const std::string &path)
 {
 	auto joined = protocol + "://" + path;
-	auto socket = Socket::connect(HOST_IP, 7070);
+	auto socket = connect();
 	if (!socket)
 		return {};
 
-	unique_ptr<FSList> handler(new FSList(joined, move(socket)));
+	std::unique_ptr<FSList> handler(new FSList(joined, std::move(socket)));
 	auto fut = handler->result.get_future();
 
 	looper.run_in_looper([&]() {
-		looper.register_handler(EVENT_OUT, move(handler));
+		looper.register_handler(EVENT_OUT, std::move(handler));
 	});
 
 	try
@@ -721,166 +892,213 @@ vector<ListEntry> NetworkFilesystem::list(const std::string &path)
 	}
 }
 
-NetworkFile::~NetworkFile()
+bool NetworkFilesystem::stat_remote(const std::string &path, FileStat &stat)
 {
-	unmap();
-}
+	auto socket = connect();
+	if (!socket)
+		return false;
 
-NetworkFile *NetworkFile::open(Granite::Looper &looper, const std::string &path, Granite::FileMode mode)
-{
-	auto *file = new NetworkFile;
-	if (!file->init(looper, path, mode))
-	{
-		delete file;
-		return nullptr;
-	}
-	else
-		return file;
-}
+	std::unique_ptr<FSStat> handler(new FSStat(path, std::move(socket)));
+	auto fut = handler->result.get_future();
 
-bool NetworkFile::init(Looper &looper_, const std::string &path_, FileMode mode_)
-{
-	path = path_;
-	mode = mode_;
-	looper = &looper_;
+	looper.run_in_looper([&]() {
+		looper.register_handler(EVENT_OUT, std::move(handler));
+	});
 
-	if (mode == FileMode::ReadWrite)
+	try
 	{
-		LOGE("Unsupported file mode.\n");
-		return false;
+		stat = fut.get();
+		return true;
 	}
-
-	if (mode == FileMode::ReadOnly)
+	catch (...)
 	{
-		if (!reopen())
-		{
-			LOGE("Failed to connect to server.\n");
-			return false;
-		}
+		return false;
 	}
+}
 
-	return true;
+bool NetworkFilesystem::stat(const std::string &path, FileStat &stat)
+{
+	return stat_remote(protocol + "://" + path, stat);
 }
 
-void NetworkFile::unmap()
+FileHandle NetworkFilesystem::open(const std::string &path, FileMode mode)
 {
-	if (mode == FileMode::WriteOnly && has_buffer && need_flush)
+	return NetworkFile::open(*this, protocol + "://" + path, mode);
+}
+
+void NetworkFilesystem::submit_range_requests(const std::vector<std::shared_ptr<RangeRequest>> &reqs)
+{
+	if (!stream)
 	{
-		need_flush = false;
-		auto socket = Socket::connect(HOST_IP, 7070);
+		auto socket = connect();
 		if (!socket)
-			throw runtime_error("Failed to connect to server.");
-
-		auto handler = unique_ptr<FSWriteCommand>(new FSWriteCommand(path, buffer, move(socket)));
-		auto reply = handler->result.get_future();
-		looper->run_in_looper([&handler, this]() {
-			looper->register_handler(EVENT_OUT | EVENT_IN, move(handler));
-		});
-
-		try
 		{
-			NetFSError error = reply.get();
-			if (error != NETFS_ERROR_OK)
-				LOGE("Failed to write file: %s\n", path.c_str());
+			for (auto &req : reqs)
+				req->result.set_exception(std::make_exception_ptr(std::runtime_error("Failed to connect")));
+			return;
 		}
-		catch (...)
+
+#ifdef GRANITE_NETFS_LZ4
+		bool allow_lz4 = options.allow_compression;
+#else
+		bool allow_lz4 = false;
+#endif
+		stream = new FSRangeStream(*this, std::move(socket), allow_lz4);
+		if (!looper.register_handler(EVENT_IN | EVENT_OUT, std::unique_ptr<FSRangeStream>(stream)))
 		{
-			LOGE("Failed to write file: %s\n", path.c_str());
+			for (auto &req : reqs)
+				req->result.set_exception(std::make_exception_ptr(std::runtime_error("Failed to register")));
+			return;
 		}
 	}
+
+	for (auto &req : reqs)
+		stream->submit(req);
 }
 
-bool NetworkFile::reopen()
+bool NetworkFilesystem::read_range(const std::string &path, Util::Hash cache_key, uint64_t file_size,
+                                   uint64_t offset, void *data, size_t size)
 {
-	if (mode == FileMode::ReadOnly)
-	{
-		has_buffer = false;
-		auto socket = Socket::connect(HOST_IP, 7070);
-		if (!socket)
-			return false;
+	const uint64_t block_size = options.block_size;
+	uint64_t first_block = offset / block_size;
+	uint64_t last_block = (offset + size - 1) / block_size;
+	auto *dst = static_cast<uint8_t *>(data);
+
+	const auto get_block_cookie = [cache_key](uint64_t block) -> uint64_t {
+		Util::Hasher h(cache_key);
+		h.u64(block);
+		return h.get();
+	};
 
-		auto *handler = new FSReader(path, move(socket));
-		future = handler->result.get_future();
+	// Copies the part of a block which overlaps the requested range.
+	const auto copy_block = [&](uint64_t block, const uint8_t *block_data) {
+		uint64_t block_begin = block * block_size;
+		uint64_t copy_begin = std::max(block_begin, offset);
+		uint64_t copy_end = std::min(block_begin + block_size, offset + size);
+		memcpy(dst + (copy_begin - offset), block_data + (copy_begin - block_begin), copy_end - copy_begin);
+	};
 
-		// Capture-by-move would be nice here.
-		looper->run_in_looper([handler, this]() {
-			looper->register_handler(EVENT_OUT, unique_ptr<FSReader>(handler));
-		});
+	std::vector<uint64_t> missing;
+	{
+		std::lock_guard<std::mutex> holder{cache_lock};
+		for (uint64_t block = first_block; block <= last_block; block++)
+		{
+			auto *cached = block_cache.find_and_mark_as_recent(get_block_cookie(block));
+			if (cached)
+				copy_block(block, cached->data());
+			else
+				missing.push_back(block);
+		}
 	}
-	return true;
-}
 
-void *NetworkFile::map_write(size_t size)
-{
-	has_buffer = true;
-	need_flush = true;
-	buffer.resize(size);
-	return buffer.empty() ? nullptr : buffer.data();
-}
+	cache_hits.fetch_add(last_block - first_block + 1 - missing.size(), std::memory_order_relaxed);
+	if (missing.empty())
+		return true;
+	cache_misses.fetch_add(missing.size(), std::memory_order_relaxed);
 
-void *NetworkFile::map()
-{
-	try
+	// Coalesce runs of missing blocks, and pipeline all of them on the stream.
+	std::vector<std::shared_ptr<RangeRequest>> reqs;
+	std::vector<uint64_t> req_first_block;
+	uint64_t max_blocks_per_request = std::max<uint64_t>(1, options.max_request_size / block_size);
+
+	for (size_t i = 0; i < missing.size(); )
 	{
-		if (!has_buffer)
+		size_t run = 1;
+		while (i + run < missing.size() && run < max_blocks_per_request &&
+		       missing[i + run] == missing[i] + run)
 		{
-			buffer = future.get();
-			has_buffer = true;
+			run++;
 		}
-		return buffer.empty() ? nullptr : buffer.data();
-	}
-	catch (...)
-	{
-		return nullptr;
+
+		auto req = std::make_shared<RangeRequest>();
+		req->path = path;
+		req->offset = missing[i] * block_size;
+		req->size = std::min(file_size, (missing[i] + run) * block_size) - req->offset;
+		reqs.push_back(std::move(req));
+		req_first_block.push_back(missing[i]);
+		i += run;
 	}
-}
 
-size_t NetworkFile::get_size()
-{
-	try
+	std::vector<std::future<std::vector<uint8_t>>> futures;
+	futures.reserve(reqs.size());
+	for (auto &req : reqs)
+		futures.push_back(req->result.get_future());
+
+	requests.fetch_add(reqs.size(), std::memory_order_relaxed);
+	looper.run_in_looper([this, reqs]() {
+		submit_range_requests(reqs);
+	});
+
+	bool success = true;
+	for (size_t i = 0; i < futures.size(); i++)
 	{
-		if (!has_buffer)
+		std::vector<uint8_t> result;
+		try
 		{
-			buffer = future.get();
-			has_buffer = true;
+			result = futures[i].get();
 		}
-		return buffer.size();
-	}
-	catch (...)
-	{
-		return 0;
+		catch (...)
+		{
+			LOGE("Failed to read range [%llu, +%llu] of %s.\n",
+			     static_cast<unsigned long long>(reqs[i]->offset),
+			     static_cast<unsigned long long>(reqs[i]->size),
+			     path.c_str());
+			success = false;
+			continue;
+		}
+
+		std::lock_guard<std::mutex> holder{cache_lock};
+		for (uint64_t block_offset = 0; block_offset < result.size(); block_offset += block_size)
+		{
+			uint64_t block = req_first_block[i] + block_offset / block_size;
+			uint64_t block_bytes = std::min<uint64_t>(block_size, result.size() - block_offset);
+			copy_block(block, result.data() + block_offset);
+
+			auto *entry = block_cache.allocate(get_block_cookie(block), block_bytes);
+			entry->assign(result.begin() + block_offset, result.begin() + block_offset + block_bytes);
+		}
+		block_cache.prune();
 	}
-}
 
-unique_ptr<File> NetworkFilesystem::open(const std::string &path, FileMode mode)
-{
-	auto joined = protocol + "://" + path;
-	return unique_ptr<File>(NetworkFile::open(looper, move(joined), mode));
+	return success;
 }
 
-bool NetworkFilesystem::stat(const std::string &path, FileStat &stat)
+bool NetworkFilesystem::write_file(const std::string &path, const std::vector<uint8_t> &buffer)
 {
-	auto joined = protocol + "://" + path;
-	auto socket = Socket::connect(HOST_IP, 7070);
+	auto socket = connect();
 	if (!socket)
+	{
+		LOGE("Failed to connect to server.\n");
 		return false;
+	}
 
-	unique_ptr<FSStat> handler(new FSStat(joined, move(socket)));
-	auto fut = handler->result.get_future();
-
-	looper.run_in_looper([&]() {
-		looper.register_handler(EVENT_OUT, move(handler));
+	auto handler = std::unique_ptr<FSWriteCommand>(new FSWriteCommand(path, buffer, std::move(socket)));
+	auto reply = handler->result.get_future();
+	looper.run_in_looper([&handler, this]() {
+		looper.register_handler(EVENT_OUT | EVENT_IN, std::move(handler));
 	});
 
 	try
 	{
-		stat = fut.get();
-		return true;
+		if (reply.get() == NETFS_ERROR_OK)
+			return true;
 	}
 	catch (...)
 	{
-		return false;
 	}
+
+	LOGE("Failed to write file: %s\n", path.c_str());
+	return false;
+}
+
+NetworkFilesystem::Statistics NetworkFilesystem::get_statistics() const
+{
+	Statistics stats = {};
+	stats.cache_hits = cache_hits.load(std::memory_order_relaxed);
+	stats.cache_misses = cache_misses.load(std::memory_order_relaxed);
+	stats.requests = requests.load(std::memory_order_relaxed);
+	stats.bytes_received = bytes_received.load(std::memory_order_relaxed);
+	return stats;
 }
 
 NetworkFilesystem::~NetworkFilesystem()
@@ -892,4 +1110,97 @@ NetworkFilesystem::~NetworkFilesystem()
 	if (looper_thread.joinable())
 		looper_thread.join();
 }
+
+NetworkFile::NetworkFile(NetworkFilesystem &fs_)
+	: fs(fs_)
+{
+}
+
+NetworkFile::~NetworkFile()
+{
+}
+
+FileHandle NetworkFile::open(NetworkFilesystem &fs, const std::string &path, FileMode mode)
+{
+	auto file = Util::make_handle<NetworkFile>(fs);
+	if (!file->init(path, mode))
+		file.reset();
+	return file;
+}
+
+bool NetworkFile::init(const std::string &path_, FileMode mode_)
+{
+	path = path_;
+	mode = mode_;
+
+	if (mode == FileMode::ReadWrite)
+	{
+		LOGE("Unsupported file mode.\n");
+		return false;
+	}
+
+	if (mode == FileMode::ReadOnly)
+	{
+		FileStat s = {};
+		if (!fs.stat_remote(path, s) || s.type != PathType::File)
+			return false;
+
+		size = s.size;
+
+		// Blocks from an older revision of the file can never alias.
+		Util::Hasher h;
+		h.string(path);
+		h.u64(s.size);
+		h.u64(s.last_modified);
+		cache_key = h.get();
+	}
+
+	return true;
+}
+
+FileMappingHandle NetworkFile::map_subset(uint64_t offset, size_t range)
+{
+	if (mode != FileMode::ReadOnly || offset + range > size)
+		return {};
+
+	void *mapped = malloc(std::max<size_t>(range, 1));
+	if (!mapped)
+		return {};
+
+	if (range && !fs.read_range(path, cache_key, size, offset, mapped, range))
+	{
+		free(mapped);
+		return {};
+	}
+
+	return Util::make_handle<FileMapping>(
+		reference_from_this(), offset,
+		mapped, range,
+		0, range);
+}
+
+FileMappingHandle NetworkFile::map_write(size_t map_size)
+{
+	if (mode == FileMode::ReadOnly)
+		return {};
+
+	write_buffer.resize(map_size);
+	return Util::make_handle<FileMapping>(
+		reference_from_this(), 0,
+		write_buffer.data(), map_size,
+		0, map_size);
+}
+
+void NetworkFile::unmap(void *mapped, size_t)
+{
+	if (mode == FileMode::ReadOnly)
+		free(mapped);
+	else
+		fs.write_file(path, write_buffer);
+}
+
+uint64_t NetworkFile::get_size()
+{
+	return mode == FileMode::ReadOnly ? size : write_buffer.size();
+}
 }
@@ -21,48 +21,68 @@
  */
 
 #pragma once
-#include "fs-netfs.hpp"
 #include "network.hpp"
-#include "../filesystem.hpp"
+#include "filesystem.hpp"
 #include "netfs.hpp"
+#include "lru_cache.hpp"
 #include <unordered_map>
 #include <future>
 #include <thread>
+#include <mutex>
+#include <atomic>
 
 namespace Granite
 {
-struct FSReader;
-class NetworkFile : public File
+struct NetFSOptions
+{
+	std::string host = "localhost";
+	uint16_t port = 7070;
+
+	// Reads are fetched and cached in blocks of this size.
+	uint64_t block_size = 256 * 1024;
+	uint64_t cache_size = 256 * 1024 * 1024;
+
+	// Adjacent missing blocks are coalesced into one ranged request up to this size.
+	uint64_t max_request_size = 4 * 1024 * 1024;
+
+	// Only has an effect if both client and server are built with GRANITE_NETFS_LZ4.
+	bool allow_compression = true;
+};
+
+class NetworkFilesystem;
+
+class NetworkFile final : public File
 {
 public:
-	static NetworkFile *open(Looper &looper, const std::string &path, FileMode mode);
-	~NetworkFile();
-	void *map() override;
-	void *map_write(size_t size) override;
-	void unmap() override;
-	size_t get_size() override;
-	bool reopen() override;
+	static FileHandle open(NetworkFilesystem &fs, const std::string &path, FileMode mode);
+	explicit NetworkFile(NetworkFilesystem &fs);
+	~NetworkFile() override;
+
+	FileMappingHandle map_subset(uint64_t offset, size_t range) override;
+	FileMappingHandle map_write(size_t size) override;
+	void unmap(void *mapped, size_t range) override;
+	uint64_t get_size() override;
 
 private:
-	NetworkFile() = default;
-	bool init(Looper &looper, const std::string &path, FileMode mode);
+	bool init(const std::string &path, FileMode mode);
+	NetworkFilesystem &fs;
 	std::string path;
-	FileMode mode;
-	Looper *looper = nullptr;
-	std::future<std::vector<uint8_t>> future;
-	std::vector<uint8_t> buffer;
-	bool has_buffer = false;
-	bool need_flush = false;
+	FileMode mode = FileMode::ReadOnly;
+	uint64_t size = 0;
+	Util::Hash cache_key = 0;
+	std::vector<uint8_t> write_buffer;
 };
 
 struct FSNotifyCommand;
+struct FSRangeStream;
+
 class NetworkFilesystem : public FilesystemBackend
 {
 public:
-	NetworkFilesystem();
-	~NetworkFilesystem();
+	explicit NetworkFilesystem(const NetFSOptions &options = {});
+	~NetworkFilesystem() override;
 	std::vector<ListEntry> list(const std::string &path) override;
-	std::unique_ptr<File> open(const std::string &path, FileMode mode) override;
+	FileHandle open(const std::string &path, FileMode mode) override;
 	bool stat(const std::string &path, FileStat &stat) override;
 
 	FileNotifyHandle install_notification(const std::string &path, std::function<void (const FileNotifyInfo &)> func) override;
@@ -76,11 +96,49 @@ public:
 		return -1;
 	}
 
+	struct Statistics
+	{
+		uint64_t cache_hits;
+		uint64_t cache_misses;
+		uint64_t requests;
+		uint64_t bytes_received;
+	};
+	Statistics get_statistics() const;
+
+	// Used by NetworkFile. Paths are fully qualified with protocol.
+	bool stat_remote(const std::string &path, FileStat &stat);
+	bool read_range(const std::string &path, Util::Hash cache_key, uint64_t file_size,
+	                uint64_t offset, void *data, size_t size);
+	bool write_file(const std::string &path, const std::vector<uint8_t> &buffer);
+
+	struct RangeRequest
+	{
+		std::string path;
+		uint64_t offset;
+		uint64_t size;
+		std::promise<std::vector<uint8_t>> result;
+	};
+
 private:
+	NetFSOptions options;
+
+	// Only accessed on the looper thread. Declared before looper since handlers are torn down with it.
+	FSRangeStream *stream = nullptr;
+	FSNotifyCommand *notify = nullptr;
+	friend struct FSRangeStream;
+
 	std::thread looper_thread;
 	Looper looper;
 	void looper_entry();
-	FSNotifyCommand *notify = nullptr;
+	std::unique_ptr<Socket> connect();
+	void submit_range_requests(const std::vector<std::shared_ptr<RangeRequest>> &requests);
+
+	std::mutex cache_lock;
+	Util::LRUCache<std::vector<uint8_t>> block_cache;
+	std::atomic<uint64_t> cache_hits;
+	std::atomic<uint64_t> cache_misses;
+	std::atomic<uint64_t> requests;
+	std::atomic<uint64_t> bytes_received;
 
 	std::unordered_map<FileNotifyHandle, std::function<void (const FileNotifyInfo &)>> handlers;
 	std::mutex lock;
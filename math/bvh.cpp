@@ -0,0 +1,230 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bvh.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace Granite
+{
+// A refitted tree is considered degraded once the summed node surface area grows this much beyond a fresh build.
+static constexpr float MaxRefitCostRatio = 1.5f;
+
+constexpr uint32_t BVH::InvalidNode;
+
+static float surface_area(const AABB &aabb)
+{
+	vec3 d = max(aabb.get_maximum() - aabb.get_minimum(), vec3(0.0f));
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static AABB empty_aabb()
+{
+	return AABB(vec3(std::numeric_limits<float>::max()), vec3(-std::numeric_limits<float>::max()));
+}
+
+void BVH::clear()
+{
+	nodes.clear();
+	leaves.clear();
+	aabb_to_node.clear();
+	task_roots.clear();
+	dirty_nodes.clear();
+	dirty_mask.clear();
+	build_cost = 0.0f;
+	current_cost = 0.0f;
+}
+
+void BVH::build(const AABB *aabbs, const Leaf *input_leaves, size_t count)
+{
+	clear();
+	if (!count)
+		return;
+
+	leaves.assign(input_leaves, input_leaves + count);
+	nodes.reserve(2 * (count / LeafSize + 1));
+	build_recursive(aabbs, 0, uint32_t(count), InvalidNode);
+
+	uint32_t max_offset = 0;
+	for (auto &leaf : leaves)
+		max_offset = std::max(max_offset, leaf.aabb_offset);
+	aabb_to_node.resize(max_offset + 1, InvalidNode);
+
+	for (uint32_t i = 0; i < nodes.size(); i++)
+	{
+		auto &node = nodes[i];
+		if (node.right_child == InvalidNode)
+			for (uint32_t j = 0; j < node.leaf_count; j++)
+				aabb_to_node[leaves[node.first_leaf + j].aabb_offset] = i;
+		build_cost += surface_area(node.aabb);
+	}
+
+	current_cost = build_cost;
+	dirty_mask.resize(nodes.size());
+	build_task_roots();
+}
+
+uint32_t BVH::build_recursive(const AABB *aabbs, uint32_t first_leaf, uint32_t leaf_count, uint32_t parent)
+{
+	uint32_t node_index = uint32_t(nodes.size());
+	nodes.emplace_back();
+
+	AABB bounds = empty_aabb();
+	AABB centroid_bounds = empty_aabb();
+	for (uint32_t i = first_leaf; i < first_leaf + leaf_count; i++)
+	{
+		auto &aabb = aabbs[leaves[i].aabb_offset];
+		vec3 center = aabb.get_center();
+		bounds.expand(aabb);
+		centroid_bounds.expand(AABB(center, center));
+	}
+
+	auto &node = nodes[node_index];
+	node.aabb = bounds;
+	node.first_leaf = first_leaf;
+	node.leaf_count = leaf_count;
+	node.right_child = InvalidNode;
+	node.parent = parent;
+
+	if (leaf_count <= LeafSize)
+		return node_index;
+
+	// Median split along the axis with largest centroid spread.
+	vec3 extent = centroid_bounds.get_maximum() - centroid_bounds.get_minimum();
+	int axis = 0;
+	if (extent.y > extent[axis])
+		axis = 1;
+	if (extent.z > extent[axis])
+		axis = 2;
+
+	uint32_t left_count = leaf_count / 2;
+	auto begin_itr = leaves.begin() + first_leaf;
+	std::nth_element(begin_itr, begin_itr + left_count, begin_itr + leaf_count,
+	                 [aabbs, axis](const Leaf &a, const Leaf &b) {
+		                 return aabbs[a.aabb_offset].get_center()[axis] < aabbs[b.aabb_offset].get_center()[axis];
+	                 });
+
+	build_recursive(aabbs, first_leaf, left_count, node_index);
+	uint32_t right_child = build_recursive(aabbs, first_leaf + left_count, leaf_count - left_count, node_index);
+	nodes[node_index].right_child = right_child;
+	return node_index;
+}
+
+void BVH::build_task_roots()
+{
+	task_roots.clear();
+	task_roots.push_back(0);
+
+	std::vector<uint32_t> next_roots;
+	bool split = true;
+	while (split && task_roots.size() < TargetTaskRoots)
+	{
+		split = false;
+		next_roots.clear();
+		for (auto &root : task_roots)
+		{
+			auto &node = nodes[root];
+			if (node.right_child != InvalidNode)
+			{
+				next_roots.push_back(root + 1);
+				next_roots.push_back(node.right_child);
+				split = true;
+			}
+			else
+				next_roots.push_back(root);
+		}
+		std::swap(task_roots, next_roots);
+	}
+}
+
+void BVH::refit_node(const AABB *aabbs, uint32_t node_index)
+{
+	auto &node = nodes[node_index];
+	float old_area = surface_area(node.aabb);
+
+	AABB bounds = empty_aabb();
+	if (node.right_child == InvalidNode)
+	{
+		for (uint32_t i = 0; i < node.leaf_count; i++)
+			bounds.expand(aabbs[leaves[node.first_leaf + i].aabb_offset]);
+	}
+	else
+	{
+		bounds.expand(nodes[node_index + 1].aabb);
+		bounds.expand(nodes[node.right_child].aabb);
+	}
+
+	node.aabb = bounds;
+	current_cost += surface_area(bounds) - old_area;
+}
+
+void BVH::mark_dirty_path(uint32_t aabb_offset)
+{
+	if (aabb_offset >= aabb_to_node.size())
+		return;
+
+	uint32_t node_index = aabb_to_node[aabb_offset];
+	while (node_index != InvalidNode && !dirty_mask[node_index])
+	{
+		dirty_mask[node_index] = 1;
+		dirty_nodes.push_back(node_index);
+		node_index = nodes[node_index].parent;
+	}
+}
+
+void BVH::refit_dirty_paths(const AABB *aabbs)
+{
+	// Children always have higher node indices than their parent.
+	std::sort(dirty_nodes.begin(), dirty_nodes.end(), std::greater<uint32_t>());
+	for (auto node_index : dirty_nodes)
+	{
+		refit_node(aabbs, node_index);
+		dirty_mask[node_index] = 0;
+	}
+	dirty_nodes.clear();
+}
+
+void BVH::refit(const AABB *aabbs, const uint32_t *aabb_offsets, size_t count)
+{
+	refit(aabbs, count, [&](const auto &mark) {
+		for (size_t i = 0; i < count; i++)
+			mark(aabb_offsets[i]);
+	});
+}
+
+void BVH::refit_all(const AABB *aabbs)
+{
+	for (size_t i = nodes.size(); i; i--)
+		refit_node(aabbs, uint32_t(i - 1));
+
+	// Avoid accumulating float error over time.
+	current_cost = 0.0f;
+	for (auto &node : nodes)
+		current_cost += surface_area(node.aabb);
+}
+
+bool BVH::needs_rebuild() const
+{
+	return current_cost > build_cost * MaxRefitCostRatio;
+}
+}
@@ -0,0 +1,192 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "aabb.hpp"
+#include "frustum.hpp"
+#include <vector>
+#include <stdint.h>
+
+namespace Granite
+{
+// Bounding volume hierarchy over externally owned AABBs.
+// Leaves refer to AABBs by offset, so the AABB storage can be reallocated freely.
+// Node bounds are kept in sync with refit(), and the tree should be rebuilt when needs_rebuild() is true.
+class BVH
+{
+public:
+	struct Leaf
+	{
+		uint32_t aabb_offset;
+		uint32_t index;
+	};
+
+	void build(const AABB *aabbs, const Leaf *leaves, size_t count);
+	void clear();
+
+	// Updates node bounds for a set of modified AABBs. Unknown offsets are ignored.
+	void refit(const AABB *aabbs, const uint32_t *aabb_offsets, size_t count);
+
+	// Same as above, but for_each_offset(func) calls func(offset) for every modified AABB,
+	// so callers which track modifications in other structures need not build an offset list.
+	template <typename ForEachOffset>
+	void refit(const AABB *aabbs, size_t count, const ForEachOffset &for_each_offset)
+	{
+		if (nodes.empty() || !count)
+			return;
+
+		// With a large fraction of the scene moving, a linear sweep is cheaper than tracking dirty paths.
+		if (count * 4 > leaves.size())
+		{
+			refit_all(aabbs);
+			return;
+		}
+
+		for_each_offset([this](uint32_t offset) { mark_dirty_path(offset); });
+		refit_dirty_paths(aabbs);
+	}
+	void refit_all(const AABB *aabbs);
+
+	// True if refits have degraded the tree enough that a full rebuild is worthwhile.
+	bool needs_rebuild() const;
+
+	size_t get_leaf_count() const
+	{
+		return leaves.size();
+	}
+
+	// Number of independent sub-trees which can be traversed in parallel.
+	unsigned get_task_root_count() const
+	{
+		return unsigned(task_roots.size());
+	}
+
+	// Calls func(leaf_index) for every leaf which intersects the frustum.
+	template <typename Func>
+	void for_each_visible(const AABB *aabbs, const Frustum &frustum, const Func &func) const
+	{
+		if (!nodes.empty())
+			traverse(aabbs, frustum.get_planes(), 0, AllPlanesMask, func);
+	}
+
+	// Traverses a subset of task roots, so that all subsets together cover the entire tree.
+	template <typename Func>
+	void for_each_visible_subset(const AABB *aabbs, const Frustum &frustum,
+	                             unsigned index, unsigned num_indices, const Func &func) const
+	{
+		size_t begin_index = (index * task_roots.size()) / num_indices;
+		size_t end_index = ((index + 1) * task_roots.size()) / num_indices;
+		for (size_t i = begin_index; i < end_index; i++)
+			traverse(aabbs, frustum.get_planes(), task_roots[i], AllPlanesMask, func);
+	}
+
+private:
+	enum { LeafSize = 4, TargetTaskRoots = 64, AllPlanesMask = 0x3f };
+	static constexpr uint32_t InvalidNode = UINT32_MAX;
+
+	struct Node
+	{
+		AABB aabb;
+		uint32_t first_leaf;
+		uint32_t leaf_count;
+		// Left child is always the next node.
+		uint32_t right_child;
+		uint32_t parent;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Leaf> leaves;
+	std::vector<uint32_t> aabb_to_node;
+	std::vector<uint32_t> task_roots;
+	std::vector<uint32_t> dirty_nodes;
+	std::vector<uint8_t> dirty_mask;
+	float build_cost = 0.0f;
+	float current_cost = 0.0f;
+
+	uint32_t build_recursive(const AABB *aabbs, uint32_t first_leaf, uint32_t leaf_count, uint32_t parent);
+	void build_task_roots();
+	void refit_node(const AABB *aabbs, uint32_t node_index);
+	void mark_dirty_path(uint32_t aabb_offset);
+	void refit_dirty_paths(const AABB *aabbs);
+
+	// Returns false if fully outside. Clears bits from plane_mask for planes which fully contain the AABB.
+	static inline bool classify(const AABB &aabb, const vec4 *planes, uint32_t &plane_mask)
+	{
+		auto &lo = aabb.get_minimum();
+		auto &hi = aabb.get_maximum();
+
+		for (unsigned i = 0; i < 6; i++)
+		{
+			if ((plane_mask & (1u << i)) == 0)
+				continue;
+
+			auto &p = planes[i];
+			vec3 major(p.x > 0.0f ? hi.x : lo.x, p.y > 0.0f ? hi.y : lo.y, p.z > 0.0f ? hi.z : lo.z);
+			vec3 minor(p.x > 0.0f ? lo.x : hi.x, p.y > 0.0f ? lo.y : hi.y, p.z > 0.0f ? lo.z : hi.z);
+
+			if (dot(p.xyz(), major) + p.w < 0.0f)
+				return false;
+			if (dot(p.xyz(), minor) + p.w >= 0.0f)
+				plane_mask &= ~(1u << i);
+		}
+
+		return true;
+	}
+
+	template <typename Func>
+	void traverse(const AABB *aabbs, const vec4 *planes, uint32_t node_index,
+	              uint32_t plane_mask, const Func &func) const
+	{
+		for (;;)
+		{
+			auto &node = nodes[node_index];
+			if (!classify(node.aabb, planes, plane_mask))
+				return;
+
+			if (plane_mask == 0)
+			{
+				// Fully inside, no need to test anything further down.
+				for (uint32_t i = 0; i < node.leaf_count; i++)
+					func(leaves[node.first_leaf + i].index);
+				return;
+			}
+
+			if (node.right_child == InvalidNode)
+			{
+				for (uint32_t i = 0; i < node.leaf_count; i++)
+				{
+					auto &leaf = leaves[node.first_leaf + i];
+					uint32_t leaf_mask = plane_mask;
+					if (classify(aabbs[leaf.aabb_offset], planes, leaf_mask))
+						func(leaf.index);
+				}
+				return;
+			}
+
+			traverse(aabbs, planes, node.right_child, plane_mask, func);
+			node_index++;
+		}
+	}
+};
+}
@@ -0,0 +1,123 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "simd_headers.hpp"
+#include <math.h>
+
+namespace Granite
+{
+namespace SIMD
+{
+// Minimal wrapper for writing SoA kernels once for every instruction set.
+// Kernels process Batch::Width lanes at a time. Loads and stores do not require alignment.
+namespace Batch
+{
+#if defined(__AVX__)
+using Float = __m256;
+using Mask = __m256;
+enum { Width = 8 };
+static inline Float load(const float *v) { return _mm256_loadu_ps(v); }
+static inline void store(float *v, Float x) { _mm256_storeu_ps(v, x); }
+static inline Float splat(float v) { return _mm256_set1_ps(v); }
+static inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+static inline Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+static inline Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+static inline Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+static inline Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+static inline Mask cmp_eq(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline Mask cmp_lt(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+#elif defined(__SSE__)
+using Float = __m128;
+using Mask = __m128;
+enum { Width = 4 };
+static inline Float load(const float *v) { return _mm_loadu_ps(v); }
+static inline void store(float *v, Float x) { _mm_storeu_ps(v, x); }
+static inline Float splat(float v) { return _mm_set1_ps(v); }
+static inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+static inline Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+static inline Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+static inline Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+static inline Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+static inline Mask cmp_eq(Float a, Float b) { return _mm_cmpeq_ps(a, b); }
+static inline Mask cmp_lt(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+static inline Float select(Mask m, Float a, Float b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+#elif defined(__ARM_NEON)
+using Float = float32x4_t;
+using Mask = uint32x4_t;
+enum { Width = 4 };
+static inline Float load(const float *v) { return vld1q_f32(v); }
+static inline void store(float *v, Float x) { vst1q_f32(v, x); }
+static inline Float splat(float v) { return vdupq_n_f32(v); }
+static inline Float add(Float a, Float b) { return vaddq_f32(a, b); }
+static inline Float sub(Float a, Float b) { return vsubq_f32(a, b); }
+static inline Float mul(Float a, Float b) { return vmulq_f32(a, b); }
+#if defined(__aarch64__)
+static inline Float div(Float a, Float b) { return vdivq_f32(a, b); }
+static inline Float sqrt(Float a) { return vsqrtq_f32(a); }
+#else
+static inline Float div(Float a, Float b)
+{
+	float32x4_t r = vrecpeq_f32(b);
+	r = vmulq_f32(r, vrecpsq_f32(b, r));
+	r = vmulq_f32(r, vrecpsq_f32(b, r));
+	return vmulq_f32(a, r);
+}
+
+static inline Float sqrt(Float a)
+{
+	// Guard against 0 * inf.
+	float32x4_t safe = vmaxq_f32(a, vdupq_n_f32(1e-30f));
+	float32x4_t r = vrsqrteq_f32(safe);
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(safe, r), r));
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(safe, r), r));
+	return vmulq_f32(a, r);
+}
+#endif
+static inline Float max(Float a, Float b) { return vmaxq_f32(a, b); }
+static inline Mask cmp_eq(Float a, Float b) { return vceqq_f32(a, b); }
+static inline Mask cmp_lt(Float a, Float b) { return vcltq_f32(a, b); }
+static inline Float select(Mask m, Float a, Float b) { return vbslq_f32(m, a, b); }
+#else
+using Float = float;
+using Mask = bool;
+enum { Width = 1 };
+static inline Float load(const float *v) { return *v; }
+static inline void store(float *v, Float x) { *v = x; }
+static inline Float splat(float v) { return v; }
+static inline Float add(Float a, Float b) { return a + b; }
+static inline Float sub(Float a, Float b) { return a - b; }
+static inline Float mul(Float a, Float b) { return a * b; }
+static inline Float div(Float a, Float b) { return a / b; }
+static inline Float max(Float a, Float b) { return a > b ? a : b; }
+static inline Float sqrt(Float a) { return ::sqrtf(a); }
+static inline Mask cmp_eq(Float a, Float b) { return a == b; }
+static inline Mask cmp_lt(Float a, Float b) { return a < b; }
+static inline Float select(Mask m, Float a, Float b) { return m ? a : b; }
+#endif
+}
+}
+}
@@ -23,6 +23,7 @@
 #include "transforms.hpp"
 #include "aabb.hpp"
 #include "simd.hpp"
+#include "simd_batch.hpp"
 #include "muglm/matrix_helper.hpp"
 #include <assert.h>
 
@@ -108,6 +109,88 @@ void compute_model_transform(mat_affine &world, vec3 s, quat rot, vec3 trans, co
 	SIMD::mul(world, parent, mat_affine(model));
 }
 
+void ModelTransformBatch::set_lane(unsigned lane, const vec3 &s, const quat &rot, const vec3 &trans,
+                                   const mat_affine &parent_transform)
+{
+	for (unsigned i = 0; i < 3; i++)
+	{
+		scale[i][lane] = s[i];
+		translation[i][lane] = trans[i];
+	}
+
+	rotation[0][lane] = rot.x;
+	rotation[1][lane] = rot.y;
+	rotation[2][lane] = rot.z;
+	rotation[3][lane] = rot.w;
+
+	for (unsigned i = 0; i < 12; i++)
+		parent[i][lane] = parent_transform[i >> 2][i & 3];
+}
+
+void ModelTransformBatch::get_lane(unsigned lane, mat_affine &world_transform) const
+{
+	for (unsigned i = 0; i < 12; i++)
+		world_transform[i >> 2][i & 3] = world[i][lane];
+}
+
+void compute_model_transforms(ModelTransformBatch &batch)
+{
+	using namespace SIMD::Batch;
+	static_assert(ModelTransformBatch::Size % Width == 0, "Batch size must be a multiple of SIMD width.");
+
+	const Float one = splat(1.0f);
+	const Float two = splat(2.0f);
+
+	for (unsigned lane = 0; lane < ModelTransformBatch::Size; lane += Width)
+	{
+		Float x = load(&batch.rotation[0][lane]);
+		Float y = load(&batch.rotation[1][lane]);
+		Float z = load(&batch.rotation[2][lane]);
+		Float w = load(&batch.rotation[3][lane]);
+
+		Float xx = mul(x, x), yy = mul(y, y), zz = mul(z, z);
+		Float xy = mul(x, y), xz = mul(x, z), yz = mul(y, z);
+		Float wx = mul(w, x), wy = mul(w, y), wz = mul(w, z);
+
+		Float sx = load(&batch.scale[0][lane]);
+		Float sy = load(&batch.scale[1][lane]);
+		Float sz = load(&batch.scale[2][lane]);
+
+		// Columns of the scaled rotation matrix, same as mat3_cast(q) * scale.
+		Float m[3][3];
+		m[0][0] = mul(sub(one, mul(two, add(yy, zz))), sx);
+		m[0][1] = mul(mul(two, add(xy, wz)), sx);
+		m[0][2] = mul(mul(two, sub(xz, wy)), sx);
+		m[1][0] = mul(mul(two, sub(xy, wz)), sy);
+		m[1][1] = mul(sub(one, mul(two, add(xx, zz))), sy);
+		m[1][2] = mul(mul(two, add(yz, wx)), sy);
+		m[2][0] = mul(mul(two, add(xz, wy)), sz);
+		m[2][1] = mul(mul(two, sub(yz, wx)), sz);
+		m[2][2] = mul(sub(one, mul(two, add(xx, yy))), sz);
+
+		Float t[3];
+		for (unsigned i = 0; i < 3; i++)
+			t[i] = load(&batch.translation[i][lane]);
+
+		for (unsigned row = 0; row < 3; row++)
+		{
+			Float p0 = load(&batch.parent[row * 4 + 0][lane]);
+			Float p1 = load(&batch.parent[row * 4 + 1][lane]);
+			Float p2 = load(&batch.parent[row * 4 + 2][lane]);
+			Float p3 = load(&batch.parent[row * 4 + 3][lane]);
+
+			for (unsigned col = 0; col < 3; col++)
+			{
+				Float v = add(add(mul(p0, m[col][0]), mul(p1, m[col][1])), mul(p2, m[col][2]));
+				store(&batch.world[row * 4 + col][lane], v);
+			}
+
+			Float v = add(add(add(mul(p0, t[0]), mul(p1, t[1])), mul(p2, t[2])), p3);
+			store(&batch.world[row * 4 + 3][lane], v);
+		}
+	}
+}
+
 void compute_normal_transform(mat4 &normal, const mat4 &world)
 {
 	normal = mat4(transpose(inverse(mat3(world))));
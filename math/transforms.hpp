@@ -37,6 +37,25 @@ bool compute_plane_refraction(mat4 &projection, mat4 &view, vec3 camera_pos, vec
 
 void compute_model_transform(mat_affine &world, vec3 scale, quat rotation, vec3 translation, const mat_affine &parent);
 
+// SoA batch for computing many model transforms at once.
+// Lanes are filled by the caller, and compute_model_transforms() computes world = parent * TRS for every lane.
+// Unused lanes must still be initialized, but their results can be ignored.
+struct ModelTransformBatch
+{
+	enum { Size = 8 };
+	alignas(32) float scale[3][Size];
+	alignas(32) float rotation[4][Size];
+	alignas(32) float translation[3][Size];
+	// Parent and world transforms are stored as mat_affine rows, i.e. element [row * 4 + col].
+	alignas(32) float parent[12][Size];
+	alignas(32) float world[12][Size];
+
+	void set_lane(unsigned lane, const vec3 &s, const quat &rot, const vec3 &trans, const mat_affine &parent_transform);
+	void get_lane(unsigned lane, mat_affine &world_transform) const;
+};
+
+void compute_model_transforms(ModelTransformBatch &batch);
+
 void compute_normal_transform(mat4 &normal, const mat4 &world);
 void compute_normal_transform(mat_affine &normal, const mat_affine &world);
 
@@ -29,6 +29,7 @@
 #include <arpa/inet.h>
 #endif
 #include <string.h>
+#include <stdint.h>
 #include <string>
 
 namespace Granite
@@ -45,7 +46,8 @@ enum NetFSCommand
 	NETFS_UNREGISTER_NOTIFICATION = 8,
 	NETFS_BEGIN_CHUNK_REQUEST = 9,
 	NETFS_BEGIN_CHUNK_REPLY = 10,
-	NETFS_BEGIN_CHUNK_NOTIFICATION = 11
+	NETFS_BEGIN_CHUNK_NOTIFICATION = 11,
+	NETFS_READ_RANGES = 12
 };
 
 enum NetFSError
@@ -68,6 +70,27 @@ enum NetFSFileType
 	NETFS_FILE_TYPE_SPECIAL = 3
 };
 
+// NETFS_READ_RANGES turns the connection into a pipelined read stream.
+// The client may send any number of range requests without waiting for replies.
+// Request: u32 request_id, u32 flags, u64 offset, u64 size, u64 path_size, followed by the path.
+// Replies come back in request order.
+// Reply: u32 request_id, u32 error, u32 encoding, u32 reserved, u64 size, u64 payload_size, followed by the payload.
+enum NetFSRangeFlagBits
+{
+	NETFS_RANGE_ALLOW_LZ4_BIT = 1 << 0
+};
+
+enum NetFSEncoding
+{
+	NETFS_ENCODING_RAW = 0,
+	NETFS_ENCODING_LZ4 = 1
+};
+
+static constexpr size_t NetFSRangeRequestSize = 32;
+static constexpr size_t NetFSRangeReplySize = 32;
+static constexpr uint64_t NetFSMaxRangeSize = 16 * 1024 * 1024;
+static constexpr uint64_t NetFSMaxPathSize = 4096;
+
 class ReplyBuilder
 {
 public:
@@ -169,7 +192,7 @@ public:
 
 	std::vector<uint8_t> &&consume_buffer()
 	{
-		return move(buffer);
+		return std::move(buffer);
 	}
 
 	void begin(size_t size = 0)
@@ -20,29 +20,34 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include "netfs_server.hpp"
 #include "network.hpp"
 #include "logging.hpp"
 #include "netfs.hpp"
 #include "filesystem.hpp"
-#include "event.hpp"
 #include <unordered_set>
 #include <queue>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef GRANITE_NETFS_LZ4
+#include <lz4.h>
+#endif
 
-using namespace Granite;
-
+namespace Granite
+{
 struct FSHandler;
 
 struct FilesystemHandler : LooperHandler
 {
-	FilesystemHandler(unique_ptr<Socket> socket_, FilesystemBackend &backend_)
-		: LooperHandler(move(socket_)), backend(backend_)
+	FilesystemHandler(std::unique_ptr<Socket> socket_, FilesystemBackend &backend_)
+		: LooperHandler(std::move(socket_)), backend(backend_)
 	{
 	}
 
 	bool handle(Looper &, EventFlags flags) override
 	{
 		if (flags & EVENT_IN)
-			Global::filesystem()->poll_notifications();
+			GRANITE_FILESYSTEM()->poll_notifications();
 
 		return true;
 	}
@@ -55,46 +60,32 @@ struct FilesystemHandler : LooperHandler
 	FilesystemBackend &backend;
 };
 
-struct NotificationSystem : EventHandler
+struct NotificationSystem
 {
 	explicit NotificationSystem(Looper &looper_)
 		: looper(looper_)
 	{
-		EVENT_MANAGER_REGISTER(NotificationSystem, on_filesystem, FilesystemProtocolEvent);
-		for (auto &proto : Global::filesystem()->get_protocols())
+		for (auto &proto : GRANITE_FILESYSTEM()->get_protocols())
 		{
 			auto &fs = proto.second;
 			if (fs->get_notification_fd() >= 0)
 			{
-				auto socket = unique_ptr<Socket>(new Socket(fs->get_notification_fd(), false));
-				auto handler = unique_ptr<FilesystemHandler>(new FilesystemHandler(move(socket), *fs));
+				auto socket = std::unique_ptr<Socket>(new Socket(fs->get_notification_fd(), false));
+				auto handler = std::unique_ptr<FilesystemHandler>(new FilesystemHandler(std::move(socket), *fs));
 				auto *ptr = handler.get();
-				looper.register_handler(EVENT_IN, move(handler));
+				looper.register_handler(EVENT_IN, std::move(handler));
 				protocols[proto.first] = ptr;
 			}
 		}
 	}
 
-	bool on_filesystem(const FilesystemProtocolEvent &fs)
-	{
-		if (fs.get_backend().get_notification_fd() >= 0)
-		{
-			auto socket = unique_ptr<Socket>(new Socket(fs.get_backend().get_notification_fd(), false));
-			auto handler = unique_ptr<FilesystemHandler>(new FilesystemHandler(move(socket), fs.get_backend()));
-			auto *ptr = handler.get();
-			looper.register_handler(EVENT_IN, move(handler));
-			protocols[fs.get_protocol()] = ptr;
-		}
-		return true;
-	}
-
 	void uninstall_all_notifications(FSHandler *handler)
 	{
 		for (auto &proto : protocols)
 			proto.second->uninstall_all_notifications(handler);
 	}
 
-	FileNotifyHandle install_notification(FSHandler *handler, const string &protocol, const string &path)
+	FileNotifyHandle install_notification(FSHandler *handler, const std::string &protocol, const std::string &path)
 	{
 		auto *proto = protocols[protocol];
 		if (!proto)
@@ -103,7 +94,7 @@ struct NotificationSystem : EventHandler
 		return proto->install_notification(path, handler);
 	}
 
-	void uninstall_notification(FSHandler *handler, const string &protocol, FileNotifyHandle handle)
+	void uninstall_notification(FSHandler *handler, const std::string &protocol, FileNotifyHandle handle)
 	{
 		auto *proto = protocols[protocol];
 		if (!proto)
@@ -118,8 +109,8 @@ struct NotificationSystem : EventHandler
 
 struct FSHandler : LooperHandler
 {
-	FSHandler(NotificationSystem &notify_system_, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_)), notify_system(notify_system_)
+	FSHandler(NotificationSystem &notify_system_, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_)), notify_system(notify_system_)
 	{
 		reply_builder.begin(4);
 		command_reader.start(reply_builder.get_buffer());
@@ -133,6 +124,9 @@ struct FSHandler : LooperHandler
 			LOGE("Tearing down Notification system ...\n");
 			notify_system.uninstall_all_notifications(this);
 		}
+
+		if (range.fd >= 0)
+			::close(range.fd);
 	}
 
 	void notify(const FileNotifyInfo &info)
@@ -173,6 +167,10 @@ struct FSHandler : LooperHandler
 
 		switch (command_id)
 		{
+		case NETFS_READ_RANGES:
+			begin_range_request();
+			return true;
+
 		case NETFS_WALK:
 		case NETFS_LIST:
 		case NETFS_READ_FILE:
@@ -221,10 +219,14 @@ struct FSHandler : LooperHandler
 		auto ret = command_reader.process(*socket);
 		if (command_reader.complete())
 		{
+			// Committed when the mapping goes away.
+			mapping.reset();
+			file.reset();
+
 			reply_builder.begin();
 			reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
 			reply_builder.add_u32(NETFS_ERROR_OK);
-			reply_builder.add_u64(file->get_size());
+			reply_builder.add_u64(write_size);
 			command_writer.start(reply_builder.get_buffer());
 			state = WriteReplyChunk;
 			looper.modify_handler(EVENT_OUT, *this);
@@ -252,8 +254,8 @@ struct FSHandler : LooperHandler
 				return false;
 			}
 
-			mapped = file->map_write(chunk_size);
-			if (!mapped)
+			mapping = file->map_write(chunk_size);
+			if (!mapping)
 			{
 				reply_builder.begin();
 				reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
@@ -265,8 +267,8 @@ struct FSHandler : LooperHandler
 			}
 			else
 			{
-				reply_builder.begin(chunk_size);
-				command_reader.start(mapped, chunk_size);
+				write_size = chunk_size;
+				command_reader.start(mapping->mutable_data(), chunk_size);
 				state = ReadChunkData2;
 			}
 			return true;
@@ -275,9 +277,9 @@ struct FSHandler : LooperHandler
 		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
 	}
 
-	bool begin_write_file(Looper &looper, const string &arg)
+	bool begin_write_file(Looper &looper, const std::string &arg)
 	{
-		file = Global::filesystem()->open(arg, FileMode::WriteOnly);
+		file = GRANITE_FILESYSTEM()->open(arg, FileMode::WriteOnly);
 		if (!file)
 		{
 			reply_builder.begin();
@@ -297,19 +299,19 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
-	bool begin_read_file(const string &arg)
+	bool begin_read_file(const std::string &arg)
 	{
-		file = Global::filesystem()->open(arg);
-		mapped = nullptr;
+		file = GRANITE_FILESYSTEM()->open(arg);
+		mapping.reset();
 		if (file)
-			mapped = file->map();
+			mapping = file->map();
 
 		reply_builder.begin();
-		if (mapped)
+		if (mapping)
 		{
 			reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
 			reply_builder.add_u32(NETFS_ERROR_OK);
-			reply_builder.add_u64(file->get_size());
+			reply_builder.add_u64(mapping->get_size());
 		}
 		else
 		{
@@ -321,7 +323,7 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
-	void write_string_list(const vector<ListEntry> &list)
+	void write_string_list(const std::vector<ListEntry> &list)
 	{
 		reply_builder.begin();
 		reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
@@ -348,12 +350,12 @@ struct FSHandler : LooperHandler
 		command_writer.start(reply_builder.get_buffer());
 	}
 
-	bool begin_stat(const string &arg)
+	bool begin_stat(const std::string &arg)
 	{
 		FileStat s;
 		reply_builder.begin();
 		reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
-		if (Global::filesystem()->stat(arg, s))
+		if (GRANITE_FILESYSTEM()->stat(arg, s))
 		{
 			reply_builder.add_u32(NETFS_ERROR_OK);
 			reply_builder.add_u64(8 + 4 + 8);
@@ -381,16 +383,16 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
-	bool begin_list(const string &arg)
+	bool begin_list(const std::string &arg)
 	{
-		auto list = Global::filesystem()->list(arg);
+		auto list = GRANITE_FILESYSTEM()->list(arg);
 		write_string_list(list);
 		return true;
 	}
 
-	bool begin_walk(const string &arg)
+	bool begin_walk(const std::string &arg)
 	{
-		auto list = Global::filesystem()->walk(arg);
+		auto list = GRANITE_FILESYSTEM()->walk(arg);
 		write_string_list(list);
 		return true;
 	}
@@ -433,7 +435,7 @@ struct FSHandler : LooperHandler
 				break;
 
 			case NETFS_NOTIFICATION:
-				protocol = move(str);
+				protocol = std::move(str);
 				looper.modify_handler(EVENT_IN, *this);
 				reply_builder.begin(3 * sizeof(uint32_t));
 				command_reader.start(reply_builder.get_buffer());
@@ -467,20 +469,15 @@ struct FSHandler : LooperHandler
 			switch (command_id)
 			{
 			case NETFS_READ_FILE:
-				if (mapped)
+				if (mapping)
 				{
-					command_writer.start(mapped, file->get_size());
+					command_writer.start(mapping->data(), mapping->get_size());
 					state = WriteReplyData;
 					return true;
 				}
 				else
 					return false;
 
-			case NETFS_WRITE_FILE:
-				if (file && mapped)
-					file->unmap();
-				return false;
-
 			default:
 				return false;
 			}
@@ -498,6 +495,201 @@ struct FSHandler : LooperHandler
 		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
 	}
 
+	void begin_range_request()
+	{
+		reply_builder.begin(NetFSRangeRequestSize);
+		command_reader.start(reply_builder.get_buffer());
+		state = RangeReadRequest;
+	}
+
+	bool range_read_request(Looper &)
+	{
+		auto ret = command_reader.process(*socket);
+		if (command_reader.complete())
+		{
+			range.id = reply_builder.read_u32();
+			range.flags = reply_builder.read_u32();
+			range.offset = reply_builder.read_u64();
+			range.size = reply_builder.read_u64();
+			uint64_t path_size = reply_builder.read_u64();
+
+			if (path_size == 0 || path_size > NetFSMaxPathSize)
+			{
+				LOGE("Invalid path size %llu in range request.\n", static_cast<unsigned long long>(path_size));
+				return false;
+			}
+
+			reply_builder.begin(path_size);
+			command_reader.start(reply_builder.get_buffer());
+			state = RangeReadPath;
+			return true;
+		}
+
+		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+	}
+
+	void open_range_file(const std::string &path)
+	{
+		if (path == range.path)
+			return;
+
+		if (range.fd >= 0)
+			::close(range.fd);
+		range.fd = -1;
+		range.path = path;
+		range.file = GRANITE_FILESYSTEM()->open(path);
+
+		// If the backend is a plain OS file we can serve with sendfile().
+		auto os_path = GRANITE_FILESYSTEM()->get_filesystem_path(path);
+		if (range.file && !os_path.empty())
+			range.fd = ::open(os_path.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+
+	bool compress_range()
+	{
+#ifdef GRANITE_NETFS_LZ4
+		// Not worth it for tiny ranges.
+		if ((range.flags & NETFS_RANGE_ALLOW_LZ4_BIT) == 0 || range.size < 4096)
+			return false;
+
+		auto src = range.file->map_subset(range.offset, range.size);
+		if (!src)
+			return false;
+
+		range.compressed.resize(LZ4_compressBound(int(range.size)));
+		int compressed_size = LZ4_compress_default(src->data<char>(),
+		                                           reinterpret_cast<char *>(range.compressed.data()),
+		                                           int(range.size), int(range.compressed.size()));
+
+		// Only bother if we save a meaningful amount of bandwidth.
+		if (compressed_size <= 0 || uint64_t(compressed_size) > range.size - range.size / 8)
+		{
+			range.compressed.clear();
+			return false;
+		}
+
+		range.compressed.resize(compressed_size);
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void begin_range_reply(Looper &looper)
+	{
+		open_range_file(reply_builder.read_string_implicit_count());
+
+		uint32_t error = NETFS_ERROR_OK;
+		uint32_t encoding = NETFS_ENCODING_RAW;
+		range.payload = nullptr;
+		range.payload_size = 0;
+		range.sent = 0;
+
+		if (!range.file || range.size > NetFSMaxRangeSize ||
+		    range.offset + range.size > range.file->get_size())
+		{
+			error = NETFS_ERROR_IO;
+		}
+		else if (compress_range())
+		{
+			encoding = NETFS_ENCODING_LZ4;
+			range.payload = range.compressed.data();
+			range.payload_size = range.compressed.size();
+		}
+		else if (range.fd >= 0)
+		{
+			range.payload_size = range.size;
+		}
+		else if (range.size)
+		{
+			range.mapping = range.file->map_subset(range.offset, range.size);
+			if (range.mapping)
+			{
+				range.payload = range.mapping->data();
+				range.payload_size = range.size;
+			}
+			else
+				error = NETFS_ERROR_IO;
+		}
+
+		reply_builder.begin();
+		reply_builder.add_u32(range.id);
+		reply_builder.add_u32(error);
+		reply_builder.add_u32(encoding);
+		reply_builder.add_u32(0);
+		reply_builder.add_u64(error == NETFS_ERROR_OK ? range.size : 0);
+		reply_builder.add_u64(range.payload_size);
+		command_writer.start(reply_builder.get_buffer());
+		state = RangeWriteReplyHeader;
+		looper.modify_handler(EVENT_OUT, *this);
+	}
+
+	bool range_read_path(Looper &looper)
+	{
+		auto ret = command_reader.process(*socket);
+		if (command_reader.complete())
+		{
+			begin_range_reply(looper);
+			return true;
+		}
+
+		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+	}
+
+	void end_range_reply(Looper &looper)
+	{
+		range.mapping.reset();
+		range.compressed.clear();
+		begin_range_request();
+		looper.modify_handler(EVENT_IN, *this);
+	}
+
+	bool range_write_reply_header(Looper &looper)
+	{
+		auto ret = command_writer.process(*socket);
+		if (command_writer.complete())
+		{
+			if (range.payload_size == 0)
+				end_range_reply(looper);
+			else if (range.payload)
+			{
+				command_writer.start(range.payload, range.payload_size);
+				state = RangeWriteReplyData;
+			}
+			else
+				state = RangeSendFile;
+			return true;
+		}
+
+		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+	}
+
+	bool range_write_reply_data(Looper &looper)
+	{
+		auto ret = command_writer.process(*socket);
+		if (command_writer.complete())
+		{
+			end_range_reply(looper);
+			return true;
+		}
+
+		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+	}
+
+	bool range_send_file(Looper &looper)
+	{
+		auto ret = socket->send_file(range.fd, range.offset + range.sent, range.payload_size - range.sent);
+		if (ret > 0)
+		{
+			range.sent += ret;
+			if (range.sent == range.payload_size)
+				end_range_reply(looper);
+			return true;
+		}
+
+		return ret == Socket::ErrorWouldBlock;
+	}
+
 	bool notification_loop_register_notification(Looper &looper)
 	{
 		auto ret = command_reader.process(*socket);
@@ -639,6 +831,16 @@ struct FSHandler : LooperHandler
 			return notification_loop_register_notification(looper);
 		else if (state == NotificationLoopUnregister)
 			return notification_loop_unregister_notification(looper);
+		else if (state == RangeReadRequest)
+			return range_read_request(looper);
+		else if (state == RangeReadPath)
+			return range_read_path(looper);
+		else if (state == RangeWriteReplyHeader)
+			return range_write_reply_header(looper);
+		else if (state == RangeWriteReplyData)
+			return range_write_reply_data(looper);
+		else if (state == RangeSendFile)
+			return range_send_file(looper);
 		else
 			return false;
 	}
@@ -654,7 +856,12 @@ struct FSHandler : LooperHandler
 		WriteReplyData,
 		NotificationLoop,
 		NotificationLoopRegister,
-		NotificationLoopUnregister
+		NotificationLoopUnregister,
+		RangeReadRequest,
+		RangeReadPath,
+		RangeWriteReplyHeader,
+		RangeWriteReplyData,
+		RangeSendFile
 	};
 
 	NotificationSystem &notify_system;
@@ -672,8 +879,28 @@ struct FSHandler : LooperHandler
 	std::queue<NotificationReply> reply_queue;
 	std::string protocol;
 
-	unique_ptr<File> file;
-	void *mapped = nullptr;
+	FileHandle file;
+	FileMappingHandle mapping;
+	uint64_t write_size = 0;
+
+	struct
+	{
+		uint32_t id = 0;
+		uint32_t flags = 0;
+		uint64_t offset = 0;
+		uint64_t size = 0;
+
+		// The last file is kept open since clients tend to stream many ranges from the same pack.
+		std::string path;
+		FileHandle file;
+		int fd = -1;
+
+		FileMappingHandle mapping;
+		std::vector<uint8_t> compressed;
+		const void *payload = nullptr;
+		uint64_t payload_size = 0;
+		uint64_t sent = 0;
+	} range;
 
 	bool is_notify_fs = false;
 };
@@ -719,19 +946,31 @@ struct ListenerHandler : TCPListener
 	{
 		auto client = accept();
 		if (client)
-			looper.register_handler(EVENT_IN, unique_ptr<FSHandler>(new FSHandler(notify_system, move(client))));
+			looper.register_handler(EVENT_IN, std::unique_ptr<FSHandler>(new FSHandler(notify_system, std::move(client))));
 		return true;
 	}
 
 	NotificationSystem &notify_system;
 };
 
-int main()
+NetFSServer::NetFSServer(uint16_t port)
+{
+	notify.reset(new NotificationSystem(looper));
+	auto listener = std::unique_ptr<LooperHandler>(new ListenerHandler(*notify, port));
+	looper.register_handler(EVENT_IN, std::move(listener));
+}
+
+NetFSServer::~NetFSServer()
 {
-	Looper looper;
-	auto notify = unique_ptr<NotificationSystem>(new NotificationSystem(looper));
-	auto listener = unique_ptr<LooperHandler>(new ListenerHandler(*notify, 7070));
+}
 
-	looper.register_handler(EVENT_IN, move(listener));
+void NetFSServer::run()
+{
 	while (looper.wait(-1) >= 0);
 }
+
+void NetFSServer::kill()
+{
+	looper.kill();
+}
+}
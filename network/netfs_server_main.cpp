@@ -0,0 +1,77 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "netfs_server.hpp"
+#include "global_managers_init.hpp"
+#include "cli_parser.hpp"
+#include "filesystem.hpp"
+#include "os_filesystem.hpp"
+#include "logging.hpp"
+#include <stdlib.h>
+
+using namespace Granite;
+
+static void print_help()
+{
+	LOGI("Usage: netfs-server [--port <port>] [--assets <directory>]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct Arguments
+	{
+		unsigned port = 7070;
+		std::string assets;
+	} args;
+
+	Util::CLICallbacks cbs;
+	cbs.add("--port", [&](Util::CLIParser &parser) { args.port = parser.next_uint(); });
+	cbs.add("--assets", [&](Util::CLIParser &parser) { args.assets = parser.next_string(); });
+	cbs.add("--help", [](Util::CLIParser &parser) { print_help(); parser.end(); });
+	cbs.error_handler = [] { print_help(); };
+
+	Util::CLIParser parser(std::move(cbs), argc - 1, argv + 1);
+	if (!parser.parse())
+		return EXIT_FAILURE;
+	else if (parser.is_ended_state())
+		return EXIT_SUCCESS;
+
+	Global::init(Global::MANAGER_FEATURE_FILESYSTEM_BIT);
+	if (!args.assets.empty())
+		GRANITE_FILESYSTEM()->register_protocol("assets", std::make_unique<OSFilesystem>(args.assets));
+
+	try
+	{
+		NetFSServer server(uint16_t(args.port));
+		LOGI("Serving NetFS on port %u.\n", args.port);
+		server.run();
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("NetFS server failed: %s\n", e.what());
+		Global::deinit();
+		return EXIT_FAILURE;
+	}
+
+	Global::deinit();
+	return EXIT_SUCCESS;
+}
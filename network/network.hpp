@@ -106,6 +106,9 @@ public:
 	int write(const void *data, size_t size);
 	int read(void *data, size_t size);
 
+	// Zero-copy transfer from a file descriptor. Same semantics as write().
+	int send_file(int file_fd, uint64_t offset, size_t size);
+
 	enum Error
 	{
 		ErrorWouldBlock = -1,
@@ -30,6 +30,9 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
 #endif
 
 namespace Granite
@@ -75,7 +78,7 @@ Socket::Socket(int fd_, bool owned_)
 {
 }
 
-unique_ptr<Socket> Socket::connect(const char *addr, uint16_t port)
+std::unique_ptr<Socket> Socket::connect(const char *addr, uint16_t port)
 {
 #ifdef __linux__
 	SocketGlobal::get();
@@ -121,7 +124,11 @@ unique_ptr<Socket> Socket::connect(const char *addr, uint16_t port)
 		return {};
 	}
 
-	return unique_ptr<Socket>(new Socket(fd));
+	// Requests are small and pipelined, don't let Nagle hold them back.
+	int yes = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+	return std::unique_ptr<Socket>(new Socket(fd));
 #else
 	return {};
 #endif
@@ -171,4 +178,22 @@ int Socket::write(const void *data, size_t size)
 	return -1;
 #endif
 }
+
+int Socket::send_file(int file_fd, uint64_t offset, size_t size)
+{
+#ifdef __linux__
+	off_t off = off_t(offset);
+	auto ret = ::sendfile(fd, file_fd, &off, size);
+	if (ret < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return ErrorWouldBlock;
+		else
+			return ErrorIO;
+	}
+	return ret;
+#else
+	return -1;
+#endif
+}
 }
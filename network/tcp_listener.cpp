@@ -54,6 +54,8 @@ TCPListener::TCPListener(uint16_t port)
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 namespace Granite
 {
@@ -67,12 +69,14 @@ SocketGlobal &SocketGlobal::get()
 	return global;
 }
 
-unique_ptr<Socket> TCPListener::accept()
+std::unique_ptr<Socket> TCPListener::accept()
 {
 	sockaddr_storage their;
 	socklen_t their_size = sizeof(their);
 	int new_fd = ::accept(socket->get_fd(),
                           reinterpret_cast<sockaddr *>(&their), &their_size);
+	if (new_fd < 0)
+		return {};
 
 	int old = fcntl(new_fd, F_GETFL);
 	if (fcntl(new_fd, F_SETFL, old | O_NONBLOCK) < 0)
@@ -81,7 +85,10 @@ unique_ptr<Socket> TCPListener::accept()
 		return {};
 	}
 
-	return unique_ptr<Socket>(new Socket(new_fd));
+	int yes = 1;
+	setsockopt(new_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+	return std::unique_ptr<Socket>(new Socket(new_fd));
 }
 
 TCPListener::TCPListener(uint16_t port)
@@ -97,7 +104,7 @@ TCPListener::TCPListener(uint16_t port)
 
 	int res = getaddrinfo(nullptr, std::to_string(port).c_str(), &hints, &servinfo);
 	if (res < 0)
-		throw runtime_error("getaddrinfo");
+		throw std::runtime_error("getaddrinfo");
 
 	int fd = -1;
 
@@ -130,15 +137,15 @@ TCPListener::TCPListener(uint16_t port)
 	freeaddrinfo(servinfo);
 
 	if (!walk)
-		throw runtime_error("bind");
+		throw std::runtime_error("bind");
 
 	if (listen(fd, 64) < 0)
 	{
 		close(fd);
-		throw runtime_error("listen");
+		throw std::runtime_error("listen");
 	}
 
-	socket = unique_ptr<Socket>(new Socket(fd));
+	socket = std::unique_ptr<Socket>(new Socket(fd));
 }
 }
 #endif
\ No newline at end of file
@@ -21,10 +21,18 @@
  */
 
 #include "physics_system.hpp"
+#include "thread_group.hpp"
 #include <btBulletDynamicsCommon.h>
 #include <btBulletCollisionCommon.h>
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletCollision/NarrowPhaseCollision/btGjkEpa2.h>
+#include <BulletCollision/NarrowPhaseCollision/btPersistentManifold.h>
 #include <BulletDynamics/Character/btKinematicCharacterController.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <LinearMath/btThreads.h>
+#include <algorithm>
 
 namespace Granite
 {
@@ -50,15 +58,127 @@ static quat convert(const btQuaternion &q)
 	return { q.w(), q.x(), q.y(), q.z() };
 }
 
+// Splits [0, count) into chunks of at least grain_size, and runs them on the thread group.
+// The calling thread takes the first chunk itself, and waits for the rest.
+template <typename Func>
+static void parallel_for_chunks(ThreadGroup *group, size_t count, size_t grain_size, const Func &func)
+{
+	if (!count)
+		return;
+
+	size_t num_threads = group ? group->get_num_threads() : 0;
+	size_t chunk_size = std::max<size_t>(grain_size, (count + 4 * num_threads) / (4 * num_threads + 1));
+	size_t num_chunks = (count + chunk_size - 1) / chunk_size;
+
+	if (num_chunks <= 1)
+	{
+		func(0, count);
+		return;
+	}
+
+	auto task = group->create_task();
+	task->set_desc("physics-parallel-for");
+	for (size_t i = 1; i < num_chunks; i++)
+	{
+		size_t begin = i * chunk_size;
+		size_t end = std::min(begin + chunk_size, count);
+		task->enqueue_task([&func, begin, end]() {
+			func(begin, end);
+		});
+	}
+	task->flush();
+
+	func(0, chunk_size);
+	task->wait();
+}
+
+// Thread group for work which calls into Bullet.
+// Bullet hands out thread indices on first use, and they must stay below BT_MAX_THREAD_COUNT.
+// The calling thread takes index 0.
+static ThreadGroup *get_bullet_thread_group()
+{
+	auto *group = GRANITE_THREAD_GROUP();
+	if (group && group->get_num_threads() > 0 && group->get_num_threads() < BT_MAX_THREAD_COUNT)
+		return group;
+	else
+		return nullptr;
+}
+
+// Routes Bullet's internal parallel loops (narrowphase, solver, integration) to the global ThreadGroup.
+// The ThreadGroup is only started after all global managers are created, so its thread count is not known yet.
+// Bullet is told BT_MAX_THREAD_COUNT instead, which is what it sizes per-thread storage with.
+// get_bullet_thread_group() only hands out thread groups that fit within that limit.
+class ThreadGroupTaskScheduler final : public btITaskScheduler
+{
+public:
+	ThreadGroupTaskScheduler()
+		: btITaskScheduler("GraniteThreadGroup")
+	{
+	}
+
+	int getMaxNumThreads() const override
+	{
+		return BT_MAX_THREAD_COUNT;
+	}
+
+	int getNumThreads() const override
+	{
+		return BT_MAX_THREAD_COUNT;
+	}
+
+	void setNumThreads(int) override
+	{
+	}
+
+	void parallelFor(int begin, int end, int grain_size, const btIParallelForBody &body) override
+	{
+		parallel_for_chunks(get_bullet_thread_group(), size_t(end - begin), size_t(std::max(grain_size, 1)),
+		                    [&body, begin](size_t chunk_begin, size_t chunk_end) {
+			                    body.forLoop(begin + int(chunk_begin), begin + int(chunk_end));
+		                    });
+	}
+
+	btScalar parallelSum(int begin, int end, int grain_size, const btIParallelSumBody &body) override
+	{
+		auto *group = get_bullet_thread_group();
+		if (!group)
+			return body.sumLoop(begin, end);
+
+		// Sum per chunk, and reduce in order so the result does not depend on scheduling.
+		size_t count = size_t(end - begin);
+		size_t chunk_size = size_t(std::max(grain_size, 1));
+		std::vector<btScalar> sums((count + chunk_size - 1) / chunk_size);
+		parallel_for_chunks(group, sums.size(), 1, [&](size_t chunk_begin, size_t chunk_end) {
+			for (size_t i = chunk_begin; i < chunk_end; i++)
+			{
+				int sum_begin = begin + int(i * chunk_size);
+				int sum_end = std::min(sum_begin + int(chunk_size), end);
+				sums[i] = body.sumLoop(sum_begin, sum_end);
+			}
+		});
+
+		btScalar sum = btScalar(0);
+		for (auto &s : sums)
+			sum += s;
+		return sum;
+	}
+};
+
 struct PhysicsHandle
 {
 	Node *node = nullptr;
 	btCollisionObject *bt_object = nullptr;
 	btCollisionShape *bt_shape = nullptr;
+	btRigidBody *bt_body = nullptr;
 	Entity *entity = nullptr;
 	PhysicsSystem::InteractionType type = PhysicsSystem::InteractionType::Ghost;
 	bool copy_transform_from_node = false;
 
+	// Index into node_driven_handles or simulated_handles.
+	unsigned sync_index = ~0u;
+	// Sleeping bodies do not move, so they only need one more write-back after they fall asleep.
+	bool was_active = true;
+
 	~PhysicsHandle()
 	{
 		if (bt_object)
@@ -118,6 +238,25 @@ void PhysicsSystem::tick_callback(float)
 	new_collision_buffer.clear();
 }
 
+static int convert_filter_mask(PhysicsSystem::InteractionTypeFlags flags)
+{
+	int mask = 0;
+	if (flags == PhysicsSystem::INTERACTION_TYPE_ALL_BITS)
+		mask = btBroadphaseProxy::AllFilter;
+	else
+	{
+		if (flags & PhysicsSystem::INTERACTION_TYPE_STATIC_BIT)
+			mask |= btBroadphaseProxy::StaticFilter;
+		if (flags & PhysicsSystem::INTERACTION_TYPE_DYNAMIC_BIT)
+			mask |= btBroadphaseProxy::DefaultFilter;
+		if (flags & PhysicsSystem::INTERACTION_TYPE_INVISIBLE_BIT)
+			mask |= btBroadphaseProxy::SensorTrigger;
+		if (flags & PhysicsSystem::INTERACTION_TYPE_KINEMATIC_BIT)
+			mask |= btBroadphaseProxy::CharacterFilter;
+	}
+	return mask;
+}
+
 RaycastResult PhysicsSystem::query_closest_hit_ray(const vec3 &from, const vec3 &dir, float t,
                                                    InteractionTypeFlags flags)
 {
@@ -125,21 +264,7 @@ RaycastResult PhysicsSystem::query_closest_hit_ray(const vec3 &from, const vec3
 	btVector3 ray_from_world = convert(from);
 	btVector3 ray_to_world = convert(to);
 	btCollisionWorld::ClosestRayResultCallback cb(ray_from_world, ray_to_world);
-
-	cb.m_collisionFilterMask = 0;
-	if (flags == INTERACTION_TYPE_ALL_BITS)
-		cb.m_collisionFilterMask = btBroadphaseProxy::AllFilter;
-	else
-	{
-		if (flags & INTERACTION_TYPE_STATIC_BIT)
-			cb.m_collisionFilterMask |= btBroadphaseProxy::StaticFilter;
-		if (flags & INTERACTION_TYPE_DYNAMIC_BIT)
-			cb.m_collisionFilterMask |= btBroadphaseProxy::DefaultFilter;
-		if (flags & INTERACTION_TYPE_INVISIBLE_BIT)
-			cb.m_collisionFilterMask |= btBroadphaseProxy::SensorTrigger;
-		if (flags & INTERACTION_TYPE_KINEMATIC_BIT)
-			cb.m_collisionFilterMask |= btBroadphaseProxy::CharacterFilter;
-	}
+	cb.m_collisionFilterMask = convert_filter_mask(flags);
 
 	world->rayTest(ray_from_world, ray_to_world, cb);
 
@@ -165,14 +290,267 @@ RaycastResult PhysicsSystem::query_closest_hit_ray(const vec3 &from, const vec3
 	return result;
 }
 
+struct SphereDistance
+{
+	// Distance from the sphere surface to the shape surface, negative if they overlap.
+	btScalar distance = SIMD_INFINITY;
+	// Closest point on the shape, and the direction from it towards the sphere center.
+	btVector3 point = btVector3(0.0f, 0.0f, 0.0f);
+	btVector3 normal = btVector3(0.0f, 1.0f, 0.0f);
+};
+
+// Real-Time Collision Detection, 5.1.5.
+static btVector3 closest_point_on_triangle(const btVector3 &p, const btVector3 &a, const btVector3 &b, const btVector3 &c)
+{
+	btVector3 ab = b - a;
+	btVector3 ac = c - a;
+	btVector3 ap = p - a;
+	btScalar d1 = ab.dot(ap);
+	btScalar d2 = ac.dot(ap);
+	if (d1 <= btScalar(0) && d2 <= btScalar(0))
+		return a;
+
+	btVector3 bp = p - b;
+	btScalar d3 = ab.dot(bp);
+	btScalar d4 = ac.dot(bp);
+	if (d3 >= btScalar(0) && d4 <= d3)
+		return b;
+
+	btScalar vc = d1 * d4 - d3 * d2;
+	if (vc <= btScalar(0) && d1 >= btScalar(0) && d3 <= btScalar(0))
+		return a + ab * (d1 / (d1 - d3));
+
+	btVector3 cp = p - c;
+	btScalar d5 = ab.dot(cp);
+	btScalar d6 = ac.dot(cp);
+	if (d6 >= btScalar(0) && d5 <= d6)
+		return c;
+
+	btScalar vb = d5 * d2 - d1 * d6;
+	if (vb <= btScalar(0) && d2 >= btScalar(0) && d6 <= btScalar(0))
+		return a + ac * (d2 / (d2 - d6));
+
+	btScalar va = d3 * d6 - d5 * d4;
+	if (va <= btScalar(0) && (d4 - d3) >= btScalar(0) && (d5 - d6) >= btScalar(0))
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	btScalar denom = btScalar(1) / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+struct SphereTriangleCallback : btTriangleCallback
+{
+	SphereTriangleCallback(const btVector3 &center_, btScalar radius_)
+		: center(center_), radius(radius_)
+	{
+	}
+
+	void processTriangle(btVector3 *triangle, int, int) override
+	{
+		btVector3 q = closest_point_on_triangle(center, triangle[0], triangle[1], triangle[2]);
+		btVector3 delta = center - q;
+		btScalar len = delta.length();
+		btScalar distance = len - radius;
+		if (distance >= result.distance)
+			return;
+
+		result.distance = distance;
+		result.point = q;
+		if (len > SIMD_EPSILON)
+			result.normal = delta / len;
+		else
+			result.normal = (triangle[1] - triangle[0]).cross(triangle[2] - triangle[0]).safeNormalize();
+	}
+
+	btVector3 center;
+	btScalar radius;
+	SphereDistance result;
+};
+
+// Collects broadphase candidates for overlap queries.
+struct OverlapCandidateCallback : btBroadphaseAabbCallback
+{
+	OverlapCandidateCallback(std::vector<const btCollisionObject *> &candidates_, int mask_)
+		: candidates(candidates_), mask(mask_)
+	{
+	}
+
+	bool process(const btBroadphaseProxy *proxy) override
+	{
+		// Same filtering as the ray and sweep callbacks, which query as btBroadphaseProxy::DefaultFilter.
+		if ((proxy->m_collisionFilterGroup & mask) != 0 &&
+		    (proxy->m_collisionFilterMask & btBroadphaseProxy::DefaultFilter) != 0)
+		{
+			candidates.push_back(static_cast<const btCollisionObject *>(proxy->m_clientObject));
+		}
+		return true;
+	}
+
+	std::vector<const btCollisionObject *> &candidates;
+	int mask;
+};
+
+// Only reads shapes and transforms, unlike contactTest(), which allocates manifolds in the dispatcher,
+// so overlap queries can run on many threads at once.
+static void sphere_shape_distance(const btCollisionShape *shape, const btTransform &transform,
+                                  const btVector3 &center, btScalar radius, SphereDistance &result)
+{
+	if (shape->getShapeType() == COMPOUND_SHAPE_PROXYTYPE)
+	{
+		auto *compound = static_cast<const btCompoundShape *>(shape);
+		for (int i = 0; i < compound->getNumChildShapes(); i++)
+		{
+			sphere_shape_distance(compound->getChildShape(i), transform * compound->getChildTransform(i),
+			                      center, radius, result);
+		}
+	}
+	else if (shape->getShapeType() == STATIC_PLANE_PROXYTYPE)
+	{
+		auto *plane = static_cast<const btStaticPlaneShape *>(shape);
+		btVector3 n = transform.getBasis() * plane->getPlaneNormal();
+		btVector3 origin = transform * (plane->getPlaneNormal() * plane->getPlaneConstant());
+		btScalar d = n.dot(center - origin);
+		if (d - radius < result.distance)
+		{
+			result.distance = d - radius;
+			result.point = center - n * d;
+			result.normal = n;
+		}
+	}
+	else if (shape->isConvex())
+	{
+		btGjkEpaSolver2::sResults gjk_result;
+		btScalar d = btGjkEpaSolver2::SignedDistance(center, radius, static_cast<const btConvexShape *>(shape),
+		                                             transform, gjk_result);
+		if (d < result.distance)
+		{
+			result.distance = d;
+			result.point = gjk_result.witnesses[0];
+			result.normal = gjk_result.normal;
+		}
+	}
+	else if (shape->isConcave())
+	{
+		// Triangles are reported in the local space of the shape, including its scale.
+		btVector3 local_center = transform.invXform(center);
+		btVector3 extent(radius, radius, radius);
+		SphereTriangleCallback cb(local_center, radius);
+		static_cast<const btConcaveShape *>(shape)->processAllTriangles(&cb, local_center - extent, local_center + extent);
+		if (cb.result.distance < result.distance)
+		{
+			result.distance = cb.result.distance;
+			result.point = transform * cb.result.point;
+			result.normal = transform.getBasis() * cb.result.normal;
+		}
+	}
+}
+
+void PhysicsSystem::query_batch(const QueryBatch &batch, QueryBatchResults &results) const
+{
+	results.hit.assign(batch.count, 0);
+	results.handles.assign(batch.count, nullptr);
+	results.entities.assign(batch.count, nullptr);
+	results.world_pos.assign(batch.count, vec3(0.0f));
+	results.world_normal.assign(batch.count, vec3(0.0f));
+	results.t.assign(batch.count, 0.0f);
+
+	int mask = convert_filter_mask(batch.mask);
+
+	const auto write_hit = [&](size_t i, const btCollisionObject *object,
+	                           const btVector3 &pos, const btVector3 &normal, float t) {
+		auto *handle = object ? static_cast<PhysicsHandle *>(object->getUserPointer()) : nullptr;
+		results.hit[i] = 1;
+		results.handles[i] = handle;
+		results.entities[i] = handle ? handle->entity : nullptr;
+		results.world_pos[i] = convert(pos);
+		results.world_normal[i] = convert(normal);
+		results.t[i] = t;
+	};
+
+	// Queries only read the world, and Bullet keeps per-thread traversal stacks in the broadphase,
+	// so every query can run independently.
+	parallel_for_chunks(get_bullet_thread_group(), batch.count, 16, [&](size_t begin, size_t end) {
+		std::vector<const btCollisionObject *> candidates;
+
+		for (size_t i = begin; i < end; i++)
+		{
+			btVector3 from = convert(batch.origins[i]);
+			float radius = batch.radii ? batch.radii[i] : batch.radius;
+
+			switch (batch.type)
+			{
+			case QueryType::Ray:
+			{
+				float length = batch.lengths[i];
+				btVector3 to = convert(batch.origins[i] + batch.directions[i] * length);
+				btCollisionWorld::ClosestRayResultCallback cb(from, to);
+				cb.m_collisionFilterMask = mask;
+				world->rayTest(from, to, cb);
+				if (cb.hasHit())
+					write_hit(i, cb.m_collisionObject, cb.m_hitPointWorld, cb.m_hitNormalWorld, cb.m_closestHitFraction * length);
+				break;
+			}
+
+			case QueryType::SphereSweep:
+			{
+				float length = batch.lengths[i];
+				btVector3 to = convert(batch.origins[i] + batch.directions[i] * length);
+				btSphereShape sphere(radius);
+				btTransform from_transform(btQuaternion::getIdentity(), from);
+				btTransform to_transform(btQuaternion::getIdentity(), to);
+				btCollisionWorld::ClosestConvexResultCallback cb(from, to);
+				cb.m_collisionFilterMask = mask;
+				world->convexSweepTest(&sphere, from_transform, to_transform, cb);
+				if (cb.hasHit())
+					write_hit(i, cb.m_hitCollisionObject, cb.m_hitPointWorld, cb.m_hitNormalWorld, cb.m_closestHitFraction * length);
+				break;
+			}
+
+			case QueryType::SphereOverlap:
+			{
+				candidates.clear();
+				btVector3 extent(radius, radius, radius);
+				OverlapCandidateCallback cb(candidates, mask);
+				world->getBroadphase()->aabbTest(from - extent, from + extent, cb);
+
+				const btCollisionObject *deepest = nullptr;
+				SphereDistance deepest_distance;
+				for (auto *object : candidates)
+				{
+					SphereDistance distance;
+					sphere_shape_distance(object->getCollisionShape(), object->getWorldTransform(), from, radius, distance);
+					if (distance.distance <= btScalar(0) && distance.distance < deepest_distance.distance)
+					{
+						deepest = object;
+						deepest_distance = distance;
+					}
+				}
+
+				if (deepest)
+					write_hit(i, deepest, deepest_distance.point, deepest_distance.normal, deepest_distance.distance);
+				break;
+			}
+			}
+		}
+	});
+}
+
 PhysicsSystem::PhysicsSystem()
 {
+	// The scheduler must be in place before the multithreaded dispatcher and solver are created.
+	task_scheduler = std::make_unique<ThreadGroupTaskScheduler>();
+	btSetTaskScheduler(task_scheduler.get());
+
+	// Pools keep their default sizes since they are allocated up front.
+	// Once exhausted, the MT dispatcher falls back to the heap, which is safe with BT_THREADSAFE.
 	collision_config = std::make_unique<btDefaultCollisionConfiguration>();
-	dispatcher = std::make_unique<btCollisionDispatcher>(collision_config.get());
+
+	dispatcher = std::make_unique<btCollisionDispatcherMt>(collision_config.get(), 40);
 	broadphase = std::make_unique<btDbvtBroadphase>();
-	solver = std::make_unique<btSequentialImpulseConstraintSolver>();
-	world = std::make_unique<btDiscreteDynamicsWorld>(dispatcher.get(), broadphase.get(),
-	                                                  solver.get(), collision_config.get());
+	solver_pool = std::make_unique<btConstraintSolverPoolMt>(BT_MAX_THREAD_COUNT);
+	solver = std::make_unique<btSequentialImpulseConstraintSolverMt>();
+	world = std::make_unique<btDiscreteDynamicsWorldMt>(dispatcher.get(), broadphase.get(),
+	                                                    solver_pool.get(), solver.get(), collision_config.get());
 
 	world->setGravity(btVector3(0.0f, -9.81f, 0.0f));
 	world->setInternalTickCallback(tick_callback_wrapper, this);
@@ -297,6 +675,10 @@ PhysicsSystem::~PhysicsSystem()
 
 	for (auto *handle : handles)
 		handle_pool.free(handle);
+
+	world.reset();
+	if (btGetTaskScheduler() == task_scheduler.get())
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
 }
 
 void PhysicsSystem::iterate(double frame_time)
@@ -319,80 +701,125 @@ void PhysicsSystem::iterate(double frame_time)
 		}
 	}
 
-	// Update ghost object locations.
-	for (auto *handle : handles)
-	{
-		if (!handle->node || !handle->copy_transform_from_node)
-			continue;
+	sync_node_driven_handles();
+	world->stepSimulation(btScalar(frame_time), 20, PHYSICS_TICK);
+	sync_simulated_handles();
+}
+
+void PhysicsSystem::add_sync_handle(PhysicsHandle *handle)
+{
+	// Ghosts which are not driven by their node (areas) are never written back.
+	if (!handle->node || (!handle->copy_transform_from_node && !handle->bt_body))
+		return;
 
-		auto *obj = handle->bt_object;
-		auto *ghost = btPairCachingGhostObject::upcast(obj);
-		auto *body = btRigidBody::upcast(obj);
+	auto &list = handle->copy_transform_from_node ? node_driven_handles : simulated_handles;
+	handle->sync_index = unsigned(list.size());
+	list.push_back(handle);
+}
 
-		if (ghost)
-		{
-			btTransform t;
-			t.setIdentity();
-			auto &rot = handle->node->transform.rotation;
-			auto &pos = handle->node->transform.translation;
-			t.setOrigin(convert(pos));
-			t.setRotation(convert(rot));
-			ghost->setWorldTransform(t);
-			if (ghost->getBroadphaseHandle())
-				world->updateSingleAabb(ghost);
-		}
-		else if (body)
+void PhysicsSystem::remove_sync_handle(PhysicsHandle *handle)
+{
+	if (handle->sync_index == ~0u)
+		return;
+
+	auto &list = handle->copy_transform_from_node ? node_driven_handles : simulated_handles;
+	list.back()->sync_index = handle->sync_index;
+	list[handle->sync_index] = list.back();
+	list.pop_back();
+	handle->sync_index = ~0u;
+}
+
+void PhysicsSystem::sync_node_driven_handles()
+{
+	// Update ghost object and kinematic body locations.
+	// Transforms and AABBs are computed in parallel, but the broadphase is not thread-safe,
+	// so the AABBs are handed to it serially afterwards.
+	node_driven_aabbs.resize(node_driven_handles.size());
+
+	parallel_for_chunks(GRANITE_THREAD_GROUP(), node_driven_handles.size(), 256, [&](size_t begin, size_t end) {
+		btVector3 contact_threshold(gContactBreakingThreshold, gContactBreakingThreshold, gContactBreakingThreshold);
+
+		for (size_t i = begin; i < end; i++)
 		{
+			auto *handle = node_driven_handles[i];
+			auto *obj = handle->bt_object;
+			auto *body = handle->bt_body;
+
 			btTransform t;
 			t.setIdentity();
-			auto &rot = handle->node->transform.rotation;
-			auto &pos = handle->node->transform.translation;
-			t.setOrigin(convert(pos));
-			t.setRotation(convert(rot));
-			if (body->getMotionState())
-				body->getMotionState()->setWorldTransform(t);
+			t.setOrigin(convert(handle->node->transform.translation));
+			t.setRotation(convert(handle->node->transform.rotation));
+
+			if (body)
+			{
+				if (body->getMotionState())
+					body->getMotionState()->setWorldTransform(t);
+				else
+					body->setWorldTransform(t);
+				body->setCenterOfMassTransform(t);
+			}
 			else
-				body->setWorldTransform(t);
-			body->setCenterOfMassTransform(t);
-			if (body->getBroadphaseHandle())
-				world->updateSingleAabb(body);
-		}
-	}
+				obj->setWorldTransform(t);
 
-	world->stepSimulation(btScalar(frame_time), 20, PHYSICS_TICK);
+			btVector3 lo, hi;
+			obj->getCollisionShape()->getAabb(obj->getWorldTransform(), lo, hi);
+			node_driven_aabbs[i] = AABB(convert(lo - contact_threshold), convert(hi + contact_threshold));
+		}
+	});
 
-	// Update node transforms from physics engine.
-	for (auto *handle : handles)
+	auto *bp = world->getBroadphase();
+	for (size_t i = 0, n = node_driven_handles.size(); i < n; i++)
 	{
-		if (!handle->node || handle->copy_transform_from_node)
+		auto *obj = node_driven_handles[i]->bt_object;
+		if (!obj->getBroadphaseHandle())
 			continue;
 
-		auto *obj = handle->bt_object;
-		auto *ghost = btPairCachingGhostObject::upcast(obj);
-		if (ghost)
-			continue;
-
-		auto *body = btRigidBody::upcast(obj);
-		btTransform t;
-		if (body && body->getMotionState())
-			body->getMotionState()->getWorldTransform(t);
+		// Let Bullet deal with degenerate bounds the way it normally does.
+		auto lo = convert(node_driven_aabbs[i].get_minimum());
+		auto hi = convert(node_driven_aabbs[i].get_maximum());
+		if ((hi - lo).length2() < btScalar(1e12))
+			bp->setAabb(obj->getBroadphaseHandle(), lo, hi, world->getDispatcher());
 		else
-			t = obj->getWorldTransform();
+			world->updateSingleAabb(obj);
+	}
+}
+
+void PhysicsSystem::sync_simulated_handles()
+{
+	// Update node transforms from physics engine.
+	parallel_for_chunks(GRANITE_THREAD_GROUP(), simulated_handles.size(), 1024, [this](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			auto *handle = simulated_handles[i];
+			auto *obj = handle->bt_object;
+			auto *body = handle->bt_body;
+
+			bool active = obj->isActive();
+			if (!active && !handle->was_active)
+				continue;
+			handle->was_active = active;
+
+			btTransform t;
+			if (body && body->getMotionState())
+				body->getMotionState()->getWorldTransform(t);
+			else
+				t = obj->getWorldTransform();
 
-		auto rot = t.getRotation();
-		auto &transform = handle->node->transform;
-		transform.rotation.x = rot.x();
-		transform.rotation.y = rot.y();
-		transform.rotation.z = rot.z();
-		transform.rotation.w = rot.w();
+			auto rot = t.getRotation();
+			auto &transform = handle->node->transform;
+			transform.rotation.x = rot.x();
+			transform.rotation.y = rot.y();
+			transform.rotation.z = rot.z();
+			transform.rotation.w = rot.w();
 
-		auto orig = t.getOrigin();
-		transform.translation.x = orig.x();
-		transform.translation.y = orig.y();
-		transform.translation.z = orig.z();
+			auto orig = t.getOrigin();
+			transform.translation.x = orig.x();
+			transform.translation.y = orig.y();
+			transform.translation.z = orig.z();
 
-		handle->node->invalidate_cached_transform();
-	}
+			handle->node->invalidate_cached_transform();
+		}
+	});
 }
 
 Entity *PhysicsSystem::get_handle_parent(PhysicsHandle *handle)
@@ -425,6 +852,7 @@ void PhysicsSystem::remove_body(PhysicsHandle *handle)
 	}
 
 	world->removeCollisionObject(obj);
+	remove_sync_handle(handle);
 	handle_pool.free(handle);
 
 	// TODO: Avoid O(n).
@@ -549,6 +977,8 @@ PhysicsHandle *PhysicsSystem::add_shape(Node *node, const MaterialInfo &info, bt
 	}
 
 	handle->type = info.type;
+	handle->bt_body = btRigidBody::upcast(handle->bt_object);
+	add_sync_handle(handle);
 	return handle;
 }
 
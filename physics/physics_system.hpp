@@ -33,7 +33,9 @@ class btDefaultCollisionConfiguration;
 class btCollisionDispatcher;
 struct btDbvtBroadphase;
 class btSequentialImpulseConstraintSolver;
+class btConstraintSolverPoolMt;
 class btDiscreteDynamicsWorld;
+class btITaskScheduler;
 class btCollisionShape;
 class btBvhTriangleMeshShape;
 class btTriangleIndexVertexArray;
@@ -255,6 +257,48 @@ public:
 	RaycastResult query_closest_hit_ray(const vec3 &from, const vec3 &dir, float length,
 	                                    InteractionTypeFlags mask = INTERACTION_TYPE_ALL_BITS);
 
+	enum class QueryType
+	{
+		// Closest hit along origin + direction * [0, length].
+		Ray,
+		// Closest hit of a sphere moving along origin + direction * [0, length].
+		SphereSweep,
+		// Deepest overlap of a sphere at origin.
+		SphereOverlap
+	};
+
+	struct QueryBatch
+	{
+		QueryType type = QueryType::Ray;
+		unsigned count = 0;
+		const vec3 *origins = nullptr;
+		// Used by rays and sweeps.
+		const vec3 *directions = nullptr;
+		const float *lengths = nullptr;
+		// Used by sweeps and overlaps. If nullptr, radius is used for every query.
+		const float *radii = nullptr;
+		float radius = 0.5f;
+		InteractionTypeFlags mask = INTERACTION_TYPE_ALL_BITS;
+	};
+
+	// One element per query. Entries for queries which did not hit anything are zero.
+	// For rays and sweeps, the hit is at origin + direction * t, like query_closest_hit_ray().
+	// For overlaps, t is the distance from the sphere surface to the surface of the object it overlaps,
+	// i.e. the negative penetration depth.
+	struct QueryBatchResults
+	{
+		std::vector<uint8_t> hit;
+		std::vector<PhysicsHandle *> handles;
+		std::vector<Entity *> entities;
+		std::vector<vec3> world_pos;
+		std::vector<vec3> world_normal;
+		std::vector<float> t;
+	};
+
+	// Runs all queries in parallel on the thread group.
+	// The world must not be modified or stepped until this returns.
+	void query_batch(const QueryBatch &batch, QueryBatchResults &results) const;
+
 	void add_point_constraint(PhysicsHandle *handle, const vec3 &local_pivot);
 	void add_point_constraint(PhysicsHandle *handle0, PhysicsHandle *handle1,
 	                          const vec3 &local_pivot0, const vec3 &local_pivot1,
@@ -270,15 +314,28 @@ public:
 	                             OverlapMethod method = OverlapMethod::Nearphase);
 
 private:
+	std::unique_ptr<btITaskScheduler> task_scheduler;
 	std::unique_ptr<btDefaultCollisionConfiguration> collision_config;
 	std::unique_ptr<btCollisionDispatcher> dispatcher;
 	std::unique_ptr<btDbvtBroadphase> broadphase;
+	std::unique_ptr<btConstraintSolverPoolMt> solver_pool;
 	std::unique_ptr<btSequentialImpulseConstraintSolver> solver;
 	std::unique_ptr<btDiscreteDynamicsWorld> world;
 
 	Util::ObjectPool<PhysicsHandle> handle_pool;
 	std::vector<PhysicsHandle *> handles;
 
+	// Handles which are synchronized with their scene node every iteration.
+	// Node driven handles are copied into the world before stepping,
+	// simulated handles are copied back out after stepping.
+	std::vector<PhysicsHandle *> node_driven_handles;
+	std::vector<PhysicsHandle *> simulated_handles;
+	std::vector<AABB> node_driven_aabbs;
+	void add_sync_handle(PhysicsHandle *handle);
+	void remove_sync_handle(PhysicsHandle *handle);
+	void sync_node_driven_handles();
+	void sync_simulated_handles();
+
 	PhysicsHandle *add_shape(Node *node, const MaterialInfo &info, btCollisionShape *shape);
 	std::vector<CollisionEvent> new_collision_buffer;
 	std::vector<std::unique_ptr<btBvhTriangleMeshShape>> mesh_collision_shapes;
@@ -0,0 +1,431 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "animation_compression.hpp"
+#include "muglm/muglm_impl.hpp"
+#include "simd_batch.hpp"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+namespace Granite
+{
+// Smallest-three components of a unit quaternion are bounded by 1 / sqrt(2).
+static constexpr float SmallestThreeRange = 0.70710678f;
+
+static float max_component(const vec4 &v)
+{
+	return muglm::max(muglm::max(v.x, v.y), muglm::max(v.z, v.w));
+}
+
+static float max_component(const vec3 &v)
+{
+	return muglm::max(muglm::max(v.x, v.y), v.z);
+}
+
+// q and -q represent the same rotation.
+static float quat_error(const vec4 &a, const vec4 &b)
+{
+	return muglm::min(max_component(abs(a - b)), max_component(abs(a + b)));
+}
+
+static void quantize_rotation(const quat &rotation, int16_t *smallest_three, unsigned &largest)
+{
+	vec4 q = normalize(rotation.as_vec4());
+	largest = 0;
+	for (unsigned c = 1; c < 4; c++)
+		if (muglm::abs(q[c]) > muglm::abs(q[largest]))
+			largest = c;
+
+	// Decoder reconstructs the largest component as positive.
+	if (q[largest] < 0.0f)
+		q = -q;
+
+	unsigned out = 0;
+	for (unsigned c = 0; c < 4; c++)
+	{
+		if (c != largest)
+		{
+			float v = muglm::clamp(q[c] / SmallestThreeRange, -1.0f, 1.0f);
+			smallest_three[out++] = int16_t(muglm::round(v * 32767.0f));
+		}
+	}
+}
+
+static uint16_t quantize_unorm(float v, float base, float extent)
+{
+	if (extent <= 0.0f)
+		return 0;
+	v = muglm::clamp((v - base) / extent, 0.0f, 1.0f);
+	return uint16_t(muglm::round(v * 65535.0f));
+}
+
+// The helpers below are scalar versions of the decode in sample(), with the same order of operations,
+// so that key reduction measures the error of what is actually decoded, quantization included.
+static constexpr float SmallestThreeScale = SmallestThreeRange / 32767.0f;
+static constexpr float UnormScale = 1.0f / 65535.0f;
+
+static vec4 dequantize_rotation(const int16_t *smallest_three, unsigned largest)
+{
+	float a = float(smallest_three[0]) * SmallestThreeScale;
+	float b = float(smallest_three[1]) * SmallestThreeScale;
+	float c = float(smallest_three[2]) * SmallestThreeScale;
+	float d = muglm::sqrt(muglm::max(((1.0f - a * a) - b * b) - c * c, 0.0f));
+
+	const float abc[3] = { a, b, c };
+	vec4 q;
+	unsigned in = 0;
+	for (unsigned i = 0; i < 4; i++)
+		q[i] = i == largest ? d : abc[in++];
+	return q;
+}
+
+static vec4 decode_nlerp(const vec4 &q0, const vec4 &q1, float l)
+{
+	float d = (q0.x * q1.x + q0.y * q1.y) + (q0.z * q1.z + q0.w * q1.w);
+	float sign = d < 0.0f ? -1.0f : 1.0f;
+
+	vec4 q;
+	for (unsigned c = 0; c < 4; c++)
+		q[c] = q0[c] + (q1[c] * sign - q0[c]) * l;
+
+	float len2 = (q.x * q.x + q.y * q.y) + (q.z * q.z + q.w * q.w);
+	return q * (1.0f / muglm::sqrt(len2));
+}
+
+static vec3 decode_lerp(const vec3 &n0, const vec3 &n1, float l, const float *base, const float *extent,
+                        unsigned stride)
+{
+	vec3 v;
+	for (unsigned c = 0; c < 3; c++)
+		v[c] = base[c * stride] + extent[c * stride] * (n0[c] + (n1[c] - n0[c]) * l);
+	return v;
+}
+
+bool CompressedAnimationClip::segment_is_within_tolerance(const Track *tracks, const Track *decoded,
+                                                          unsigned a, unsigned b,
+                                                          const AnimationCompressionOptions &options) const
+{
+	for (unsigned channel = 0; channel < num_channels; channel++)
+	{
+		auto &track = tracks[channel];
+		auto &dec = decoded[channel];
+		for (unsigned s = a + 1; s < b; s++)
+		{
+			// Matches the interpolation factor from locate().
+			float l = float(s - a) / float(b - a);
+
+			if (!track.rotation.empty())
+			{
+				vec4 q = decode_nlerp(dec.rotation[a].as_vec4(), dec.rotation[b].as_vec4(), l);
+				if (quat_error(q, normalize(track.rotation[s].as_vec4())) > options.rotation_tolerance)
+					return false;
+			}
+
+			if (!track.translation.empty())
+			{
+				vec3 t = decode_lerp(dec.translation[a], dec.translation[b], l,
+				                     &translation_base[channel], &translation_extent[channel], num_channels_padded);
+				if (max_component(abs(t - track.translation[s])) > options.translation_tolerance)
+					return false;
+			}
+
+			if (!track.scale.empty())
+			{
+				vec3 t = decode_lerp(dec.scale[a], dec.scale[b], l,
+				                     &scale_base[channel], &scale_extent[channel], num_channels_padded);
+				if (max_component(abs(t - track.scale[s])) > options.scale_tolerance)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void CompressedAnimationClip::reduce_keys(const Track *tracks, const Track *decoded, unsigned num_samples,
+                                          const AnimationCompressionOptions &options)
+{
+	key_samples.clear();
+	key_samples.push_back(0);
+
+	unsigned max_interval = muglm::max(options.max_key_interval, 1u);
+	unsigned a = 0;
+
+	// Greedily extend each segment as long as the decoded interpolation of every channel stays within tolerance.
+	while (a + 1 < num_samples)
+	{
+		unsigned b = a + 1;
+		unsigned limit = muglm::min(num_samples - 1, a + max_interval);
+		for (unsigned candidate = a + 2; candidate <= limit; candidate++)
+		{
+			if (!segment_is_within_tolerance(tracks, decoded, a, candidate, options))
+				break;
+			b = candidate;
+		}
+
+		key_samples.push_back(b);
+		a = b;
+	}
+}
+
+void CompressedAnimationClip::compress(const Track *tracks, unsigned num_channels_, unsigned num_samples,
+                                       const AnimationCompressionOptions &options)
+{
+	num_channels = num_channels_;
+	num_channels_padded = (num_channels + AnimationSampleBatch::Size - 1) & ~(AnimationSampleBatch::Size - 1);
+	num_samples = muglm::max(num_samples, 1u);
+
+	translation_base.assign(3 * num_channels_padded, 0.0f);
+	translation_extent.assign(3 * num_channels_padded, 0.0f);
+	scale_base.assign(3 * num_channels_padded, 1.0f);
+	scale_extent.assign(3 * num_channels_padded, 0.0f);
+
+	// Ranges cover every sample rather than only the keys,
+	// since they have to be known before key reduction can account for quantization.
+	const auto compute_range = [&](const std::vector<vec3> &values, float *base, float *extent, unsigned channel) {
+		vec3 lo(std::numeric_limits<float>::max());
+		vec3 hi(-std::numeric_limits<float>::max());
+		for (auto &v : values)
+		{
+			lo = min(lo, v);
+			hi = max(hi, v);
+		}
+
+		for (unsigned c = 0; c < 3; c++)
+		{
+			base[c * num_channels_padded + channel] = lo[c];
+			extent[c * num_channels_padded + channel] = hi[c] - lo[c];
+		}
+	};
+
+	const auto quantize_range = [&](const vec3 &v, const float *base, const float *extent, uint16_t *out,
+	                                unsigned channel) {
+		for (unsigned c = 0; c < 3; c++)
+		{
+			size_t range_offset = c * num_channels_padded + channel;
+			out[c] = quantize_unorm(v[c], base[range_offset], extent[range_offset]);
+		}
+	};
+
+	// What the decoder sees for every sample, in case it ends up as a key.
+	std::vector<Track> decoded(num_channels);
+
+	for (unsigned channel = 0; channel < num_channels; channel++)
+	{
+		auto &track = tracks[channel];
+		auto &dec = decoded[channel];
+
+		if (!track.translation.empty())
+			compute_range(track.translation, translation_base.data(), translation_extent.data(), channel);
+		if (!track.scale.empty())
+			compute_range(track.scale, scale_base.data(), scale_extent.data(), channel);
+
+		for (auto &rotation : track.rotation)
+		{
+			int16_t smallest_three[3];
+			unsigned largest;
+			quantize_rotation(rotation, smallest_three, largest);
+			dec.rotation.push_back(quat(dequantize_rotation(smallest_three, largest)));
+		}
+
+		for (auto &translation : track.translation)
+		{
+			uint16_t q[3];
+			quantize_range(translation, translation_base.data(), translation_extent.data(), q, channel);
+			dec.translation.push_back(vec3(float(q[0]), float(q[1]), float(q[2])) * UnormScale);
+		}
+
+		for (auto &scale : track.scale)
+		{
+			uint16_t q[3];
+			quantize_range(scale, scale_base.data(), scale_extent.data(), q, channel);
+			dec.scale.push_back(vec3(float(q[0]), float(q[1]), float(q[2])) * UnormScale);
+		}
+	}
+
+	reduce_keys(tracks, decoded.data(), num_samples, options);
+	size_t num_keys = key_samples.size();
+
+	// Identity for padding and channels which do not animate a component.
+	rotation_data.assign(num_keys * 3 * num_channels_padded, 0);
+	rotation_largest.assign(num_keys * num_channels_padded, 3);
+	translation_data.assign(num_keys * 3 * num_channels_padded, 0);
+	scale_data.assign(num_keys * 3 * num_channels_padded, 0);
+
+	for (unsigned channel = 0; channel < num_channels; channel++)
+	{
+		auto &track = tracks[channel];
+
+		for (size_t key = 0; key < num_keys; key++)
+		{
+			uint32_t s = key_samples[key];
+			size_t offset = key * 3 * num_channels_padded + channel;
+
+			if (!track.rotation.empty())
+			{
+				int16_t smallest_three[3];
+				unsigned largest;
+				quantize_rotation(track.rotation[s], smallest_three, largest);
+				for (unsigned c = 0; c < 3; c++)
+					rotation_data[offset + c * num_channels_padded] = smallest_three[c];
+				rotation_largest[key * num_channels_padded + channel] = uint8_t(largest);
+			}
+
+			uint16_t q[3];
+			if (!track.translation.empty())
+			{
+				quantize_range(track.translation[s], translation_base.data(), translation_extent.data(), q, channel);
+				for (unsigned c = 0; c < 3; c++)
+					translation_data[offset + c * num_channels_padded] = q[c];
+			}
+
+			if (!track.scale.empty())
+			{
+				quantize_range(track.scale[s], scale_base.data(), scale_extent.data(), q, channel);
+				for (unsigned c = 0; c < 3; c++)
+					scale_data[offset + c * num_channels_padded] = q[c];
+			}
+		}
+	}
+}
+
+CompressedAnimationClip::KeyLocation CompressedAnimationClip::locate(float sample) const
+{
+	KeyLocation loc = {};
+	if (key_samples.empty())
+		return loc;
+
+	sample = muglm::clamp(sample, 0.0f, float(key_samples.back()));
+	auto itr = std::upper_bound(key_samples.begin(), key_samples.end(), uint32_t(sample));
+	loc.lo = uint32_t(itr - key_samples.begin()) - 1;
+	loc.hi = muglm::min(loc.lo + 1, uint32_t(key_samples.size() - 1));
+
+	uint32_t lo_sample = key_samples[loc.lo];
+	uint32_t hi_sample = key_samples[loc.hi];
+	if (hi_sample > lo_sample)
+		loc.l = muglm::clamp((sample - float(lo_sample)) / float(hi_sample - lo_sample), 0.0f, 1.0f);
+
+	return loc;
+}
+
+static inline void decode_smallest_three(SIMD::Batch::Float a, SIMD::Batch::Float b, SIMD::Batch::Float c,
+                                         SIMD::Batch::Float largest, SIMD::Batch::Float *q)
+{
+	using namespace SIMD::Batch;
+	Float d = sqrt(max(sub(sub(sub(splat(1.0f), mul(a, a)), mul(b, b)), mul(c, c)), splat(0.0f)));
+	Mask m0 = cmp_eq(largest, splat(0.0f));
+	Mask m1 = cmp_eq(largest, splat(1.0f));
+	Mask m2 = cmp_eq(largest, splat(2.0f));
+	Mask m3 = cmp_eq(largest, splat(3.0f));
+	q[0] = select(m0, d, a);
+	q[1] = select(m0, a, select(m1, d, b));
+	q[2] = select(m3, c, select(m2, d, b));
+	q[3] = select(m3, d, c);
+}
+
+void CompressedAnimationClip::sample(const KeyLocation &loc, unsigned first_channel,
+                                     AnimationSampleBatch &batch) const
+{
+	using namespace SIMD::Batch;
+	constexpr unsigned Size = AnimationSampleBatch::Size;
+	static_assert(Size % Width == 0, "Batch size must be a multiple of SIMD width.");
+	assert(first_channel % Size == 0 && first_channel < num_channels_padded);
+
+	// Widen quantized data for both keys. The rest of the decode is vectorized.
+	alignas(32) float rot[2][4][Size];
+	alignas(32) float trans[2][3][Size];
+	alignas(32) float scale[2][3][Size];
+
+	for (unsigned k = 0; k < 2; k++)
+	{
+		size_t key = k ? loc.hi : loc.lo;
+		size_t offset = key * 3 * num_channels_padded + first_channel;
+		for (unsigned c = 0; c < 3; c++)
+		{
+			const int16_t *r = &rotation_data[offset + c * num_channels_padded];
+			const uint16_t *t = &translation_data[offset + c * num_channels_padded];
+			const uint16_t *s = &scale_data[offset + c * num_channels_padded];
+			for (unsigned i = 0; i < Size; i++)
+			{
+				rot[k][c][i] = float(r[i]) * SmallestThreeScale;
+				trans[k][c][i] = float(t[i]) * UnormScale;
+				scale[k][c][i] = float(s[i]) * UnormScale;
+			}
+		}
+
+		const uint8_t *largest = &rotation_largest[key * num_channels_padded + first_channel];
+		for (unsigned i = 0; i < Size; i++)
+			rot[k][3][i] = float(largest[i]);
+	}
+
+	Float l = splat(loc.l);
+
+	for (unsigned i = 0; i < Size; i += Width)
+	{
+		Float q0[4], q1[4];
+		decode_smallest_three(load(&rot[0][0][i]), load(&rot[0][1][i]), load(&rot[0][2][i]), load(&rot[0][3][i]), q0);
+		decode_smallest_three(load(&rot[1][0][i]), load(&rot[1][1][i]), load(&rot[1][2][i]), load(&rot[1][3][i]), q1);
+
+		// Take the shortest path, then nlerp.
+		Float d = add(add(mul(q0[0], q1[0]), mul(q0[1], q1[1])), add(mul(q0[2], q1[2]), mul(q0[3], q1[3])));
+		Float sign = select(cmp_lt(d, splat(0.0f)), splat(-1.0f), splat(1.0f));
+
+		Float q[4];
+		for (unsigned c = 0; c < 4; c++)
+			q[c] = add(q0[c], mul(sub(mul(q1[c], sign), q0[c]), l));
+
+		Float len2 = add(add(mul(q[0], q[0]), mul(q[1], q[1])), add(mul(q[2], q[2]), mul(q[3], q[3])));
+		Float inv_len = div(splat(1.0f), sqrt(len2));
+		for (unsigned c = 0; c < 4; c++)
+			store(&batch.rotation[c][i], mul(q[c], inv_len));
+
+		for (unsigned c = 0; c < 3; c++)
+		{
+			size_t range_offset = c * num_channels_padded + first_channel + i;
+
+			Float t0 = load(&trans[0][c][i]);
+			Float t1 = load(&trans[1][c][i]);
+			Float t = add(t0, mul(sub(t1, t0), l));
+			t = add(load(&translation_base[range_offset]), mul(load(&translation_extent[range_offset]), t));
+			store(&batch.translation[c][i], t);
+
+			Float s0 = load(&scale[0][c][i]);
+			Float s1 = load(&scale[1][c][i]);
+			Float s = add(s0, mul(sub(s1, s0), l));
+			s = add(load(&scale_base[range_offset]), mul(load(&scale_extent[range_offset]), s));
+			store(&batch.scale[c][i], s);
+		}
+	}
+}
+
+size_t CompressedAnimationClip::get_memory_size() const
+{
+	return key_samples.size() * sizeof(key_samples[0]) +
+	       rotation_data.size() * sizeof(rotation_data[0]) +
+	       rotation_largest.size() * sizeof(rotation_largest[0]) +
+	       translation_data.size() * sizeof(translation_data[0]) +
+	       scale_data.size() * sizeof(scale_data[0]) +
+	       (translation_base.size() + translation_extent.size() +
+	        scale_base.size() + scale_extent.size()) * sizeof(float);
+}
+}
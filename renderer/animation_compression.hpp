@@ -0,0 +1,118 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "math.hpp"
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Granite
+{
+struct AnimationCompressionOptions
+{
+	// Maximum error of decoded samples, including 16-bit quantization, when key frames are removed.
+	// Rotation error is measured per quaternion component.
+	float rotation_tolerance = 0.0005f;
+	float translation_tolerance = 0.0001f;
+	float scale_tolerance = 0.0001f;
+	// Bounds the cost of key reduction for long clips.
+	unsigned max_key_interval = 64;
+};
+
+// SoA output for a batch of consecutive channels.
+struct AnimationSampleBatch
+{
+	enum { Size = 8 };
+	alignas(32) float rotation[4][Size];
+	alignas(32) float translation[3][Size];
+	alignas(32) float scale[3][Size];
+};
+
+// Animation clip where all channels share a reduced set of key frames.
+// Rotations are quantized with smallest-three encoding, while translation and scale
+// are quantized to 16-bit relative to the per-channel range.
+// Key data is laid out as [key][component][channel], so many channels can be decoded at once.
+class CompressedAnimationClip
+{
+public:
+	struct Track
+	{
+		// Either empty or num_samples long.
+		std::vector<quat> rotation;
+		std::vector<vec3> translation;
+		std::vector<vec3> scale;
+	};
+
+	void compress(const Track *tracks, unsigned num_channels, unsigned num_samples,
+	              const AnimationCompressionOptions &options);
+
+	struct KeyLocation
+	{
+		uint32_t lo;
+		uint32_t hi;
+		float l;
+	};
+
+	// sample is in units of the original sample rate.
+	KeyLocation locate(float sample) const;
+
+	// Decodes channels [first_channel, first_channel + AnimationSampleBatch::Size).
+	// first_channel must be a multiple of AnimationSampleBatch::Size.
+	// Channels past the end are decoded as identity transforms.
+	void sample(const KeyLocation &loc, unsigned first_channel, AnimationSampleBatch &batch) const;
+
+	unsigned get_num_channels() const
+	{
+		return num_channels;
+	}
+
+	unsigned get_num_keys() const
+	{
+		return unsigned(key_samples.size());
+	}
+
+	size_t get_memory_size() const;
+
+private:
+	unsigned num_channels = 0;
+	unsigned num_channels_padded = 0;
+	std::vector<uint32_t> key_samples;
+
+	std::vector<int16_t> rotation_data;
+	std::vector<uint8_t> rotation_largest;
+	std::vector<uint16_t> translation_data;
+	std::vector<uint16_t> scale_data;
+
+	// [component][channel]
+	std::vector<float> translation_base;
+	std::vector<float> translation_extent;
+	std::vector<float> scale_base;
+	std::vector<float> scale_extent;
+
+	void reduce_keys(const Track *tracks, const Track *decoded, unsigned num_samples,
+	                 const AnimationCompressionOptions &options);
+	bool segment_is_within_tolerance(const Track *tracks, const Track *decoded, unsigned a, unsigned b,
+	                                 const AnimationCompressionOptions &options) const;
+};
+}
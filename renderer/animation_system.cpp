@@ -22,6 +22,9 @@
 
 #include "animation_system.hpp"
 #include "task_composer.hpp"
+#include <algorithm>
+#include <functional>
+#include <assert.h>
 
 namespace Granite
 {
@@ -52,18 +55,6 @@ unsigned AnimationUnrolled::find_or_allocate_index(uint32_t node_index)
 	}
 }
 
-void AnimationUnrolled::reserve_num_clips(unsigned count)
-{
-	if (count > key_frames_rotation.size())
-	{
-		key_frames_rotation.resize(count);
-		key_frames_translation.resize(count);
-		key_frames_scale.resize(count);
-		multi_node_indices.resize(count);
-		channel_mask.resize(count);
-	}
-}
-
 unsigned AnimationUnrolled::get_num_channels() const
 {
 	return channel_mask.size();
@@ -79,6 +70,11 @@ float AnimationUnrolled::get_length() const
 	return length;
 }
 
+size_t AnimationUnrolled::get_memory_size() const
+{
+	return clip.get_memory_size();
+}
+
 bool AnimationUnrolled::is_skinned() const
 {
 	return skinning;
@@ -93,43 +89,51 @@ void AnimationUnrolled::animate(Transform *transforms, const uint32_t *transform
 {
 	if (num_transforms != get_num_channels())
 		throw std::logic_error("Incorrect number of transforms.");
-
-	float sample = offset_time * frame_rate;
-	float low_sample = muglm::floor(sample);
-	int lo = clamp(int(low_sample), 0, int(num_samples) - 1);
-	int hi = muglm::min(lo + 1, int(num_samples) - 1);
-	float l = sample - low_sample;
-
-	for (unsigned i = 0; i < num_transforms; i++)
-	{
-		auto *t = &transforms[transform_indices[i]];
-		animate_single(*t, i, lo, hi, l);
-	}
+	animate_range(transforms, transform_indices, 0, num_transforms, offset_time);
 }
 
-void AnimationUnrolled::animate_single(Transform &t, unsigned channel, int lo, int hi, float l) const
+void AnimationUnrolled::animate_range(Transform *transforms, const uint32_t *transform_indices,
+                                      unsigned first_channel, unsigned num_channels, float offset_time) const
 {
+	assert(first_channel % AnimationSampleBatch::Size == 0);
+	assert(first_channel + num_channels <= get_num_channels());
+
 	// The animations should be resampled at such a high rate in runtime (e.g. 60 fps)
 	// that doing slerp for rotation is irrelevant.
-	auto mask = channel_mask[channel];
-	if (mask & ROTATION_BIT)
-		t.rotation = normalize(quat(mix(key_frames_rotation[channel][lo].as_vec4(), key_frames_rotation[channel][hi].as_vec4(), l)));
-	if (mask & TRANSLATION_BIT)
-		t.translation = mix(key_frames_translation[channel][lo], key_frames_translation[channel][hi], l);
-	if (mask & SCALE_BIT)
-		t.scale = mix(key_frames_scale[channel][lo], key_frames_scale[channel][hi], l);
+	auto loc = clip.locate(offset_time * frame_rate);
+	AnimationSampleBatch batch;
+
+	unsigned end_channel = first_channel + num_channels;
+	for (unsigned base = first_channel; base < end_channel; base += AnimationSampleBatch::Size)
+	{
+		clip.sample(loc, base, batch);
+		unsigned count = muglm::min(end_channel - base, unsigned(AnimationSampleBatch::Size));
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			auto &t = transforms[transform_indices[base + i]];
+			auto mask = channel_mask[base + i];
+			if (mask & ROTATION_BIT)
+				t.rotation = quat(batch.rotation[3][i], batch.rotation[0][i], batch.rotation[1][i], batch.rotation[2][i]);
+			if (mask & TRANSLATION_BIT)
+				t.translation = vec3(batch.translation[0][i], batch.translation[1][i], batch.translation[2][i]);
+			if (mask & SCALE_BIT)
+				t.scale = vec3(batch.scale[0][i], batch.scale[1][i], batch.scale[2][i]);
+		}
+	}
 }
 
-AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, float key_frame_rate)
+AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, float key_frame_rate,
+                                     const AnimationCompressionOptions &options)
 {
 	frame_rate = key_frame_rate;
 	inv_frame_rate = 1.0f / key_frame_rate;
 	size_t size = animation.channels.size();
-	key_frames_rotation.reserve(size);
-	key_frames_translation.reserve(size);
-	key_frames_translation.reserve(size);
 	multi_node_indices.reserve(size);
-	channel_mask.resize(size);
+
+	// Resample everything at a fixed rate first, then compress.
+	std::vector<CompressedAnimationClip::Track> tracks;
+	tracks.reserve(size);
 
 	float total_length = 0.0f;
 	for (auto &c : animation.channels)
@@ -157,13 +161,20 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			index = find_or_allocate_index(c.node_index);
 		}
 
-		reserve_num_clips(index + 1);
+		if (index + 1 > tracks.size())
+		{
+			tracks.resize(index + 1);
+			multi_node_indices.resize(index + 1);
+			channel_mask.resize(index + 1);
+		}
+
+		auto &track = tracks[index];
 
 		switch (c.type)
 		{
 		case SceneFormats::AnimationChannel::Type::CubicScale:
-			key_frames_scale[index].resize(num_samples);
-			resample_channel(key_frames_scale[index].data(), num_samples, c,
+			track.scale.resize(num_samples);
+			resample_channel(track.scale.data(), num_samples, c,
 			                 [&c](unsigned i, float t, float dt) {
 				                 return c.positional.sample_spline(i, t, dt);
 			                 }, inv_frame_rate);
@@ -171,8 +182,8 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			break;
 
 		case SceneFormats::AnimationChannel::Type::Scale:
-			key_frames_scale[index].resize(num_samples);
-			resample_channel(key_frames_scale[index].data(), num_samples, c,
+			track.scale.resize(num_samples);
+			resample_channel(track.scale.data(), num_samples, c,
 			                 [&c](unsigned i, float t, float) {
 				                 return c.positional.sample(i, t);
 			                 }, inv_frame_rate);
@@ -180,8 +191,8 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			break;
 
 		case SceneFormats::AnimationChannel::Type::CubicTranslation:
-			key_frames_translation[index].resize(num_samples);
-			resample_channel(key_frames_translation[index].data(), num_samples, c,
+			track.translation.resize(num_samples);
+			resample_channel(track.translation.data(), num_samples, c,
 			                 [&c](unsigned i, float t, float dt) {
 				                 return c.positional.sample_spline(i, t, dt);
 			                 }, inv_frame_rate);
@@ -189,8 +200,8 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			break;
 
 		case SceneFormats::AnimationChannel::Type::Translation:
-			key_frames_translation[index].resize(num_samples);
-			resample_channel(key_frames_translation[index].data(), num_samples, c,
+			track.translation.resize(num_samples);
+			resample_channel(track.translation.data(), num_samples, c,
 			                 [&c](unsigned i, float t, float) {
 				                 return c.positional.sample(i, t);
 			                 }, inv_frame_rate);
@@ -198,8 +209,8 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			break;
 
 		case SceneFormats::AnimationChannel::Type::CubicRotation:
-			key_frames_rotation[index].resize(num_samples);
-			resample_channel(key_frames_rotation[index].data(), num_samples, c,
+			track.rotation.resize(num_samples);
+			resample_channel(track.rotation.data(), num_samples, c,
 			                 [&c](unsigned i, float t, float dt) {
 				                 return c.spherical.sample_spline(i, t, dt);
 			                 }, inv_frame_rate);
@@ -207,8 +218,8 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			break;
 
 		case SceneFormats::AnimationChannel::Type::Squad:
-			key_frames_rotation[index].resize(num_samples);
-			resample_channel(key_frames_rotation[index].data(), num_samples, c,
+			track.rotation.resize(num_samples);
+			resample_channel(track.rotation.data(), num_samples, c,
 			                 [&c](unsigned i, float t, float) {
 				                 return c.spherical.sample_squad(i, t);
 			                 }, inv_frame_rate);
@@ -216,8 +227,8 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			break;
 
 		case SceneFormats::AnimationChannel::Type::Rotation:
-			key_frames_rotation[index].resize(num_samples);
-			resample_channel(key_frames_rotation[index].data(), num_samples, c,
+			track.rotation.resize(num_samples);
+			resample_channel(track.rotation.data(), num_samples, c,
 			                 [&c](unsigned i, float t, float) {
 				                 return c.spherical.sample(i, t);
 			                 }, inv_frame_rate);
@@ -225,6 +236,8 @@ AnimationUnrolled::AnimationUnrolled(const SceneFormats::Animation &animation, f
 			break;
 		}
 	}
+
+	clip.compress(tracks.data(), unsigned(tracks.size()), num_samples, options);
 }
 
 AnimationID AnimationSystem::get_animation_id_from_name(const std::string &name) const
@@ -461,7 +474,7 @@ void AnimationSystem::set_relative_timing(Granite::AnimationStateID id, bool ena
 		state->relative_timing = enable;
 }
 
-void AnimationSystem::update(AnimationState *anim, double frame_time, double elapsed_time)
+float AnimationSystem::update_timing(AnimationState *anim, double frame_time, double elapsed_time)
 {
 	bool complete = false;
 
@@ -482,23 +495,82 @@ void AnimationSystem::update(AnimationState *anim, double frame_time, double ela
 	if (anim->repeating)
 		offset = mod(offset, double(anim->animation.get_length()));
 
-	if (anim->animation.is_skinned())
+	if (complete)
+		garbage_collect_animations.push(anim);
+
+	return float(offset);
+}
+
+void AnimationSystem::plan_updates(double frame_time, double elapsed_time)
+{
+	work_items.clear();
+
+	for (auto *anim : active_animation)
 	{
-		auto *node = anim->skinned_node;
-		anim->animation.animate(anim->transforms_base,
-		                        node->get_skin()->skin.data(), node->get_skin()->skin.size(), float(offset));
-		node->invalidate_cached_transform();
+		float offset = update_timing(anim, frame_time, elapsed_time);
+		unsigned num_channels = anim->animation.get_num_channels();
+
+		if (anim->animation.is_skinned() && anim->skinned_node->get_skin()->skin.size() != num_channels)
+			throw std::logic_error("Incorrect number of transforms.");
+
+		for (unsigned first = 0; first < num_channels; first += MaxChannelsPerWorkItem)
+		{
+			unsigned count = muglm::min(num_channels - first, unsigned(MaxChannelsPerWorkItem));
+			work_items.push_back({ anim, offset, first, count });
+		}
 	}
-	else
+
+	// Batch by clip, so that workers keep sampling the same key data.
+	std::sort(work_items.begin(), work_items.end(), [](const WorkItem &a, const WorkItem &b) {
+		return std::less<const AnimationUnrolled *>()(&a.state->animation, &b.state->animation);
+	});
+}
+
+template <typename Func>
+void AnimationSystem::for_each_work_chunk(const Func &func) const
+{
+	size_t begin_index = 0;
+	unsigned num_channels = 0;
+
+	for (size_t i = 0, n = work_items.size(); i < n; i++)
 	{
-		anim->animation.animate(anim->transforms_base,
-		                        anim->channel_transforms.data(), anim->channel_transforms.size(), float(offset));
-		for (auto *node : anim->channel_nodes)
-			node->invalidate_cached_transform();
+		num_channels += work_items[i].num_channels;
+		if (num_channels >= TargetChannelsPerTask)
+		{
+			func(work_items.data() + begin_index, i + 1 - begin_index);
+			begin_index = i + 1;
+			num_channels = 0;
+		}
 	}
 
-	if (complete)
-		garbage_collect_animations.push(anim);
+	if (begin_index < work_items.size())
+		func(work_items.data() + begin_index, work_items.size() - begin_index);
+}
+
+void AnimationSystem::perform_work_items(const WorkItem *items, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &item = items[i];
+		auto *anim = item.state;
+
+		// Results go straight into the TransformAllocator arrays.
+		if (anim->animation.is_skinned())
+		{
+			auto *node = anim->skinned_node;
+			anim->animation.animate_range(anim->transforms_base, node->get_skin()->skin.data(),
+			                              item.first_channel, item.num_channels, item.offset);
+			if (item.first_channel == 0)
+				node->invalidate_cached_transform();
+		}
+		else
+		{
+			anim->animation.animate_range(anim->transforms_base, anim->channel_transforms.data(),
+			                              item.first_channel, item.num_channels, item.offset);
+			for (unsigned j = 0; j < item.num_channels; j++)
+				anim->channel_nodes[item.first_channel + j]->invalidate_cached_transform();
+		}
+	}
 }
 
 void AnimationSystem::garbage_collect()
@@ -519,10 +591,8 @@ void AnimationSystem::garbage_collect()
 
 void AnimationSystem::animate(double frame_time, double elapsed_time)
 {
-	// TODO: Run multithreaded.
-	for (auto *anim : active_animation)
-		update(anim, frame_time, elapsed_time);
-
+	plan_updates(frame_time, elapsed_time);
+	perform_work_items(work_items.data(), work_items.size());
 	garbage_collect();
 }
 
@@ -530,20 +600,15 @@ void AnimationSystem::animate(TaskComposer &composer, double frame_time, double
 {
 	auto &group = composer.begin_pipeline_stage();
 	group.set_desc("animation-update");
-	size_t count = active_animation.size();
-	constexpr size_t per_batch = 32;
-	for (size_t i = 0; i < count; i += per_batch)
-	{
-		group.enqueue_task([=]() {
-			auto itr = active_animation.begin() + i;
-			auto end_itr = itr + std::min(per_batch, count - i);
-			while (itr != end_itr)
-			{
-				update(*itr, frame_time, elapsed_time);
-				++itr;
-			}
+	group.enqueue_task([this, frame_time, elapsed_time, h = composer.get_deferred_enqueue_handle()]() mutable {
+		// Timing updates are cheap and serial, sampling is spread across workers.
+		plan_updates(frame_time, elapsed_time);
+		for_each_work_chunk([&](const WorkItem *items, size_t count) {
+			h->enqueue_task([this, items, count]() {
+				perform_work_items(items, count);
+			});
 		});
-	}
+	});
 
 	auto &cleanup = composer.begin_pipeline_stage();
 	cleanup.set_desc("animation-cleanup");
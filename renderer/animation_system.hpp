@@ -24,6 +24,7 @@
 
 #include "scene.hpp"
 #include "scene_formats.hpp"
+#include "animation_compression.hpp"
 #include "generational_handle.hpp"
 #include "intrusive_hash_map.hpp"
 #include "unordered_array.hpp"
@@ -36,9 +37,15 @@ namespace Granite
 class AnimationUnrolled : public Util::IntrusiveHashMapEnabled<AnimationUnrolled>
 {
 public:
-	AnimationUnrolled(const SceneFormats::Animation &animation, float key_frame_rate);
+	AnimationUnrolled(const SceneFormats::Animation &animation, float key_frame_rate,
+	                  const AnimationCompressionOptions &options = {});
 	void animate(Transform *transforms, const uint32_t *transform_indices, unsigned num_transforms, float offset_time) const;
 
+	// Only animates channels [first_channel, first_channel + num_channels).
+	// transform_indices is still indexed by channel, and first_channel must be a multiple of AnimationSampleBatch::Size.
+	void animate_range(Transform *transforms, const uint32_t *transform_indices,
+	                   unsigned first_channel, unsigned num_channels, float offset_time) const;
+
 	unsigned get_num_channels() const;
 
 	bool is_skinned() const;
@@ -46,6 +53,7 @@ public:
 	Util::Hash get_skin_compat() const;
 
 	float get_length() const;
+	size_t get_memory_size() const;
 
 private:
 	enum ChannelMask
@@ -55,9 +63,7 @@ private:
 		SCALE_BIT = 1 << 2
 	};
 
-	std::vector<std::vector<quat>> key_frames_rotation;
-	std::vector<std::vector<vec3>> key_frames_translation;
-	std::vector<std::vector<vec3>> key_frames_scale;
+	CompressedAnimationClip clip;
 	std::vector<uint8_t> channel_mask;
 
 	std::vector<uint32_t> multi_node_indices;
@@ -70,10 +76,7 @@ private:
 	Util::Hash skin_compat = 0;
 	bool skinning = false;
 
-	void reserve_num_clips(unsigned count);
 	unsigned find_or_allocate_index(uint32_t node_index);
-
-	void animate_single(Transform &transform, unsigned channel, int lo, int hi, float l) const;
 };
 
 using AnimationID = Util::GenerationalHandleID;
@@ -133,7 +136,25 @@ private:
 	Util::IntrusiveUnorderedArray<AnimationState> active_animation;
 	Util::AtomicAppendBuffer<AnimationState *> garbage_collect_animations;
 
-	void update(AnimationState *state, double frame_time, double elapsed_time);
+	// Large skeletons are split so that work can be balanced by channel count.
+	enum { MaxChannelsPerWorkItem = 256, TargetChannelsPerTask = 1024 };
+	static_assert(MaxChannelsPerWorkItem % AnimationSampleBatch::Size == 0,
+	              "Work items must be aligned to sample batches.");
+
+	struct WorkItem
+	{
+		AnimationState *state;
+		float offset;
+		unsigned first_channel;
+		unsigned num_channels;
+	};
+	std::vector<WorkItem> work_items;
+
+	float update_timing(AnimationState *state, double frame_time, double elapsed_time);
+	void plan_updates(double frame_time, double elapsed_time);
+	void perform_work_items(const WorkItem *items, size_t count);
+	template <typename Func>
+	void for_each_work_chunk(const Func &func) const;
 	void garbage_collect();
 };
 }
\ No newline at end of file
@@ -20,70 +20,37 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#define NOMINMAX
-#include "stb_truetype.h"
 #include "font.hpp"
 #include <stdexcept>
-#include "filesystem.hpp"
 #include "device.hpp"
 #include "sprite.hpp"
 #include <string.h>
-#include <float.h>
 
 using namespace Vulkan;
 using namespace Util;
 
 namespace Granite
 {
-struct Font::Baked
-{
-	stbtt_bakedchar chars[128 - 32];
-};
-
 Font::~Font()
 {
 }
 
 Font::Font(const std::string &path, unsigned size)
 {
-	baked_chars.reset(new Baked);
-
-	auto file = GRANITE_FILESYSTEM()->open_readonly_mapping(path);
-	if (!file)
+	font_data = GRANITE_FILESYSTEM()->open_readonly_mapping(path);
+	if (!font_data)
 		throw std::runtime_error("Failed to open font.");
 
-	auto *mapped = file->data();
-	if (!mapped)
-		throw std::runtime_error("Failed to map font.");
-
-	unsigned multiplier = 4;
-	bool success = false;
+	if (!glyph_cache.init(font_data->data(), font_data->get_size()))
+		throw std::runtime_error("Failed to parse font.");
 
-	do
-	{
-		width = size * multiplier;
-		height = size * multiplier;
-		bitmap.resize(width * height);
-		int res = stbtt_BakeFontBitmap(static_cast<const unsigned char *>(mapped),
-		                               0, size,
-		                               bitmap.data(), width, height,
-		                               32, 96,
-		                               baked_chars->chars);
-
-		if (res <= 0)
-			multiplier++;
-		else
-		{
-			height = unsigned(res);
-			success = true;
-		}
-	} while (!success && multiplier <= 32);
-
-	if (!success)
-		throw std::runtime_error("Failed to bake bitmap.");
+	// Printable ASCII is always needed, so have it resident before the first upload.
+	for (uint32_t c = 32; c < 127; c++)
+		glyph_cache.get_glyph(c);
 
 	font_height = size;
 	EVENT_MANAGER_REGISTER_LATCH(Font, on_device_created, on_device_destroyed, DeviceCreatedEvent);
+	EVENT_MANAGER_REGISTER_LATCH(Font, on_swapchain_index, on_swapchain_index_released, SwapchainIndexEvent);
 }
 
 vec2 Font::get_text_geometry(const char *text) const
@@ -91,33 +58,8 @@ vec2 Font::get_text_geometry(const char *text) const
 	if (!*text)
 		return vec2(0);
 
-	vec2 off = vec2(0.0f);
-	off.y += font_height;
-
-	vec2 cached = off;
-	vec2 minimum = vec2(FLT_MAX);
-	vec2 maximum = vec2(-FLT_MAX);
-
-	while (*text)
-	{
-		stbtt_aligned_quad q;
-		if (*text == '\n')
-		{
-			cached.y += font_height;
-			off = cached;
-		}
-		else if (*text >= 32)
-		{
-			stbtt_GetBakedQuad(baked_chars->chars, width, height, *text - 32, &off.x, &off.y, &q, 1);
-			minimum = min(minimum, vec2(q.x0, q.y0));
-			minimum = min(minimum, vec2(q.x1, q.y1));
-			maximum = max(maximum, vec2(q.x0, q.y0));
-			maximum = max(maximum, vec2(q.x1, q.y1));
-		}
-		text++;
-	}
-
-	return ceil(vec2(maximum.x, cached.y));
+	std::lock_guard<std::mutex> holder{lock};
+	return glyph_cache.layout_text(text, float(font_height)).geometry;
 }
 
 vec2 Font::get_aligned_offset(Alignment alignment, vec2 text_geometry, vec2 target_geometry) const
@@ -165,6 +107,32 @@ vec2 Font::get_aligned_offset(Alignment alignment, vec2 text_geometry, vec2 targ
 	return round(alignment_offset);
 }
 
+void Font::flush_atlas_updates() const
+{
+	unsigned begin, end;
+	if (!texture || !glyph_cache.get_dirty_rows(begin, end))
+		return;
+
+	unsigned width = glyph_cache.get_atlas_width();
+	auto cmd = device->request_command_buffer();
+
+	// Existing glyphs may still be in use, so the old contents must be preserved.
+	cmd->image_barrier(*texture, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	auto *data = static_cast<uint8_t *>(cmd->update_image(*texture, { 0, int(begin), 0 }, { width, end - begin, 1 },
+	                                                     0, 0, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }));
+	memcpy(data, glyph_cache.get_atlas_data() + begin * width, (end - begin) * width);
+
+	cmd->image_barrier(*texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+	device->submit(cmd);
+
+	glyph_cache.clear_dirty_rows();
+}
+
 void Font::render_text(RenderQueue &queue, const char *text, const vec3 &offset, const vec2 &size,
                        const vec2 &clip_offset, const vec2 &clip_size,
                        const vec4 &color,
@@ -173,65 +141,48 @@ void Font::render_text(RenderQueue &queue, const char *text, const vec3 &offset,
 	if (!*text)
 		return;
 
-	vec2 geometry = get_text_geometry(text);
-	vec2 alignment_offset = get_aligned_offset(alignment, geometry, size);
+	std::lock_guard<std::mutex> holder{lock};
+	auto &layout = glyph_cache.layout_text(text, float(font_height));
+	if (layout.glyphs.empty())
+		return;
+
+	// Any glyphs rasterized by this layout must be visible before the queue is flushed.
+	flush_atlas_updates();
+
+	vec2 alignment_offset = get_aligned_offset(alignment, layout.geometry, size);
+	vec2 origin = offset.xy() + alignment_offset;
 
-	size_t len = strlen(text);
 	SpriteRenderInfo sprite;
 	sprite.textures[0] = &texture->get_view();
-	sprite.sampler = StockSampler::LinearWrap;
+	sprite.sampler = StockSampler::LinearClamp;
 
 	auto *instance_data = queue.allocate_one<SpriteInstanceInfo>();
-	auto *quads = queue.allocate_many<QuadData>(len);
+	auto *quads = queue.allocate_many<QuadData>(layout.glyphs.size());
 	instance_data->quads = quads;
-	instance_data->count = 0; // Will be accumulated in the loop.
-
-	vec2 off = offset.xy();
-	off.y += font_height;
-	vec2 cached = off;
+	instance_data->count = unsigned(layout.glyphs.size());
 
-	vec2 min_rect = vec2(FLT_MAX);
-	vec2 max_rect = vec2(-FLT_MAX);
-
-	while (*text)
+	auto half_color = floatToHalf(color);
+	for (auto &glyph : layout.glyphs)
 	{
-		stbtt_aligned_quad q;
-		if (*text == '\n')
-		{
-			cached.y += font_height;
-			off = cached;
-		}
-		else if (*text >= 32)
-		{
-			stbtt_GetBakedQuad(baked_chars->chars, width, height, *text - 32, &off.x, &off.y, &q, 1);
-
-			q.x0 += alignment_offset.x;
-			q.x1 += alignment_offset.x;
-			q.y0 += alignment_offset.y;
-			q.y1 += alignment_offset.y;
-
-			auto &quad = quads[instance_data->count++];
-			quad.color = floatToHalf(color);
-			quad.rotation[0] = 1.0f;
-			quad.rotation[1] = 0.0f;
-			quad.rotation[2] = 0.0f;
-			quad.rotation[3] = 1.0f;
-			quad.layer = offset.z;
-			quad.pos_off_x = q.x0;
-			quad.pos_off_y = q.y0;
-			quad.pos_scale_x = q.x1 - q.x0;
-			quad.pos_scale_y = q.y1 - q.y0;
-			quad.tex_off_x = muglm::round(q.s0 * width);
-			quad.tex_off_y = muglm::round(q.t0 * height);
-			quad.tex_scale_x = muglm::round(q.s1 * width) - quad.tex_off_x;
-			quad.tex_scale_y = muglm::round(q.t1 * height) - quad.tex_off_y;
-
-			max_rect = max(max_rect, vec2(q.x1, q.y1));
-			min_rect = min(min_rect, vec2(q.x0, q.y0));
-		}
-		text++;
+		auto &quad = *quads++;
+		quad.color = half_color;
+		quad.rotation[0] = 1.0f;
+		quad.rotation[1] = 0.0f;
+		quad.rotation[2] = 0.0f;
+		quad.rotation[3] = 1.0f;
+		quad.layer = offset.z;
+		quad.pos_off_x = origin.x + glyph.offset.x;
+		quad.pos_off_y = origin.y + glyph.offset.y;
+		quad.pos_scale_x = glyph.size.x;
+		quad.pos_scale_y = glyph.size.y;
+		quad.tex_off_x = float(glyph.tex_x);
+		quad.tex_off_y = float(glyph.tex_y);
+		quad.tex_scale_x = float(glyph.tex_width);
+		quad.tex_scale_y = float(glyph.tex_height);
 	}
 
+	vec2 min_rect = origin + layout.ink_min;
+	vec2 max_rect = origin + layout.ink_max;
 	if (any(lessThan(min_rect, clip_offset)) || any(greaterThan(max_rect, clip_offset + clip_size)))
 		sprite.clip_quad = ivec4(ivec2(clip_offset), ivec2(clip_size));
 
@@ -259,7 +210,7 @@ void Font::render_text(RenderQueue &queue, const char *text, const vec3 &offset,
 			                           MESH_ATTRIBUTE_POSITION_BIT |
 			                           MESH_ATTRIBUTE_VERTEX_COLOR_BIT,
 			                           MATERIAL_TEXTURE_BASE_COLOR_BIT,
-			                           Sprite::ALPHA_TEXTURE_BIT));
+			                           Sprite::SDF_TEXTURE_BIT));
 
 		*sprite_data = sprite;
 	}
@@ -267,18 +218,37 @@ void Font::render_text(RenderQueue &queue, const char *text, const vec3 &offset,
 
 void Font::on_device_created(const DeviceCreatedEvent &created)
 {
-	auto &device = created.get_device();
+	std::lock_guard<std::mutex> holder{lock};
+	device = &created.get_device();
 
-	ImageCreateInfo info = ImageCreateInfo::immutable_2d_image(width, height, VK_FORMAT_R8_UNORM, false);
+	ImageCreateInfo info = ImageCreateInfo::immutable_2d_image(glyph_cache.get_atlas_width(),
+	                                                           glyph_cache.get_atlas_height(),
+	                                                           VK_FORMAT_R8_UNORM, false);
+	info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	ImageInitialData initial = {};
-	initial.data = bitmap.data();
-	texture = device.create_image(info, &initial);
-	device.set_name(*texture, "font");
+	initial.data = glyph_cache.get_atlas_data();
+	texture = device->create_image(info, &initial);
+	device->set_name(*texture, "font");
+	glyph_cache.clear_dirty_rows();
 }
 
 void Font::on_device_destroyed(const DeviceCreatedEvent &)
 {
+	std::lock_guard<std::mutex> holder{lock};
 	texture.reset();
+	device = nullptr;
+}
+
+void Font::on_swapchain_index(const SwapchainIndexEvent &)
+{
+	// A new frame begins, so text queued with the old glyph locations has been submitted.
+	// The next render_text() uploads the flushed atlas before any new glyphs are used.
+	std::lock_guard<std::mutex> holder{lock};
+	glyph_cache.flush_full_atlas();
+}
+
+void Font::on_swapchain_index_released(const SwapchainIndexEvent &)
+{
 }
 
 }
@@ -25,7 +25,10 @@
 #include "event.hpp"
 #include "render_queue.hpp"
 #include "renderer.hpp"
+#include "glyph_cache.hpp"
+#include "filesystem.hpp"
 #include <memory>
+#include <mutex>
 
 namespace Granite
 {
@@ -60,13 +63,18 @@ public:
 
 private:
 	Vulkan::ImageHandle texture;
-	struct Baked;
-	std::unique_ptr<Baked> baked_chars;
+	Vulkan::Device *device = nullptr;
 	void on_device_created(const Vulkan::DeviceCreatedEvent &e);
 	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
+	void on_swapchain_index(const Vulkan::SwapchainIndexEvent &e);
+	void on_swapchain_index_released(const Vulkan::SwapchainIndexEvent &e);
 
-	std::vector<uint8_t> bitmap;
-	unsigned width = 0, height = 0;
+	// Text is laid out and rendered from const paths, possibly on multiple threads.
+	FileMappingHandle font_data;
+	mutable GlyphCache glyph_cache;
+	mutable std::mutex lock;
 	unsigned font_height = 0;
+
+	void flush_atlas_updates() const;
 };
 }
\ No newline at end of file
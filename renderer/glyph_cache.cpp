@@ -0,0 +1,369 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "glyph_cache.hpp"
+#include "stb_truetype.h"
+#include "logging.hpp"
+#include "hash.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <string.h>
+#include <float.h>
+#include <algorithm>
+
+namespace Granite
+{
+uint32_t decode_utf8(const char *&text)
+{
+	auto *str = reinterpret_cast<const uint8_t *>(text);
+	uint32_t c = str[0];
+
+	if (c < 0x80)
+	{
+		text++;
+		return c;
+	}
+
+	unsigned extra;
+	uint32_t min_value;
+	if ((c & 0xe0) == 0xc0)
+	{
+		extra = 1;
+		min_value = 0x80;
+		c &= 0x1f;
+	}
+	else if ((c & 0xf0) == 0xe0)
+	{
+		extra = 2;
+		min_value = 0x800;
+		c &= 0x0f;
+	}
+	else if ((c & 0xf8) == 0xf0)
+	{
+		extra = 3;
+		min_value = 0x10000;
+		c &= 0x07;
+	}
+	else
+	{
+		text++;
+		return 0xfffd;
+	}
+
+	for (unsigned i = 1; i <= extra; i++)
+	{
+		// Also catches the terminating null.
+		if ((str[i] & 0xc0) != 0x80)
+		{
+			text++;
+			return 0xfffd;
+		}
+		c = (c << 6) | (str[i] & 0x3f);
+	}
+
+	// Reject overlong encodings, surrogates and values beyond the Unicode range.
+	if (c < min_value || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+	{
+		text++;
+		return 0xfffd;
+	}
+
+	text += extra + 1;
+	return c;
+}
+
+void GlyphAtlas::init(unsigned width_, unsigned height_)
+{
+	width = width_;
+	height = height_;
+	reset();
+}
+
+void GlyphAtlas::reset()
+{
+	shelves.clear();
+	next_y = 0;
+}
+
+bool GlyphAtlas::allocate(unsigned w, unsigned h, unsigned &x, unsigned &y)
+{
+	if (w > width || h > height)
+		return false;
+
+	// Don't let small glyphs waste tall shelves while there is still room for new shelves.
+	Shelf *best = nullptr;
+	for (auto &shelf : shelves)
+	{
+		if (shelf.height < h || shelf.used_width + w > width)
+			continue;
+		if (next_y + h <= height && shelf.height > h + h / 2)
+			continue;
+		if (!best || shelf.height < best->height)
+			best = &shelf;
+	}
+
+	if (!best)
+	{
+		if (next_y + h > height)
+			return false;
+		shelves.push_back({ next_y, h, 0 });
+		next_y += h;
+		best = &shelves.back();
+	}
+
+	x = best->used_width;
+	y = best->y;
+	best->used_width += w;
+	return true;
+}
+
+GlyphCache::GlyphCache()
+{
+	atlas.init(AtlasSize, AtlasSize);
+	atlas_data.resize(AtlasSize * AtlasSize);
+	// Roughly the glyph count of a few screens full of text.
+	layouts.set_total_cost(64 * 1024);
+}
+
+GlyphCache::~GlyphCache()
+{
+}
+
+bool GlyphCache::init(const void *data, size_t size)
+{
+	auto *font_data = static_cast<const unsigned char *>(data);
+	int offset = stbtt_GetFontOffsetForIndex(font_data, 0);
+	if (offset < 0 || size_t(offset) >= size)
+		return false;
+
+	info.reset(new stbtt_fontinfo);
+	if (!stbtt_InitFont(info.get(), font_data, offset))
+	{
+		info.reset();
+		return false;
+	}
+
+	base_scale = stbtt_ScaleForPixelHeight(info.get(), float(BaseSize));
+	reset_atlas();
+	return true;
+}
+
+void GlyphCache::reset_atlas()
+{
+	atlas.reset();
+	glyphs.clear();
+	memset(ascii_glyphs, 0, sizeof(ascii_glyphs));
+	// Zero is the far outside of the distance field.
+	memset(atlas_data.data(), 0, atlas_data.size());
+	dirty_begin = 0;
+	dirty_end = atlas.get_height();
+	atlas_generation++;
+	atlas_full = false;
+}
+
+bool GlyphCache::flush_full_atlas()
+{
+	if (!atlas_full)
+		return false;
+
+	reset_atlas();
+	return true;
+}
+
+bool GlyphCache::get_dirty_rows(unsigned &begin, unsigned &end) const
+{
+	begin = dirty_begin;
+	end = dirty_end;
+	return dirty_begin < dirty_end;
+}
+
+void GlyphCache::clear_dirty_rows()
+{
+	dirty_begin = 0;
+	dirty_end = 0;
+}
+
+const GlyphCache::Glyph *GlyphCache::get_glyph(uint32_t codepoint)
+{
+	if (codepoint < 128 && ascii_glyphs[codepoint])
+		return ascii_glyphs[codepoint];
+
+	auto itr = glyphs.find(codepoint);
+	if (itr != glyphs.end())
+		return &itr->second;
+
+	return rasterize_glyph(codepoint);
+}
+
+const GlyphCache::Glyph *GlyphCache::rasterize_glyph(uint32_t codepoint)
+{
+	// Don't bother rasterizing, there is no room for it until the atlas is flushed.
+	if (!info || atlas_full)
+		return nullptr;
+
+	Glyph glyph = {};
+	glyph.glyph_index = stbtt_FindGlyphIndex(info.get(), int(codepoint));
+
+	int advance = 0, lsb = 0;
+	stbtt_GetGlyphHMetrics(info.get(), glyph.glyph_index, &advance, &lsb);
+	glyph.advance = float(advance) * base_scale;
+
+	int ix0, iy0, ix1, iy1;
+	stbtt_GetGlyphBitmapBox(info.get(), glyph.glyph_index, base_scale, base_scale, &ix0, &iy0, &ix1, &iy1);
+	glyph.ink_x1 = float(ix1);
+
+	int w = 0, h = 0, xoff = 0, yoff = 0;
+	unsigned char *sdf = stbtt_GetGlyphSDF(info.get(), base_scale, glyph.glyph_index, Padding,
+	                                       OnEdgeValue, float(OnEdgeValue) / float(Padding),
+	                                       &w, &h, &xoff, &yoff);
+
+	// Whitespace has no bitmap, only an advance.
+	if (sdf)
+	{
+		unsigned x, y;
+		if (!atlas.allocate(unsigned(w), unsigned(h), x, y))
+		{
+			// Glyphs handed out earlier may still be referenced by text which has not been drawn yet,
+			// so the atlas cannot be flushed here.
+			LOGW("Glyph atlas is full, dropping new glyphs until it is flushed.\n");
+			atlas_full = true;
+			stbtt_FreeSDF(sdf, nullptr);
+			return nullptr;
+		}
+
+		for (int row = 0; row < h; row++)
+			memcpy(&atlas_data[(y + row) * atlas.get_width() + x], &sdf[row * w], w);
+		stbtt_FreeSDF(sdf, nullptr);
+
+		if (dirty_begin < dirty_end)
+		{
+			dirty_begin = std::min(dirty_begin, y);
+			dirty_end = std::max(dirty_end, y + h);
+		}
+		else
+		{
+			dirty_begin = y;
+			dirty_end = y + h;
+		}
+
+		glyph.x0 = float(xoff);
+		glyph.y0 = float(yoff);
+		glyph.width = float(w);
+		glyph.height = float(h);
+		glyph.tex_x = x;
+		glyph.tex_y = y;
+	}
+
+	auto *ret = &(glyphs[codepoint] = glyph);
+	if (codepoint < 128)
+		ascii_glyphs[codepoint] = ret;
+	return ret;
+}
+
+void GlyphCache::build_layout(Layout &layout, const char *text, float size)
+{
+	layout.glyphs.clear();
+
+	float scale = size / float(BaseSize);
+	vec2 pen = vec2(0.0f, size);
+	vec2 ink_min = vec2(FLT_MAX);
+	vec2 ink_max = vec2(-FLT_MAX);
+	float max_x = 0.0f;
+	int prev_glyph = -1;
+
+	while (*text)
+	{
+		uint32_t codepoint = decode_utf8(text);
+		if (codepoint == '\n')
+		{
+			pen.x = 0.0f;
+			pen.y += size;
+			prev_glyph = -1;
+			continue;
+		}
+		else if (codepoint < 32)
+			continue;
+
+		auto *glyph = get_glyph(codepoint);
+		if (!glyph)
+			continue;
+
+		if (prev_glyph >= 0)
+			pen.x += float(stbtt_GetGlyphKernAdvance(info.get(), prev_glyph, glyph->glyph_index)) * base_scale * scale;
+		prev_glyph = glyph->glyph_index;
+
+		max_x = std::max(max_x, pen.x + glyph->ink_x1 * scale);
+
+		if (glyph->width > 0.0f)
+		{
+			LayoutGlyph g;
+			g.offset = pen + vec2(glyph->x0, glyph->y0) * scale;
+			g.size = vec2(glyph->width, glyph->height) * scale;
+			g.tex_x = glyph->tex_x;
+			g.tex_y = glyph->tex_y;
+			g.tex_width = unsigned(glyph->width);
+			g.tex_height = unsigned(glyph->height);
+			layout.glyphs.push_back(g);
+
+			ink_min = min(ink_min, g.offset);
+			ink_max = max(ink_max, g.offset + g.size);
+		}
+
+		pen.x += glyph->advance * scale;
+	}
+
+	layout.geometry = ceil(vec2(max_x, pen.y));
+	if (layout.glyphs.empty())
+	{
+		ink_min = vec2(0.0f);
+		ink_max = vec2(0.0f);
+	}
+	layout.ink_min = ink_min;
+	layout.ink_max = ink_max;
+}
+
+const GlyphCache::Layout &GlyphCache::layout_text(const char *text, float size)
+{
+	Util::Hasher h;
+	h.string(text);
+	h.f32(size);
+	auto hash = h.get();
+
+	// The text is kept around to reject hash collisions.
+	auto *layout = layouts.find_and_mark_as_recent(hash);
+	if (layout && layout->atlas_generation == atlas_generation && layout->size == size && layout->text == text)
+		return *layout;
+
+	if (!layout)
+		layouts.prune();
+	// Cost is roughly the glyph count, allocate() also updates the cost when a stale entry is reused.
+	layout = layouts.allocate(hash, strlen(text) + 1);
+
+	// The atlas is never flushed while laying out, so every glyph location in the layout stays valid.
+	build_layout(*layout, text, size);
+
+	layout->text = text;
+	layout->size = size;
+	layout->atlas_generation = atlas_generation;
+	return *layout;
+}
+}
@@ -0,0 +1,190 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "lru_cache.hpp"
+#include "math.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+struct stbtt_fontinfo;
+
+namespace Granite
+{
+// Decodes one code point and advances text past it.
+// Malformed or truncated sequences decode to U+FFFD and consume one byte.
+uint32_t decode_utf8(const char *&text);
+
+// Shelf packer for glyph bitmaps. Shelves are opened top to bottom with the height of the first
+// glyph placed in them, and glyphs go to the tightest shelf which still has room.
+class GlyphAtlas
+{
+public:
+	void init(unsigned width, unsigned height);
+	bool allocate(unsigned w, unsigned h, unsigned &x, unsigned &y);
+	void reset();
+
+	unsigned get_width() const
+	{
+		return width;
+	}
+
+	unsigned get_height() const
+	{
+		return height;
+	}
+
+private:
+	struct Shelf
+	{
+		unsigned y;
+		unsigned height;
+		unsigned used_width;
+	};
+	std::vector<Shelf> shelves;
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned next_y = 0;
+};
+
+// Rasterizes glyphs on demand as signed distance fields into a single R8 atlas.
+// Glyphs are rendered once at BaseSize pixels and scaled for any text size.
+// Glyphs never move while they are cached. Once the atlas is full, new glyphs are refused
+// until the owner calls flush_full_atlas() at a point where no earlier glyph locations are in use.
+// Not thread-safe, the owner is expected to serialize access.
+class GlyphCache
+{
+public:
+	enum
+	{
+		BaseSize = 32,
+		Padding = 4,
+		AtlasSize = 1024,
+		// Value of the distance field exactly on the glyph outline.
+		OnEdgeValue = 128
+	};
+
+	struct Glyph
+	{
+		// Quad relative to the pen position at BaseSize, including SDF padding.
+		float x0, y0;
+		float width, height;
+		// Right edge of the ink, used for text geometry.
+		float ink_x1;
+		float advance;
+		unsigned tex_x, tex_y;
+		int glyph_index;
+	};
+
+	struct LayoutGlyph
+	{
+		// Top-left corner relative to the text origin.
+		vec2 offset;
+		vec2 size;
+		unsigned tex_x, tex_y;
+		unsigned tex_width, tex_height;
+	};
+
+	struct Layout
+	{
+		std::string text;
+		float size = 0.0f;
+		uint64_t atlas_generation = 0;
+		vec2 geometry = vec2(0.0f);
+		vec2 ink_min = vec2(0.0f);
+		vec2 ink_max = vec2(0.0f);
+		std::vector<LayoutGlyph> glyphs;
+	};
+
+	GlyphCache();
+	~GlyphCache();
+
+	// data must be kept alive for the lifetime of the cache.
+	bool init(const void *data, size_t size);
+
+	const Glyph *get_glyph(uint32_t codepoint);
+
+	// Lays out UTF-8 text with kerning, baselines are size pixels apart like the old baked fonts.
+	// Layouts are cached by string hash, and the returned reference is valid until the next call.
+	const Layout &layout_text(const char *text, float size);
+
+	const uint8_t *get_atlas_data() const
+	{
+		return atlas_data.data();
+	}
+
+	unsigned get_atlas_width() const
+	{
+		return atlas.get_width();
+	}
+
+	unsigned get_atlas_height() const
+	{
+		return atlas.get_height();
+	}
+
+	uint64_t get_atlas_generation() const
+	{
+		return atlas_generation;
+	}
+
+	// Rows [begin, end) of the atlas which changed since the last clear_dirty_rows().
+	bool get_dirty_rows(unsigned &begin, unsigned &end) const;
+	void clear_dirty_rows();
+
+	bool is_atlas_full() const
+	{
+		return atlas_full;
+	}
+
+	// Evicts every glyph if the atlas ran out of space, e.g. at a frame boundary. Returns true if it did.
+	// Cached layouts are rebuilt on next use, which also fills in glyphs that were refused.
+	bool flush_full_atlas();
+
+private:
+	std::unique_ptr<stbtt_fontinfo> info;
+	float base_scale = 0.0f;
+
+	GlyphAtlas atlas;
+	std::vector<uint8_t> atlas_data;
+	uint64_t atlas_generation = 0;
+	bool atlas_full = false;
+	unsigned dirty_begin = 0;
+	unsigned dirty_end = 0;
+
+	std::unordered_map<uint32_t, Glyph> glyphs;
+	// Element pointers in unordered_map are stable, so ASCII skips the hash lookup.
+	const Glyph *ascii_glyphs[128] = {};
+
+	Util::LRUCache<Layout> layouts;
+
+	const Glyph *rasterize_glyph(uint32_t codepoint);
+	void reset_atlas();
+	void build_layout(Layout &layout, const char *text, float size);
+};
+}
@@ -23,12 +23,15 @@
 #include "render_graph.hpp"
 #include "type_to_string.hpp"
 #include "format.hpp"
+#include "texture_format.hpp"
 #include "quirks.hpp"
 #include "muglm/muglm_impl.hpp"
 #include "thread_group.hpp"
 #include "task_composer.hpp"
+#include "thread_id.hpp"
 #include "vulkan_prerotate.hpp"
 #include <algorithm>
+#include <set>
 
 namespace Granite
 {
@@ -69,6 +72,15 @@ void RenderPassInterface::build_render_pass_separate_layer(Vulkan::CommandBuffer
 {
 }
 
+unsigned RenderPassInterface::get_num_secondary_command_buffers(unsigned) const
+{
+	return 0;
+}
+
+void RenderPassInterface::build_render_pass_secondary(Vulkan::CommandBuffer &, unsigned, unsigned, unsigned)
+{
+}
+
 void RenderPassInterface::enqueue_prepare_render_pass(RenderGraph &, TaskComposer &)
 {
 }
@@ -1413,6 +1425,25 @@ void RenderGraph::log()
 		}
 	}
 
+	if (!transient_memory_requests.empty())
+	{
+		plan_transient_memory();
+		auto &plan = transient_memory_plan;
+		LOGI("Transient memory plan: %u blocks, %.3f MiB (unaliased: %.3f MiB, peak live: %.3f MiB)\n",
+		     unsigned(plan.block_sizes.size()),
+		     double(plan.total_size) / (1024.0 * 1024.0),
+		     double(plan.unaliased_size) / (1024.0 * 1024.0),
+		     double(plan.peak_live_size) / (1024.0 * 1024.0));
+
+		for (unsigned i = 0; i < transient_memory_plan_resources.size(); i++)
+		{
+			LOGI("  Resource #%u: block %u, offset: %llu\n",
+			     transient_memory_plan_resources[i],
+			     plan.placements[i].block,
+			     static_cast<unsigned long long>(plan.placements[i].offset));
+		}
+	}
+
 	auto barrier_itr = begin(pass_barriers);
 
 	const auto swap_str = [this](const Barrier &barrier) -> const char * {
@@ -1545,6 +1576,50 @@ void RenderGraph::enqueue_scaled_requests(Vulkan::CommandBuffer &cmd, const std:
 	                                                "builtin://shaders/scaled_readback.frag", defines);
 }
 
+// Optimally tiled render targets are commonly aligned to 64 KiB.
+static constexpr uint64_t TransientImageAlignment = 64 * 1024;
+
+static uint64_t estimate_image_size(const ResourceDimensions &dim)
+{
+	uint32_t block_width, block_height;
+	Vulkan::TextureFormatLayout::format_block_dim(dim.format, block_width, block_height);
+
+	auto aspect = Vulkan::format_to_aspect_mask(dim.format);
+	uint64_t block_size;
+	if (aspect == (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT))
+	{
+		block_size = Vulkan::TextureFormatLayout::format_block_size(dim.format, VK_IMAGE_ASPECT_DEPTH_BIT) +
+		             Vulkan::TextureFormatLayout::format_block_size(dim.format, VK_IMAGE_ASPECT_STENCIL_BIT);
+	}
+	else
+		block_size = Vulkan::TextureFormatLayout::format_block_size(dim.format, aspect);
+
+	uint64_t size = 0;
+	unsigned width = dim.width;
+	unsigned height = dim.height;
+	unsigned depth = dim.depth;
+	for (unsigned level = 0; level < dim.levels; level++)
+	{
+		uint64_t blocks_x = (width + block_width - 1) / block_width;
+		uint64_t blocks_y = (height + block_height - 1) / block_height;
+		size += blocks_x * blocks_y * depth * block_size;
+
+		width = std::max(width >> 1u, 1u);
+		height = std::max(height >> 1u, 1u);
+		depth = std::max(depth >> 1u, 1u);
+	}
+
+	return size * dim.layers * dim.samples;
+}
+
+void RenderGraph::plan_transient_memory()
+{
+	TransientMemoryPlanner planner;
+	for (auto &request : transient_memory_requests)
+		planner.add_resource(request);
+	transient_memory_plan = planner.plan();
+}
+
 void RenderGraph::build_aliases()
 {
 	struct Range
@@ -1675,6 +1750,43 @@ void RenderGraph::build_aliases()
 			register_writer(output, subpass.get_physical_pass_index(), true);
 	}
 
+	// Gather what plan_transient_memory() needs to pack transient images into shared memory blocks.
+	// Unlike the aliasing below, this is not limited to resources with identical dimensions.
+	// The plan itself is expensive and only computed on demand.
+	transient_memory_plan = {};
+	transient_memory_plan_resources.clear();
+	transient_memory_requests.clear();
+
+	for (unsigned i = 0; i < physical_dimensions.size(); i++)
+	{
+		auto &dim = physical_dimensions[i];
+		if (dim.buffer_info.size || physical_image_has_history[i] || i == swapchain_physical_index)
+			continue;
+		if (!pass_range[i].is_used())
+			continue;
+
+		TransientResourceRequest request;
+		request.size = estimate_image_size(dim);
+		request.alignment = TransientImageAlignment;
+		request.group = dim.queues;
+
+		// Same restrictions as regular aliasing, resources which cannot alias keep memory for the whole frame.
+		bool single_queue = (dim.queues & (dim.queues - 1)) == 0;
+		if (pass_range[i].can_alias() && single_queue)
+		{
+			request.first_pass = pass_range[i].first_used_pass();
+			request.last_pass = pass_range[i].last_used_pass();
+		}
+		else
+		{
+			request.first_pass = 0;
+			request.last_pass = ~0u;
+		}
+
+		transient_memory_requests.push_back(request);
+		transient_memory_plan_resources.push_back(i);
+	}
+
 	std::vector<std::vector<unsigned>> alias_chains(physical_dimensions.size());
 
 	physical_aliases.resize(physical_dimensions.size());
@@ -2180,25 +2292,9 @@ void RenderGraph::physical_pass_handle_flush_barrier(const Barrier &barrier, Pas
 		event.pipeline_barrier_src_stages = barrier.stages;
 }
 
-void RenderGraph::physical_pass_enqueue_graphics_commands(const PhysicalPass &physical_pass, PassSubmissionState &state)
+unsigned RenderGraph::physical_pass_setup_layers(const PhysicalPass &physical_pass, Vulkan::RenderPassInfo &rp_info) const
 {
-	auto &cmd = *state.cmd;
-	for (auto &clear_req : physical_pass.color_clear_requests)
-		clear_req.pass->get_clear_color(clear_req.index, clear_req.target);
-
-	if (physical_pass.depth_clear_request.pass)
-	{
-		physical_pass.depth_clear_request.pass->get_clear_depth_stencil(
-				physical_pass.depth_clear_request.target);
-	}
-
-	Vulkan::QueryPoolHandle start_graphics, end_graphics;
-	if (enabled_timestamps)
-		start_graphics = cmd.write_timestamp(VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
-
 	VK_ASSERT(physical_pass.layers != ~0u);
-
-	auto rp_info = physical_pass.render_pass_info;
 	unsigned layer_iterations = 1;
 
 	if (physical_pass.layers > 1)
@@ -2239,8 +2335,86 @@ void RenderGraph::physical_pass_enqueue_graphics_commands(const PhysicalPass &ph
 		}
 	}
 
+	return layer_iterations;
+}
+
+void RenderGraph::physical_pass_record_secondary_commands(const PhysicalPass &physical_pass,
+                                                          PassSubmissionState &state, TaskGroup &group)
+{
+	auto rp_info = physical_pass.render_pass_info;
+	unsigned layer_iterations = physical_pass_setup_layers(physical_pass, rp_info);
+	size_t num_subpasses = physical_pass.passes.size();
+
+	state.secondary_cmds.clear();
+
+	for (unsigned layer = 0; layer < layer_iterations; layer++)
+	{
+		rp_info.base_layer = layer;
+
+		for (size_t subpass_index = 0; subpass_index < num_subpasses; subpass_index++)
+		{
+			// Scaled clears are recorded inline in the primary command buffer, so we cannot use secondaries here.
+			if (!physical_pass.scaled_clear_requests[subpass_index].empty())
+				continue;
+
+			auto &pass = *passes[physical_pass.passes[subpass_index]];
+			unsigned count = pass.get_num_secondary_command_buffers(pass.render_pass_is_multiview() ? 0 : layer);
+			if (!count)
+				continue;
+
+			if (state.secondary_cmds.empty())
+				state.secondary_cmds.resize(layer_iterations * num_subpasses);
+			auto &cmds = state.secondary_cmds[layer * num_subpasses + subpass_index];
+			cmds.resize(count);
+
+			for (unsigned i = 0; i < count; i++)
+			{
+				group.enqueue_task([this, &pass, &cmds, rp_info, layer, subpass_index, i, count]() {
+					auto cmd = Vulkan::CommandBuffer::request_secondary_command_buffer(
+							*device, rp_info, Util::get_current_thread_index(), unsigned(subpass_index));
+					pass.build_render_pass_secondary(*cmd, pass.render_pass_is_multiview() ? 0 : layer, i, count);
+					// Must end on the thread which recorded it.
+					cmd->end_threaded_recording();
+					cmds[i] = std::move(cmd);
+				});
+			}
+		}
+	}
+}
+
+void RenderGraph::physical_pass_enqueue_graphics_commands(const PhysicalPass &physical_pass, PassSubmissionState &state)
+{
+	auto &cmd = *state.cmd;
+	for (auto &clear_req : physical_pass.color_clear_requests)
+		clear_req.pass->get_clear_color(clear_req.index, clear_req.target);
+
+	if (physical_pass.depth_clear_request.pass)
+	{
+		physical_pass.depth_clear_request.pass->get_clear_depth_stencil(
+				physical_pass.depth_clear_request.target);
+	}
+
+	Vulkan::QueryPoolHandle start_graphics, end_graphics;
+	if (enabled_timestamps)
+		start_graphics = cmd.write_timestamp(VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+
+	auto rp_info = physical_pass.render_pass_info;
+	unsigned layer_iterations = physical_pass_setup_layers(physical_pass, rp_info);
+
+	size_t num_subpasses = physical_pass.passes.size();
+
 	for (unsigned layer = 0; layer < layer_iterations; layer++)
 	{
+		auto *secondary_cmds = state.secondary_cmds.empty() ?
+		                       nullptr : &state.secondary_cmds[layer * num_subpasses];
+
+		for (size_t i = 0; i < num_subpasses; i++)
+		{
+			state.subpass_contents[i] = secondary_cmds && !secondary_cmds[i].empty() ?
+			                            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS :
+			                            VK_SUBPASS_CONTENTS_INLINE;
+		}
+
 		rp_info.base_layer = layer;
 		cmd.begin_region("begin-render-pass");
 		cmd.begin_render_pass(rp_info, state.subpass_contents[0]);
@@ -2259,7 +2433,14 @@ void RenderGraph::physical_pass_enqueue_graphics_commands(const PhysicalPass &ph
 			// This should be an extremely unlikely scenario.
 			// Either you need all subpasses or none.
 			cmd.begin_region(pass.get_name().c_str());
-			pass.build_render_pass(cmd, layer);
+			if (state.subpass_contents[subpass_index] == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+			{
+				for (auto &secondary : secondary_cmds[subpass_index])
+					cmd.submit_secondary(std::move(secondary));
+				secondary_cmds[subpass_index].clear();
+			}
+			else
+				pass.build_render_pass(cmd, layer);
 			cmd.end_region();
 
 			if (&subpass != &physical_pass.passes.back())
@@ -2381,6 +2562,20 @@ void RenderGraph::physical_pass_handle_gpu_timeline(ThreadGroup &group, Vulkan::
                                                     const PhysicalPass &physical_pass,
                                                     PassSubmissionState &state)
 {
+	if (state.graphics)
+	{
+		// Passes may want to record their subpasses as secondary command buffers in parallel,
+		// which can only be known once preparation is done.
+		TaskComposer composer(group);
+		composer.set_incoming_task(state.rendering_dependency);
+		auto &record_group = composer.begin_pipeline_stage();
+		record_group.set_desc((passes[physical_pass.passes.front()]->get_name() + "-plan-secondary").c_str());
+		record_group.enqueue_task([&, h = composer.get_deferred_enqueue_handle()]() mutable {
+			physical_pass_record_secondary_commands(physical_pass, state, *h);
+		});
+		state.rendering_dependency = composer.get_outgoing_task();
+	}
+
 	auto task = group.create_task([&]() {
 		state.cmd = device_.request_command_buffer(state.queue_type);
 		state.emit_pre_pass_barriers();
@@ -2764,14 +2959,25 @@ void RenderGraph::setup_attachments(Vulkan::Device &device_, Vulkan::ImageView *
 	}
 }
 
-void RenderGraph::traverse_dependencies(const RenderPass &pass, unsigned stack_count)
+void RenderGraph::traverse_dependencies(const RenderPass &pass)
 {
-	// For these kinds of resources,
-	// make sure that we pull in the dependency right away so we can merge render passes if possible.
+	// Passes are appended to pass_stack after all their dependencies, so every pass is visited once,
+	// and pass_stack ends up in a valid submission order.
+	auto &state = pass_traversal_state[pass.get_index()];
+	if (state == 2)
+		return;
+	else if (state == 1)
+		throw std::logic_error("Cycle detected.");
+	state = 1;
+
+	std::vector<unsigned> pushed_passes;
+
+	// For these kinds of resources, the writers are collected first and visited last (see below),
+	// so they end up right before this pass and we can merge render passes if possible.
 	if (pass.get_depth_stencil_input())
 	{
-		depend_passes_recursive(pass, pass.get_depth_stencil_input()->get_write_passes(),
-		                        stack_count, false, false, true);
+		depend_passes(pass, pass.get_depth_stencil_input()->get_write_passes(), pushed_passes,
+		              false, false, true);
 	}
 
 	for (auto *input : pass.get_attachment_inputs())
@@ -2781,33 +2987,33 @@ void RenderGraph::traverse_dependencies(const RenderPass &pass, unsigned stack_c
 			self_dependency = true;
 
 		if (!self_dependency)
-			depend_passes_recursive(pass, input->get_write_passes(), stack_count, false, false, true);
+			depend_passes(pass, input->get_write_passes(), pushed_passes, false, false, true);
 	}
 
 	for (auto *input : pass.get_color_inputs())
 	{
 		if (input)
-			depend_passes_recursive(pass, input->get_write_passes(), stack_count, false, false, true);
+			depend_passes(pass, input->get_write_passes(), pushed_passes, false, false, true);
 	}
 
 	for (auto *input : pass.get_color_scale_inputs())
 	{
 		if (input)
-			depend_passes_recursive(pass, input->get_write_passes(), stack_count, false, false, false);
+			depend_passes(pass, input->get_write_passes(), pushed_passes, false, false, false);
 	}
 
 	for (auto &input : pass.get_generic_texture_inputs())
-		depend_passes_recursive(pass, input.texture->get_write_passes(), stack_count, false, false, false);
+		depend_passes(pass, input.texture->get_write_passes(), pushed_passes, false, false, false);
 
 	for (auto &input : pass.get_proxy_inputs())
-		depend_passes_recursive(pass, input.proxy->get_write_passes(), stack_count, false, false, false);
+		depend_passes(pass, input.proxy->get_write_passes(), pushed_passes, false, false, false);
 
 	for (auto &input : pass.get_proxy_outputs())
 	{
 		if (input.alias_input)
 		{
-			depend_passes_recursive(pass, input.alias_input->get_write_passes(), stack_count, true, false, false);
-			depend_passes_recursive(pass, input.alias_input->get_read_passes(), stack_count, true, true, false);
+			depend_passes(pass, input.alias_input->get_write_passes(), pushed_passes, true, false, false);
+			depend_passes(pass, input.alias_input->get_read_passes(), pushed_passes, true, true, false);
 		}
 	}
 
@@ -2816,35 +3022,41 @@ void RenderGraph::traverse_dependencies(const RenderPass &pass, unsigned stack_c
 		if (input)
 		{
 			// There might be no writers of this resource if it's used in a feedback fashion.
-			depend_passes_recursive(pass, input->get_write_passes(), stack_count, true, false, false);
+			depend_passes(pass, input->get_write_passes(), pushed_passes, true, false, false);
 			// Deal with write-after-read hazards if a storage buffer is read in other passes
 			// (feedback) before being updated.
-			depend_passes_recursive(pass, input->get_read_passes(), stack_count, true, true, false);
+			depend_passes(pass, input->get_read_passes(), pushed_passes, true, true, false);
 		}
 	}
 
 	for (auto *input : pass.get_storage_texture_inputs())
 	{
 		if (input)
-			depend_passes_recursive(pass, input->get_write_passes(), stack_count, false, false, false);
+			depend_passes(pass, input->get_write_passes(), pushed_passes, false, false, false);
 	}
 
 	for (auto &input : pass.get_generic_buffer_inputs())
 	{
 		// There might be no writers of this resource if it's used in a feedback fashion.
-		depend_passes_recursive(pass, input.buffer->get_write_passes(), stack_count, true, false, false);
+		depend_passes(pass, input.buffer->get_write_passes(), pushed_passes, true, false, false);
 	}
+
+	// Visit dependencies in reverse, so that the ones collected first, i.e. merge candidates,
+	// are appended to pass_stack last and end up adjacent to this pass.
+	for (auto itr = pushed_passes.rbegin(); itr != pushed_passes.rend(); ++itr)
+		traverse_dependencies(*passes[*itr]);
+
+	state = 2;
+	pass_stack.push_back(pass.get_index());
 }
 
-void RenderGraph::depend_passes_recursive(const RenderPass &self, const std::unordered_set<unsigned> &written_passes,
-                                          unsigned stack_count, bool no_check, bool ignore_self, bool merge_dependency)
+void RenderGraph::depend_passes(const RenderPass &self, const std::unordered_set<unsigned> &written_passes,
+                                std::vector<unsigned> &pushed_passes,
+                                bool no_check, bool ignore_self, bool merge_dependency)
 {
 	if (!no_check && written_passes.empty())
 		throw std::logic_error("No pass exists which writes to resource.");
 
-	if (stack_count > passes.size())
-		throw std::logic_error("Cycle detected.");
-
 	for (auto &pass : written_passes)
 		if (pass != self.get_index())
 			pass_dependencies[self.get_index()].insert(pass);
@@ -2854,8 +3066,6 @@ void RenderGraph::depend_passes_recursive(const RenderPass &self, const std::uno
 			if (pass != self.get_index())
 				pass_merge_dependencies[self.get_index()].insert(pass);
 
-	stack_count++;
-
 	for (auto &pushed_pass : written_passes)
 	{
 		if (ignore_self && pushed_pass == self.get_index())
@@ -2863,14 +3073,52 @@ void RenderGraph::depend_passes_recursive(const RenderPass &self, const std::uno
 		else if (pushed_pass == self.get_index())
 			throw std::logic_error("Pass depends on itself.");
 
-		pass_stack.push_back(pushed_pass);
-		auto &pass = *passes[pushed_pass];
-		traverse_dependencies(pass, stack_count);
+		pushed_passes.push_back(pushed_pass);
 	}
 }
 
+void RenderGraph::build_pass_schedule(const RenderResource &backbuffer_resource)
+{
+	pass_stack.clear();
+
+	pass_dependencies.clear();
+	pass_merge_dependencies.clear();
+	pass_dependencies.resize(passes.size());
+	pass_merge_dependencies.resize(passes.size());
+	pass_traversal_state.clear();
+	pass_traversal_state.resize(passes.size());
+
+	// Work our way back from the backbuffer, and sort out all the dependencies.
+	for (auto &pass : backbuffer_resource.get_write_passes())
+		traverse_dependencies(*passes[pass]);
+
+	// Now, reorder passes to extract better pipelining.
+	reorder_passes(pass_stack);
+}
+
 void RenderGraph::reorder_passes(std::vector<unsigned> &flattened_passes)
 {
+	// Keep the transitive closure of the dependency graph around as bitsets,
+	// so depends_on_pass() is a single lookup rather than a recursive walk.
+	// flattened_passes is in dependency order, so every dependency is complete before it is merged in.
+	pass_closure_words = unsigned((passes.size() + 63) / 64);
+	pass_dependency_closure.clear();
+	pass_dependency_closure.resize(passes.size() * pass_closure_words);
+
+	const auto merge_closure = [&](unsigned dst, unsigned src) {
+		auto *dst_bits = &pass_dependency_closure[dst * pass_closure_words];
+		auto *src_bits = &pass_dependency_closure[src * pass_closure_words];
+		for (unsigned i = 0; i < pass_closure_words; i++)
+			dst_bits[i] |= src_bits[i];
+	};
+
+	for (auto pass : flattened_passes)
+	{
+		pass_dependency_closure[pass * pass_closure_words + pass / 64] |= uint64_t(1) << (pass & 63);
+		for (auto &dep : pass_dependencies[pass])
+			merge_closure(pass, dep);
+	}
+
 	// If a pass depends on an earlier pass via merge dependencies,
 	// copy over dependencies to the dependees to avoid cases which can break subpass merging.
 	// This is a "soft" dependency. If we ignore it, it's not a real problem.
@@ -2887,107 +3135,174 @@ void RenderGraph::reorder_passes(std::vector<unsigned> &flattened_passes)
 				if (depends_on_pass(dependee, merge_dep))
 					continue;
 
-				if (merge_dep != dependee)
-					pass_dependencies[merge_dep].insert(dependee);
+				if (merge_dep != dependee && pass_dependencies[merge_dep].insert(dependee).second)
+				{
+					// Everything which depended on merge_dep now depends on dependee as well.
+					for (auto pass : flattened_passes)
+						if (depends_on_pass(pass, merge_dep))
+							merge_closure(pass, dependee);
+				}
 			}
 		}
 	}
 
-	// TODO: This is very inefficient, but should work okay for a reasonable amount of passes ...
-	// But, reasonable amounts are always one more than what you'd think ...
-	// Clarity in the algorithm is pretty important, because these things tend to be very annoying to debug.
-
 	if (flattened_passes.size() <= 2)
 		return;
 
+	// List scheduling. A pass is ready once all its dependencies are scheduled.
+	// Among ready passes, we prefer the one which does not introduce any hard barrier,
+	// i.e. the pass whose most recently scheduled dependency lies furthest back,
+	// which lets as many passes as possible overlap between the depender and the dependee.
+	// Ties are broken by the original order.
+	// Since every dependency is scheduled before its dependers, the most recent pass a pass transitively depends on
+	// is always one of its direct dependencies, so this can be tracked incrementally.
 	std::vector<unsigned> unscheduled_passes;
 	unscheduled_passes.reserve(passes.size());
 	swap(flattened_passes, unscheduled_passes);
 
-	const auto schedule = [&](unsigned index) {
-		// Need to preserve the order of remaining elements.
-		flattened_passes.push_back(unscheduled_passes[index]);
-		std::move(unscheduled_passes.begin() + index + 1,
-		          unscheduled_passes.end(),
-		          unscheduled_passes.begin() + index);
-		unscheduled_passes.pop_back();
-	};
+	std::vector<int> order(passes.size(), -1);
+	for (auto &pass : unscheduled_passes)
+		order[pass] = int(&pass - unscheduled_passes.data());
 
-	schedule(0);
-	while (!unscheduled_passes.empty())
-	{
-		// Find the next pass to schedule.
-		// We can pick any pass N, if the pass does not depend on anything left in unscheduled_passes.
-		// unscheduled_passes[0] is always okay as a fallback, so unless we find something better,
-		// we will at least pick that.
+	std::vector<unsigned> pending_dependencies(passes.size());
+	std::vector<int> last_dependency_position(passes.size(), -1);
+	std::vector<std::vector<unsigned>> dependers(passes.size());
+	std::vector<std::vector<unsigned>> merge_dependers(passes.size());
 
-		// Ideally, we pick a pass which does not introduce any hard barrier.
-		// A "hard barrier" here is where a pass depends directly on the pass before it forcing something ala vkCmdPipelineBarrier,
-		// we would like to avoid this if possible.
+	for (auto &pass : unscheduled_passes)
+	{
+		for (auto &dep : pass_dependencies[pass])
+		{
+			if (order[dep] < 0)
+				continue;
+			pending_dependencies[pass]++;
+			dependers[dep].push_back(pass);
+		}
 
-		// Find the pass which has the optimal overlap factor which means the number of passes can be scheduled in-between
-		// the depender, and the dependee.
+		for (auto &dep : pass_merge_dependencies[pass])
+			if (order[dep] >= 0)
+				merge_dependers[dep].push_back(pass);
+	}
 
-		unsigned best_candidate = 0;
-		unsigned best_overlap_factor = 0;
+	std::set<std::pair<int, unsigned>> ready;
+	for (auto &pass : unscheduled_passes)
+		if (pending_dependencies[pass] == 0)
+			ready.insert({ -1, unsigned(order[pass]) });
 
-		for (unsigned i = 0; i < unscheduled_passes.size(); i++)
+	while (!ready.empty())
+	{
+		// Always try to merge passes if possible on tilers.
+		// This might not make sense on desktop however,
+		// so we can conditionally enable this path depending on our GPU.
+		auto candidate = ready.end();
+		if (!flattened_passes.empty())
 		{
-			unsigned overlap_factor = 0;
-
-			// Always try to merge passes if possible on tilers.
-			// This might not make sense on desktop however,
-			// so we can conditionally enable this path depending on our GPU.
-			if (pass_merge_dependencies[unscheduled_passes[i]].count(flattened_passes.back()))
+			for (auto &merge_pass : merge_dependers[flattened_passes.back()])
 			{
-				overlap_factor = ~0u;
-			}
-			else
-			{
-				for (auto itr = flattened_passes.rbegin(); itr != flattened_passes.rend(); ++itr)
-				{
-					if (depends_on_pass(unscheduled_passes[i], *itr))
-						break;
-					overlap_factor++;
-				}
+				auto itr = ready.find({ last_dependency_position[merge_pass], unsigned(order[merge_pass]) });
+				if (itr != ready.end() && (candidate == ready.end() || itr->second < candidate->second))
+					candidate = itr;
 			}
+		}
 
-			if (overlap_factor <= best_overlap_factor)
-				continue;
+		if (candidate == ready.end())
+			candidate = ready.begin();
 
-			bool possible_candidate = true;
-			for (unsigned j = 0; j < i; j++)
-			{
-				if (depends_on_pass(unscheduled_passes[i], unscheduled_passes[j]))
-				{
-					possible_candidate = false;
-					break;
-				}
-			}
+		unsigned pass = unscheduled_passes[candidate->second];
+		ready.erase(candidate);
 
-			if (!possible_candidate)
-				continue;
+		int position = int(flattened_passes.size());
+		flattened_passes.push_back(pass);
 
-			best_candidate = i;
-			best_overlap_factor = overlap_factor;
+		for (auto &depender : dependers[pass])
+		{
+			last_dependency_position[depender] = position;
+			if (--pending_dependencies[depender] == 0)
+				ready.insert({ position, unsigned(order[depender]) });
 		}
-
-		schedule(best_candidate);
 	}
+
+	assert(flattened_passes.size() == unscheduled_passes.size());
 }
 
-bool RenderGraph::depends_on_pass(unsigned dst_pass, unsigned src_pass)
+bool RenderGraph::depends_on_pass(unsigned dst_pass, unsigned src_pass) const
 {
 	if (dst_pass == src_pass)
 		return true;
+	return (pass_dependency_closure[dst_pass * pass_closure_words + src_pass / 64] >> (src_pass & 63)) & 1;
+}
+
+Util::Hash RenderGraph::compute_topology_hash() const
+{
+	Util::Hasher h;
+
+	const auto hash_set = [&](const std::unordered_set<unsigned> &set) {
+		std::vector<unsigned> sorted(set.begin(), set.end());
+		std::sort(sorted.begin(), sorted.end());
+		h.u32(uint32_t(sorted.size()));
+		for (auto &index : sorted)
+			h.u32(index);
+	};
+
+	const auto hash_resource = [&](const RenderResource *resource) {
+		h.u32(resource ? resource->get_index() : ~0u);
+	};
 
-	for (auto &dep : pass_dependencies[dst_pass])
+	const auto hash_resources = [&](const auto &list) {
+		h.u32(uint32_t(list.size()));
+		for (auto *resource : list)
+			hash_resource(resource);
+	};
+
+	h.u32(uint32_t(passes.size()));
+	h.u32(uint32_t(resources.size()));
+
+	auto itr = resource_to_index.find(backbuffer_source);
+	h.u32(itr != end(resource_to_index) ? itr->second : ~0u);
+
+	for (auto &resource : resources)
 	{
-		if (depends_on_pass(dep, src_pass))
-			return true;
+		h.u32(uint32_t(resource->get_type()));
+		hash_set(resource->get_write_passes());
+		hash_set(resource->get_read_passes());
 	}
 
-	return false;
+	for (auto &pass : passes)
+	{
+		h.u32(uint32_t(pass->get_queue()));
+		hash_resource(pass->get_depth_stencil_input());
+		hash_resource(pass->get_depth_stencil_output());
+		hash_resources(pass->get_color_inputs());
+		hash_resources(pass->get_color_outputs());
+		hash_resources(pass->get_resolve_outputs());
+		hash_resources(pass->get_color_scale_inputs());
+		hash_resources(pass->get_attachment_inputs());
+		hash_resources(pass->get_storage_inputs());
+		hash_resources(pass->get_storage_outputs());
+		hash_resources(pass->get_transfer_outputs());
+		hash_resources(pass->get_storage_texture_inputs());
+		hash_resources(pass->get_storage_texture_outputs());
+		hash_resources(pass->get_history_inputs());
+
+		h.u32(uint32_t(pass->get_generic_texture_inputs().size()));
+		for (auto &input : pass->get_generic_texture_inputs())
+			hash_resource(input.texture);
+		h.u32(uint32_t(pass->get_generic_buffer_inputs().size()));
+		for (auto &input : pass->get_generic_buffer_inputs())
+			hash_resource(input.buffer);
+
+		h.u32(uint32_t(pass->get_proxy_inputs().size()));
+		for (auto &input : pass->get_proxy_inputs())
+			hash_resource(input.proxy);
+		h.u32(uint32_t(pass->get_proxy_outputs().size()));
+		for (auto &output : pass->get_proxy_outputs())
+		{
+			hash_resource(output.proxy);
+			hash_resource(output.alias_input);
+		}
+	}
+
+	return h.get();
 }
 
 void RenderGraph::bake()
@@ -3002,34 +3317,24 @@ void RenderGraph::bake()
 	if (itr == end(resource_to_index))
 		throw std::logic_error("Backbuffer source does not exist.");
 
-	pass_stack.clear();
-
-	pass_dependencies.clear();
-	pass_merge_dependencies.clear();
-	pass_dependencies.resize(passes.size());
-	pass_merge_dependencies.resize(passes.size());
-
-	// Work our way back from the backbuffer, and sort out all the dependencies.
 	auto &backbuffer_resource = *resources[itr->second];
-
 	if (backbuffer_resource.get_write_passes().empty())
 		throw std::logic_error("No pass exists which writes to resource.");
 
-	for (auto &pass : backbuffer_resource.get_write_passes())
-		pass_stack.push_back(pass);
-
-	auto tmp_pass_stack = pass_stack;
-	for (auto &pushed_pass : tmp_pass_stack)
+	// The schedule does not depend on resource dimensions, so only the schedule is reused across bakes.
+	// The physical stages below cannot be cached the same way. Mip counts are derived from sizes and decide
+	// both merging and barrier layouts, and swapchain aliasing decides transients and physical barriers.
+	Util::Hash topology_hash = compute_topology_hash();
+	if (!cached_pass_stack.empty() && topology_hash == cached_topology_hash)
 	{
-		auto &pass = *passes[pushed_pass];
-		traverse_dependencies(pass, 0);
+		pass_stack = cached_pass_stack;
+	}
+	else
+	{
+		build_pass_schedule(backbuffer_resource);
+		cached_topology_hash = topology_hash;
+		cached_pass_stack = pass_stack;
 	}
-
-	reverse(begin(pass_stack), end(pass_stack));
-	filter_passes(pass_stack);
-
-	// Now, reorder passes to extract better pipelining.
-	reorder_passes(pass_stack);
 
 	// Now, we have a linear list of passes to submit in-order which would obey the dependencies.
 
@@ -3105,9 +3410,13 @@ void RenderGraph::bake()
 	// Also build virtual "transfer" barriers. These things only copy events over to other physical resources.
 	build_aliases();
 
-	for (auto &physical_pass : physical_passes)
-		for (auto pass : physical_pass.passes)
-			passes[pass]->setup(*device);
+	// The graph can be baked without a device, e.g. to inspect or benchmark scheduling offline.
+	if (device)
+	{
+		for (auto &physical_pass : physical_passes)
+			for (auto pass : physical_pass.passes)
+				passes[pass]->setup(*device);
+	}
 }
 
 ResourceDimensions RenderGraph::get_resource_dimensions(const RenderBufferResource &resource) const
@@ -3746,23 +4055,6 @@ void RenderGraph::build_barriers()
 	}
 }
 
-void RenderGraph::filter_passes(std::vector<unsigned> &list)
-{
-	std::unordered_set<unsigned> seen;
-
-	auto output_itr = begin(list);
-	for (auto itr = begin(list); itr != end(list); ++itr)
-	{
-		if (!seen.count(*itr))
-		{
-			*output_itr = *itr;
-			seen.insert(*itr);
-			++output_itr;
-		}
-	}
-	list.erase(output_itr, end(list));
-}
-
 void RenderGraph::enable_timestamps(bool enable)
 {
 	enabled_timestamps = enable;
@@ -3797,6 +4089,9 @@ void RenderGraph::reset()
 	physical_events.clear();
 	physical_history_events.clear();
 	physical_history_image_attachments.clear();
+	transient_memory_plan = {};
+	transient_memory_plan_resources.clear();
+	transient_memory_requests.clear();
 }
 
 const char *RenderPassExternalLockInterface::get_ident() const
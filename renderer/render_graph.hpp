@@ -36,6 +36,8 @@
 #include "application_wsi_events.hpp"
 #include "quirks.hpp"
 #include "thread_group.hpp"
+#include "hash.hpp"
+#include "transient_memory_planner.hpp"
 
 namespace Granite
 {
@@ -70,6 +72,15 @@ public:
 
 	virtual void build_render_pass(Vulkan::CommandBuffer &cmd);
 	virtual void build_render_pass_separate_layer(Vulkan::CommandBuffer &cmd, unsigned layer);
+
+	// Can change per frame. Called after enqueue_prepare_render_pass() has completed.
+	// If non-zero, the subpass is recorded into this many secondary command buffers in parallel
+	// with build_render_pass_secondary() instead of build_render_pass().
+	// The secondary command buffers are executed in index order.
+	// layer is always 0 unless the render pass is separate layered.
+	virtual unsigned get_num_secondary_command_buffers(unsigned layer) const;
+	virtual void build_render_pass_secondary(Vulkan::CommandBuffer &cmd, unsigned layer,
+	                                         unsigned index, unsigned num_indices);
 };
 using RenderPassInterfaceHandle = Util::IntrusivePtr<RenderPassInterface>;
 
@@ -695,6 +706,20 @@ public:
 			build_render_pass_cb(cmd);
 	}
 
+	unsigned get_num_secondary_command_buffers(unsigned layer) const
+	{
+		if (render_pass_handle)
+			return render_pass_handle->get_num_secondary_command_buffers(layer);
+		else
+			return 0;
+	}
+
+	void build_render_pass_secondary(Vulkan::CommandBuffer &cmd, unsigned layer, unsigned index, unsigned num_indices)
+	{
+		if (render_pass_handle)
+			render_pass_handle->build_render_pass_secondary(cmd, layer, index, num_indices);
+	}
+
 	void set_render_pass_interface(RenderPassInterfaceHandle handle)
 	{
 		render_pass_handle = std::move(handle);
@@ -811,6 +836,24 @@ public:
 	void bake();
 	void reset();
 	void log();
+
+	// Packs transient images into shared memory blocks by lifetime, using estimated image sizes.
+	// The plan is informational and not used for allocation, so it is only computed on demand,
+	// e.g. by log(). Must be called after bake().
+	void plan_transient_memory();
+
+	// Byte offsets from the last plan_transient_memory(), cleared by bake().
+	// Placements are indexed in the same order as get_transient_memory_plan_resources().
+	const TransientMemoryPlan &get_transient_memory_plan() const
+	{
+		return transient_memory_plan;
+	}
+
+	const std::vector<unsigned> &get_transient_memory_plan_resources() const
+	{
+		return transient_memory_plan_resources;
+	}
+
 	void setup_attachments(Vulkan::Device &device, Vulkan::ImageView *swapchain);
 	void enqueue_render_passes(Vulkan::Device &device, TaskComposer &composer);
 
@@ -920,7 +963,6 @@ private:
 
 	std::vector<Barriers> pass_barriers;
 
-	void filter_passes(std::vector<unsigned> &list);
 	void validate_passes();
 	void build_barriers();
 
@@ -1012,6 +1054,9 @@ private:
 	std::vector<PipelineEvent> physical_history_events;
 	std::vector<bool> physical_image_has_history;
 	std::vector<unsigned> physical_aliases;
+	TransientMemoryPlan transient_memory_plan;
+	std::vector<unsigned> transient_memory_plan_resources;
+	std::vector<TransientResourceRequest> transient_memory_requests;
 
 	Vulkan::ImageView *swapchain_attachment = nullptr;
 	unsigned swapchain_physical_index = RenderResource::Unused;
@@ -1027,16 +1072,30 @@ private:
 	void setup_physical_buffer(Vulkan::Device &device, unsigned attachment);
 	void setup_physical_image(Vulkan::Device &device, unsigned attachment);
 
-	void depend_passes_recursive(const RenderPass &pass, const std::unordered_set<unsigned> &passes,
-	                             unsigned stack_count, bool no_check, bool ignore_self, bool merge_dependency);
+	void depend_passes(const RenderPass &pass, const std::unordered_set<unsigned> &passes,
+	                   std::vector<unsigned> &pushed_passes,
+	                   bool no_check, bool ignore_self, bool merge_dependency);
 
-	void traverse_dependencies(const RenderPass &pass, unsigned stack_count);
+	void traverse_dependencies(const RenderPass &pass);
 
 	std::vector<std::unordered_set<unsigned>> pass_dependencies;
 	std::vector<std::unordered_set<unsigned>> pass_merge_dependencies;
-	bool depends_on_pass(unsigned dst_pass, unsigned src_pass);
-
+	// Traversal state per pass, 0 = unvisited, 1 = on the traversal stack, 2 = done.
+	std::vector<uint8_t> pass_traversal_state;
+	// Transitive closure of pass_dependencies, pass_closure_words bits per pass.
+	std::vector<uint64_t> pass_dependency_closure;
+	unsigned pass_closure_words = 0;
+	bool depends_on_pass(unsigned dst_pass, unsigned src_pass) const;
+
+	void build_pass_schedule(const RenderResource &backbuffer_resource);
 	void reorder_passes(std::vector<unsigned> &passes);
+
+	// The pass schedule only depends on how passes and resources are connected,
+	// so it is reused across bakes, e.g. on resize, until the topology changes.
+	// Everything from build_physical_resources() onwards is rebuilt on every bake.
+	Util::Hash compute_topology_hash() const;
+	Util::Hash cached_topology_hash = 0;
+	std::vector<unsigned> cached_pass_stack;
 	static bool need_invalidate(const Barrier &barrier, const PipelineEvent &event);
 
 	struct PassSubmissionState
@@ -1046,6 +1105,8 @@ private:
 		Util::SmallVector<VkImageMemoryBarrier2> image_barriers;
 
 		Util::SmallVector<VkSubpassContents> subpass_contents;
+		// Indexed by layer * num_subpasses + subpass. Empty for subpasses which are recorded inline.
+		std::vector<std::vector<Vulkan::CommandBufferHandle>> secondary_cmds;
 
 		Util::SmallVector<Vulkan::Semaphore> wait_semaphores;
 		Util::SmallVector<VkPipelineStageFlags2> wait_semaphore_stages;
@@ -1075,6 +1136,9 @@ private:
 	void physical_pass_invalidate_attachments(const PhysicalPass &pass);
 	void physical_pass_invalidate_attachments_early();
 
+	unsigned physical_pass_setup_layers(const PhysicalPass &pass, Vulkan::RenderPassInfo &rp_info) const;
+	void physical_pass_record_secondary_commands(const PhysicalPass &pass, PassSubmissionState &state,
+	                                             TaskGroup &group);
 	void physical_pass_enqueue_graphics_commands(const PhysicalPass &pass, PassSubmissionState &state);
 	void physical_pass_enqueue_compute_commands(const PhysicalPass &pass, PassSubmissionState &state);
 
@@ -871,13 +871,14 @@ void Renderer::flush_subset(Vulkan::CommandBuffer &cmd, const RenderQueue &queue
 	CommandBufferSavedState state = {};
 	cmd.save_state(COMMAND_BUFFER_SAVED_SCISSOR_BIT | COMMAND_BUFFER_SAVED_VIEWPORT_BIT | COMMAND_BUFFER_SAVED_RENDER_STATE_BIT, state);
 
-	if ((options & (MESH_ASSET_OPAQUE_BIT | MESH_ASSET_MOTION_VECTOR_BIT)) != 0)
+	// Mesh assets are not part of the queue, so only the first subset renders them.
+	if (index == 0 && (options & (MESH_ASSET_OPAQUE_BIT | MESH_ASSET_MOTION_VECTOR_BIT)) != 0)
 	{
 		render_mesh_assets(cmd, context, DrawPipeline::Opaque, parameters, options, false);
 		render_mesh_assets(cmd, context, DrawPipeline::Opaque, parameters, options, true);
 	}
 
-	if ((options & MESH_ASSET_OPAQUE_BIT) != 0 && (options & MESH_ASSET_MOTION_VECTOR_BIT) == 0)
+	if (index == 0 && (options & MESH_ASSET_OPAQUE_BIT) != 0 && (options & MESH_ASSET_MOTION_VECTOR_BIT) == 0)
 	{
 		render_mesh_assets(cmd, context, DrawPipeline::AlphaTest, parameters, options, false);
 		render_mesh_assets(cmd, context, DrawPipeline::AlphaTest, parameters, options, true);
@@ -895,7 +896,7 @@ void Renderer::flush_subset(Vulkan::CommandBuffer &cmd, const RenderQueue &queue
 		cmd.set_depth_test(true, false);
 		cmd.save_state(COMMAND_BUFFER_SAVED_SCISSOR_BIT | COMMAND_BUFFER_SAVED_VIEWPORT_BIT | COMMAND_BUFFER_SAVED_RENDER_STATE_BIT, state);
 
-		if ((options & MESH_ASSET_TRANSPARENT_BIT) != 0)
+		if (index == 0 && (options & MESH_ASSET_TRANSPARENT_BIT) != 0)
 		{
 			render_mesh_assets(cmd, context, DrawPipeline::AlphaBlend, parameters, options, false);
 			render_mesh_assets(cmd, context, DrawPipeline::AlphaBlend, parameters, options, true);
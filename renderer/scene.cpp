@@ -53,9 +53,18 @@ Scene::Scene()
 	  render_pass_creators(pool.get_component_group<RenderPassComponent>())
 {
 	pending_hierarchy_level_mask.store(0, std::memory_order_relaxed);
-	updated_transforms_count.store(0, std::memory_order_relaxed);
-	updated_aabb_count.store(0, std::memory_order_relaxed);
-	cleared_occlusion_states_count.store(0, std::memory_order_relaxed);
+	updated_transforms.init(MaxNumNodesLog2);
+	updated_aabbs.init(MaxNumNodesLog2);
+	cleared_occlusion_states.init(MaxOcclusionStatesLog2);
+
+	culling_hierarchies[CullingHierarchyOpaque].group =
+			pool.get_component_group_holder<RenderInfoComponent, RenderableComponent, CachedSpatialTransformTimestampComponent, OpaqueComponent>();
+	culling_hierarchies[CullingHierarchyTransparent].group =
+			pool.get_component_group_holder<RenderInfoComponent, RenderableComponent, CachedSpatialTransformTimestampComponent, TransparentComponent>();
+	culling_hierarchies[CullingHierarchyStaticShadow].group =
+			pool.get_component_group_holder<RenderInfoComponent, RenderableComponent, CachedSpatialTransformTimestampComponent, CastsStaticShadowComponent>();
+	culling_hierarchies[CullingHierarchyDynamicShadow].group =
+			pool.get_component_group_holder<RenderInfoComponent, RenderableComponent, CachedSpatialTransformTimestampComponent, CastsDynamicShadowComponent>();
 }
 
 Scene::~Scene()
@@ -70,38 +79,164 @@ Scene::~Scene()
 }
 
 template <typename T, typename Func>
-static void gather_visible_renderables(const Frustum &frustum, VisibilityList &list, const T &objects,
-                                       size_t begin_index, size_t end_index, const Func &filter_func)
+static inline void gather_visible_renderable(const Frustum &frustum, VisibilityList &list, const T &o,
+                                             bool test_frustum, const Func &filter_func)
+{
+	auto *transform = get_component<RenderInfoComponent>(o);
+
+	auto *renderable = get_component<RenderableComponent>(o);
+	auto flags = renderable->renderable->flags;
+	if (!filter_func(transform, flags))
+		return;
+
+	auto *timestamp = get_component<CachedSpatialTransformTimestampComponent>(o);
+
+	Util::Hasher h;
+	h.u64(timestamp->cookie);
+	h.u32(timestamp->last_timestamp);
+
+	if (transform->has_scene_node())
+	{
+		if (!test_frustum || (flags & RENDERABLE_FORCE_VISIBLE_BIT) != 0 ||
+		    SIMD::frustum_cull(transform->get_aabb(), frustum.get_planes()))
+		{
+			list.push_back({ renderable->renderable.get(), transform, h.get() });
+		}
+	}
+	else
+		list.push_back({ renderable->renderable.get(), nullptr, h.get() });
+}
+
+template <typename T, typename Func>
+static void gather_visible_renderables_range(const Frustum &frustum, VisibilityList &list, const T &objects,
+                                             size_t begin_index, size_t end_index, const Func &filter_func)
 {
 	for (size_t i = begin_index; i < end_index; i++)
+		gather_visible_renderable(frustum, list, objects[i], true, filter_func);
+}
+
+const Scene::CullingHierarchy *Scene::get_valid_culling_hierarchy(unsigned type) const
+{
+	if (!culling_hierarchy_enabled)
+		return nullptr;
+
+	// If group membership changed since last update, leaf indices are stale.
+	auto &hier = culling_hierarchies[type];
+	if (hier.generation != hier.group->get_generation())
+		return nullptr;
+	return &hier;
+}
+
+template <typename T, typename Func>
+void Scene::gather_visible_renderables(const Frustum &frustum, VisibilityList &list, const T &objects,
+                                       unsigned type, unsigned index, unsigned num_indices,
+                                       const Func &filter_func) const
+{
+	auto *hier = get_valid_culling_hierarchy(type);
+	if (!hier)
+	{
+		size_t start_index = (index * objects.size()) / num_indices;
+		size_t end_index = ((index + 1) * objects.size()) / num_indices;
+		gather_visible_renderables_range(frustum, list, objects, start_index, end_index, filter_func);
+		return;
+	}
+
+	// Leaves have already been tested against the frustum.
+	hier->bvh.for_each_visible_subset(transform_allocator_aabb.get_aabbs(), frustum, index, num_indices,
+	                                  [&](uint32_t object_index) {
+		                                  gather_visible_renderable(frustum, list, objects[object_index],
+		                                                            false, filter_func);
+	                                  });
+
+	size_t start_index = (index * hier->unculled.size()) / num_indices;
+	size_t end_index = ((index + 1) * hier->unculled.size()) / num_indices;
+	for (size_t i = start_index; i < end_index; i++)
+		gather_visible_renderable(frustum, list, objects[hier->unculled[i]], true, filter_func);
+}
+
+void Scene::set_culling_hierarchy_enabled(bool enable)
+{
+	culling_hierarchy_enabled = enable;
+	if (!enable)
+	{
+		for (auto &hier : culling_hierarchies)
+		{
+			hier.bvh.clear();
+			hier.unculled.clear();
+			hier.generation = UINT64_MAX;
+		}
+	}
+}
+
+template <typename T>
+void Scene::update_culling_hierarchy(CullingHierarchy &hier, const T &objects)
+{
+	auto *aabbs = transform_allocator_aabb.get_aabbs();
+	uint64_t generation = hier.group->get_generation();
+
+	if (hier.generation == generation && !hier.bvh.needs_rebuild())
+	{
+		// The update list is only cleared after rendering, so refitting against the full list is fine
+		// even if we are called multiple times in a frame.
+		hier.bvh.refit(aabbs, updated_aabbs.count(), [this](const auto &mark) {
+			updated_aabbs.for_each_bit(mark);
+		});
+		return;
+	}
+
+	std::vector<BVH::Leaf> leaves;
+	leaves.reserve(objects.size());
+	hier.unculled.clear();
+
+	for (size_t i = 0, n = objects.size(); i < n; i++)
 	{
 		auto &o = objects[i];
 		auto *transform = get_component<RenderInfoComponent>(o);
+		auto flags = get_component<RenderableComponent>(o)->renderable->flags;
 
-		auto *renderable = get_component<RenderableComponent>(o);
-		auto flags = renderable->renderable->flags;
-		if (!filter_func(transform, flags))
-			continue;
+		if (transform->has_scene_node() && (flags & RENDERABLE_FORCE_VISIBLE_BIT) == 0)
+			leaves.push_back({ transform->aabb.offset, uint32_t(i) });
+		else
+			hier.unculled.push_back(uint32_t(i));
+	}
 
-		auto *timestamp = get_component<CachedSpatialTransformTimestampComponent>(o);
+	hier.bvh.build(aabbs, leaves.data(), leaves.size());
+	hier.generation = generation;
+}
 
-		Util::Hasher h;
-		h.u64(timestamp->cookie);
-		h.u32(timestamp->last_timestamp);
+void Scene::update_culling_hierarchy_subset(unsigned index, unsigned num_indices)
+{
+	if (!culling_hierarchy_enabled)
+		return;
 
-		if (transform->has_scene_node())
+	for (unsigned i = index; i < CullingHierarchyCount; i += num_indices)
+	{
+		auto &hier = culling_hierarchies[i];
+		switch (i)
 		{
-			if ((flags & RENDERABLE_FORCE_VISIBLE_BIT) != 0 ||
-			    SIMD::frustum_cull(transform->get_aabb(), frustum.get_planes()))
-			{
-				list.push_back({ renderable->renderable.get(), transform, h.get() });
-			}
+		case CullingHierarchyOpaque:
+			update_culling_hierarchy(hier, opaque);
+			break;
+		case CullingHierarchyTransparent:
+			update_culling_hierarchy(hier, transparent);
+			break;
+		case CullingHierarchyStaticShadow:
+			update_culling_hierarchy(hier, static_shadowing);
+			break;
+		case CullingHierarchyDynamicShadow:
+			update_culling_hierarchy(hier, dynamic_shadowing);
+			break;
+		default:
+			break;
 		}
-		else
-			list.push_back({ renderable->renderable.get(), nullptr, h.get() });
 	}
 }
 
+void Scene::update_culling_hierarchy()
+{
+	update_culling_hierarchy_subset(0, 1);
+}
+
 void Scene::add_render_passes(RenderGraph &graph)
 {
 	for (auto &pass : render_pass_creators)
@@ -247,73 +382,63 @@ static bool filter_true(const RenderInfoComponent *, RenderableFlags flags)
 	return (flags & RENDERABLE_MESH_ASSET_BIT) == 0;
 }
 
+static bool filter_motion_vectors(const RenderInfoComponent *info, RenderableFlags flags)
+{
+	return (flags & RENDERABLE_IMPLICIT_MOTION_BIT) == 0 &&
+	       (flags & RENDERABLE_MESH_ASSET_BIT) == 0 &&
+	       info->requires_motion_vectors;
+}
+
 void Scene::gather_visible_opaque_renderables(const Frustum &frustum, VisibilityList &list) const
 {
-	gather_visible_renderables(frustum, list, opaque, 0, opaque.size(), filter_true);
+	gather_visible_renderables(frustum, list, opaque, CullingHierarchyOpaque, 0, 1, filter_true);
 }
 
 void Scene::gather_visible_motion_vector_renderables(const Frustum &frustum, VisibilityList &list) const
 {
-	gather_visible_renderables(frustum, list, opaque, 0, opaque.size(),
-	                           [](const RenderInfoComponent *info, RenderableFlags flags)
-	                           {
-		                           return (flags & RENDERABLE_IMPLICIT_MOTION_BIT) == 0 &&
-		                                  (flags & RENDERABLE_MESH_ASSET_BIT) == 0 &&
-		                                  info->requires_motion_vectors;
-	                           });
+	gather_visible_renderables(frustum, list, opaque, CullingHierarchyOpaque, 0, 1, filter_motion_vectors);
 }
 
 void Scene::gather_visible_opaque_renderables_subset(const Frustum &frustum, VisibilityList &list,
                                                      unsigned index, unsigned num_indices) const
 {
-	size_t start_index = (index * opaque.size()) / num_indices;
-	size_t end_index = ((index + 1) * opaque.size()) / num_indices;
-	gather_visible_renderables(frustum, list, opaque, start_index, end_index, filter_true);
+	gather_visible_renderables(frustum, list, opaque, CullingHierarchyOpaque, index, num_indices, filter_true);
 }
 
 void Scene::gather_visible_motion_vector_renderables_subset(const Frustum &frustum, VisibilityList &list,
                                                             unsigned index, unsigned num_indices) const
 {
-	size_t start_index = (index * opaque.size()) / num_indices;
-	size_t end_index = ((index + 1) * opaque.size()) / num_indices;
-	gather_visible_renderables(frustum, list, opaque, start_index, end_index,
-	                           [](const RenderInfoComponent *info, RenderableFlags flags)
-	                           {
-		                           return (flags & RENDERABLE_IMPLICIT_MOTION_BIT) == 0 &&
-		                                  (flags & RENDERABLE_MESH_ASSET_BIT) == 0 &&
-		                                  info->requires_motion_vectors;
-	                           });
+	gather_visible_renderables(frustum, list, opaque, CullingHierarchyOpaque, index, num_indices,
+	                           filter_motion_vectors);
 }
 
 void Scene::gather_visible_transparent_renderables(const Frustum &frustum, VisibilityList &list) const
 {
-	gather_visible_renderables(frustum, list, transparent, 0, transparent.size(), filter_true);
+	gather_visible_renderables(frustum, list, transparent, CullingHierarchyTransparent, 0, 1, filter_true);
 }
 
 void Scene::gather_visible_static_shadow_renderables(const Frustum &frustum, VisibilityList &list) const
 {
-	gather_visible_renderables(frustum, list, static_shadowing, 0, static_shadowing.size(), filter_true);
+	gather_visible_renderables(frustum, list, static_shadowing, CullingHierarchyStaticShadow, 0, 1, filter_true);
 }
 
 void Scene::gather_visible_transparent_renderables_subset(const Frustum &frustum, VisibilityList &list,
                                                           unsigned index, unsigned num_indices) const
 {
-	size_t start_index = (index * transparent.size()) / num_indices;
-	size_t end_index = ((index + 1) * transparent.size()) / num_indices;
-	gather_visible_renderables(frustum, list, transparent, start_index, end_index, filter_true);
+	gather_visible_renderables(frustum, list, transparent, CullingHierarchyTransparent,
+	                           index, num_indices, filter_true);
 }
 
 void Scene::gather_visible_static_shadow_renderables_subset(const Frustum &frustum, VisibilityList &list,
                                                             unsigned index, unsigned num_indices) const
 {
-	size_t start_index = (index * static_shadowing.size()) / num_indices;
-	size_t end_index = ((index + 1) * static_shadowing.size()) / num_indices;
-	gather_visible_renderables(frustum, list, static_shadowing, start_index, end_index, filter_true);
+	gather_visible_renderables(frustum, list, static_shadowing, CullingHierarchyStaticShadow,
+	                           index, num_indices, filter_true);
 }
 
 void Scene::gather_visible_dynamic_shadow_renderables(const Frustum &frustum, VisibilityList &list) const
 {
-	gather_visible_renderables(frustum, list, dynamic_shadowing, 0, dynamic_shadowing.size(), filter_true);
+	gather_visible_renderables(frustum, list, dynamic_shadowing, CullingHierarchyDynamicShadow, 0, 1, filter_true);
 	for (auto &object : render_pass_shadowing)
 		list.push_back({ get_component<RenderableComponent>(object)->renderable.get(), nullptr });
 }
@@ -321,9 +446,8 @@ void Scene::gather_visible_dynamic_shadow_renderables(const Frustum &frustum, Vi
 void Scene::gather_visible_dynamic_shadow_renderables_subset(const Frustum &frustum, VisibilityList &list,
                                                              unsigned index, unsigned num_indices) const
 {
-	size_t start_index = (index * dynamic_shadowing.size()) / num_indices;
-	size_t end_index = ((index + 1) * dynamic_shadowing.size()) / num_indices;
-	gather_visible_renderables(frustum, list, dynamic_shadowing, start_index, end_index, filter_true);
+	gather_visible_renderables(frustum, list, dynamic_shadowing, CullingHierarchyDynamicShadow,
+	                           index, num_indices, filter_true);
 
 	if (index == 0)
 		for (auto &object : render_pass_shadowing)
@@ -553,9 +677,6 @@ void Scene::perform_update_skinning(Node * const *updates, size_t count)
 
 void Scene::update_transform_tree(TaskComposer *composer)
 {
-	updated_transforms.reserve(get_transforms().get_count());
-	updated_aabbs.reserve(get_aabbs().get_count());
-
 	if (composer)
 	{
 		auto &group = composer->begin_pipeline_stage();
@@ -629,7 +750,6 @@ void Scene::update_transform_tree(TaskComposer *composer)
 				l.clear();
 			pending_node_updates_skin.clear();
 			pending_hierarchy_level_mask.store(0, std::memory_order_relaxed);
-			sort_updates();
 		});
 	}
 	else
@@ -639,7 +759,6 @@ void Scene::update_transform_tree(TaskComposer *composer)
 			l.clear();
 		pending_node_updates_skin.clear();
 		pending_hierarchy_level_mask.store(0, std::memory_order_relaxed);
-		sort_updates();
 	}
 }
 
@@ -786,49 +905,25 @@ void Scene::update_cached_transforms_range(size_t begin_range, size_t end_range)
 
 void Scene::notify_allocated_occlusion_state(uint32_t offset, uint32_t count)
 {
-	// Unordered is fine, we only need thread-safe writes to this array, but consumption happens
+	// Unordered is fine, we only need thread-safe writes to this bitmap, but consumption happens
 	// in a well defined place where we ensure thread safety through external means.
-	size_t write_offset = cleared_occlusion_states_count.fetch_add(count, std::memory_order_relaxed);
-
-	if (write_offset + count > cleared_occlusion_states.get_capacity())
-	{
-		// Technically, this isn't a big problem, but may lead to weirdness down the line.
-		LOGE("Cleared occlusion state buffer is full.\n");
-		return;
-	}
-
-	for (uint32_t i = 0; i < count; i++)
-		cleared_occlusion_states[write_offset + i] = offset + i;
+	cleared_occlusion_states.set_range(offset, count);
 }
 
 void Scene::notify_transform_updates(uint32_t offset, uint32_t count)
 {
-	size_t write_offset = updated_transforms_count.fetch_add(count, std::memory_order_relaxed);
-
-	if (write_offset + count > updated_transforms.get_capacity())
-	{
-		// This shouldn't happen unless someone forgets to restart the list.
-		LOGE("Transform update state buffer is full.\n");
-		return;
-	}
+	updated_transforms.set_range(offset, count);
+}
 
+void Scene::notify_transform_updates(const uint32_t *offsets, uint32_t count)
+{
 	for (uint32_t i = 0; i < count; i++)
-		updated_transforms[write_offset + i] = offset + i;
+		updated_transforms.set(offsets[i]);
 }
 
 void Scene::notify_aabb_updates(uint32_t offset, uint32_t count)
 {
-	size_t write_offset = updated_aabb_count.fetch_add(count, std::memory_order_relaxed);
-
-	if (write_offset + count > updated_aabbs.get_capacity())
-	{
-		// This shouldn't happen unless someone forgets to restart the list.
-		LOGE("AABB update state buffer is full.\n");
-		return;
-	}
-
-	for (uint32_t i = 0; i < count; i++)
-		updated_aabbs[write_offset + i] = offset + i;
+	updated_aabbs.set_range(offset, count);
 }
 
 void Scene::push_pending_node_update(Node *node)
@@ -836,20 +931,11 @@ void Scene::push_pending_node_update(Node *node)
 	pending_node_updates.push(node);
 }
 
-void Scene::sort_updates()
-{
-	std::sort(updated_transforms.data(),
-	          updated_transforms.data() + updated_transforms_count.load(std::memory_order_relaxed));
-	std::sort(updated_aabbs.data(), updated_aabbs.data() + updated_aabb_count.load(std::memory_order_relaxed));
-	std::sort(cleared_occlusion_states.data(),
-	          cleared_occlusion_states.data() + cleared_occlusion_states_count.load(std::memory_order_relaxed));
-}
-
 void Scene::clear_updates()
 {
-	updated_transforms_count.store(0, std::memory_order_relaxed);
-	updated_aabb_count.store(0, std::memory_order_relaxed);
-	cleared_occlusion_states_count.store(0, std::memory_order_relaxed);
+	updated_transforms.clear();
+	updated_aabbs.clear();
+	cleared_occlusion_states.clear();
 }
 
 void Scene::distribute_update_to_level(Node *update, unsigned level)
@@ -900,26 +986,43 @@ void Scene::distribute_per_level_updates(TaskGroup *group)
 	}
 }
 
-void Scene::update_transform_tree_node(Node &node, const mat_affine &transform)
+void Scene::perform_updates(Node * const *updates, size_t count)
 {
-	node.get_cached_prev_transform() = node.get_cached_transform();
-	auto &t = node.get_transform();
-	compute_model_transform(node.get_cached_transform(), t.scale, t.rotation, t.translation, transform);
+	ModelTransformBatch batch;
+	uint32_t offsets[ModelTransformBatch::Size];
+
+	for (size_t base = 0; base < count; base += ModelTransformBatch::Size)
+	{
+		unsigned lanes = unsigned(std::min<size_t>(count - base, ModelTransformBatch::Size));
 
-	notify_transform_updates(node.transform.offset, 1);
+		for (unsigned lane = 0; lane < lanes; lane++)
+		{
+			auto &node = *updates[base + lane];
+			auto *parent = node.get_parent();
+			auto &t = node.get_transform();
+			batch.set_lane(lane, t.scale, t.rotation, t.translation,
+			               parent ? parent->get_cached_transform() : identity_transform);
+
+			// Write the previous transform in the same pass.
+			node.get_cached_prev_transform() = node.get_cached_transform();
+			offsets[lane] = node.transform.offset;
+		}
 
-	node.update_timestamp();
-	node.clear_pending_update_no_atomic();
-}
+		// Keep the tail lanes well-defined.
+		for (unsigned lane = lanes; lane < ModelTransformBatch::Size; lane++)
+			batch.set_lane(lane, vec3(1.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(0.0f), identity_transform);
 
-void Scene::perform_updates(Node * const *updates, size_t count)
-{
-	for (size_t i = 0; i < count; i++)
-	{
-		auto *update = updates[i];
-		auto *parent = update->get_parent();
-		auto &transform = parent ? parent->get_cached_transform() : identity_transform;
-		update_transform_tree_node(*update, transform);
+		compute_model_transforms(batch);
+
+		for (unsigned lane = 0; lane < lanes; lane++)
+		{
+			auto &node = *updates[base + lane];
+			batch.get_lane(lane, node.get_cached_transform());
+			node.update_timestamp();
+			node.clear_pending_update_no_atomic();
+		}
+
+		notify_transform_updates(offsets, lanes);
 	}
 }
 
@@ -1174,7 +1277,6 @@ Entity *Scene::create_renderable(AbstractRenderableHandle renderable, Node *node
 				if (!get_occluder_states().allocate(num_occluder_words, &transform->occluder_state))
 					LOGE("Exhausted occluder state pool.\n");
 
-				cleared_occlusion_states.reserve(get_occluder_states().get_count());
 				notify_allocated_occlusion_state(transform->occluder_state.offset, num_occluder_words);
 			}
 		}
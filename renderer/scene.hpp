@@ -25,11 +25,13 @@
 #include "ecs.hpp"
 #include "render_components.hpp"
 #include "frustum.hpp"
+#include "bvh.hpp"
 #include "scene_formats.hpp"
 #include "no_init_pod.hpp"
 #include "thread_group.hpp"
 #include "atomic_append_buffer.hpp"
 #include "arena_allocator.hpp"
+#include "atomic_bitmap.hpp"
 #include <atomic>
 
 namespace Granite
@@ -130,6 +132,14 @@ public:
 	void update_cached_transforms_subset(unsigned index, unsigned num_indices);
 	size_t get_cached_transforms_count() const;
 
+	// Optional BVH acceleration for the renderable gathers.
+	// The hierarchy must be updated after cached transforms have been updated,
+	// otherwise gathers fall back to linear culling until the next update.
+	void set_culling_hierarchy_enabled(bool enable);
+	bool get_culling_hierarchy_enabled() const { return culling_hierarchy_enabled; }
+	void update_culling_hierarchy();
+	void update_culling_hierarchy_subset(unsigned index, unsigned num_indices);
+
 	void gather_visible_opaque_renderables(const Frustum &frustum, VisibilityList &list) const;
 	void gather_visible_motion_vector_renderables(const Frustum &frustum, VisibilityList &list) const;
 	void gather_visible_transparent_renderables(const Frustum &frustum, VisibilityList &list) const;
@@ -217,26 +227,22 @@ public:
 	OccluderStateAllocator &get_occluder_states() { return occluder_state_allocator; }
 	const OccluderStateAllocator &get_occluder_states() const { return occluder_state_allocator; }
 
-	struct UpdateSpan
-	{
-		const uint32_t *offsets;
-		size_t count;
-	};
-
+	// Dirty state for GPU uploads and culling hierarchy refits.
+	// Iteration yields each modified offset once in increasing order, or as contiguous runs.
 	// These are not thread-safe.
-	UpdateSpan get_transform_update_span() const
+	const Util::AtomicBitmap &get_transform_updates() const
 	{
-		return { updated_transforms.data(), updated_transforms_count.load(std::memory_order_relaxed) };
+		return updated_transforms;
 	}
 
-	UpdateSpan get_aabb_update_span() const
+	const Util::AtomicBitmap &get_aabb_updates() const
 	{
-		return { updated_aabbs.data(), updated_aabb_count.load(std::memory_order_relaxed) };
+		return updated_aabbs;
 	}
 
-	UpdateSpan get_occluder_state_update_span() const
+	const Util::AtomicBitmap &get_occluder_state_updates() const
 	{
-		return { cleared_occlusion_states.data(), cleared_occlusion_states_count.load(std::memory_order_relaxed) };
+		return cleared_occlusion_states;
 	}
 
 	void clear_updates();
@@ -250,12 +256,9 @@ private:
 	Util::ObjectPool<Node> node_pool;
 	NodeHandle root_node;
 
-	Util::DynamicArray<uint32_t> updated_transforms;
-	Util::DynamicArray<uint32_t> updated_aabbs;
-	Util::DynamicArray<uint32_t> cleared_occlusion_states;
-	std::atomic_size_t updated_transforms_count;
-	std::atomic_size_t updated_aabb_count;
-	std::atomic_size_t cleared_occlusion_states_count;
+	Util::AtomicBitmap updated_transforms;
+	Util::AtomicBitmap updated_aabbs;
+	Util::AtomicBitmap cleared_occlusion_states;
 
 	// Sets up the default useful component groups up front.
 	const ComponentGroupVector<
@@ -321,6 +324,34 @@ private:
 			CachedSpatialTransformTimestampComponent,
 			RenderInfoComponent> &volumetric_decals;
 
+	struct CullingHierarchy
+	{
+		BVH bvh;
+		const EntityGroupBase *group = nullptr;
+		uint64_t generation = UINT64_MAX;
+		// Objects which cannot be culled, e.g. force visible or without a scene node.
+		std::vector<uint32_t> unculled;
+	};
+
+	enum
+	{
+		CullingHierarchyOpaque,
+		CullingHierarchyTransparent,
+		CullingHierarchyStaticShadow,
+		CullingHierarchyDynamicShadow,
+		CullingHierarchyCount
+	};
+	CullingHierarchy culling_hierarchies[CullingHierarchyCount];
+	bool culling_hierarchy_enabled = false;
+	const CullingHierarchy *get_valid_culling_hierarchy(unsigned type) const;
+
+	template <typename T>
+	void update_culling_hierarchy(CullingHierarchy &hier, const T &objects);
+	template <typename T, typename Func>
+	void gather_visible_renderables(const Frustum &frustum, VisibilityList &list, const T &objects,
+	                                unsigned type, unsigned index, unsigned num_indices,
+	                                const Func &filter_func) const;
+
 	const ComponentGroupVector<PerFrameUpdateComponent> &per_frame_updates;
 	const ComponentGroupVector<PerFrameUpdateTransformComponent,
 			RenderInfoComponent> &per_frame_update_transforms;
@@ -353,12 +384,11 @@ private:
 	void update_transform_tree(TaskComposer *composer);
 
 	void perform_updates(Node * const *updates, size_t count);
-	void update_transform_tree_node(Node &node, const mat_affine &transform);
 	void update_skinning(Node &node);
 	void perform_update_skinning(Node * const *updates, size_t count);
 	void notify_transform_updates(uint32_t offset, uint32_t count);
+	void notify_transform_updates(const uint32_t *offsets, uint32_t count);
 	void notify_aabb_updates(uint32_t offset, uint32_t count);
 	void notify_allocated_occlusion_state(uint32_t offset, uint32_t count);
-	void sort_updates();
 };
 }
@@ -323,7 +323,7 @@ NodeHandle SceneLoader::parse_gltf(const std::string &path)
 		auto view = Vulkan::Meshlet::create_mesh_view(*mapping);
 		if (!view.format_header)
 			throw std::runtime_error("Failed to parse meshlet.");
-		uint32_t num_occlusion_states = view.format_header->meshlet_count;
+		uint32_t num_occlusion_states = view.num_bounds;
 
 		auto pipe = DrawPipeline::Opaque;
 		MeshAssetMaterialFlags flags = 0;
@@ -395,7 +395,55 @@ void RenderPassSceneRenderer::enqueue_prepare_render_pass(RenderGraph &, TaskCom
 	}
 }
 
-void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd, unsigned layer) const
+const RenderQueue *RenderPassSceneRenderer::get_secondary_command_buffer_queue(unsigned layer) const
+{
+	// Every secondary command buffer renders a slice of the same queue.
+	// If there are multiple phases in the pass, we would break ordering between phases.
+	constexpr SceneRendererFlags single_queue_flags =
+			SCENE_RENDERER_DEPTH_BIT | SCENE_RENDERER_Z_PREPASS_BIT |
+			SCENE_RENDERER_FORWARD_OPAQUE_BIT | SCENE_RENDERER_DEFERRED_GBUFFER_BIT;
+	constexpr SceneRendererFlags inline_flags =
+			SCENE_RENDERER_FORWARD_TRANSPARENT_BIT | SCENE_RENDERER_DEFERRED_LIGHTING_BIT |
+			SCENE_RENDERER_DEBUG_PROBES_BIT | SCENE_RENDERER_MOTION_VECTOR_BIT;
+
+	auto flags = setup_data.flags;
+	if ((flags & SCENE_RENDERER_SECONDARY_COMMAND_BUFFER_BIT) == 0 || (flags & inline_flags) != 0)
+		return nullptr;
+
+	auto queue_flags = flags & single_queue_flags;
+	if (queue_flags == 0 || (queue_flags & (queue_flags - 1)) != 0)
+		return nullptr;
+
+	unsigned bucket_index = render_pass_is_separate_layered() ? layer : 0;
+	if (queue_flags & (SCENE_RENDERER_DEPTH_BIT | SCENE_RENDERER_Z_PREPASS_BIT))
+		return &queue_per_task_depth[bucket_index];
+	else
+		return &queue_per_task_opaque[bucket_index];
+}
+
+unsigned RenderPassSceneRenderer::get_num_secondary_command_buffers(unsigned layer) const
+{
+	auto *queue = get_secondary_command_buffer_queue(layer);
+	if (!queue)
+		return 0;
+
+	size_t count = queue->get_dispatch_size(Queue::Opaque) / MinDrawsPerSecondaryCommandBuffer;
+	count = std::min<size_t>(count, MaxSecondaryCommandBuffers);
+
+	// Not worth the overhead, just record inline.
+	if (count < 2)
+		return 0;
+	return unsigned(count);
+}
+
+void RenderPassSceneRenderer::build_render_pass_secondary(Vulkan::CommandBuffer &cmd, unsigned layer,
+                                                          unsigned index, unsigned num_indices)
+{
+	build_render_pass_inner(cmd, layer, index, num_indices);
+}
+
+void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd, unsigned layer,
+                                                      unsigned index, unsigned num_indices) const
 {
 	auto *suite = setup_data.suite;
 
@@ -420,11 +468,11 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 	{
 		if (setup_data.flags & SCENE_RENDERER_Z_PREPASS_BIT)
 		{
-			suite->get_renderer(RendererSuite::Type::PrepassDepth).flush(
+			suite->get_renderer(RendererSuite::Type::PrepassDepth).flush_subset(
 				cmd, queue_per_task_depth[bucket_index], setup_data.context[bucket_index],
 				Renderer::NO_COLOR_BIT | Renderer::SKIP_SORTING_BIT |
 				Renderer::MESH_ASSET_OPAQUE_BIT |
-				flush_flags, &flush_params);
+				flush_flags, &flush_params, index, num_indices);
 		}
 
 		if (setup_data.flags & SCENE_RENDERER_FORWARD_OPAQUE_BIT)
@@ -432,8 +480,9 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 			Renderer::RendererOptionFlags opt = Renderer::SKIP_SORTING_BIT | Renderer::MESH_ASSET_OPAQUE_BIT | flush_flags;
 			if (setup_data.flags & (SCENE_RENDERER_Z_PREPASS_BIT | SCENE_RENDERER_Z_EXISTING_PREPASS_BIT))
 				opt |= Renderer::DEPTH_STENCIL_READ_ONLY_BIT | Renderer::DEPTH_TEST_EQUAL_BIT;
-			suite->get_renderer(RendererSuite::Type::ForwardOpaque).flush(
-					cmd, queue_per_task_opaque[bucket_index], setup_data.context[bucket_index], opt, &flush_params);
+			suite->get_renderer(RendererSuite::Type::ForwardOpaque).flush_subset(
+					cmd, queue_per_task_opaque[bucket_index], setup_data.context[bucket_index], opt, &flush_params,
+					index, num_indices);
 
 			if (setup_data.flags & SCENE_RENDERER_DEBUG_PROBES_BIT)
 			{
@@ -467,10 +516,10 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 		if (setup_data.flags & SCENE_RENDERER_Z_EXISTING_PREPASS_BIT)
 			opt |= Renderer::DEPTH_STENCIL_READ_ONLY_BIT | Renderer::DEPTH_TEST_EQUAL_BIT;
 
-		suite->get_renderer(RendererSuite::Type::Deferred).flush(cmd, queue_per_task_opaque[bucket_index],
-		                                                         setup_data.context[bucket_index],
-		                                                         opt | flush_flags,
-		                                                         &flush_params);
+		suite->get_renderer(RendererSuite::Type::Deferred).flush_subset(cmd, queue_per_task_opaque[bucket_index],
+		                                                                setup_data.context[bucket_index],
+		                                                                opt | flush_flags,
+		                                                                &flush_params, index, num_indices);
 
 		if (setup_data.flags & SCENE_RENDERER_DEBUG_PROBES_BIT)
 		{
@@ -495,10 +544,10 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 	if (setup_data.flags & SCENE_RENDERER_DEPTH_BIT)
 	{
 		auto type = get_depth_renderer_type(setup_data.flags);
-		suite->get_renderer(type).flush(cmd, queue_per_task_depth[bucket_index], setup_data.context[bucket_index],
-		                                Renderer::DEPTH_BIAS_BIT | Renderer::SKIP_SORTING_BIT |
-		                                Renderer::MESH_ASSET_OPAQUE_BIT | flush_flags,
-		                                &flush_params);
+		suite->get_renderer(type).flush_subset(cmd, queue_per_task_depth[bucket_index], setup_data.context[bucket_index],
+		                                       Renderer::DEPTH_BIAS_BIT | Renderer::SKIP_SORTING_BIT |
+		                                       Renderer::MESH_ASSET_OPAQUE_BIT | flush_flags,
+		                                       &flush_params, index, num_indices);
 	}
 }
 
@@ -547,6 +596,7 @@ void SceneTransformManager::on_device_created(const Vulkan::DeviceCreatedEvent &
 void SceneTransformManager::on_device_destroyed(const Vulkan::DeviceCreatedEvent &)
 {
 	device = nullptr;
+	staging_block = {};
 	transforms.reset();
 	prev_transforms.reset();
 	aabbs.reset();
@@ -595,9 +645,17 @@ void SceneTransformManager::refresh(const RenderContext &, TaskComposer &compose
 {
 	// Do actual work.
 	auto &stage = composer.begin_pipeline_stage();
-	stage.enqueue_task([&]()
+	stage.set_desc("scene-buffers-pack");
+	stage.enqueue_task([this, h = composer.get_deferred_enqueue_handle()]() mutable
+	{
+		begin_scene_buffer_update(h.get());
+	});
+
+	auto &submit_stage = composer.begin_pipeline_stage();
+	submit_stage.set_desc("scene-buffers-submit");
+	submit_stage.enqueue_task([this]()
 	{
-		update_scene_buffers();
+		end_scene_buffer_update();
 	});
 }
 
@@ -617,71 +675,145 @@ static void flush_update(Vulkan::CommandBuffer &cmd, Vulkan::Buffer &buffer, VkD
 
 template <typename T>
 static void update_span(Vulkan::CommandBuffer &cmd, Vulkan::Buffer &buffer, const T *data,
-                        const Scene::UpdateSpan &span)
+                        const Util::AtomicBitmap &updates)
 {
-	uint32_t base_i = 0;
-	uint32_t base = 0;
-	size_t count = 0;
+	updates.for_each_run([&](uint32_t offset, uint32_t count) {
+		flush_update(cmd, buffer, offset, count, data);
+	});
+}
 
-	const auto flush = [&]()
+static void copy_span(Vulkan::CommandBuffer &cmd, Vulkan::Buffer &dst, Vulkan::Buffer &src,
+                      const Util::AtomicBitmap &updates, VkDeviceSize element_size)
+{
+	updates.for_each_run([&](uint32_t offset, uint32_t count) {
+		cmd.copy_buffer(dst, offset * element_size, src, offset * element_size, count * element_size);
+	});
+}
+
+enum class ScatterMode
+{
+	Payload = 0, // dst[offsets[i]] = payload[i]
+	Copy = 1, // dst[offsets[i]] = src[offsets[i]]
+	Clear = 2 // dst[offsets[i]] = 0
+};
+
+static void dispatch_scatter(Vulkan::CommandBuffer &cmd, ScatterMode mode, const Vulkan::Buffer &dst,
+                             const Vulkan::BufferBlockAllocation &indices, size_t count,
+                             const Vulkan::Buffer *src, VkDeviceSize src_offset, VkDeviceSize src_size,
+                             uint32_t element_words)
+{
+	cmd.set_program("builtin://shaders/util/scatter_update.comp", {{ "SCATTER_MODE", int(mode) }});
+	cmd.set_storage_buffer(0, 0, dst);
+	cmd.set_storage_buffer(0, 1, *indices.buffer, indices.offset, count * sizeof(uint32_t));
+	if (src)
+		cmd.set_storage_buffer(0, 2, *src, src_offset, src_size);
+
+	struct Push
 	{
-		if (count)
-		{
-			flush_update(cmd, buffer, base, count, data);
-			count = 0;
-		}
-	};
+		uint32_t word_offset;
+		uint32_t word_count;
+		uint32_t element_words;
+	} push = {};
+
+	push.word_count = uint32_t(count * element_words);
+	push.element_words = element_words;
 
-	assert(span.count != 0);
-	base = span.offsets[0];
+	const uint32_t max_wgx = cmd.get_device().get_gpu_properties().limits.maxComputeWorkGroupCount[0];
+	const uint32_t max_words_per_dispatch = std::min<uint32_t>(max_wgx, 0xffffffffu / 64) * 64;
 
-	for (size_t i = 0; i < span.count; i++)
+	for (uint32_t offset = 0; offset < push.word_count; offset += max_words_per_dispatch)
 	{
-		if (base + (i - base_i) != span.offsets[i])
-		{
-			flush();
-			base = span.offsets[i];
-			base_i = i;
-		}
+		push.word_offset = offset;
+		cmd.push_constants(&push, 0, sizeof(push));
+		uint32_t words = std::min<uint32_t>(push.word_count - offset, max_words_per_dispatch);
+		cmd.dispatch((words + 63) / 64, 1, 1);
+	}
+}
 
-		count++;
+Vulkan::BufferBlockAllocation SceneTransformManager::request_staging_memory(VkDeviceSize size)
+{
+	auto data = staging_block.allocate(size);
+	if (!data.host)
+	{
+		device->request_staging_block(staging_block, size);
+		data = staging_block.allocate(size);
 	}
 
-	flush();
+	return data;
 }
 
-static void copy_span(Vulkan::CommandBuffer &cmd, Vulkan::Buffer &dst, Vulkan::Buffer &src,
-                      const Scene::UpdateSpan &span, VkDeviceSize element_size)
+void SceneTransformManager::prepare_delta_upload(DeltaUpload &upload, const Util::AtomicBitmap &updates,
+                                                 const void *data, size_t element_size)
 {
-	uint32_t base_i = 0;
-	uint32_t base = 0;
-	size_t count = 0;
-
-	const auto flush = [&]()
-	{
-		if (count)
+	upload.updates = &updates;
+	upload.data = data;
+	upload.element_size = element_size;
+	upload.count = 0;
+	upload.scatter = false;
+	upload.chunks.clear();
+
+	// One pass over the dirty words gives us the element count, the number of runs,
+	// and chunk boundaries for packing in parallel.
+	size_t runs = 0;
+	uint32_t prev_word_index = UINT32_MAX;
+	uint64_t prev_bits = 0;
+	DeltaUpload::Chunk chunk = {};
+
+	updates.for_each_word([&](uint32_t word_index, uint64_t bits) {
+		uint64_t carry = (prev_word_index + 1 == word_index) ? (prev_bits >> 63) : 0;
+		runs += Util::popcount64(bits & ~((bits << 1) | carry));
+
+		if (upload.count - chunk.output_offset >= DeltaPackChunkSize)
 		{
-			cmd.copy_buffer(dst, base * element_size, src, base * element_size, count * element_size);
-			count = 0;
+			chunk.end_word = word_index;
+			upload.chunks.push_back(chunk);
+			chunk.first_word = word_index;
+			chunk.output_offset = upload.count;
 		}
-	};
 
-	assert(span.count != 0);
-	base = span.offsets[0];
+		upload.count += Util::popcount64(bits);
+		prev_word_index = word_index;
+		prev_bits = bits;
+	});
 
-	for (size_t i = 0; i < span.count; i++)
-	{
-		if (base + (i - base_i) != span.offsets[i])
-		{
-			flush();
-			base = span.offsets[i];
-			base_i = i;
-		}
+	if (upload.count == 0)
+		return;
+
+	chunk.end_word = updates.get_num_words();
+	upload.chunks.push_back(chunk);
+
+	upload.scatter = runs >= DeltaScatterMinRuns && upload.count < runs * DeltaScatterMaxAverageRunLength;
+	if (!upload.scatter)
+		return;
+
+	upload.indices = request_staging_memory(upload.count * sizeof(uint32_t));
+	if (data)
+		upload.payload = request_staging_memory(upload.count * element_size);
 
-		count++;
+	if (!upload.indices.host || (data && !upload.payload.host))
+	{
+		LOGW("Failed to allocate staging for scatter upload, falling back to copies.\n");
+		upload.scatter = false;
 	}
+}
 
-	flush();
+void SceneTransformManager::pack_delta_upload(const DeltaUpload &upload, const DeltaUpload::Chunk &chunk)
+{
+	auto *indices = reinterpret_cast<uint32_t *>(upload.indices.host) + chunk.output_offset;
+	auto *dst = upload.payload.host ? upload.payload.host + chunk.output_offset * upload.element_size : nullptr;
+	auto *src = static_cast<const uint8_t *>(upload.data);
+
+	upload.updates->for_each_word(chunk.first_word, chunk.end_word, [&](uint32_t word_index, uint64_t bits) {
+		Util::for_each_bit64(bits, [&](uint32_t bit) {
+			uint32_t offset = word_index * 64 + bit;
+			*indices++ = offset;
+			if (src)
+			{
+				memcpy(dst, src + offset * upload.element_size, upload.element_size);
+				dst += upload.element_size;
+			}
+		});
+	});
 }
 
 MDICall SceneTransformManager::get_template_mdi_call_parameters(
@@ -840,48 +972,125 @@ void SceneTransformManager::update_task_buffer(Vulkan::CommandBuffer &cmd)
 	device->unmap_host_buffer(*task_buffer, Vulkan::MEMORY_ACCESS_WRITE_BIT);
 }
 
-void SceneTransformManager::update_scene_buffers()
+void SceneTransformManager::begin_scene_buffer_update(TaskGroup *pack_group)
 {
 	if (!scene)
 		return;
 
-	auto cmd = acquire_internal(*device, VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
-	                            VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+	// Only CPU work happens here. Command buffers belong to the pool of the thread which requested them,
+	// and the submit stage may run on a different worker, so all recording is left to end_scene_buffer_update().
+	prepare_delta_upload(transform_upload, scene->get_transform_updates(),
+	                     scene->get_transforms().get_cached_transforms(), sizeof(mat_affine));
+	prepare_delta_upload(aabb_upload, scene->get_aabb_updates(),
+	                     scene->get_aabbs().get_aabbs(), sizeof(AABB));
+	prepare_delta_upload(occlusion_upload, scene->get_occluder_state_updates(), nullptr, 0);
 
-	update_task_buffer(*cmd);
+	// Fragmented deltas are packed into staging in parallel.
+	for (auto *upload : { &transform_upload, &aabb_upload, &occlusion_upload })
+	{
+		if (!upload->scatter)
+			continue;
 
-	auto transform_span = scene->get_transform_update_span();
-	auto aabb_span = scene->get_aabb_update_span();
-	auto occlusion_span = scene->get_occluder_state_update_span();
+		for (auto &chunk : upload->chunks)
+		{
+			if (pack_group)
+				pack_group->enqueue_task([upload, &chunk]() { pack_delta_upload(*upload, chunk); });
+			else
+				pack_delta_upload(*upload, chunk);
+		}
+	}
+}
 
-	ensure_buffer(*cmd, transforms, VkDeviceSize(scene->get_transforms().get_count()) * sizeof(mat_affine), "transforms", true);
-	ensure_buffer(*cmd, prev_transforms, VkDeviceSize(scene->get_transforms().get_count()) * sizeof(mat_affine), "prev-transforms", true);
-	ensure_buffer(*cmd, aabbs, VkDeviceSize(scene->get_aabbs().get_count()) * sizeof(AABB), "aabbs", true);
+void SceneTransformManager::end_scene_buffer_update()
+{
+	if (!scene)
+		return;
+
+	auto cmd_handle = acquire_internal(*device, VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT |
+	                                            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	                                   VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT |
+	                                   VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+	auto &cmd = *cmd_handle;
+
+	update_task_buffer(cmd);
+
+	ensure_buffer(cmd, transforms, VkDeviceSize(scene->get_transforms().get_count()) * sizeof(mat_affine), "transforms", true);
+	ensure_buffer(cmd, prev_transforms, VkDeviceSize(scene->get_transforms().get_count()) * sizeof(mat_affine), "prev-transforms", true);
+	ensure_buffer(cmd, aabbs, VkDeviceSize(scene->get_aabbs().get_count()) * sizeof(AABB), "aabbs", true);
 
 	for (auto &ctx : per_context_data)
-		ensure_buffer(*cmd, ctx.occlusions, VkDeviceSize(scene->get_occluder_states().get_count()) * sizeof(uint32_t), "occlusion-state", true);
+		ensure_buffer(cmd, ctx.occlusions, VkDeviceSize(scene->get_occluder_states().get_count()) * sizeof(uint32_t), "occlusion-state", true);
 
-	if (transform_span.count != 0)
+	if (transform_upload.count != 0 && !transform_upload.scatter)
 	{
 		// If there is motion this frame, copy over old transform.
 		// We don't need to remember to keep copying over prev transforms when there is no motion since we only
 		// need to render motion vectors for objects that moved *this* frame,
 		// and we consider prev_transforms only valid for nodes which require special motion vectors.
-		copy_span(*cmd, *prev_transforms, *transforms, transform_span, sizeof(mat_affine));
+		copy_span(cmd, *prev_transforms, *transforms, scene->get_transform_updates(), sizeof(mat_affine));
 		// Add a pure execution barrier to ensure we don't clobber transforms before we have copied over to prev_transforms.
-		cmd->barrier(VK_PIPELINE_STAGE_2_COPY_BIT, 0, VK_PIPELINE_STAGE_2_COPY_BIT, 0);
-		update_span(*cmd, *transforms, scene->get_transforms().get_cached_transforms(), transform_span);
+		cmd.barrier(VK_PIPELINE_STAGE_2_COPY_BIT, 0, VK_PIPELINE_STAGE_2_COPY_BIT, 0);
+		update_span(cmd, *transforms, scene->get_transforms().get_cached_transforms(), scene->get_transform_updates());
+	}
+
+	if (aabb_upload.count != 0 && !aabb_upload.scatter)
+		update_span(cmd, *aabbs, scene->get_aabbs().get_aabbs(), scene->get_aabb_updates());
+
+	if (occlusion_upload.count != 0 && !occlusion_upload.scatter)
+		for (auto &ctx : per_context_data)
+			update_span(cmd, *ctx.occlusions, static_cast<const uint32_t *>(nullptr), scene->get_occluder_state_updates());
+
+	if (transform_upload.scatter || aabb_upload.scatter || occlusion_upload.scatter)
+	{
+		// Buffer resizes and plain copies above may touch the same buffers.
+		cmd.barrier(VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		            VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+	}
+
+	if (transform_upload.scatter)
+	{
+		constexpr uint32_t words = sizeof(mat_affine) / sizeof(uint32_t);
+		dispatch_scatter(cmd, ScatterMode::Copy, *prev_transforms, transform_upload.indices, transform_upload.count,
+		                 transforms.get(), 0, transforms->get_create_info().size, words);
+		// Same as the copy path, don't clobber transforms before prev_transforms has been read.
+		cmd.barrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0);
+		dispatch_scatter(cmd, ScatterMode::Payload, *transforms, transform_upload.indices, transform_upload.count,
+		                 transform_upload.payload.buffer.get(), transform_upload.payload.offset,
+		                 transform_upload.count * sizeof(mat_affine), words);
 	}
 
-	if (aabb_span.count != 0)
-		update_span(*cmd, *aabbs, scene->get_aabbs().get_aabbs(), aabb_span);
+	if (aabb_upload.scatter)
+	{
+		dispatch_scatter(cmd, ScatterMode::Payload, *aabbs, aabb_upload.indices, aabb_upload.count,
+		                 aabb_upload.payload.buffer.get(), aabb_upload.payload.offset,
+		                 aabb_upload.count * sizeof(AABB), sizeof(AABB) / sizeof(uint32_t));
+	}
 
-	if (occlusion_span.count != 0)
+	if (occlusion_upload.scatter)
+	{
 		for (auto &ctx : per_context_data)
-			update_span(*cmd, *ctx.occlusions, static_cast<const uint32_t *>(nullptr), occlusion_span);
+		{
+			dispatch_scatter(cmd, ScatterMode::Clear, *ctx.occlusions, occlusion_upload.indices,
+			                 occlusion_upload.count, nullptr, 0, 0, 1);
+		}
+	}
+
+	// Hands the staging block back to the current frame context, which keeps it alive until the GPU is done.
+	if (staging_block.is_mapped())
+		device->request_staging_block(staging_block, 0);
+
+	release_internal(cmd_handle, VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT |
+	                             VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	                 VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
 
-	release_internal(cmd, VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
-	                 VK_ACCESS_TRANSFER_WRITE_BIT);
+	for (auto *upload : { &transform_upload, &aabb_upload, &occlusion_upload })
+	{
+		upload->indices = {};
+		upload->payload = {};
+		upload->scatter = false;
+		upload->count = 0;
+	}
 
 	scene->clear_updates();
 }
@@ -52,6 +52,9 @@ enum SceneRendererFlagBits : uint32_t
 	SCENE_RENDERER_SKIP_UNBOUNDED_BIT = 1 << 16,
 	SCENE_RENDERER_SKIP_OPAQUE_FLOATING_BIT = 1 << 17,
 	SCENE_RENDERER_MOTION_VECTOR_FULL_BIT = 1 << 18, // Reconstruct MVs even for static objects.
+	// Large queues are recorded into secondary command buffers in parallel.
+	// Only takes effect for passes which flush a single queue, i.e. depth, Z-prepass, forward opaque or G-buffer.
+	SCENE_RENDERER_SECONDARY_COMMAND_BUFFER_BIT = 1 << 19
 };
 using SceneRendererFlags = uint32_t;
 
@@ -75,6 +78,9 @@ public:
 	void build_render_pass(Vulkan::CommandBuffer &cmd, unsigned layer) const;
 	void build_render_pass(Vulkan::CommandBuffer &cmd) override;
 	void build_render_pass_separate_layer(Vulkan::CommandBuffer &cmd, unsigned layer) override;
+	unsigned get_num_secondary_command_buffers(unsigned layer) const override;
+	void build_render_pass_secondary(Vulkan::CommandBuffer &cmd, unsigned layer,
+	                                 unsigned index, unsigned num_indices) override;
 	bool get_clear_color(unsigned attachment, VkClearColorValue *value) const override;
 	void enqueue_prepare_render_pass(RenderGraph &graph, TaskComposer &composer) override;
 
@@ -97,7 +103,12 @@ protected:
 	RenderQueue queue_per_task_transparent[MaxTasks];
 	mutable RenderQueue queue_non_tasked;
 
-	void build_render_pass_inner(Vulkan::CommandBuffer &cmd, unsigned layer) const;
+	// Auto-sizing for secondary command buffers.
+	enum { MaxSecondaryCommandBuffers = 8, MinDrawsPerSecondaryCommandBuffer = 2048 };
+	const RenderQueue *get_secondary_command_buffer_queue(unsigned layer) const;
+
+	void build_render_pass_inner(Vulkan::CommandBuffer &cmd, unsigned layer,
+	                             unsigned index = 0, unsigned num_indices = 1) const;
 	void setup_debug_probes();
 	void render_debug_probes(const Renderer &renderer, Vulkan::CommandBuffer &cmd, RenderQueue &queue,
 	                         const RenderContext &context) const;
@@ -162,7 +173,53 @@ private:
 	void on_device_created(const Vulkan::DeviceCreatedEvent &event);
 	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &event);
 
-	void update_scene_buffers();
+	// Delta uploads are split in two stages. The first records the plain copies and packs
+	// fragmented updates into staging memory, possibly spread across the pack group.
+	// The second records the scatter dispatches and submits.
+	void begin_scene_buffer_update(TaskGroup *pack_group);
+	void end_scene_buffer_update();
+
+	struct DeltaUpload
+	{
+		// Range of bitmap words to pack, and where in staging the first element goes.
+		struct Chunk
+		{
+			uint32_t first_word;
+			uint32_t end_word;
+			size_t output_offset;
+		};
+
+		const Util::AtomicBitmap *updates = nullptr;
+		const void *data = nullptr;
+		size_t element_size = 0;
+		size_t count = 0;
+		std::vector<Chunk> chunks;
+		Vulkan::BufferBlockAllocation indices = {};
+		Vulkan::BufferBlockAllocation payload = {};
+		bool scatter = false;
+	};
+
+	enum
+	{
+		// When a delta has at least this many runs and the runs are short on average,
+		// a single scatter dispatch beats recording one copy per run.
+		DeltaScatterMinRuns = 32,
+		DeltaScatterMaxAverageRunLength = 8,
+		DeltaPackChunkSize = 4096
+	};
+
+	void prepare_delta_upload(DeltaUpload &upload, const Util::AtomicBitmap &updates,
+	                          const void *data, size_t element_size);
+	static void pack_delta_upload(const DeltaUpload &upload, const DeltaUpload::Chunk &chunk);
+
+	// Staging for packed deltas. It is filled before the update command buffer exists,
+	// so it is requested from the device directly rather than through CommandBuffer.
+	Vulkan::BufferBlock staging_block;
+	Vulkan::BufferBlockAllocation request_staging_memory(VkDeviceSize size);
+
+	DeltaUpload transform_upload;
+	DeltaUpload aabb_upload;
+	DeltaUpload occlusion_upload;
 
 	Vulkan::Device *device = nullptr;
 	Vulkan::BufferHandle transforms;
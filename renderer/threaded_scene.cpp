@@ -217,5 +217,22 @@ void scene_update_cached_transforms(Scene &scene, TaskComposer &composer, unsign
 		scene.update_transform_listener_components();
 	});
 }
+
+void scene_update_culling_hierarchy(Scene &scene, TaskComposer &composer)
+{
+	if (!scene.get_culling_hierarchy_enabled())
+		return;
+
+	// Each renderable group has its own hierarchy, so they can be updated in parallel.
+	constexpr unsigned NumTasks = 4;
+	auto &group = composer.begin_pipeline_stage();
+	group.set_desc("parallel-update-culling-hierarchy");
+	for (unsigned i = 0; i < NumTasks; i++)
+	{
+		group.enqueue_task([&scene, i]() {
+			scene.update_culling_hierarchy_subset(i, NumTasks);
+		});
+	}
+}
 }
 }
@@ -59,5 +59,6 @@ void compose_parallel_push_renderables(TaskComposer &composer, const RenderConte
                                        PushType type, bool layered);
 
 void scene_update_cached_transforms(Scene &scene, TaskComposer &composer, unsigned num_tasks);
+void scene_update_culling_hierarchy(Scene &scene, TaskComposer &composer);
 }
 }
\ No newline at end of file
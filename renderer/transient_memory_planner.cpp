@@ -0,0 +1,174 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "transient_memory_planner.hpp"
+#include <algorithm>
+#include <assert.h>
+
+namespace Granite
+{
+static uint64_t align_offset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+void TransientMemoryPlanner::set_max_block_size(uint64_t size)
+{
+	max_block_size = size;
+}
+
+unsigned TransientMemoryPlanner::add_resource(const TransientResourceRequest &request)
+{
+	assert(request.first_pass <= request.last_pass);
+	assert(request.alignment && (request.alignment & (request.alignment - 1)) == 0);
+	requests.push_back(request);
+	return unsigned(requests.size() - 1);
+}
+
+void TransientMemoryPlanner::reset()
+{
+	requests.clear();
+}
+
+bool TransientMemoryPlanner::lifetimes_overlap(const TransientResourceRequest &a, const TransientResourceRequest &b)
+{
+	return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+}
+
+TransientMemoryPlan TransientMemoryPlanner::plan() const
+{
+	TransientMemoryPlan result;
+	result.placements.resize(requests.size());
+
+	std::vector<unsigned> order(requests.size());
+	for (unsigned i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	// Largest first, since large resources are the hardest to fit into gaps later.
+	std::sort(order.begin(), order.end(), [this](unsigned a, unsigned b) {
+		if (requests[a].size != requests[b].size)
+			return requests[a].size > requests[b].size;
+		if (requests[a].first_pass != requests[b].first_pass)
+			return requests[a].first_pass < requests[b].first_pass;
+		return a < b;
+	});
+
+	std::vector<std::vector<unsigned>> block_resources;
+	std::vector<unsigned> conflicts;
+
+	for (unsigned index : order)
+	{
+		auto &request = requests[index];
+		unsigned best_block = unsigned(result.block_sizes.size());
+		uint64_t best_offset = 0;
+		uint64_t best_growth = UINT64_MAX;
+
+		for (unsigned block = 0; block < result.block_sizes.size(); block++)
+		{
+			if (result.block_groups[block] != request.group)
+				continue;
+
+			conflicts.clear();
+			for (unsigned other : block_resources[block])
+				if (lifetimes_overlap(request, requests[other]))
+					conflicts.push_back(other);
+
+			std::sort(conflicts.begin(), conflicts.end(), [&result](unsigned a, unsigned b) {
+				return result.placements[a].offset < result.placements[b].offset;
+			});
+
+			// Lowest aligned offset which fits in a gap between live resources.
+			// Conflicting resources may overlap each other in memory, so track the furthest end seen so far.
+			uint64_t candidate = 0;
+			for (unsigned other : conflicts)
+			{
+				uint64_t aligned = align_offset(candidate, request.alignment);
+				if (aligned + request.size <= result.placements[other].offset)
+					break;
+				candidate = std::max(candidate, result.placements[other].offset + requests[other].size);
+			}
+
+			uint64_t offset = align_offset(candidate, request.alignment);
+			uint64_t end = offset + request.size;
+			uint64_t block_size = result.block_sizes[block];
+			if (end > block_size && end > max_block_size)
+				continue;
+
+			uint64_t growth = end > block_size ? end - block_size : 0;
+			if (growth < best_growth)
+			{
+				best_block = block;
+				best_offset = offset;
+				best_growth = growth;
+				if (growth == 0)
+					break;
+			}
+		}
+
+		if (best_block == result.block_sizes.size())
+		{
+			result.block_sizes.push_back(0);
+			result.block_groups.push_back(request.group);
+			block_resources.emplace_back();
+		}
+
+		result.placements[index] = { best_block, best_offset };
+		block_resources[best_block].push_back(index);
+		result.block_sizes[best_block] = std::max(result.block_sizes[best_block], best_offset + request.size);
+	}
+
+	for (auto &size : result.block_sizes)
+		result.total_size += size;
+	for (auto &request : requests)
+		result.unaliased_size += request.size;
+
+	// Sweep over lifetime boundaries to find the largest live set.
+	struct Event
+	{
+		uint64_t pass;
+		int64_t delta;
+	};
+	std::vector<Event> events;
+	events.reserve(requests.size() * 2);
+	for (auto &request : requests)
+	{
+		events.push_back({ request.first_pass, int64_t(request.size) });
+		events.push_back({ uint64_t(request.last_pass) + 1, -int64_t(request.size) });
+	}
+
+	// Resources which die at a pass are released before the ones that start in it are added.
+	std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) {
+		if (a.pass != b.pass)
+			return a.pass < b.pass;
+		return a.delta < b.delta;
+	});
+
+	int64_t live = 0;
+	for (auto &event : events)
+	{
+		live += event.delta;
+		result.peak_live_size = std::max(result.peak_live_size, uint64_t(live));
+	}
+
+	return result;
+}
+}
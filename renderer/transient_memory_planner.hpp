@@ -0,0 +1,84 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace Granite
+{
+struct TransientResourceRequest
+{
+	uint64_t size = 0;
+	// Must be a power of two.
+	uint64_t alignment = 1;
+	// Inclusive range of passes in which the resource must hold its contents.
+	unsigned first_pass = 0;
+	unsigned last_pass = 0;
+	// Only resources with the same group may share a memory block, e.g. same queue and memory type.
+	uint32_t group = 0;
+};
+
+struct TransientResourcePlacement
+{
+	unsigned block = 0;
+	uint64_t offset = 0;
+};
+
+struct TransientMemoryPlan
+{
+	// Indexed in the same order as the requests.
+	std::vector<TransientResourcePlacement> placements;
+	std::vector<uint64_t> block_sizes;
+	std::vector<uint32_t> block_groups;
+
+	// Sum of all block sizes, i.e. the planned footprint.
+	uint64_t total_size = 0;
+	// Footprint if every resource got its own allocation.
+	uint64_t unaliased_size = 0;
+	// Largest number of bytes alive in any single pass, a lower bound for total_size.
+	uint64_t peak_live_size = 0;
+};
+
+// Packs resources with known lifetimes into shared memory blocks.
+// Resources are placed largest first, each at the aligned offset which grows its block the least
+// without overlapping any resource in the block whose lifetime intersects its own.
+// Planning only looks at sizes and pass indices, so it can be run on synthetic graphs without a device.
+class TransientMemoryPlanner
+{
+public:
+	// Blocks are never planned larger than this unless a single resource requires it.
+	void set_max_block_size(uint64_t size);
+
+	unsigned add_resource(const TransientResourceRequest &request);
+	void reset();
+
+	TransientMemoryPlan plan() const;
+
+	static bool lifetimes_overlap(const TransientResourceRequest &a, const TransientResourceRequest &b);
+
+private:
+	std::vector<TransientResourceRequest> requests;
+	uint64_t max_block_size = UINT64_MAX;
+};
+}
@@ -0,0 +1,605 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "image_metrics.hpp"
+#include "thread_group.hpp"
+#include "simd_batch.hpp"
+#include "muglm/muglm_impl.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <vector>
+#include <string.h>
+#include <math.h>
+
+namespace Granite
+{
+using namespace SIMD::Batch;
+
+static constexpr int SSIMRadius = 5;
+static constexpr float SSIMSigma = 1.5f;
+static constexpr float SSIMC1 = 0.01f * 0.01f;
+static constexpr float SSIMC2 = 0.03f * 0.03f;
+static constexpr unsigned SSIMTileWidth = 256;
+
+static bool format_is_supported(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static unsigned align_width(unsigned count)
+{
+	return (count + Width - 1) & ~unsigned(Width - 1);
+}
+
+struct MetricsContext
+{
+	const Vulkan::TextureFormatLayout *a;
+	const Vulkan::TextureFormatLayout *b;
+	ImageMetricFlags flags;
+	float *error_map;
+
+	unsigned width;
+	unsigned height;
+	// Rows are stored planar with a replicated halo on both sides,
+	// and every row is padded to a multiple of the SIMD width.
+	unsigned halo;
+	unsigned padded_width;
+	unsigned stride;
+
+	float weights[2 * SSIMRadius + 1];
+	// 1.0 for texels inside the image, 0.0 for padding, so padding never contributes to sums.
+	std::vector<float> valid;
+};
+
+struct StripResult
+{
+	double error[4] = {};
+	double ssim = 0.0;
+	double flip = 0.0;
+};
+
+static double reduce(Float v)
+{
+	float lanes[Width];
+	store(lanes, v);
+	double sum = 0.0;
+	for (auto &lane : lanes)
+		sum += lane;
+	return sum;
+}
+
+static inline Float min_lanes(Float a, Float b)
+{
+	return select(cmp_lt(a, b), a, b);
+}
+
+static inline Float abs_lanes(Float a)
+{
+	return max(a, sub(splat(0.0f), a));
+}
+
+static void load_row(const MetricsContext &ctx, const Vulkan::TextureFormatLayout &layout,
+                     unsigned y, float *const *planes)
+{
+	unsigned halo = ctx.halo;
+	unsigned width = ctx.width;
+
+	switch (layout.get_format())
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	{
+		auto *src = layout.data_2d<const uint8_t>(0, y);
+		float *r = planes[0] + halo;
+		float *g = planes[1] + halo;
+		float *b = planes[2] + halo;
+		float *a = planes[3] + halo;
+		for (unsigned x = 0; x < width; x++, src += 4)
+		{
+			r[x] = float(src[0]) * (1.0f / 255.0f);
+			g[x] = float(src[1]) * (1.0f / 255.0f);
+			b[x] = float(src[2]) * (1.0f / 255.0f);
+			a[x] = float(src[3]) * (1.0f / 255.0f);
+		}
+		break;
+	}
+
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	{
+		auto *src = layout.data_2d<const uint16_t>(0, y);
+		for (unsigned x = 0; x < width; x++, src += 4)
+			for (unsigned c = 0; c < 4; c++)
+				planes[c][halo + x] = muglm::halfToFloat(src[c]);
+		break;
+	}
+
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+	{
+		auto *src = layout.data_2d<const float>(0, y);
+		for (unsigned x = 0; x < width; x++, src += 4)
+			for (unsigned c = 0; c < 4; c++)
+				planes[c][halo + x] = src[c];
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	for (unsigned c = 0; c < 4; c++)
+	{
+		float *plane = planes[c];
+		std::fill(plane, plane + halo, plane[halo]);
+		std::fill(plane + halo + width, plane + ctx.stride, plane[halo + width - 1]);
+	}
+}
+
+// Converts one row to interleaved floats. The tail of dst is left untouched.
+static void load_row_interleaved(const MetricsContext &ctx, const Vulkan::TextureFormatLayout &layout,
+                                 unsigned y, float *dst)
+{
+	unsigned count = 4 * ctx.width;
+
+	switch (layout.get_format())
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	{
+		auto *src = layout.data_2d<const uint8_t>(0, y);
+		for (unsigned i = 0; i < count; i++)
+			dst[i] = float(src[i]) * (1.0f / 255.0f);
+		break;
+	}
+
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	{
+		auto *src = layout.data_2d<const uint16_t>(0, y);
+		for (unsigned i = 0; i < count; i++)
+			dst[i] = muglm::halfToFloat(src[i]);
+		break;
+	}
+
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		memcpy(dst, layout.data_2d<const float>(0, y), count * sizeof(float));
+		break;
+
+	default:
+		break;
+	}
+}
+
+// PSNR alone only needs per-channel sums, so it skips the planar conversion.
+// Lane i of the interleaved row always holds channel i % 4.
+static void compute_strip_psnr(const MetricsContext &ctx, unsigned y0, unsigned y1, StripResult &result)
+{
+	constexpr unsigned BatchesPerStep = Width < 4 ? 4 / Width : 1;
+	constexpr unsigned Step = BatchesPerStep * Width;
+
+	// Padding is zero in both rows and never contributes.
+	unsigned count = (4 * ctx.width + Step - 1) & ~(Step - 1);
+	std::vector<float> row_a(count), row_b(count);
+
+	for (unsigned y = y0; y < y1; y++)
+	{
+		load_row_interleaved(ctx, *ctx.a, y, row_a.data());
+		load_row_interleaved(ctx, *ctx.b, y, row_b.data());
+
+		Float acc[BatchesPerStep];
+		for (auto &a : acc)
+			a = splat(0.0f);
+
+		for (unsigned i = 0; i < count; i += Step)
+		{
+			for (unsigned j = 0; j < BatchesPerStep; j++)
+			{
+				Float diff = sub(load(row_a.data() + i + j * Width), load(row_b.data() + i + j * Width));
+				acc[j] = add(acc[j], mul(diff, diff));
+			}
+		}
+
+		for (unsigned j = 0; j < BatchesPerStep; j++)
+		{
+			float lanes[Width];
+			store(lanes, acc[j]);
+			for (unsigned lane = 0; lane < Width; lane++)
+				result.error[(j * Width + lane) & 3] += lanes[lane];
+		}
+	}
+}
+
+static void compute_luma(float *luma, const float *const *planes, unsigned count)
+{
+	const Float wr = splat(0.2126f);
+	const Float wg = splat(0.7152f);
+	const Float wb = splat(0.0722f);
+
+	for (unsigned x = 0; x < count; x += Width)
+	{
+		Float r = load(planes[0] + x);
+		Float g = load(planes[1] + x);
+		Float b = load(planes[2] + x);
+		store(luma + x, add(add(mul(r, wr), mul(g, wg)), mul(b, wb)));
+	}
+}
+
+static void accumulate_squared_error(const MetricsContext &ctx, const float *const *planes_a,
+                                     const float *const *planes_b, StripResult &result)
+{
+	for (unsigned c = 0; c < 4; c++)
+	{
+		const float *a = planes_a[c] + ctx.halo;
+		const float *b = planes_b[c] + ctx.halo;
+		Float acc = splat(0.0f);
+
+		for (unsigned x = 0; x < ctx.padded_width; x += Width)
+		{
+			Float diff = mul(sub(load(a + x), load(b + x)), load(ctx.valid.data() + x));
+			acc = add(acc, mul(diff, diff));
+		}
+
+		result.error[c] += reduce(acc);
+	}
+}
+
+// Opponent color difference, the chromatic term of the perceptual error.
+static void compute_color_error(const MetricsContext &ctx, float *color_error,
+                                const float *luma_a, const float *luma_b,
+                                const float *const *planes_a, const float *const *planes_b)
+{
+	const Float half = splat(0.5f);
+	const Float quarter = splat(0.25f);
+	const Float one = splat(1.0f);
+	unsigned halo = ctx.halo;
+
+	for (unsigned x = 0; x < ctx.padded_width; x += Width)
+	{
+		unsigned i = halo + x;
+		Float ra = load(planes_a[0] + i), ga = load(planes_a[1] + i), ba = load(planes_a[2] + i);
+		Float rb = load(planes_b[0] + i), gb = load(planes_b[1] + i), bb = load(planes_b[2] + i);
+
+		Float dy = sub(load(luma_a + i), load(luma_b + i));
+		Float dcx = sub(sub(ra, ga), sub(rb, gb));
+		Float dcz = sub(sub(mul(half, add(ra, ga)), ba), sub(mul(half, add(rb, gb)), bb));
+
+		Float chroma = mul(quarter, add(mul(dcx, dcx), mul(dcz, dcz)));
+		store(color_error + x, min_lanes(sqrt(add(mul(dy, dy), chroma)), one));
+	}
+}
+
+static void horizontal_blur(const MetricsContext &ctx, float *output, const float *input)
+{
+	Float w[2 * SSIMRadius + 1];
+	for (int i = 0; i <= 2 * SSIMRadius; i++)
+		w[i] = splat(ctx.weights[i]);
+
+	for (unsigned x = 0; x < ctx.padded_width; x += Width)
+	{
+		Float acc = mul(load(input + x), w[0]);
+		for (int i = 1; i <= 2 * SSIMRadius; i++)
+			acc = add(acc, mul(load(input + x + i), w[i]));
+		store(output + x, acc);
+	}
+}
+
+static inline Float vertical_blur(const Float *w, const float *input, unsigned stride, unsigned x)
+{
+	Float acc = mul(load(input + x), w[0]);
+	for (int i = 1; i <= 2 * SSIMRadius; i++)
+		acc = add(acc, mul(load(input + i * stride + x), w[i]));
+	return acc;
+}
+
+static Float sobel_magnitude(const float *up, const float *center, const float *down)
+{
+	const Float two = splat(2.0f);
+	Float gx = add(add(sub(load(up + 1), load(up - 1)),
+	                   mul(two, sub(load(center + 1), load(center - 1)))),
+	               sub(load(down + 1), load(down - 1)));
+	Float gy = add(add(sub(load(down - 1), load(up - 1)),
+	                   mul(two, sub(load(down), load(up)))),
+	               sub(load(down + 1), load(up + 1)));
+	return mul(sqrt(add(mul(gx, gx), mul(gy, gy))), splat(0.25f));
+}
+
+static void compute_strip(const MetricsContext &ctx, unsigned y0, unsigned y1, StripResult &result)
+{
+	bool psnr = (ctx.flags & IMAGE_METRIC_PSNR_BIT) != 0;
+	bool ssim = (ctx.flags & IMAGE_METRIC_SSIM_BIT) != 0;
+	bool flip = (ctx.flags & IMAGE_METRIC_FLIP_BIT) != 0;
+
+	if (!ssim && !flip)
+	{
+		if (psnr)
+			compute_strip_psnr(ctx, y0, y1, result);
+		return;
+	}
+
+	int halo = int(ctx.halo);
+	int first_row = int(y0) - halo;
+	int last_row = int(y1) + halo;
+	unsigned num_rows = unsigned(last_row - first_row);
+	unsigned stride = ctx.stride;
+	unsigned padded_width = ctx.padded_width;
+
+	std::vector<float> rgba(8 * stride);
+	std::vector<float> luma(2 * num_rows * stride);
+	std::vector<float> products(ssim ? 3 * stride : 0);
+	std::vector<float> blurred(ssim ? 5 * num_rows * padded_width : 0);
+	std::vector<float> color_error(flip ? (y1 - y0) * padded_width : 0);
+
+	float *planes_a[4], *planes_b[4];
+	for (unsigned c = 0; c < 4; c++)
+	{
+		planes_a[c] = rgba.data() + c * stride;
+		planes_b[c] = rgba.data() + (c + 4) * stride;
+	}
+
+	for (int row = first_row; row < last_row; row++)
+	{
+		unsigned local = unsigned(row - first_row);
+		unsigned y = unsigned(muglm::clamp(row, 0, int(ctx.height) - 1));
+		load_row(ctx, *ctx.a, y, planes_a);
+		load_row(ctx, *ctx.b, y, planes_b);
+
+		float *luma_a = luma.data() + local * stride;
+		float *luma_b = luma.data() + (num_rows + local) * stride;
+		compute_luma(luma_a, planes_a, stride);
+		compute_luma(luma_b, planes_b, stride);
+
+		bool inside = row >= int(y0) && row < int(y1);
+		if (inside && psnr)
+			accumulate_squared_error(ctx, planes_a, planes_b, result);
+		if (inside && flip)
+		{
+			compute_color_error(ctx, color_error.data() + (row - int(y0)) * padded_width,
+			                    luma_a, luma_b, planes_a, planes_b);
+		}
+
+		if (ssim)
+		{
+			float *aa = products.data();
+			float *bb = products.data() + stride;
+			float *ab = products.data() + 2 * stride;
+			for (unsigned x = 0; x < stride; x += Width)
+			{
+				Float la = load(luma_a + x);
+				Float lb = load(luma_b + x);
+				store(aa + x, mul(la, la));
+				store(bb + x, mul(lb, lb));
+				store(ab + x, mul(la, lb));
+			}
+
+			const float *inputs[5] = { luma_a, luma_b, aa, bb, ab };
+			for (unsigned q = 0; q < 5; q++)
+				horizontal_blur(ctx, blurred.data() + (q * num_rows + local) * padded_width, inputs[q]);
+		}
+	}
+
+	const float *valid = ctx.valid.data();
+
+	if (ssim)
+	{
+		const Float c1 = splat(SSIMC1);
+		const Float c2 = splat(SSIMC2);
+		const Float two = splat(2.0f);
+		Float acc = splat(0.0f);
+
+		Float w[2 * SSIMRadius + 1];
+		for (int i = 0; i <= 2 * SSIMRadius; i++)
+			w[i] = splat(ctx.weights[i]);
+
+		// Walk the strip in column tiles so the 11 rows of each blurred quantity stay in cache.
+		for (unsigned tile_x = 0; tile_x < padded_width; tile_x += SSIMTileWidth)
+		{
+			unsigned tile_end = std::min(tile_x + SSIMTileWidth, padded_width);
+
+			for (unsigned y = y0; y < y1; y++)
+			{
+				// Window for output row y starts SSIMRadius rows above it.
+				unsigned local = y - y0 + ctx.halo - SSIMRadius;
+				const float *rows[5];
+				for (unsigned q = 0; q < 5; q++)
+					rows[q] = blurred.data() + (q * num_rows + local) * padded_width;
+
+				for (unsigned x = tile_x; x < tile_end; x += Width)
+				{
+					Float mu_a = vertical_blur(w, rows[0], padded_width, x);
+					Float mu_b = vertical_blur(w, rows[1], padded_width, x);
+					Float mu_aa = mul(mu_a, mu_a);
+					Float mu_bb = mul(mu_b, mu_b);
+					Float mu_ab = mul(mu_a, mu_b);
+					Float var_a = sub(vertical_blur(w, rows[2], padded_width, x), mu_aa);
+					Float var_b = sub(vertical_blur(w, rows[3], padded_width, x), mu_bb);
+					Float cov = sub(vertical_blur(w, rows[4], padded_width, x), mu_ab);
+
+					Float num = mul(add(mul(two, mu_ab), c1), add(mul(two, cov), c2));
+					Float den = mul(add(add(mu_aa, mu_bb), c1), add(add(var_a, var_b), c2));
+					acc = add(acc, mul(div(num, den), load(valid + x)));
+				}
+
+				// Flush per row to keep float accumulation error bounded.
+				result.ssim += reduce(acc);
+				acc = splat(0.0f);
+			}
+		}
+	}
+
+	if (flip)
+	{
+		const Float one = splat(1.0f);
+		std::vector<float> error_row(ctx.error_map ? padded_width : 0);
+
+		for (unsigned y = y0; y < y1; y++)
+		{
+			unsigned local = y - y0 + ctx.halo;
+			const float *luma_a = luma.data() + local * stride + ctx.halo;
+			const float *luma_b = luma.data() + (num_rows + local) * stride + ctx.halo;
+			const float *color = color_error.data() + (y - y0) * padded_width;
+			Float acc = splat(0.0f);
+
+			for (unsigned x = 0; x < padded_width; x += Width)
+			{
+				Float grad_a = sobel_magnitude(luma_a + x - stride, luma_a + x, luma_a + x + stride);
+				Float grad_b = sobel_magnitude(luma_b + x - stride, luma_b + x, luma_b + x + stride);
+				Float edge = min_lanes(abs_lanes(sub(grad_a, grad_b)), one);
+				Float c = load(color + x);
+
+				// Union of the color and edge terms, stays within [0, 1].
+				Float error = sub(add(c, edge), mul(c, edge));
+				acc = add(acc, mul(error, load(valid + x)));
+				if (ctx.error_map)
+					store(error_row.data() + x, error);
+			}
+
+			result.flip += reduce(acc);
+			if (ctx.error_map)
+				memcpy(ctx.error_map + size_t(y) * ctx.width, error_row.data(), ctx.width * sizeof(float));
+		}
+	}
+}
+
+static double psnr_from_error(double error, double count)
+{
+	return 10.0 * log10(count / error);
+}
+
+bool compute_image_metrics(const Vulkan::TextureFormatLayout &a, const Vulkan::TextureFormatLayout &b,
+                           ImageMetricFlags flags, ImageMetrics &metrics,
+                           ThreadGroup *group, float *error_map)
+{
+	if (!format_is_supported(a.get_format()) || !format_is_supported(b.get_format()))
+	{
+		LOGE("Unsupported format.\n");
+		return false;
+	}
+
+	if (a.get_width() != b.get_width() || a.get_height() != b.get_height())
+	{
+		LOGE("Dimension mismatch.\n");
+		return false;
+	}
+
+	if (error_map && (flags & IMAGE_METRIC_FLIP_BIT) == 0)
+	{
+		LOGE("Error map requires IMAGE_METRIC_FLIP_BIT.\n");
+		return false;
+	}
+
+	MetricsContext ctx;
+	ctx.a = &a;
+	ctx.b = &b;
+	ctx.flags = flags;
+	ctx.error_map = error_map;
+	ctx.width = a.get_width();
+	ctx.height = a.get_height();
+
+	if (flags & IMAGE_METRIC_SSIM_BIT)
+		ctx.halo = SSIMRadius;
+	else if (flags & IMAGE_METRIC_FLIP_BIT)
+		ctx.halo = 1;
+	else
+		ctx.halo = 0;
+
+	ctx.padded_width = align_width(ctx.width);
+	ctx.stride = align_width(ctx.padded_width + 2 * ctx.halo);
+
+	ctx.valid.resize(ctx.padded_width);
+	for (unsigned x = 0; x < ctx.padded_width; x++)
+		ctx.valid[x] = x < ctx.width ? 1.0f : 0.0f;
+
+	float total_weight = 0.0f;
+	for (int i = -SSIMRadius; i <= SSIMRadius; i++)
+	{
+		float w = expf(-float(i * i) / (2.0f * SSIMSigma * SSIMSigma));
+		ctx.weights[i + SSIMRadius] = w;
+		total_weight += w;
+	}
+	for (auto &w : ctx.weights)
+		w /= total_weight;
+
+	// Keep strips large enough that the halo rows are amortized.
+	unsigned rows_per_strip = std::max(32u, (1u << 18) / ctx.width);
+	unsigned num_strips = (ctx.height + rows_per_strip - 1) / rows_per_strip;
+	std::vector<StripResult> results(num_strips);
+
+	if (group)
+	{
+		auto task = group->create_task();
+		for (unsigned i = 0; i < num_strips; i++)
+		{
+			task->enqueue_task([&ctx, &results, i, rows_per_strip]() {
+				unsigned y0 = i * rows_per_strip;
+				unsigned y1 = std::min(y0 + rows_per_strip, ctx.height);
+				compute_strip(ctx, y0, y1, results[i]);
+			});
+		}
+		task->flush();
+		task->wait();
+	}
+	else
+	{
+		for (unsigned i = 0; i < num_strips; i++)
+		{
+			unsigned y0 = i * rows_per_strip;
+			unsigned y1 = std::min(y0 + rows_per_strip, ctx.height);
+			compute_strip(ctx, y0, y1, results[i]);
+		}
+	}
+
+	// Reduce in strip order so the result does not depend on scheduling.
+	StripResult total;
+	for (auto &result : results)
+	{
+		for (unsigned c = 0; c < 4; c++)
+			total.error[c] += result.error[c];
+		total.ssim += result.ssim;
+		total.flip += result.flip;
+	}
+
+	double count = double(ctx.width) * double(ctx.height);
+	metrics = {};
+
+	if (flags & IMAGE_METRIC_PSNR_BIT)
+	{
+		for (unsigned c = 0; c < 4; c++)
+			metrics.psnr[c] = psnr_from_error(total.error[c], count);
+		metrics.psnr_rgb = psnr_from_error(total.error[0] + total.error[1] + total.error[2], 3.0 * count);
+	}
+
+	if (flags & IMAGE_METRIC_SSIM_BIT)
+		metrics.ssim = total.ssim / count;
+	if (flags & IMAGE_METRIC_FLIP_BIT)
+		metrics.flip = total.flip / count;
+
+	return true;
+}
+}
@@ -0,0 +1,60 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "texture_format.hpp"
+#include <stdint.h>
+
+namespace Granite
+{
+class ThreadGroup;
+
+enum ImageMetricFlagBits
+{
+	IMAGE_METRIC_PSNR_BIT = 1 << 0,
+	IMAGE_METRIC_SSIM_BIT = 1 << 1,
+	IMAGE_METRIC_FLIP_BIT = 1 << 2
+};
+using ImageMetricFlags = uint32_t;
+
+struct ImageMetrics
+{
+	// Per-channel PSNR in R, G, B, A order and combined over RGB.
+	// The peak is 1.0 for every format, i.e. 255 for UNORM8.
+	double psnr[4] = {};
+	double psnr_rgb = 0.0;
+	// Mean SSIM of luma, 11x11 Gaussian window with sigma 1.5.
+	double ssim = 0.0;
+	// Mean of the perceptual error map, in [0, 1].
+	double flip = 0.0;
+};
+
+// Compares layer 0, mip 0 of two 2D images with identical dimensions.
+// Supported formats are RGBA8 (UNORM or SRGB), RGBA16F and RGBA32F, and the formats may differ.
+// Work is split into strips of rows which are enqueued on group if one is provided.
+// If error_map is not null, it receives width * height floats of the perceptual error map,
+// which requires IMAGE_METRIC_FLIP_BIT.
+bool compute_image_metrics(const Vulkan::TextureFormatLayout &a, const Vulkan::TextureFormatLayout &b,
+                           ImageMetricFlags flags, ImageMetrics &metrics,
+                           ThreadGroup *group = nullptr, float *error_map = nullptr);
+}
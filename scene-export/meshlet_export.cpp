@@ -29,6 +29,8 @@
 #include "meshlet.hpp"
 #include <type_traits>
 #include <limits>
+#include <algorithm>
+#include <unordered_map>
 
 namespace Granite
 {
@@ -53,7 +55,10 @@ struct Encoded
 {
 	std::vector<PayloadWord> payload;
 	std::vector<Bound> bounds;
+	std::vector<LODBound> lod_bounds;
 	CombinedMesh mesh;
+	uint32_t base_meshlet_count;
+	uint32_t lod_level_count;
 };
 
 struct Meshlet
@@ -499,7 +504,7 @@ static void encode_attribute_stream(std::vector<PayloadWord> &out_payload_buffer
 	for (uint32_t i = 0; i < num_attributes; i++)
 		attributes[i] = raw_attributes[vbo_remap ? vbo_remap[i] : i];
 	for (uint32_t i = num_attributes; i < MaxElements; i++)
-		attributes[i] = attributes[0];
+		attributes[i] = num_attributes ? attributes[0] : T(UnsignedScalar(0));
 
 	T ulo{std::numeric_limits<UnsignedScalar>::max()};
 	T uhi{std::numeric_limits<UnsignedScalar>::min()};
@@ -682,12 +687,15 @@ static bool export_encoded_mesh(const std::string &path, const Encoded &encoded)
 	header.stream_count = encoded.mesh.stream_count;
 	header.meshlet_count = uint32_t(encoded.mesh.meshlets.size());
 	header.payload_size_words = uint32_t(encoded.payload.size());
+	header.base_meshlet_count = encoded.base_meshlet_count;
+	header.lod_level_count = encoded.lod_level_count;
 
 	required_size += sizeof(magic);
 	required_size += sizeof(FormatHeader);
 
 	// Bounds.
 	required_size += encoded.bounds.size() * sizeof(Bound);
+	required_size += encoded.lod_bounds.size() * sizeof(LODBound);
 
 	// Stream metadata.
 	required_size += encoded.mesh.stream_count * encoded.mesh.meshlets.size() * sizeof(Stream);
@@ -714,6 +722,9 @@ static bool export_encoded_mesh(const std::string &path, const Encoded &encoded)
 	memcpy(ptr, encoded.bounds.data(), encoded.bounds.size() * sizeof(Bound));
 	ptr += encoded.bounds.size() * sizeof(Bound);
 
+	memcpy(ptr, encoded.lod_bounds.data(), encoded.lod_bounds.size() * sizeof(LODBound));
+	ptr += encoded.lod_bounds.size() * sizeof(LODBound);
+
 	for (uint32_t i = 0; i < header.meshlet_count; i++)
 	{
 		for (uint32_t j = 0; j < header.stream_count; j++)
@@ -756,7 +767,7 @@ static size_t find_closest_sphere(const Bound *bounds, size_t num_bounds, const
 
 // FIXME: O(n^2). Revisit if this becomes a real problem.
 static void sort_bounds(Bound *bound, size_t num_bounds,
-                        Meshlet *meshlets, Metadata *metadata)
+                        Meshlet *meshlets, Metadata *metadata, LODBound *lod_bounds)
 {
 	for (size_t offset = 1; offset < num_bounds; offset++)
 	{
@@ -777,6 +788,7 @@ static void sort_bounds(Bound *bound, size_t num_bounds,
 			std::swap(bound[offset], bound[index]);
 			std::swap(meshlets[offset], meshlets[index]);
 			std::swap(metadata[offset], metadata[index]);
+			std::swap(lod_bounds[offset], lod_bounds[index]);
 		}
 	}
 }
@@ -830,7 +842,290 @@ static void encode_bounds(std::vector<Bound> &bounds,
 	LOGI("Average cutoff %.3f (%zu bounds)\n", total_cutoff, num_new_bounds);
 }
 
-bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, MeshStyle style)
+struct LODCluster
+{
+	std::vector<uint32_t> indices;
+	vec4 sphere;
+	vec4 parent_sphere;
+	float error;
+	float parent_error;
+	uint32_t level;
+};
+
+// Number of clusters which are merged and simplified together.
+// After simplifying to half the triangle count, this yields roughly 2 clusters per group.
+static constexpr unsigned LODGroupSize = 4;
+static constexpr unsigned MaxLODLevels = 16;
+// If simplification cannot remove at least this fraction of triangles, the group is considered stuck.
+static constexpr float LODMinReduction = 0.15f;
+
+static vec4 compute_cluster_sphere(const uint32_t *indices, size_t count, const std::vector<vec3> &positions)
+{
+	auto bound = meshopt_computeClusterBounds(indices, count, positions[0].data, positions.size(), sizeof(vec3));
+	return vec4(bound.center[0], bound.center[1], bound.center[2], bound.radius);
+}
+
+static vec4 merge_spheres(const vec4 *spheres, size_t count)
+{
+	vec4 merged = spheres[0];
+	for (size_t i = 1; i < count; i++)
+	{
+		vec3 delta = spheres[i].xyz() - merged.xyz();
+		float dist = length(delta);
+
+		if (dist + spheres[i].w <= merged.w)
+			continue;
+
+		if (dist + merged.w <= spheres[i].w)
+		{
+			merged = spheres[i];
+			continue;
+		}
+
+		float new_radius = 0.5f * (dist + merged.w + spheres[i].w);
+		vec3 new_center = merged.xyz() + delta * ((new_radius - merged.w) / dist);
+		merged = vec4(new_center, new_radius);
+	}
+
+	return merged;
+}
+
+static void build_lod_clusters(std::vector<LODCluster> &clusters,
+                               const uint32_t *indices, size_t count,
+                               const std::vector<vec3> &positions, uint32_t level)
+{
+	constexpr unsigned max_vertices = MaxElements;
+	constexpr unsigned max_primitives = MaxElements;
+	size_t num_meshlets = meshopt_buildMeshletsBound(count, max_vertices, max_primitives);
+
+	std::vector<unsigned> vertex_redirection_buffer(num_meshlets * max_vertices);
+	std::vector<unsigned char> local_index_buffer(num_meshlets * max_primitives * 3);
+	std::vector<meshopt_Meshlet> meshlets(num_meshlets);
+
+	num_meshlets = meshopt_buildMeshlets(meshlets.data(),
+	                                     vertex_redirection_buffer.data(), local_index_buffer.data(),
+	                                     indices, count,
+	                                     positions[0].data, positions.size(), sizeof(vec3),
+	                                     max_vertices, max_primitives, 0.5f);
+
+	for (size_t i = 0; i < num_meshlets; i++)
+	{
+		auto &meshlet = meshlets[i];
+		LODCluster cluster = {};
+		cluster.level = level;
+		cluster.error = 0.0f;
+		cluster.parent_error = std::numeric_limits<float>::max();
+
+		cluster.indices.reserve(meshlet.triangle_count * 3);
+		for (unsigned j = 0; j < meshlet.triangle_count * 3; j++)
+		{
+			cluster.indices.push_back(
+					vertex_redirection_buffer[meshlet.vertex_offset + local_index_buffer[meshlet.triangle_offset + j]]);
+		}
+
+		cluster.sphere = compute_cluster_sphere(cluster.indices.data(), cluster.indices.size(), positions);
+		cluster.parent_sphere = cluster.sphere;
+		clusters.push_back(std::move(cluster));
+	}
+}
+
+// Greedily grows groups from clusters which share the most vertices, which keeps locked group borders short.
+static std::vector<std::vector<uint32_t>> group_lod_clusters(const std::vector<LODCluster> &clusters,
+                                                             const std::vector<uint32_t> &pending,
+                                                             const std::vector<uint32_t> &position_remap)
+{
+	// Build a compact vertex -> pending cluster adjacency list.
+	std::vector<uint32_t> vertex_offsets(position_remap.size() + 1);
+	for (auto &c : pending)
+		for (auto &i : clusters[c].indices)
+			vertex_offsets[position_remap[i] + 1]++;
+	for (size_t i = 1; i < vertex_offsets.size(); i++)
+		vertex_offsets[i] += vertex_offsets[i - 1];
+
+	std::vector<uint32_t> vertex_clusters(vertex_offsets.back());
+	{
+		auto write_offsets = vertex_offsets;
+		for (uint32_t local_index = 0; local_index < pending.size(); local_index++)
+			for (auto &i : clusters[pending[local_index]].indices)
+				vertex_clusters[write_offsets[position_remap[i]]++] = local_index;
+	}
+
+	std::vector<std::vector<uint32_t>> groups;
+	std::vector<bool> assigned(pending.size());
+	std::vector<uint32_t> shared_count(pending.size());
+	std::vector<uint32_t> candidates;
+
+	for (uint32_t seed = 0; seed < pending.size(); seed++)
+	{
+		if (assigned[seed])
+			continue;
+
+		std::vector<uint32_t> group = { seed };
+		assigned[seed] = true;
+
+		while (group.size() < LODGroupSize)
+		{
+			for (auto &member : group)
+			{
+				for (auto &i : clusters[pending[member]].indices)
+				{
+					uint32_t v = position_remap[i];
+					for (uint32_t j = vertex_offsets[v]; j < vertex_offsets[v + 1]; j++)
+					{
+						uint32_t candidate = vertex_clusters[j];
+						if (!assigned[candidate] && shared_count[candidate]++ == 0)
+							candidates.push_back(candidate);
+					}
+				}
+			}
+
+			uint32_t best_candidate = UINT32_MAX;
+			uint32_t best_count = 0;
+			for (auto &candidate : candidates)
+			{
+				if (shared_count[candidate] > best_count)
+				{
+					best_candidate = candidate;
+					best_count = shared_count[candidate];
+				}
+				shared_count[candidate] = 0;
+			}
+			candidates.clear();
+
+			if (best_candidate == UINT32_MAX)
+				break;
+
+			assigned[best_candidate] = true;
+			group.push_back(best_candidate);
+		}
+
+		for (auto &member : group)
+			member = pending[member];
+		groups.push_back(std::move(group));
+	}
+
+	return groups;
+}
+
+// Simplifies the group in a compacted vertex space, so that cost does not scale with the full vertex count.
+static bool simplify_lod_group(std::vector<uint32_t> &simplified, float &error,
+                               const std::vector<uint32_t> &merged, const std::vector<vec3> &positions)
+{
+	std::vector<uint32_t> local_to_global;
+	std::vector<uint32_t> local_indices;
+	std::vector<vec3> local_positions;
+	std::unordered_map<uint32_t, uint32_t> global_to_local;
+
+	local_indices.reserve(merged.size());
+	for (auto &i : merged)
+	{
+		auto itr = global_to_local.find(i);
+		if (itr == global_to_local.end())
+		{
+			uint32_t local_index = uint32_t(local_to_global.size());
+			global_to_local[i] = local_index;
+			local_to_global.push_back(i);
+			local_positions.push_back(positions[i]);
+			local_indices.push_back(local_index);
+		}
+		else
+			local_indices.push_back(itr->second);
+	}
+
+	// Group borders must remain intact, otherwise we get cracks against neighbor groups.
+	size_t target_index_count = (merged.size() / 6) * 3;
+	std::vector<uint32_t> local_simplified(merged.size());
+	float relative_error = 0.0f;
+	size_t count = meshopt_simplify(local_simplified.data(), local_indices.data(), local_indices.size(),
+	                                local_positions[0].data, local_positions.size(), sizeof(vec3),
+	                                target_index_count, std::numeric_limits<float>::max(),
+	                                meshopt_SimplifyLockBorder, &relative_error);
+
+	if (count == 0 || float(count) > float(merged.size()) * (1.0f - LODMinReduction))
+		return false;
+
+	error = relative_error * meshopt_simplifyScale(local_positions[0].data, local_positions.size(), sizeof(vec3));
+
+	simplified.clear();
+	simplified.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		simplified.push_back(local_to_global[local_simplified[i]]);
+
+	return true;
+}
+
+static uint32_t build_lod_hierarchy(std::vector<LODCluster> &clusters, const std::vector<vec3> &positions)
+{
+	std::vector<uint32_t> position_remap(positions.size());
+	meshopt_generateVertexRemap(position_remap.data(), nullptr, positions.size(),
+	                            positions[0].data, positions.size(), sizeof(vec3));
+
+	std::vector<uint32_t> pending(clusters.size());
+	for (uint32_t i = 0; i < pending.size(); i++)
+		pending[i] = i;
+
+	uint32_t level_count = 1;
+	std::vector<uint32_t> merged;
+	std::vector<uint32_t> simplified;
+	std::vector<vec4> group_spheres;
+
+	while (pending.size() > 1 && level_count < MaxLODLevels)
+	{
+		auto groups = group_lod_clusters(clusters, pending, position_remap);
+		std::vector<uint32_t> next_pending;
+
+		for (auto &group : groups)
+		{
+			merged.clear();
+			group_spheres.clear();
+			float group_error = 0.0f;
+			for (auto &c : group)
+			{
+				merged.insert(merged.end(), clusters[c].indices.begin(), clusters[c].indices.end());
+				group_spheres.push_back(clusters[c].sphere);
+				group_error = std::max(group_error, clusters[c].error);
+			}
+
+			float simplify_error = 0.0f;
+			if (!simplify_lod_group(simplified, simplify_error, merged, positions))
+				continue;
+
+			// Error must be monotonic through the hierarchy, or the selected cut will have holes or overlaps.
+			group_error = std::max(group_error, simplify_error);
+			vec4 group_sphere = merge_spheres(group_spheres.data(), group_spheres.size());
+
+			for (auto &c : group)
+			{
+				clusters[c].parent_sphere = group_sphere;
+				clusters[c].parent_error = group_error;
+			}
+
+			size_t first_cluster = clusters.size();
+			build_lod_clusters(clusters, simplified.data(), simplified.size(), positions, level_count);
+
+			for (size_t i = first_cluster; i < clusters.size(); i++)
+			{
+				clusters[i].sphere = group_sphere;
+				clusters[i].error = group_error;
+				clusters[i].parent_sphere = group_sphere;
+				next_pending.push_back(uint32_t(i));
+			}
+		}
+
+		if (next_pending.empty())
+			break;
+
+		LOGI("LOD level %u: %zu clusters -> %zu groups -> %zu clusters.\n",
+		     level_count, pending.size(), groups.size(), next_pending.size());
+
+		pending = std::move(next_pending);
+		level_count++;
+	}
+
+	return level_count;
+}
+
+bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, MeshStyle style, ExportFlags flags)
 {
 	mesh_deduplicate_vertices(mesh);
 	if (!mesh_optimize_index_buffer(mesh, {}))
@@ -899,68 +1194,143 @@ bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, Me
 	for (auto &p : positions)
 		position_buffer.push_back(decode_snorm_exp(p, aux[int(StreamType::Position)]));
 
-	constexpr unsigned max_vertices = MaxElements;
-	constexpr unsigned max_primitives = MaxElements;
-	size_t num_meshlets = meshopt_buildMeshletsBound(mesh.count, max_vertices, max_primitives);
+	std::vector<LODCluster> clusters;
+	build_lod_clusters(clusters, reinterpret_cast<const uint32_t *>(mesh.indices.data()), mesh.count,
+	                   position_buffer, 0);
 
-	std::vector<unsigned> out_vertex_redirection_buffer(num_meshlets * max_vertices);
-	std::vector<unsigned char> local_index_buffer(num_meshlets * max_primitives * 3);
-	std::vector<meshopt_Meshlet> meshlets(num_meshlets);
-
-	num_meshlets = meshopt_buildMeshlets(meshlets.data(),
-	                                     out_vertex_redirection_buffer.data(), local_index_buffer.data(),
-	                                     reinterpret_cast<const uint32_t *>(mesh.indices.data()), mesh.count,
-	                                     position_buffer[0].data, positions.size(), sizeof(vec3),
-	                                     max_vertices, max_primitives, 0.5f);
+	if (clusters.empty())
+	{
+		LOGE("No meshlets.\n");
+		return false;
+	}
 
-	meshlets.resize(num_meshlets);
+	uint32_t base_meshlet_count = uint32_t(clusters.size());
+	uint32_t lod_level_count = 1;
+	if ((flags & EXPORT_LOD_HIERARCHY_BIT) != 0)
+		lod_level_count = build_lod_hierarchy(clusters, position_buffer);
+
+	// Lay out clusters level by level. Each level starts on a new 256 chunk, so runtime can consider chunks
+	// from different levels in isolation. Padding meshlets are empty and can never be selected.
+	std::vector<uint32_t> cluster_order;
+	std::vector<uint32_t> level_offsets;
+	cluster_order.reserve(clusters.size());
+	for (uint32_t level = 0; level < lod_level_count; level++)
+	{
+		if (level != 0)
+			while (cluster_order.size() & (ChunkFactor - 1))
+				cluster_order.push_back(UINT32_MAX);
+
+		level_offsets.push_back(uint32_t(cluster_order.size()));
+		for (uint32_t i = 0; i < clusters.size(); i++)
+			if (clusters[i].level == level)
+				cluster_order.push_back(i);
+	}
+	level_offsets.push_back(uint32_t(cluster_order.size()));
 
+	std::vector<uint32_t> attribute_remap;
+	std::vector<unsigned char> local_index_buffer;
 	std::vector<Meshlet> out_meshlets;
 	std::vector<uvec3> out_index_buffer;
+	std::vector<LODBound> lod_bounds;
 
-	out_meshlets.reserve(num_meshlets);
+	out_meshlets.reserve(cluster_order.size());
+	lod_bounds.reserve(cluster_order.size());
 
-	for (auto &meshlet : meshlets)
+	for (uint32_t level = 0; level < lod_level_count; level++)
 	{
-		Meshlet m = {};
+		for (uint32_t i = level_offsets[level]; i < level_offsets[level + 1]; i++)
+		{
+			Meshlet m = {};
+			LODBound lod_bound = {};
+			lod_bound.level = level;
 
-		auto *local_indices = local_index_buffer.data() + meshlet.triangle_offset;
-		m.local_indices = local_indices;
-		m.attribute_remap = out_vertex_redirection_buffer.data() + meshlet.vertex_offset;
-		m.primitive_count = meshlet.triangle_count;
-		m.vertex_count = meshlet.vertex_count;
-		m.global_indices_offset = uint32_t(out_index_buffer.size());
+			if (cluster_order[i] == UINT32_MAX)
+			{
+				lod_bound.error = std::numeric_limits<float>::max();
+				lod_bound.parent_error = std::numeric_limits<float>::max();
+			}
+			else
+			{
+				auto &cluster = clusters[cluster_order[i]];
 
-		for (unsigned i = 0; i < meshlet.triangle_count; i++)
-		{
-			out_index_buffer.emplace_back(
-					out_vertex_redirection_buffer[local_indices[3 * i + 0] + meshlet.vertex_offset],
-					out_vertex_redirection_buffer[local_indices[3 * i + 1] + meshlet.vertex_offset],
-					out_vertex_redirection_buffer[local_indices[3 * i + 2] + meshlet.vertex_offset]);
+				// Temporarily store offsets. Resolve pointers once the buffers are complete.
+				m.local_indices = reinterpret_cast<const unsigned char *>(uintptr_t(local_index_buffer.size()));
+				m.attribute_remap = reinterpret_cast<const uint32_t *>(uintptr_t(attribute_remap.size()));
+				m.global_indices_offset = uint32_t(out_index_buffer.size());
+				m.primitive_count = uint32_t(cluster.indices.size() / 3);
+
+				size_t remap_offset = attribute_remap.size();
+				for (auto &index : cluster.indices)
+				{
+					auto itr = std::find(attribute_remap.begin() + remap_offset, attribute_remap.end(), index);
+					local_index_buffer.push_back(uint8_t(itr - (attribute_remap.begin() + remap_offset)));
+					if (itr == attribute_remap.end())
+						attribute_remap.push_back(index);
+				}
+
+				m.vertex_count = uint32_t(attribute_remap.size() - remap_offset);
+				assert(m.vertex_count <= MaxElements);
+
+				for (size_t j = 0; j < cluster.indices.size(); j += 3)
+				{
+					out_index_buffer.emplace_back(
+							cluster.indices[j + 0], cluster.indices[j + 1], cluster.indices[j + 2]);
+				}
+
+				memcpy(lod_bound.center, cluster.sphere.data, sizeof(lod_bound.center));
+				lod_bound.radius = cluster.sphere.w;
+				memcpy(lod_bound.parent_center, cluster.parent_sphere.data, sizeof(lod_bound.parent_center));
+				lod_bound.parent_radius = cluster.parent_sphere.w;
+				lod_bound.error = cluster.error;
+				lod_bound.parent_error = cluster.parent_error;
+			}
+
+			out_meshlets.push_back(m);
+			lod_bounds.push_back(lod_bound);
 		}
+	}
 
-		out_meshlets.push_back(m);
+	for (auto &m : out_meshlets)
+	{
+		if (!m.primitive_count)
+			continue;
+		m.local_indices = local_index_buffer.data() + uintptr_t(m.local_indices);
+		m.attribute_remap = attribute_remap.data() + uintptr_t(m.attribute_remap);
 	}
 
 	Encoded encoded;
 	encode_mesh(encoded, out_meshlets.data(), out_meshlets.size(),
 	            p_data, aux, num_attribute_streams + 1);
 	encoded.mesh.mesh_style = style;
+	encoded.lod_bounds = std::move(lod_bounds);
+	encoded.base_meshlet_count = base_meshlet_count;
+	encoded.lod_level_count = lod_level_count;
 
 	// Compute bounds
 	encode_bounds(encoded.bounds, out_meshlets.data(), out_meshlets.size(),
 	              out_index_buffer.data(), position_buffer.data(), positions.size(),
 	              1);
 
-	sort_bounds(encoded.bounds.data(), encoded.bounds.size(),
-	            out_meshlets.data(), encoded.mesh.meshlets.data());
+	// Padding meshlets must remain at the end of their level.
+	for (uint32_t level = 0; level < lod_level_count; level++)
+	{
+		uint32_t offset = level_offsets[level];
+		uint32_t count = 0;
+		while (offset + count < level_offsets[level + 1] && out_meshlets[offset + count].primitive_count)
+			count++;
+
+		sort_bounds(encoded.bounds.data() + offset, count,
+		            out_meshlets.data() + offset, encoded.mesh.meshlets.data() + offset,
+		            encoded.lod_bounds.data() + offset);
+	}
 
 	encode_bounds(encoded.bounds, out_meshlets.data(), out_meshlets.size(),
 	              out_index_buffer.data(), position_buffer.data(), positions.size(),
 				  ChunkFactor);
 
 	LOGI("Exported meshlet:\n");
-	LOGI("  %zu meshlets\n", encoded.mesh.meshlets.size());
+	LOGI("  %u full detail meshlets\n", encoded.base_meshlet_count);
+	LOGI("  %zu meshlets in %u LOD levels\n", encoded.mesh.meshlets.size(), encoded.lod_level_count);
 	LOGI("  %zu payload bytes\n", encoded.payload.size() * sizeof(PayloadWord));
 	LOGI("  %u total indices\n", mesh.count);
 	LOGI("  %zu total attributes\n", mesh.positions.size() / mesh.position_stride);
@@ -31,6 +31,14 @@ namespace Granite
 {
 namespace Meshlet
 {
-bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, Vulkan::Meshlet::MeshStyle style);
+enum ExportFlagBits : uint32_t
+{
+	// Builds a cluster group simplification hierarchy on top of the full detail meshlets.
+	EXPORT_LOD_HIERARCHY_BIT = 1 << 0
+};
+using ExportFlags = uint32_t;
+
+bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, Vulkan::Meshlet::MeshStyle style,
+                            ExportFlags flags = 0);
 }
 }
@@ -25,9 +25,151 @@
 #include <algorithm>
 #include <iterator>
 #include <assert.h>
+#include "bitops.hpp"
+#include "simd_headers.hpp"
+
+#if defined(__SSE2__) || (defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define RGTC_SIMD 1
+#define RGTC_SIMD_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define RGTC_SIMD 1
+#define RGTC_SIMD_NEON 1
+#else
+#define RGTC_SIMD 0
+#endif
 
 namespace Granite
 {
+#if RGTC_SIMD_SSE
+using Lanes = __m128i;
+
+static inline Lanes lanes_set(int a, int b, int c, int d)
+{
+	return _mm_setr_epi32(a, b, c, d);
+}
+
+static inline Lanes lanes_splat(int v)
+{
+	return _mm_set1_epi32(v);
+}
+
+static inline void lanes_store(int32_t *dst, Lanes v)
+{
+	_mm_store_si128(reinterpret_cast<__m128i *>(dst), v);
+}
+
+static inline Lanes lanes_add(Lanes a, Lanes b)
+{
+	return _mm_add_epi32(a, b);
+}
+
+static inline Lanes lanes_sub(Lanes a, Lanes b)
+{
+	return _mm_sub_epi32(a, b);
+}
+
+static inline Lanes lanes_mul(Lanes a, Lanes b)
+{
+#ifdef __SSE4_1__
+	return _mm_mullo_epi32(a, b);
+#else
+	// Low 32 bits of the product are the same for signed and unsigned multiplies.
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static inline Lanes lanes_sra20(Lanes a)
+{
+	return _mm_srai_epi32(a, 20);
+}
+
+static inline Lanes lanes_less_than(Lanes a, Lanes b)
+{
+	return _mm_cmplt_epi32(a, b);
+}
+
+static inline Lanes lanes_select(Lanes mask, Lanes a, Lanes b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline Lanes lanes_min(Lanes a, Lanes b)
+{
+#ifdef __SSE4_1__
+	return _mm_min_epi32(a, b);
+#else
+	return lanes_select(_mm_cmplt_epi32(a, b), a, b);
+#endif
+}
+
+static inline Lanes lanes_or(Lanes a, Lanes b)
+{
+	return _mm_or_si128(a, b);
+}
+#elif RGTC_SIMD_NEON
+using Lanes = int32x4_t;
+
+static inline Lanes lanes_set(int a, int b, int c, int d)
+{
+	alignas(16) const int32_t v[4] = { a, b, c, d };
+	return vld1q_s32(v);
+}
+
+static inline Lanes lanes_splat(int v)
+{
+	return vdupq_n_s32(v);
+}
+
+static inline void lanes_store(int32_t *dst, Lanes v)
+{
+	vst1q_s32(dst, v);
+}
+
+static inline Lanes lanes_add(Lanes a, Lanes b)
+{
+	return vaddq_s32(a, b);
+}
+
+static inline Lanes lanes_sub(Lanes a, Lanes b)
+{
+	return vsubq_s32(a, b);
+}
+
+static inline Lanes lanes_mul(Lanes a, Lanes b)
+{
+	return vmulq_s32(a, b);
+}
+
+static inline Lanes lanes_sra20(Lanes a)
+{
+	return vshrq_n_s32(a, 20);
+}
+
+static inline Lanes lanes_less_than(Lanes a, Lanes b)
+{
+	return vreinterpretq_s32_u32(vcltq_s32(a, b));
+}
+
+static inline Lanes lanes_select(Lanes mask, Lanes a, Lanes b)
+{
+	return vbslq_s32(vreinterpretq_u32_s32(mask), a, b);
+}
+
+static inline Lanes lanes_min(Lanes a, Lanes b)
+{
+	return vminq_s32(a, b);
+}
+
+static inline Lanes lanes_or(Lanes a, Lanes b)
+{
+	return vorrq_s32(a, b);
+}
+#endif
+
 static const int range_threshold = 16;
 static const int div_7 = (0x100000) / 7;
 static const int div_5 = (0x100000) / 5;
@@ -164,7 +306,20 @@ void decompress_rgtc_red_block(uint8_t *output_r, const uint8_t *block)
 	}
 }
 
-void compress_rgtc_red_block(uint8_t *output_r, const uint8_t *input_r)
+struct RedBlockState
+{
+	uint64_t block;
+	uint8_t encode_0;
+	uint8_t encode_1;
+	int best_error;
+	int lo_index;
+	int hi_index;
+	bool use_5_weight;
+	int sorted_block[16];
+};
+
+// Computes the 7-weight encoding. Returns true if the 5-weight partition search may improve the result.
+static bool begin_rgtc_red_block(RedBlockState &state, const uint8_t *input_r)
 {
 	int block_lo = 255;
 	int block_hi = 0;
@@ -176,24 +331,25 @@ void compress_rgtc_red_block(uint8_t *output_r, const uint8_t *input_r)
 	}
 
 	uint64_t block = 0;
-	uint8_t encode_0 = 0;
-	uint8_t encode_1 = 0;
-
 	int range = block_hi - block_lo;
 
+	state.encode_0 = uint8_t(block_hi);
+	state.encode_1 = uint8_t(block_lo);
+	state.best_error = 0;
+	state.lo_index = 0;
+	state.hi_index = 15;
+	state.use_5_weight = false;
+
 	if (range == 0)
 	{
-		encode_0 = uint8_t(block_hi);
-		encode_1 = uint8_t(block_lo);
+		state.block = 0;
+		return false;
 	}
 	else if (range < range_threshold)
 	{
 		// Simple case, range is small enough that we can directly quantize and be done with it.
 		int divider = divider_lut.lut7(range);
 
-		encode_0 = uint8_t(block_hi);
-		encode_1 = uint8_t(block_lo);
-
 		for (int i = 0; i < 16; i++)
 		{
 			int code = ((input_r[i] - block_lo) * divider + 0x80000) >> 20;
@@ -208,17 +364,14 @@ void compress_rgtc_red_block(uint8_t *output_r, const uint8_t *input_r)
 
 			block |= uint64_t(code) << (3 * i);
 		}
+
+		state.block = block;
+		return false;
 	}
 	else
 	{
 		int divider = divider_lut.lut7(range);
-		encode_0 = uint8_t(block_hi);
-		encode_1 = uint8_t(block_lo);
-
 		int best_error = 0;
-		int lo_index = 0;
-		int hi_index = 15;
-		bool use_5_weight = false;
 
 		for (int i = 0; i < 16; i++)
 		{
@@ -239,105 +392,264 @@ void compress_rgtc_red_block(uint8_t *output_r, const uint8_t *input_r)
 			block |= uint64_t(code) << (3 * i);
 		}
 
-		int sorted_block[16];
+		state.block = block;
+		state.best_error = best_error;
+
 		for (int i = 0; i < 16; i++)
-			sorted_block[i] = input_r[i];
-		std::sort(std::begin(sorted_block), std::end(sorted_block));
+			state.sorted_block[i] = input_r[i];
+		std::sort(std::begin(state.sorted_block), std::end(state.sorted_block));
+		return true;
+	}
+}
 
-		for (int lo = 0; lo < 15; lo++)
+static void search_rgtc_red_partition(RedBlockState &state)
+{
+	const int *sorted_block = state.sorted_block;
+
+	for (int lo = 0; lo < 15; lo++)
+	{
+		for (int hi = lo; hi < 15; hi++)
 		{
-			for (int hi = lo; hi < 15; hi++)
+			int partition_lo = sorted_block[lo];
+			int partition_hi = sorted_block[hi];
+			assert(partition_hi >= partition_lo);
+			int partition_range = partition_hi - partition_lo;
+			int partition_divider = divider_lut.lut5(partition_range);
+
+			int error = 0;
+
+			// Consider that we can quantize to 0.0 as well.
+			for (int i = 0; i < lo; i++)
+			{
+				int diff = std::min(sorted_block[i] - 0, partition_lo - sorted_block[i]);
+				error += diff * diff;
+			}
+
+			for (int i = lo; i <= hi; i++)
 			{
-				int partition_lo = sorted_block[lo];
-				int partition_hi = sorted_block[hi];
-				assert(partition_hi >= partition_lo);
-				int partition_range = partition_hi - partition_lo;
-				int partition_divider = divider_lut.lut5(partition_range);
-
-				int error = 0;
-
-				// Consider that we can quantize to 0.0 as well.
-				for (int i = 0; i < lo; i++)
-				{
-					int diff = std::min(sorted_block[i] - 0, partition_lo - sorted_block[i]);
-					error += diff * diff;
-				}
-
-				for (int i = lo; i <= hi; i++)
-				{
-					int code = ((sorted_block[i] - partition_lo) * partition_divider + 0x80000) >> 20;
-					assert(code <= 7);
-					int interpolated_value = partition_lo + ((partition_range * code * div_5 + 0x80000) >> 20);
-					int diff = interpolated_value - sorted_block[i];
-					error += diff * diff;
-				}
-
-				// Consider that we can quantize to 1.0 as well.
-				for (int i = hi + 1; i <= 15; i++)
-				{
-					int diff = std::min(255 - sorted_block[i], sorted_block[i] - partition_hi);
-					error += diff * diff;
-				}
-
-				if (error < best_error)
-				{
-					lo_index = lo;
-					hi_index = hi;
-					best_error = error;
-					use_5_weight = true;
-				}
+				int code = ((sorted_block[i] - partition_lo) * partition_divider + 0x80000) >> 20;
+				assert(code <= 7);
+				int interpolated_value = partition_lo + ((partition_range * code * div_5 + 0x80000) >> 20);
+				int diff = interpolated_value - sorted_block[i];
+				error += diff * diff;
+			}
+
+			// Consider that we can quantize to 1.0 as well.
+			for (int i = hi + 1; i <= 15; i++)
+			{
+				int diff = std::min(255 - sorted_block[i], sorted_block[i] - partition_hi);
+				error += diff * diff;
+			}
+
+			if (error < state.best_error)
+			{
+				state.lo_index = lo;
+				state.hi_index = hi;
+				state.best_error = error;
+				state.use_5_weight = true;
 			}
 		}
+	}
+}
 
-		// Did we find a better partition?
-		if (use_5_weight)
-		{
-			int partition_lo = sorted_block[lo_index];
-			int partition_hi = sorted_block[hi_index];
-			encode_0 = uint8_t(partition_lo);
-			encode_1 = uint8_t(partition_hi);
+static void end_rgtc_red_block(uint8_t *output_r, RedBlockState &state, const uint8_t *input_r)
+{
+	// Did we find a better partition?
+	if (state.use_5_weight)
+	{
+		int partition_lo = state.sorted_block[state.lo_index];
+		int partition_hi = state.sorted_block[state.hi_index];
+		state.encode_0 = uint8_t(partition_lo);
+		state.encode_1 = uint8_t(partition_hi);
 
-			block = 0;
-			assert(partition_hi >= partition_lo);
-			int partition_range = partition_hi - partition_lo;
-			int partition_divider = divider_lut.lut5(partition_range);
+		uint64_t block = 0;
+		assert(partition_hi >= partition_lo);
+		int partition_range = partition_hi - partition_lo;
+		int partition_divider = divider_lut.lut5(partition_range);
 
-			for (int i = 0; i < 16; i++)
+		for (int i = 0; i < 16; i++)
+		{
+			int code;
+			if (input_r[i] < partition_lo)
+			{
+				if ((input_r[i] - 0) < (partition_lo - input_r[i]))
+					code = 6;
+				else
+					code = 0;
+			}
+			else if (input_r[i] > partition_hi)
 			{
-				int code;
-				if (input_r[i] < partition_lo)
-				{
-					if ((input_r[i] - 0) < (partition_lo - input_r[i]))
-						code = 6;
-					else
-						code = 0;
-				}
-				else if (input_r[i] > partition_hi)
-				{
-					if ((255 - input_r[i]) < (input_r[i] - partition_hi))
-						code = 7;
-					else
-						code = 1;
-				}
+				if ((255 - input_r[i]) < (input_r[i] - partition_hi))
+					code = 7;
 				else
-				{
-					code = ((input_r[i] - partition_lo) * partition_divider + 0x80000) >> 20;
-					assert(code <= 5);
-					if (code == 5)
-						code = 1;
-					else if (code != 0)
-						code++;
-				}
-
-				block |= uint64_t(code) << (3 * i);
+					code = 1;
 			}
+			else
+			{
+				code = ((input_r[i] - partition_lo) * partition_divider + 0x80000) >> 20;
+				assert(code <= 5);
+				if (code == 5)
+					code = 1;
+				else if (code != 0)
+					code++;
+			}
+
+			block |= uint64_t(code) << (3 * i);
 		}
+
+		state.block = block;
 	}
 
-	output_r[0] = encode_0;
-	output_r[1] = encode_1;
+	output_r[0] = state.encode_0;
+	output_r[1] = state.encode_1;
 	for (int i = 0; i < 6; i++)
-		output_r[2 + i] = uint8_t((block >> (8 * i)) & 0xff);
+		output_r[2 + i] = uint8_t((state.block >> (8 * i)) & 0xff);
+}
+
+void compress_rgtc_red_block(uint8_t *output_r, const uint8_t *input_r)
+{
+	RedBlockState state;
+	if (begin_rgtc_red_block(state, input_r))
+		search_rgtc_red_partition(state);
+	end_rgtc_red_block(output_r, state, input_r);
+}
+
+#if RGTC_SIMD
+// Same partition search as search_rgtc_red_partition, but each lane evaluates a different block.
+// The lo/hi loops do not depend on the block contents, so all lanes walk the candidates in lockstep
+// and the strict less-than update picks the exact same candidate as the scalar path.
+static void search_rgtc_red_partition_x4(RedBlockState *states)
+{
+	Lanes sorted_block[16];
+	for (int i = 0; i < 16; i++)
+	{
+		sorted_block[i] = lanes_set(states[0].sorted_block[i], states[1].sorted_block[i],
+		                            states[2].sorted_block[i], states[3].sorted_block[i]);
+	}
+
+	Lanes best_error = lanes_set(states[0].best_error, states[1].best_error,
+	                             states[2].best_error, states[3].best_error);
+	Lanes lo_index = lanes_splat(0);
+	Lanes hi_index = lanes_splat(15);
+	Lanes use_5_weight = lanes_splat(0);
+
+	const Lanes round = lanes_splat(0x80000);
+	const Lanes weight_div_5 = lanes_splat(div_5);
+	const Lanes white = lanes_splat(255);
+
+	for (int lo = 0; lo < 15; lo++)
+	{
+		Lanes partition_lo = sorted_block[lo];
+
+		// Error contribution from values quantized to 0.0 only depends on lo.
+		Lanes lo_error = lanes_splat(0);
+		for (int i = 0; i < lo; i++)
+		{
+			Lanes diff = lanes_min(sorted_block[i], lanes_sub(partition_lo, sorted_block[i]));
+			lo_error = lanes_add(lo_error, lanes_mul(diff, diff));
+		}
+
+		for (int hi = lo; hi < 15; hi++)
+		{
+			Lanes partition_hi = sorted_block[hi];
+			Lanes partition_range = lanes_sub(partition_hi, partition_lo);
+
+			alignas(16) int32_t ranges[4];
+			lanes_store(ranges, partition_range);
+			Lanes partition_divider = lanes_set(divider_lut.lut5(ranges[0]), divider_lut.lut5(ranges[1]),
+			                                    divider_lut.lut5(ranges[2]), divider_lut.lut5(ranges[3]));
+
+			Lanes error = lo_error;
+
+			for (int i = lo; i <= hi; i++)
+			{
+				Lanes code = lanes_sra20(lanes_add(lanes_mul(lanes_sub(sorted_block[i], partition_lo), partition_divider), round));
+				Lanes interpolated_value = lanes_add(partition_lo,
+				                                     lanes_sra20(lanes_add(lanes_mul(lanes_mul(partition_range, code), weight_div_5), round)));
+				Lanes diff = lanes_sub(interpolated_value, sorted_block[i]);
+				error = lanes_add(error, lanes_mul(diff, diff));
+			}
+
+			for (int i = hi + 1; i <= 15; i++)
+			{
+				Lanes diff = lanes_min(lanes_sub(white, sorted_block[i]), lanes_sub(sorted_block[i], partition_hi));
+				error = lanes_add(error, lanes_mul(diff, diff));
+			}
+
+			Lanes mask = lanes_less_than(error, best_error);
+			best_error = lanes_select(mask, error, best_error);
+			lo_index = lanes_select(mask, lanes_splat(lo), lo_index);
+			hi_index = lanes_select(mask, lanes_splat(hi), hi_index);
+			use_5_weight = lanes_or(use_5_weight, mask);
+		}
+	}
+
+	alignas(16) int32_t lane_best_error[4];
+	alignas(16) int32_t lane_lo_index[4];
+	alignas(16) int32_t lane_hi_index[4];
+	alignas(16) int32_t lane_use_5_weight[4];
+	lanes_store(lane_best_error, best_error);
+	lanes_store(lane_lo_index, lo_index);
+	lanes_store(lane_hi_index, hi_index);
+	lanes_store(lane_use_5_weight, use_5_weight);
+
+	for (int lane = 0; lane < 4; lane++)
+	{
+		states[lane].best_error = lane_best_error[lane];
+		states[lane].lo_index = lane_lo_index[lane];
+		states[lane].hi_index = lane_hi_index[lane];
+		states[lane].use_5_weight = lane_use_5_weight[lane] != 0;
+	}
+}
+#endif
+
+static void compress_rgtc_red_blocks_strided(uint8_t *output_r, size_t output_stride,
+                                             const uint8_t *input_r, unsigned count)
+{
+	RedBlockState states[4];
+	unsigned i = 0;
+
+#if RGTC_SIMD
+	for (; i + 4 <= count; i += 4)
+	{
+		unsigned search_mask = 0;
+		for (unsigned lane = 0; lane < 4; lane++)
+			if (begin_rgtc_red_block(states[lane], input_r + (i + lane) * 16))
+				search_mask |= 1u << lane;
+
+		if (search_mask & (search_mask - 1))
+		{
+			// Lanes which skip the search get a zero error target, so they can never pick a partition.
+			for (unsigned lane = 0; lane < 4; lane++)
+				if ((search_mask & (1u << lane)) == 0)
+					std::fill(std::begin(states[lane].sorted_block), std::end(states[lane].sorted_block), 0);
+			search_rgtc_red_partition_x4(states);
+		}
+		else if (search_mask)
+			search_rgtc_red_partition(states[Util::trailing_zeroes(search_mask)]);
+
+		for (unsigned lane = 0; lane < 4; lane++)
+			end_rgtc_red_block(output_r + (i + lane) * output_stride, states[lane], input_r + (i + lane) * 16);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		if (begin_rgtc_red_block(states[0], input_r + i * 16))
+			search_rgtc_red_partition(states[0]);
+		end_rgtc_red_block(output_r + i * output_stride, states[0], input_r + i * 16);
+	}
+}
+
+void compress_rgtc_red_blocks(uint8_t *output_r, const uint8_t *input_r, unsigned count)
+{
+	compress_rgtc_red_blocks_strided(output_r, 8, input_r, count);
+}
+
+void compress_rgtc_red_green_blocks(uint8_t *output_rg, const uint8_t *input_r, const uint8_t *input_g, unsigned count)
+{
+	compress_rgtc_red_blocks_strided(output_rg, 16, input_r, count);
+	compress_rgtc_red_blocks_strided(output_rg + 8, 16, input_g, count);
 }
 
 void compress_rgtc_red_green_block(uint8_t *output_rg, const uint8_t *input_r, const uint8_t *input_g)
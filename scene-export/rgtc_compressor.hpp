@@ -28,5 +28,9 @@ namespace Granite
 {
 void compress_rgtc_red_block(uint8_t *output_r, const uint8_t *input_r);
 void compress_rgtc_red_green_block(uint8_t *output_rg, const uint8_t *input_r, const uint8_t *input_g);
+// Encodes count consecutive 4x4 blocks, each block being 16 tightly packed texels.
+// Output is bit-exact with the per-block functions, but independent blocks are searched in parallel.
+void compress_rgtc_red_blocks(uint8_t *output_r, const uint8_t *input_r, unsigned count);
+void compress_rgtc_red_green_blocks(uint8_t *output_rg, const uint8_t *input_r, const uint8_t *input_g, unsigned count);
 void decompress_rgtc_red_block(uint8_t *output_r, const uint8_t *block);
 }
\ No newline at end of file
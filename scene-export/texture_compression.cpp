@@ -505,59 +505,72 @@ void CompressorState::enqueue_compression_block_rgtc(TaskGroupHandle &group, uns
 	int width = input->get_layout().get_width(level);
 	int height = input->get_layout().get_height(level);
 	int blocks_x = (width + block_size_x - 1) / block_size_x;
+	int blocks_y = (height + block_size_y - 1) / block_size_y;
 
-	for (int y = 0; y < height; y += block_size_y)
+	// One task per 4x4 block drowns in scheduling overhead, so encode strips of block rows instead.
+	constexpr int target_blocks_per_task = 1024;
+	int rows_per_task = std::max(1, target_blocks_per_task / blocks_x);
+
+	for (int strip_y = 0; strip_y < blocks_y; strip_y += rows_per_task)
 	{
-		for (int x = 0; x < width; x += block_size_x)
-		{
-			group->enqueue_task([=, format = args.format]() {
-				auto &layout = input->get_layout();
-				uint8_t padded_red[4 * 4];
-				uint8_t padded_green[4 * 4];
-				auto *src = static_cast<const uint8_t *>(layout.data(layer, level));
-				unsigned pixel_stride = layout.get_block_stride();
+		int strip_end_y = std::min(strip_y + rows_per_task, blocks_y);
 
-				const auto get_block_data = [&](int block_size) -> uint8_t * {
-					auto *dst = static_cast<uint8_t *>(output->get_layout().data(layer, level));
-					dst += (x / block_size_x) * block_size;
-					dst += (y / block_size_y) * blocks_x * block_size;
-					return dst;
-				};
+		group->enqueue_task([=, format = args.format]() {
+			auto &layout = input->get_layout();
+			auto *src = static_cast<const uint8_t *>(layout.data(layer, level));
+			auto *dst = static_cast<uint8_t *>(output->get_layout().data(layer, level));
+			unsigned pixel_stride = layout.get_block_stride();
+			int block_size = format == VK_FORMAT_BC5_UNORM_BLOCK ? 16 : 8;
 
-				const auto get_encode_data = [&](int block_size) -> uint8_t * {
-					return get_block_data(block_size);
-				};
+			std::vector<uint8_t> padded_red(blocks_x * 16);
+			std::vector<uint8_t> padded_green(pixel_stride > 1 ? blocks_x * 16 : 0);
 
-				const auto get_component = [&](int sx, int sy, int c) -> uint8_t {
-					sx = std::min(sx, width - 1);
-					sy = std::min(sy, height - 1);
-					return src[pixel_stride * (sy * width + sx) + c];
-				};
+			for (int block_y = strip_y; block_y < strip_end_y; block_y++)
+			{
+				int y = block_y * block_size_y;
 
 				for (int sy = 0; sy < 4; sy++)
 				{
-					for (int sx = 0; sx < 4; sx++)
+					const uint8_t *row = src + pixel_stride * std::min(y + sy, height - 1) * width;
+
+					for (int x = 0; x < width; x++)
+					{
+						int index = (x >> 2) * 16 + sy * 4 + (x & 3);
+						padded_red[index] = row[pixel_stride * x];
+						if (pixel_stride > 1)
+							padded_green[index] = row[pixel_stride * x + 1];
+					}
+
+					// Replicate the edge texel into the padding of the last block.
+					for (int x = width; x < blocks_x * block_size_x; x++)
 					{
-						padded_red[sy * 4 + sx] = get_component(x + sx, y + sy, 0);
+						int index = (x >> 2) * 16 + sy * 4 + (x & 3);
+						padded_red[index] = row[pixel_stride * (width - 1)];
 						if (pixel_stride > 1)
-							padded_green[sy * 4 + sx] = get_component(x + sx, y + sy, 1);
+							padded_green[index] = row[pixel_stride * (width - 1) + 1];
 					}
 				}
 
+				uint8_t *encoded = dst + block_y * blocks_x * block_size;
+
 				switch (format)
 				{
 				case VK_FORMAT_BC4_UNORM_BLOCK:
 				{
-					compress_rgtc_red_block(get_encode_data(8), padded_red);
+					compress_rgtc_red_blocks(encoded, padded_red.data(), blocks_x);
 
 #ifdef RGTC_DEBUG
 					if (level == 0 && layer == 0)
 					{
-						uint8_t decoded_red[16];
-						decompress_rgtc_red_block(decoded_red, get_encode_data(8));
 						double error = 0.0;
-						for (int i = 0; i < 16; i++)
-							error += double((decoded_red[i] - padded_red[i]) * (decoded_red[i] - padded_red[i])) / (width * height);
+						for (int block_x = 0; block_x < blocks_x; block_x++)
+						{
+							uint8_t decoded_red[16];
+							const uint8_t *red = padded_red.data() + block_x * 16;
+							decompress_rgtc_red_block(decoded_red, encoded + block_x * 8);
+							for (int i = 0; i < 16; i++)
+								error += double((decoded_red[i] - red[i]) * (decoded_red[i] - red[i])) / (width * height);
+						}
 
 						std::lock_guard<std::mutex> l{lock};
 						total_error[0] += error;
@@ -568,22 +581,30 @@ void CompressorState::enqueue_compression_block_rgtc(TaskGroupHandle &group, uns
 
 				case VK_FORMAT_BC5_UNORM_BLOCK:
 				{
-					compress_rgtc_red_green_block(get_encode_data(16), padded_red, padded_green);
+					if (pixel_stride > 1)
+						compress_rgtc_red_green_blocks(encoded, padded_red.data(), padded_green.data(), blocks_x);
+					else
+						compress_rgtc_red_green_blocks(encoded, padded_red.data(), padded_red.data(), blocks_x);
 
 #ifdef RGTC_DEBUG
-					if (level == 0 && layer == 0)
+					if (level == 0 && layer == 0 && pixel_stride > 1)
 					{
-						uint8_t decoded_red[16];
-						uint8_t decoded_green[16];
-						decompress_rgtc_red_block(decoded_red, get_encode_data(16));
-						decompress_rgtc_red_block(decoded_green, get_encode_data(16) + 8);
-
 						double error_red = 0.0;
 						double error_green = 0.0;
-						for (int i = 0; i < 16; i++)
-							error_red += double((decoded_red[i] - padded_red[i]) * (decoded_red[i] - padded_red[i])) / (width * height);
-						for (int i = 0; i < 16; i++)
-							error_green += double((decoded_green[i] - padded_green[i]) * (decoded_green[i] - padded_green[i])) / (width * height);
+						for (int block_x = 0; block_x < blocks_x; block_x++)
+						{
+							uint8_t decoded_red[16];
+							uint8_t decoded_green[16];
+							const uint8_t *red = padded_red.data() + block_x * 16;
+							const uint8_t *green = padded_green.data() + block_x * 16;
+							decompress_rgtc_red_block(decoded_red, encoded + block_x * 16);
+							decompress_rgtc_red_block(decoded_green, encoded + block_x * 16 + 8);
+
+							for (int i = 0; i < 16; i++)
+								error_red += double((decoded_red[i] - red[i]) * (decoded_red[i] - red[i])) / (width * height);
+							for (int i = 0; i < 16; i++)
+								error_green += double((decoded_green[i] - green[i]) * (decoded_green[i] - green[i])) / (width * height);
+						}
 
 						std::lock_guard<std::mutex> l{lock};
 						total_error[0] += error_red;
@@ -596,8 +617,8 @@ void CompressorState::enqueue_compression_block_rgtc(TaskGroupHandle &group, uns
 				default:
 					break;
 				}
-			});
-		}
+			}
+		});
 	}
 }
 
@@ -0,0 +1,122 @@
+#include "animation_compression.hpp"
+#include "muglm/muglm_impl.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <float.h>
+#include <stdlib.h>
+
+using namespace Granite;
+
+using Tracks = std::vector<CompressedAnimationClip::Track>;
+
+static void verify_clip(const char *name, const Tracks &tracks, unsigned num_samples)
+{
+	auto num_channels = unsigned(tracks.size());
+	AnimationCompressionOptions options;
+	CompressedAnimationClip clip;
+	clip.compress(tracks.data(), num_channels, num_samples, options);
+
+	LOGI("%s: Compressed %u samples to %u keys, %zu bytes.\n", name, num_samples, clip.get_num_keys(),
+	     clip.get_memory_size());
+
+	// Key reduction accounts for quantization, so decoded samples stay within the requested tolerance.
+	// The only slack is float rounding, which depends on the magnitude of the values and on FMA contraction.
+	const auto max_error = [](const vec3 &a, const vec3 &b) {
+		vec3 d = abs(a - b);
+		vec3 m = abs(b);
+		float rounding = 4.0f * FLT_EPSILON * std::max(std::max(m.x, m.y), m.z);
+		return std::max(std::max(d.x, d.y), d.z) - rounding;
+	};
+
+	// q and -q represent the same rotation.
+	const auto max_quat_error = [](const vec4 &a, const vec4 &b) {
+		vec4 d0 = abs(a - b);
+		vec4 d1 = abs(a + b);
+		return std::min(std::max(std::max(d0.x, d0.y), std::max(d0.z, d0.w)),
+		                std::max(std::max(d1.x, d1.y), std::max(d1.z, d1.w)));
+	};
+
+	for (float s = -3.0f; s < float(num_samples + 5); s += 0.37f)
+	{
+		auto loc = clip.locate(s);
+		float clamped = clamp(s, 0.0f, float(num_samples - 1));
+		unsigned lo = unsigned(muglm::floor(clamped));
+		unsigned hi = std::min(lo + 1, num_samples - 1);
+		float l = clamped - muglm::floor(clamped);
+
+		for (unsigned base = 0; base < num_channels; base += AnimationSampleBatch::Size)
+		{
+			AnimationSampleBatch batch;
+			clip.sample(loc, base, batch);
+
+			for (unsigned i = 0; i < AnimationSampleBatch::Size && base + i < num_channels; i++)
+			{
+				auto &t = tracks[base + i];
+				vec4 rot(batch.rotation[0][i], batch.rotation[1][i], batch.rotation[2][i], batch.rotation[3][i]);
+				vec3 trans(batch.translation[0][i], batch.translation[1][i], batch.translation[2][i]);
+				vec3 scale(batch.scale[0][i], batch.scale[1][i], batch.scale[2][i]);
+
+				vec4 ref_rot = t.rotation.empty() ? vec4(0.0f, 0.0f, 0.0f, 1.0f) :
+				               normalize(mix(t.rotation[lo].as_vec4(), t.rotation[hi].as_vec4(), l));
+				vec3 ref_trans = t.translation.empty() ? vec3(0.0f) : mix(t.translation[lo], t.translation[hi], l);
+				vec3 ref_scale = t.scale.empty() ? vec3(1.0f) : mix(t.scale[lo], t.scale[hi], l);
+
+				if (max_quat_error(rot, ref_rot) > options.rotation_tolerance ||
+				    max_error(trans, ref_trans) > options.translation_tolerance ||
+				    max_error(scale, ref_scale) > options.scale_tolerance)
+				{
+					LOGE("%s: Mismatch in channel %u at sample %.3f.\n", name, base + i, s);
+					exit(1);
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	constexpr unsigned NumChannels = 37;
+	constexpr unsigned NumSamples = 600;
+	Tracks tracks(NumChannels);
+
+	for (unsigned c = 0; c < NumChannels; c++)
+	{
+		auto &t = tracks[c];
+		vec3 axis = normalize(vec3(1.0f + float(c), 0.5f, -0.3f * float(c)));
+
+		// Leave some components unanimated, and exercise both quaternion signs.
+		for (unsigned i = 0; (c % 5) != 1 && i < NumSamples; i++)
+		{
+			float f = float(i) / 60.0f;
+			quat q = angleAxis(2.0f * muglm::sin(f * float(1 + c % 3)) + float(c), axis);
+			t.rotation.push_back((c % 7) == 0 ? quat(-q.as_vec4()) : q);
+		}
+
+		for (unsigned i = 0; (c % 3) == 0 && i < NumSamples; i++)
+			t.translation.push_back(vec3(0.01f * float(i), muglm::sin(0.05f * float(i)), float((i % 40) < 20)));
+
+		for (unsigned i = 0; (c % 4) == 0 && i < NumSamples; i++)
+			t.scale.push_back(vec3(1.0f + 0.1f * muglm::sin(0.02f * float(i))));
+	}
+
+	verify_clip("Mixed", tracks, NumSamples);
+
+	// Slow motion over a large range, where most keys are removed and quantization uses a large part of the budget.
+	Tracks smooth(NumChannels);
+	for (unsigned c = 0; c < NumChannels; c++)
+	{
+		auto &t = smooth[c];
+		vec3 axis = normalize(vec3(0.3f, 1.0f, 0.1f * float(c)));
+		for (unsigned i = 0; i < NumSamples; i++)
+		{
+			float f = float(i) / 600.0f;
+			t.rotation.push_back(angleAxis(0.5f * muglm::sin(f + float(c)), axis));
+			t.translation.push_back(vec3(5.0f * muglm::sin(f), 3.0f * f, 4.0f * muglm::cos(0.7f * f + float(c))));
+			t.scale.push_back(vec3(1.0f + 0.5f * f));
+		}
+	}
+
+	verify_clip("Smooth", smooth, NumSamples);
+
+	LOGI("Animation compression test passed.\n");
+}
@@ -0,0 +1,116 @@
+#include "animation_system.hpp"
+#include "scene.hpp"
+#include "thread_group.hpp"
+#include "task_composer.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <stdlib.h>
+
+using namespace Granite;
+
+static SceneFormats::Animation build_skeleton_animation(unsigned num_bones, unsigned num_keys)
+{
+	SceneFormats::Animation animation;
+	animation.name = "stress";
+
+	for (unsigned bone = 0; bone < num_bones; bone++)
+	{
+		SceneFormats::AnimationChannel rotation;
+		rotation.node_index = bone;
+		rotation.type = SceneFormats::AnimationChannel::Type::Rotation;
+
+		SceneFormats::AnimationChannel translation;
+		translation.node_index = bone;
+		translation.type = SceneFormats::AnimationChannel::Type::Translation;
+
+		for (unsigned key = 0; key < num_keys; key++)
+		{
+			float t = float(key) / float(num_keys - 1);
+			float phase = t * 2.0f * pi<float>() + float(bone);
+			rotation.timestamps.push_back(t);
+			rotation.spherical.values.push_back(
+					angleAxis(0.5f * muglm::sin(phase), normalize(vec3(1.0f, float(bone % 3), 0.5f))).as_vec4());
+			translation.timestamps.push_back(t);
+			translation.positional.values.push_back(vec3(0.0f, 1.0f + 0.1f * muglm::cos(phase), 0.0f));
+		}
+
+		animation.channels.push_back(std::move(rotation));
+		animation.channels.push_back(std::move(translation));
+	}
+
+	animation.update_length();
+	return animation;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned num_skeletons = argc >= 2 ? unsigned(strtoul(argv[1], nullptr, 0)) : 1000;
+	unsigned num_bones = argc >= 3 ? unsigned(strtoul(argv[2], nullptr, 0)) : 64;
+	unsigned num_threads = argc >= 4 ? unsigned(strtoul(argv[3], nullptr, 0)) : 4;
+	constexpr unsigned NumFrames = 200;
+
+	if (!num_skeletons || !num_bones || !num_threads)
+	{
+		LOGE("Usage: animation-stress-bench [skeletons] [bones] [threads]\n");
+		return EXIT_FAILURE;
+	}
+
+	ThreadGroup group;
+	group.start(num_threads, 0, {});
+
+	Scene scene;
+	AnimationSystem system;
+	auto id = system.register_animation("stress", build_skeleton_animation(num_bones, 61));
+
+	scene.set_root_node(scene.create_node());
+	std::vector<NodeHandle> nodes(num_bones);
+	for (unsigned i = 0; i < num_skeletons; i++)
+	{
+		// Chain bones so the transform hierarchy has depth.
+		for (unsigned bone = 0; bone < num_bones; bone++)
+		{
+			nodes[bone] = scene.create_node();
+			if (bone)
+				nodes[bone - 1]->add_child(nodes[bone]);
+		}
+
+		scene.get_root_node()->add_child(nodes[0]);
+		auto state = system.start_animation_multi(nodes.data(), num_bones, id, 0.01 * double(i));
+		system.set_repeating(state, true);
+	}
+
+	int64_t animation_time = 0;
+	int64_t transform_time = 0;
+
+	for (unsigned frame = 0; frame < NumFrames; frame++)
+	{
+		double elapsed_time = double(frame) / 60.0;
+
+		auto start = Util::get_current_time_nsecs();
+		{
+			TaskComposer composer(group);
+			system.animate(composer, 1.0 / 60.0, elapsed_time);
+			composer.get_outgoing_task()->wait();
+		}
+		auto mid = Util::get_current_time_nsecs();
+		{
+			TaskComposer composer(group);
+			scene.update_transform_tree(composer);
+			composer.get_outgoing_task()->wait();
+		}
+		auto end = Util::get_current_time_nsecs();
+
+		scene.clear_updates();
+		animation_time += mid - start;
+		transform_time += end - mid;
+	}
+
+	double total_bones = double(num_skeletons) * double(num_bones);
+	LOGI("%u skeletons x %u bones, %u threads.\n", num_skeletons, num_bones, num_threads);
+	LOGI("  Animation: %.3f ms / frame (%.1f M bones / s)\n",
+	     1e-6 * double(animation_time) / NumFrames,
+	     1e-6 * total_bones * NumFrames / (1e-9 * double(animation_time)));
+	LOGI("  Transforms: %.3f ms / frame (%.1f M bones / s)\n",
+	     1e-6 * double(transform_time) / NumFrames,
+	     1e-6 * total_bones * NumFrames / (1e-9 * double(transform_time)));
+}
@@ -0,0 +1,172 @@
+#include "arena_allocator.hpp"
+#include "logging.hpp"
+#include <random>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Util;
+
+struct MockAllocation
+{
+	uint32_t block = UINT32_MAX;
+	uint32_t mask = 0;
+	IntrusiveList<LegionHeap<MockAllocation>>::Iterator heap = {};
+};
+
+struct MockArena : ArenaAllocator<MockArena, MockAllocation>
+{
+	uint32_t next_block = 0;
+	uint32_t live_blocks = 0;
+
+	bool allocate_backing_heap(MockAllocation *alloc)
+	{
+		*alloc = {};
+		alloc->block = next_block++;
+		live_blocks++;
+		return true;
+	}
+
+	void free_backing_heap(MockAllocation *)
+	{
+		live_blocks--;
+	}
+
+	void prepare_allocation(MockAllocation *alloc, IntrusiveList<MiniHeap>::Iterator heap,
+	                        const SuballocationResult &suballoc)
+	{
+		alloc->block = heap->allocation.block;
+		alloc->mask = suballoc.mask;
+		alloc->heap = heap;
+	}
+};
+
+static constexpr uint32_t SubBlockSize = 1024;
+
+static bool check(bool cond, const char *what)
+{
+	if (!cond)
+		LOGE("Check failed: %s\n", what);
+	return cond;
+}
+
+static bool check_heap_state(const MockArena &arena, const ArenaAllocatorStats &stats, uint64_t expected_live_size)
+{
+	uint32_t histogram_heaps = 0;
+	for (auto count : stats.longest_free_run_histogram)
+		histogram_heaps += count;
+
+	if (!check(stats.sub_block_size == SubBlockSize, "sub-block size") ||
+	    !check(stats.live_size == expected_live_size, "live size") ||
+	    !check(stats.heap_count == arena.live_blocks, "heap count") ||
+	    !check(histogram_heaps == stats.heap_count, "longest free run histogram"))
+		return false;
+
+	// Peaks are only tracked while stats are enabled.
+	return !arena.get_stats_enabled() ||
+	       (check(stats.peak_heap_count >= stats.heap_count, "peak heap count") &&
+	        check(stats.peak_live_size >= stats.live_size, "peak live size"));
+}
+
+int main()
+{
+	ObjectPool<LegionHeap<MockAllocation>> pool;
+	MockArena arena;
+	arena.set_sub_block_size(SubBlockSize);
+	arena.set_object_pool(&pool);
+
+	std::mt19937 rnd(7);
+	std::uniform_int_distribution<uint32_t> size_dist(1, LegionAllocator::NumSubBlocks * SubBlockSize);
+
+	struct Object
+	{
+		MockAllocation alloc;
+		uint32_t num_blocks;
+	};
+	std::vector<Object> objects(2000);
+
+	// Nothing is counted before stats are enabled, but heap state is always sampled.
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		auto &obj = objects[i];
+		uint32_t size = size_dist(rnd);
+		obj.num_blocks = (size + SubBlockSize - 1) / SubBlockSize;
+		if (!arena.allocate(size, &obj.alloc))
+			return EXIT_FAILURE;
+	}
+
+	uint64_t expected_live_size = 0;
+	for (uint32_t i = 0; i < 100; i++)
+		expected_live_size += uint64_t(objects[i].num_blocks) * SubBlockSize;
+
+	ArenaAllocatorStats stats;
+	arena.get_stats(stats);
+	if (!check(stats.allocation_count == 0 && stats.heap_allocation_count == 0, "counters while disabled") ||
+	    !check_heap_state(arena, stats, expected_live_size))
+		return EXIT_FAILURE;
+
+	// Enabling seeds live size and heap count from the current state.
+	arena.set_stats_enabled(true);
+	arena.get_stats(stats);
+	if (!check(stats.peak_live_size == expected_live_size, "seeded peak live size") ||
+	    !check(stats.peak_heap_count == arena.live_blocks, "seeded peak heap count") ||
+	    !check_heap_state(arena, stats, expected_live_size))
+		return EXIT_FAILURE;
+
+	uint32_t initial_heaps = arena.live_blocks;
+	uint64_t size_histogram[LegionAllocator::NumSubBlocks] = {};
+	for (uint32_t i = 100; i < objects.size(); i++)
+	{
+		auto &obj = objects[i];
+		uint32_t size = size_dist(rnd);
+		obj.num_blocks = (size + SubBlockSize - 1) / SubBlockSize;
+		if (!arena.allocate(size, &obj.alloc))
+			return EXIT_FAILURE;
+		size_histogram[obj.num_blocks - 1]++;
+		expected_live_size += uint64_t(obj.num_blocks) * SubBlockSize;
+	}
+
+	uint64_t peak_live_size = expected_live_size;
+	arena.get_stats(stats);
+	if (!check(stats.allocation_count == objects.size() - 100, "allocation count") ||
+	    !check(memcmp(stats.allocation_size_histogram, size_histogram, sizeof(size_histogram)) == 0,
+	           "allocation size histogram") ||
+	    !check(stats.heap_allocation_count == arena.live_blocks - initial_heaps, "heap allocation count") ||
+	    !check(stats.peak_live_size == peak_live_size, "peak live size after allocation") ||
+	    !check_heap_state(arena, stats, expected_live_size))
+		return EXIT_FAILURE;
+
+	// Free every other object, then the rest, so heaps are released along the way.
+	uint64_t frees = 0;
+	for (uint32_t pass = 0; pass < 2; pass++)
+	{
+		for (uint32_t i = pass; i < objects.size(); i += 2)
+		{
+			auto &obj = objects[i];
+			arena.free(obj.alloc.heap, obj.alloc.mask);
+			expected_live_size -= uint64_t(obj.num_blocks) * SubBlockSize;
+			frees++;
+		}
+
+		arena.get_stats(stats);
+		if (!check(stats.free_count == frees, "free count") ||
+		    !check(stats.heap_count == stats.heap_allocation_count + initial_heaps - stats.heap_free_count,
+		           "heap allocations minus frees") ||
+		    !check(stats.peak_live_size == peak_live_size, "peak live size after free") ||
+		    !check_heap_state(arena, stats, expected_live_size))
+			return EXIT_FAILURE;
+	}
+
+	if (!check(stats.heap_count == 0 && stats.live_size == 0, "empty arena"))
+		return EXIT_FAILURE;
+
+	// Disabling drops the counters again.
+	arena.set_stats_enabled(false);
+	arena.get_stats(stats);
+	if (!check(stats.allocation_count == 0 && stats.free_count == 0 && stats.peak_live_size == 0,
+	           "counters after disable"))
+		return EXIT_FAILURE;
+
+	LOGI("Arena allocator stats test passed.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,278 @@
+#include "asset_manager.hpp"
+#include "filesystem.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Granite;
+
+// Records every decision of the planner, so runs can be compared against each other.
+struct MockInterface final : AssetInstantiatorInterface
+{
+	uint64_t estimate_cost_asset(AssetID, File &mapping) override
+	{
+		return mapping.get_size();
+	}
+
+	void instantiate_asset(AssetManager &manager, TaskGroup *, AssetID id, File &mapping) override
+	{
+		events.push_back(int(id.id) + 1);
+		resident[id.id] = true;
+		manager.update_cost(id, mapping.get_size());
+	}
+
+	void release_asset(AssetID id) override
+	{
+		if (resident[id.id])
+			events.push_back(-int(id.id) - 1);
+		resident[id.id] = false;
+	}
+
+	void set_id_bounds(uint32_t bound) override
+	{
+		resident.resize(bound);
+	}
+
+	void latch_handles() override
+	{
+	}
+
+	std::vector<int> events;
+	std::vector<bool> resident;
+};
+
+struct MockPrefetch final : AssetPrefetchInterface
+{
+	void predict_assets(AssetManager &manager) override
+	{
+		for (auto &id : ids)
+			manager.prefetch_asset(id);
+	}
+
+	std::vector<AssetID> ids;
+};
+
+static AssetID register_file(Filesystem &fs, AssetManager &manager, unsigned index, size_t size,
+                             AssetClass asset_class, int prio)
+{
+	auto path = "tmp://" + std::to_string(index);
+	{
+		auto mapping = fs.open_writeonly_mapping(path, size);
+		if (!mapping)
+			return {};
+	}
+	return manager.register_asset(fs.open(path), asset_class, prio);
+}
+
+#define EXPECT(x) do { if (!(x)) { LOGE("Check failed: %s (line %d)\n", #x, __LINE__); return false; } } while (0)
+
+static bool test_budget()
+{
+	Filesystem fs;
+	fs.register_protocol("tmp", std::make_unique<ScratchFilesystem>());
+	// The manager releases everything through the interface on destruction.
+	MockInterface iface;
+	AssetManager manager;
+	manager.set_asset_instantiator_interface(&iface);
+
+	AssetID ids[5];
+	for (unsigned i = 0; i < 5; i++)
+		ids[i] = register_file(fs, manager, i, 1u << i, AssetClass::ImageZeroable, 1);
+
+	manager.set_asset_budget(25);
+	manager.set_asset_budget_per_iteration(5);
+	manager.set_asset_residency_priority(ids[4], 2);
+
+	// Highest prio first, then lowest ID. The per-iteration budget may be overrun once.
+	manager.iterate(nullptr);
+	EXPECT(manager.get_current_total_consumed() == 16);
+	manager.iterate(nullptr);
+	EXPECT(manager.get_current_total_consumed() == 23);
+
+	// The prio 0 resource is paged out to make room for the last prio 1 resource.
+	manager.set_asset_residency_priority(ids[4], 0);
+	manager.iterate(nullptr);
+	EXPECT(manager.get_current_total_consumed() == 15);
+	EXPECT(!iface.resident[4]);
+
+	// Lowering the budget pages out the least recently used resources first, largest first among equals.
+	manager.iterate(nullptr);
+	manager.set_asset_budget(4);
+	size_t num_events = iface.events.size();
+	manager.iterate(nullptr);
+	EXPECT(manager.get_current_total_consumed() <= 4);
+	std::vector<int> expected = { -3, -2, -1, -4 };
+	EXPECT(std::vector<int>(iface.events.begin() + num_events, iface.events.end()) == expected);
+	return true;
+}
+
+static bool test_class_budget()
+{
+	Filesystem fs;
+	fs.register_protocol("tmp", std::make_unique<ScratchFilesystem>());
+	MockInterface iface;
+	AssetManager manager;
+	manager.set_asset_instantiator_interface(&iface);
+
+	// Meshes are registered first and have the lowest IDs, so they'd be loaded first.
+	for (unsigned i = 0; i < 5; i++)
+		register_file(fs, manager, i, 4, AssetClass::Mesh, 1);
+	for (unsigned i = 5; i < 10; i++)
+		register_file(fs, manager, i, 4, AssetClass::ImageColor, 1);
+
+	manager.set_asset_budget(1000);
+	manager.set_asset_budget_per_iteration(1000);
+	manager.set_asset_class_budget(AssetClass::Mesh, 10);
+
+	// A full mesh budget must not stop images from loading.
+	manager.iterate(nullptr);
+	EXPECT(manager.get_current_class_consumed(AssetClass::Mesh) == 8);
+	EXPECT(manager.get_current_class_consumed(AssetClass::ImageColor) == 20);
+	EXPECT(manager.get_current_total_consumed() == 28);
+
+	manager.set_asset_class_budget(AssetClass::Mesh, 4);
+	manager.iterate(nullptr);
+	EXPECT(manager.get_current_class_consumed(AssetClass::Mesh) == 4);
+	EXPECT(manager.get_current_class_consumed(AssetClass::ImageColor) == 20);
+	return true;
+}
+
+static bool test_prefetch()
+{
+	Filesystem fs;
+	fs.register_protocol("tmp", std::make_unique<ScratchFilesystem>());
+	MockInterface iface;
+	MockPrefetch prefetch;
+	AssetManager manager;
+	manager.set_asset_instantiator_interface(&iface);
+	manager.set_asset_prefetch_interface(&prefetch);
+
+	AssetID ids[8];
+	for (unsigned i = 0; i < 8; i++)
+		ids[i] = register_file(fs, manager, i, 2, AssetClass::ImageGeneric, 1);
+
+	manager.set_asset_budget(5);
+	manager.set_asset_budget_per_iteration(100);
+
+	// Without hints, the lowest IDs win.
+	manager.iterate(nullptr);
+	manager.iterate(nullptr);
+	manager.iterate(nullptr);
+	EXPECT(iface.resident[0] && iface.resident[1]);
+
+	// Used assets rank ahead of prefetched ones, which rank ahead of anything older.
+	prefetch.ids = { ids[7] };
+	manager.mark_used_asset(ids[5]);
+	manager.iterate(nullptr);
+	EXPECT(iface.resident[5] && iface.resident[7]);
+	EXPECT(!iface.resident[0] && !iface.resident[1]);
+	std::vector<int> expected = { 1, 2, -2, 6, -1, 8 };
+	EXPECT(iface.events == expected);
+	return true;
+}
+
+static std::vector<int> run_random_workload(unsigned seed)
+{
+	Filesystem fs;
+	fs.register_protocol("tmp", std::make_unique<ScratchFilesystem>());
+	MockInterface iface;
+	AssetManager manager;
+	manager.set_asset_instantiator_interface(&iface);
+
+	std::mt19937 rnd(seed);
+	std::vector<AssetID> ids;
+	for (unsigned i = 0; i < 500; i++)
+	{
+		auto asset_class = (rnd() & 3) == 0 ? AssetClass::Mesh : AssetClass::ImageColor;
+		ids.push_back(register_file(fs, manager, i, 1 + rnd() % 64, asset_class, int(rnd() % 3)));
+	}
+
+	manager.set_asset_budget(4000);
+	manager.set_asset_budget_per_iteration(500);
+	manager.set_asset_class_budget(AssetClass::Mesh, 1000);
+
+	for (unsigned frame = 0; frame < 200; frame++)
+	{
+		for (unsigned i = 0; i < 50; i++)
+			manager.mark_used_asset(ids[rnd() % ids.size()]);
+		if (frame % 10 == 0)
+			manager.set_asset_residency_priority(ids[rnd() % ids.size()], int(rnd() % 3));
+		manager.iterate(nullptr);
+
+		if (manager.get_current_class_consumed(AssetClass::Mesh) > 1000 ||
+		    manager.get_current_total_consumed() > 4000)
+		{
+			LOGE("Budget exceeded in frame %u.\n", frame);
+			return {};
+		}
+	}
+
+	return iface.events;
+}
+
+static bool test_determinism()
+{
+	auto a = run_random_workload(1234);
+	auto b = run_random_workload(1234);
+	EXPECT(!a.empty());
+	EXPECT(a == b);
+	return true;
+}
+
+// The planner logs every page-out, which would dominate the timings.
+struct QuietLogging final : Util::LoggingInterface
+{
+	bool log(const char *tag, const char *, va_list) override
+	{
+		return strcmp(tag, "[INFO]: ") == 0;
+	}
+};
+
+static void bench_iterate(unsigned num_assets)
+{
+	Filesystem fs;
+	fs.register_protocol("tmp", std::make_unique<ScratchFilesystem>());
+	MockInterface iface;
+	AssetManager manager;
+	manager.set_asset_instantiator_interface(&iface);
+
+	std::mt19937 rnd(42);
+	std::vector<AssetID> ids;
+	ids.reserve(num_assets);
+	for (unsigned i = 0; i < num_assets; i++)
+		ids.push_back(register_file(fs, manager, i, 1 + rnd() % 16, AssetClass::ImageColor, 1));
+
+	// Roughly half of the assets fit.
+	manager.set_asset_budget(4 * uint64_t(num_assets));
+	manager.set_asset_budget_per_iteration(UINT64_MAX);
+	manager.iterate(nullptr);
+
+	const unsigned frames = 100;
+	QuietLogging quiet;
+	Util::set_thread_logging_interface(&quiet);
+	auto start = Util::get_current_time_nsecs();
+	for (unsigned frame = 0; frame < frames; frame++)
+	{
+		for (unsigned i = 0; i < 1000; i++)
+			manager.mark_used_asset(ids[rnd() % ids.size()]);
+		manager.iterate(nullptr);
+	}
+	auto end = Util::get_current_time_nsecs();
+	Util::set_thread_logging_interface(nullptr);
+
+	LOGI("%u assets: %.3f ms / iterate.\n", num_assets, 1e-6 * double(end - start) / frames);
+}
+
+int main()
+{
+	if (!test_budget() || !test_class_budget() || !test_prefetch() || !test_determinism())
+		return EXIT_FAILURE;
+
+	bench_iterate(10000);
+	bench_iterate(100000);
+	return EXIT_SUCCESS;
+}
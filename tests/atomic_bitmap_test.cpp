@@ -0,0 +1,193 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "atomic_bitmap.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <stdlib.h>
+
+using namespace Util;
+
+static bool verify(const AtomicBitmap &bitmap, const std::set<uint32_t> &reference)
+{
+	std::vector<uint32_t> bits;
+	bitmap.for_each_bit([&](uint32_t index) { bits.push_back(index); });
+
+	if (bits.size() != reference.size() || !std::equal(bits.begin(), bits.end(), reference.begin()))
+	{
+		LOGE("Bit iteration does not match reference.\n");
+		return false;
+	}
+
+	if (bitmap.count() != reference.size())
+	{
+		LOGE("Count mismatch, %zu != %zu.\n", bitmap.count(), reference.size());
+		return false;
+	}
+
+	// Expand runs back into bits, and ensure runs are maximal.
+	std::vector<uint32_t> run_bits;
+	uint32_t prev_end = UINT32_MAX;
+	bool ok = true;
+	bitmap.for_each_run([&](uint32_t offset, uint32_t count) {
+		if (count == 0 || offset == prev_end)
+			ok = false;
+		for (uint32_t i = 0; i < count; i++)
+			run_bits.push_back(offset + i);
+		prev_end = offset + count;
+	});
+
+	if (!ok || run_bits != bits)
+	{
+		LOGE("Run iteration does not match reference.\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	AtomicBitmap bitmap;
+	bitmap.init(20);
+
+	std::mt19937 rnd(1234);
+	std::set<uint32_t> reference;
+
+	for (unsigned iter = 0; iter < 64; iter++)
+	{
+		bitmap.clear();
+		reference.clear();
+
+		unsigned num_ranges = rnd() % 200;
+		for (unsigned i = 0; i < num_ranges; i++)
+		{
+			uint32_t offset = rnd() % bitmap.get_num_bits();
+			uint32_t count = std::min<uint32_t>(rnd() % 300, bitmap.get_num_bits() - offset);
+			bitmap.set_range(offset, count);
+			for (uint32_t j = 0; j < count; j++)
+				reference.insert(offset + j);
+		}
+
+		unsigned num_bits = rnd() % 2000;
+		for (unsigned i = 0; i < num_bits; i++)
+		{
+			uint32_t index = rnd() % bitmap.get_num_bits();
+			bool inserted = reference.insert(index).second;
+			if (bitmap.set(index) != inserted)
+			{
+				LOGE("set() did not report a newly set bit correctly.\n");
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (!verify(bitmap, reference))
+			return EXIT_FAILURE;
+	}
+
+	// Runs made of whole words, which is where trailing_ones64() would see an all-ones word.
+	{
+		const struct
+		{
+			uint32_t offset, count;
+		} full_word_runs[][2] = {
+			{ { 64, 64 }, { 0, 0 } },
+			{ { 128, 256 }, { 0, 0 } },
+			{ { 0, 64 }, { 192, 128 } },
+			{ { 32, 160 }, { 640, 64 } },
+			{ { 0, 1u << 20 }, { 0, 0 } },
+		};
+
+		for (auto &runs : full_word_runs)
+		{
+			bitmap.clear();
+			reference.clear();
+			for (auto &run : runs)
+			{
+				bitmap.set_range(run.offset, run.count);
+				for (uint32_t j = 0; j < run.count; j++)
+					reference.insert(run.offset + j);
+			}
+
+			if (!verify(bitmap, reference))
+				return EXIT_FAILURE;
+
+			std::vector<std::pair<uint32_t, uint32_t>> seen;
+			bitmap.for_each_run([&](uint32_t offset, uint32_t count) { seen.emplace_back(offset, count); });
+			std::vector<std::pair<uint32_t, uint32_t>> expected;
+			for (auto &run : runs)
+				if (run.count)
+					expected.emplace_back(run.offset, run.count);
+
+			if (seen != expected)
+			{
+				LOGE("Full word runs were not reported as single runs.\n");
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	// Overlapping concurrent writers must end up with the union, regardless of interleaving.
+	bitmap.clear();
+	reference.clear();
+	constexpr unsigned NumThreads = 8;
+	std::vector<std::vector<uint32_t>> per_thread(NumThreads);
+	for (auto &indices : per_thread)
+	{
+		for (unsigned i = 0; i < 20000; i++)
+		{
+			uint32_t index = rnd() % (bitmap.get_num_bits() / 16);
+			indices.push_back(index);
+			reference.insert(index);
+		}
+	}
+
+	std::vector<std::thread> threads;
+	for (auto &indices : per_thread)
+	{
+		threads.emplace_back([&bitmap, &indices]() {
+			for (auto index : indices)
+				bitmap.set(index);
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	if (!verify(bitmap, reference))
+		return EXIT_FAILURE;
+
+	bitmap.clear();
+	if (bitmap.count() != 0)
+	{
+		LOGE("Bitmap is not empty after clear.\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("All atomic bitmap tests passed.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "bvh.hpp"
+#include "simd.hpp"
+#include "muglm/muglm_impl.hpp"
+#include "muglm/matrix_helper.hpp"
+#include "logging.hpp"
+#include "transforms.hpp"
+#include <random>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace Granite;
+
+static void randomize_aabb(AABB &aabb, std::mt19937 &rnd)
+{
+	std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 4.0f);
+	vec3 c(pos(rnd), pos(rnd), pos(rnd));
+	vec3 r(size(rnd), size(rnd), size(rnd));
+	aabb = AABB(c - r, c + r);
+}
+
+int main()
+{
+	std::mt19937 rnd(1);
+	std::vector<AABB> aabbs(5000);
+	std::vector<BVH::Leaf> leaves;
+
+	for (uint32_t i = 0; i < aabbs.size(); i++)
+	{
+		randomize_aabb(aabbs[i], rnd);
+		// Not every AABB is part of the hierarchy.
+		if (i & 1)
+			leaves.push_back({ i, i * 10 });
+	}
+
+	BVH bvh;
+	bvh.build(aabbs.data(), leaves.data(), leaves.size());
+
+	for (unsigned iter = 0; iter < 64; iter++)
+	{
+		std::vector<uint32_t> updates;
+		for (unsigned i = 0; i < 100; i++)
+		{
+			uint32_t index = rnd() % aabbs.size();
+			randomize_aabb(aabbs[index], rnd);
+			updates.push_back(index);
+		}
+
+		if (iter & 1)
+			bvh.refit(aabbs.data(), updates.data(), updates.size());
+		else
+			bvh.refit_all(aabbs.data());
+
+		if (bvh.needs_rebuild())
+			bvh.build(aabbs.data(), leaves.data(), leaves.size());
+
+		mat4 proj = projection(0.5f, 1.0f, 1.0f, 50.0f + float(iter));
+		mat4 view = mat4_cast(angleAxis(0.1f * float(iter), vec3(0.0f, 1.0f, 0.0f)));
+		Frustum frustum;
+		frustum.build_planes(inverse(proj * view));
+
+		std::vector<uint32_t> reference, visible, visible_subset;
+		for (auto &leaf : leaves)
+			if (SIMD::frustum_cull(aabbs[leaf.aabb_offset], frustum.get_planes()))
+				reference.push_back(leaf.index);
+
+		bvh.for_each_visible(aabbs.data(), frustum, [&](uint32_t index) {
+			visible.push_back(index);
+		});
+
+		for (unsigned i = 0; i < 7; i++)
+		{
+			bvh.for_each_visible_subset(aabbs.data(), frustum, i, 7, [&](uint32_t index) {
+				visible_subset.push_back(index);
+			});
+		}
+
+		std::sort(reference.begin(), reference.end());
+		std::sort(visible.begin(), visible.end());
+		std::sort(visible_subset.begin(), visible_subset.end());
+
+		if (reference != visible || reference != visible_subset)
+		{
+			LOGE("BVH culling mismatch in iteration %u (%zu, %zu, %zu).\n",
+			     iter, reference.size(), visible.size(), visible_subset.size());
+			exit(1);
+		}
+	}
+
+	LOGI("BVH test passed with %u task roots.\n", bvh.get_task_root_count());
+}
@@ -0,0 +1,135 @@
+#include "lru_cache.hpp"
+#include "concurrent_lru_cache.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <thread>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace Util;
+
+// Resource cache style workload: mostly hits on a hot working set, misses allocate.
+static constexpr unsigned NumKeys = 64 * 1024;
+static constexpr unsigned LookupsPerThread = 1000000;
+
+struct MutexCache
+{
+	LRUCache<uint64_t> cache;
+	std::mutex lock;
+
+	uint64_t lookup(uint64_t cookie)
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		auto *v = cache.find_and_mark_as_recent(cookie);
+		if (!v)
+		{
+			v = cache.allocate(cookie, 1);
+			*v = cookie;
+		}
+		return *v;
+	}
+};
+
+struct ShardedCache
+{
+	ConcurrentLRUCache<uint64_t> cache;
+
+	uint64_t lookup(uint64_t cookie)
+	{
+		return *cache.find_or_allocate(cookie, 1, [cookie](uint64_t &v) { v = cookie; });
+	}
+};
+
+template <typename Cache>
+static double run_threads(Cache &cache, unsigned num_threads)
+{
+	std::vector<std::thread> threads;
+	auto start = get_current_time_nsecs();
+
+	for (unsigned i = 0; i < num_threads; i++)
+	{
+		threads.emplace_back([&cache, i]() {
+			std::mt19937 rnd(i);
+			// Skewed towards low keys, roughly like a frame's working set.
+			std::uniform_real_distribution<double> dist(0.0, 1.0);
+			uint64_t sum = 0;
+			for (unsigned j = 0; j < LookupsPerThread; j++)
+			{
+				double v = dist(rnd);
+				sum += cache.lookup(uint64_t(v * v * v * NumKeys));
+			}
+			if (sum == 0)
+				LOGI("Sum: %llu\n", static_cast<unsigned long long>(sum));
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	auto end = get_current_time_nsecs();
+	return double(num_threads) * LookupsPerThread / (1e-9 * double(end - start));
+}
+
+static bool sanity_check()
+{
+	ConcurrentLRUCache<unsigned> cache;
+	cache.set_total_cost(20);
+	*cache.allocate(1, 10) = 1;
+	*cache.allocate(2, 10) = 2;
+	*cache.allocate(3, 10) = 3;
+	*cache.allocate(4, 10) = 4;
+
+	if (cache.get_current_cost() != 40 || !cache.erase(1) || cache.get_current_cost() != 30)
+		return false;
+
+	// 4 is referenced, so 2 or 3 must go first.
+	cache.find_and_mark_as_recent(4);
+	cache.prune();
+	if (cache.get_current_cost() != 20 || !cache.find_and_mark_as_recent(4))
+		return false;
+
+	// Evicted entries go first, no matter the reference bit.
+	cache.evict(4);
+	cache.set_total_cost(10);
+	cache.prune();
+	return !cache.find_and_mark_as_recent(4) && cache.get_current_cost() == 10;
+}
+
+int main()
+{
+	if (!sanity_check())
+	{
+		LOGE("Sanity check failed.\n");
+		return EXIT_FAILURE;
+	}
+
+	unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned> thread_counts;
+	for (unsigned num_threads = 1; num_threads < max_threads; num_threads *= 2)
+		thread_counts.push_back(num_threads);
+	thread_counts.push_back(max_threads);
+
+	for (unsigned num_threads : thread_counts)
+	{
+		MutexCache mutex_cache;
+		ShardedCache sharded_cache;
+		mutex_cache.cache.set_total_cost(NumKeys / 2);
+		sharded_cache.cache.set_total_cost(NumKeys / 2);
+
+		// Two "frames" with a prune at the boundary, only the second one is timed.
+		run_threads(mutex_cache, num_threads);
+		run_threads(sharded_cache, num_threads);
+		mutex_cache.cache.prune();
+		sharded_cache.cache.prune();
+
+		double mutex_rate = run_threads(mutex_cache, num_threads);
+		double sharded_rate = run_threads(sharded_cache, num_threads);
+		LOGI("%2u threads: LRUCache + mutex %7.2f Mlookups/s, ConcurrentLRUCache %7.2f Mlookups/s.\n",
+		     num_threads, 1e-6 * mutex_rate, 1e-6 * sharded_rate);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,284 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "arena_allocator.hpp"
+#include "defragmentation_planner.hpp"
+#include "logging.hpp"
+#include <random>
+#include <unordered_map>
+#include <stdlib.h>
+
+using namespace Util;
+
+struct MockArena;
+
+// Stands in for a DeviceAllocation. Backing heaps are just numbered blocks.
+struct MockAllocation
+{
+	uint32_t block = UINT32_MAX;
+	uint32_t offset = 0;
+	uint32_t size = 0;
+	uint32_t mask = 0;
+	IntrusiveList<LegionHeap<MockAllocation>>::Iterator heap = {};
+};
+
+struct MockArena : ArenaAllocator<MockArena, MockAllocation>
+{
+	uint32_t next_block = 0;
+	uint32_t live_blocks = 0;
+
+	bool allocate_backing_heap(MockAllocation *alloc)
+	{
+		*alloc = {};
+		alloc->block = next_block++;
+		live_blocks++;
+		return true;
+	}
+
+	void free_backing_heap(MockAllocation *)
+	{
+		live_blocks--;
+	}
+
+	void prepare_allocation(MockAllocation *alloc, IntrusiveList<MiniHeap>::Iterator heap,
+	                        const SuballocationResult &suballoc)
+	{
+		alloc->block = heap->allocation.block;
+		alloc->offset = suballoc.offset;
+		alloc->size = suballoc.size;
+		alloc->mask = suballoc.mask;
+		alloc->heap = heap;
+		heap->live_size += suballoc.size;
+	}
+};
+
+struct Object
+{
+	MockAllocation alloc;
+	uint32_t size;
+	bool live;
+};
+
+static uint64_t memory_key(const MockAllocation &alloc)
+{
+	return (uint64_t(alloc.block) << 32) | alloc.offset;
+}
+
+static uint64_t heap_id(const LegionHeap<MockAllocation> *heap)
+{
+	return uint64_t(reinterpret_cast<uintptr_t>(heap));
+}
+
+struct MockDevice
+{
+	ObjectPool<LegionHeap<MockAllocation>> pool;
+	MockArena arena;
+	// Simulated memory contents, one word per allocation.
+	std::unordered_map<uint64_t, uint32_t> memory;
+
+	MockDevice()
+	{
+		arena.set_sub_block_size(1024);
+		arena.set_object_pool(&pool);
+	}
+
+	bool allocate(Object &obj, uint32_t payload)
+	{
+		if (!arena.allocate(obj.size, &obj.alloc))
+			return false;
+		if (memory.count(memory_key(obj.alloc)))
+		{
+			LOGE("Allocation overlaps a live allocation.\n");
+			return false;
+		}
+		memory[memory_key(obj.alloc)] = payload;
+		obj.live = true;
+		return true;
+	}
+
+	void free(Object &obj)
+	{
+		memory.erase(memory_key(obj.alloc));
+		obj.alloc.heap->live_size -= obj.alloc.size;
+		arena.free(obj.alloc.heap, obj.alloc.mask);
+		obj.live = false;
+	}
+
+	void gather_heaps(std::vector<DefragmentationHeapInfo> &heaps) const
+	{
+		heaps.clear();
+		arena.for_each_heap([&](const LegionHeap<MockAllocation> &heap) {
+			heaps.push_back({ heap_id(&heap), arena.get_max_allocation_size(), heap.live_size, heap.live_size });
+		});
+	}
+};
+
+int main()
+{
+	std::mt19937 rnd(42);
+	MockDevice dev;
+	std::vector<Object> objects(4000);
+
+	for (uint32_t i = 0; i < objects.size(); i++)
+	{
+		objects[i].size = std::uniform_int_distribution<uint32_t>(1, 8 * 1024)(rnd);
+		if (!dev.allocate(objects[i], i))
+			return EXIT_FAILURE;
+	}
+
+	// Streaming-like churn, leaves most heaps sparsely populated.
+	for (auto &obj : objects)
+		if (std::uniform_int_distribution<uint32_t>(0, 99)(rnd) < 80)
+			dev.free(obj);
+
+	DefragmentationPlanner planner;
+	DefragmentationOptions options;
+	options.max_occupancy = 0.5f;
+	options.max_bytes_per_step = 64 * 1024;
+	options.max_heaps_per_pass = 8;
+	planner.set_options(options);
+
+	std::vector<DefragmentationHeapInfo> heaps;
+	dev.gather_heaps(heaps);
+	auto before = planner.compute_stats(heaps.data(), heaps.size());
+	LOGI("Before: %u heaps, %u sparse, fragmentation %.3f.\n",
+	     unsigned(before.heap_count), unsigned(before.sparse_heap_count), before.get_fragmentation());
+
+	if (before.heap_count != dev.arena.live_blocks)
+	{
+		LOGE("Heap enumeration does not match backing allocations.\n");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint64_t> selected;
+	std::vector<DefragmentationAllocationInfo> allocations;
+	std::vector<DefragmentationMove> moves;
+	std::unordered_map<uint64_t, LegionHeap<MockAllocation> *> heap_lookup;
+	unsigned total_steps = 0;
+
+	for (unsigned pass = 0; pass < 64; pass++)
+	{
+		dev.gather_heaps(heaps);
+		planner.select_heaps(heaps.data(), heaps.size(), selected);
+		if (selected.empty())
+			break;
+
+		heap_lookup.clear();
+		dev.arena.for_each_heap([&](LegionHeap<MockAllocation> &heap) { heap_lookup[heap_id(&heap)] = &heap; });
+		for (auto id : selected)
+			dev.arena.retire_heap(heap_lookup[id]);
+
+		allocations.clear();
+		for (uint32_t i = 0; i < objects.size(); i++)
+			if (objects[i].live)
+				allocations.push_back({ i, heap_id(objects[i].alloc.heap.get()), objects[i].alloc.size });
+
+		uint32_t steps = planner.plan_moves(allocations.data(), allocations.size(), selected, moves);
+		total_steps += steps;
+
+		uint32_t current_step = 0;
+		uint64_t step_bytes = 0;
+		for (auto &move : moves)
+		{
+			if (move.step != current_step)
+			{
+				current_step = move.step;
+				step_bytes = 0;
+			}
+
+			step_bytes += move.size;
+			if (step_bytes > options.max_bytes_per_step && step_bytes != move.size)
+			{
+				LOGE("Step exceeds byte budget.\n");
+				return EXIT_FAILURE;
+			}
+
+			// Allocate the new copy before releasing the old one, like a GPU copy would.
+			auto &obj = objects[move.object_id];
+			Object relocated = obj;
+			uint32_t payload = dev.memory[memory_key(obj.alloc)];
+			if (!dev.allocate(relocated, payload))
+				return EXIT_FAILURE;
+
+			if (relocated.alloc.heap->retired)
+			{
+				LOGE("Relocated allocation landed in a retired heap.\n");
+				return EXIT_FAILURE;
+			}
+
+			dev.free(obj);
+			obj = relocated;
+		}
+
+		// Evacuated heaps are released by the last free.
+		dev.arena.for_each_heap([&](const LegionHeap<MockAllocation> &heap) {
+			if (heap.retired)
+			{
+				LOGE("Retired heap was not released after evacuation.\n");
+				exit(EXIT_FAILURE);
+			}
+		});
+		dev.arena.restore_retired_heaps();
+	}
+
+	dev.gather_heaps(heaps);
+	auto after = planner.compute_stats(heaps.data(), heaps.size());
+	LOGI("After %u steps: %u heaps, %u sparse, fragmentation %.3f.\n",
+	     total_steps, unsigned(after.heap_count), unsigned(after.sparse_heap_count), after.get_fragmentation());
+
+	if (after.live_size != before.live_size)
+	{
+		LOGE("Live size changed during compaction.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (after.heap_count >= before.heap_count || after.get_fragmentation() >= before.get_fragmentation())
+	{
+		LOGE("Compaction did not release any heaps.\n");
+		return EXIT_FAILURE;
+	}
+
+	for (uint32_t i = 0; i < objects.size(); i++)
+	{
+		if (!objects[i].live)
+			continue;
+		auto itr = dev.memory.find(memory_key(objects[i].alloc));
+		if (itr == dev.memory.end() || itr->second != i)
+		{
+			LOGE("Object %u lost its contents.\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (auto &obj : objects)
+		if (obj.live)
+			dev.free(obj);
+
+	if (dev.arena.live_blocks != 0)
+	{
+		LOGE("Leaked backing heaps.\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("Defragmentation test passed.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#include "glyph_cache.hpp"
+#include "global_managers_init.hpp"
+#include "filesystem.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+using namespace Granite;
+
+// UI style text: a mix of short labels and longer lines, some of them non-ASCII.
+static std::vector<std::string> build_strings(unsigned count)
+{
+	static const char *fragments[] = {
+		"Frame time", "Résumé", "Überprüfung", "Ωmega", "naïve café",
+		"Привет", "→ next", "€ 12.50", "Load scene", "Quit",
+	};
+
+	std::vector<std::string> strings;
+	strings.reserve(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		std::string str = fragments[i % 10];
+		str += ": ";
+		str += std::to_string(i);
+		if (i % 3 == 0)
+		{
+			str += "\n";
+			str += fragments[(i * 7) % 10];
+		}
+		strings.push_back(std::move(str));
+	}
+	return strings;
+}
+
+static double layout_ms(GlyphCache &cache, const std::vector<std::string> &strings, float size)
+{
+	auto start = Util::get_current_time_nsecs();
+	float checksum = 0.0f;
+	for (auto &str : strings)
+		checksum += cache.layout_text(str.c_str(), size).geometry.x;
+	auto end = Util::get_current_time_nsecs();
+
+	// Keep the loop from being optimized away.
+	if (checksum < 0.0f)
+		LOGI("Checksum: %f\n", checksum);
+	return 1e-6 * double(end - start);
+}
+
+// Once the atlas is full, glyphs which are already cached must keep their location until the owner flushes it,
+// since text queued earlier in the frame still refers to them.
+static bool check_full_atlas(GlyphCache &cache)
+{
+	const auto *a = cache.get_glyph('A');
+	if (!a)
+		return false;
+	unsigned tex_x = a->tex_x;
+	unsigned tex_y = a->tex_y;
+	uint64_t generation = cache.get_atlas_generation();
+
+	uint32_t refused = 0;
+	for (uint32_t c = 0x100; c < 0x10000 && !refused; c++)
+		if (!cache.get_glyph(c))
+			refused = c;
+
+	if (!refused || !cache.is_atlas_full())
+	{
+		LOGE("Failed to fill the glyph atlas.\n");
+		return false;
+	}
+
+	a = cache.get_glyph('A');
+	if (!a || a->tex_x != tex_x || a->tex_y != tex_y || cache.get_atlas_generation() != generation)
+	{
+		LOGE("Cached glyphs moved while the atlas was full.\n");
+		return false;
+	}
+
+	if (!cache.flush_full_atlas() || cache.is_atlas_full() || cache.get_atlas_generation() == generation)
+	{
+		LOGE("Full atlas was not flushed.\n");
+		return false;
+	}
+
+	if (!cache.get_glyph(refused))
+	{
+		LOGE("Refused glyph U+%04X is still missing after flush.\n", refused);
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+
+	const char *path = argc >= 2 ? argv[1] : "builtin://fonts/font.ttf";
+	auto mapping = GRANITE_FILESYSTEM()->open_readonly_mapping(path);
+	if (!mapping)
+	{
+		LOGE("Failed to open %s.\n", path);
+		return EXIT_FAILURE;
+	}
+
+	{
+		// Everything here runs without a device, only the CPU side of text rendering is measured.
+		GlyphCache cache;
+		if (!cache.init(mapping->data(), mapping->get_size()))
+		{
+			LOGE("Failed to parse %s.\n", path);
+			return EXIT_FAILURE;
+		}
+
+		auto start = Util::get_current_time_nsecs();
+		unsigned rasterized = 0;
+		for (uint32_t c = 32; c < 0x250; c++)
+			if (cache.get_glyph(c))
+				rasterized++;
+		double raster = 1e-6 * double(Util::get_current_time_nsecs() - start);
+		LOGI("Rasterized %u SDF glyphs in %.3f ms (%.3f us / glyph).\n",
+		     rasterized, raster, 1e3 * raster / double(rasterized));
+
+		auto strings = build_strings(2000);
+		double cold = layout_ms(cache, strings, 16.0f);
+		double warm = layout_ms(cache, strings, 16.0f);
+		double other_size = layout_ms(cache, strings, 24.0f);
+		LOGI("%u strings: cold layout %.3f ms, cached layout %.3f ms, new size %.3f ms.\n",
+		     unsigned(strings.size()), cold, warm, other_size);
+
+		if (!check_full_atlas(cache))
+		{
+			Global::deinit();
+			return EXIT_FAILURE;
+		}
+	}
+
+	Global::deinit();
+	return EXIT_SUCCESS;
+}
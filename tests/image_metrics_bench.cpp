@@ -0,0 +1,190 @@
+#include "image_metrics.hpp"
+#include "memory_mapped_texture.hpp"
+#include "thread_group.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+// Smooth gradients as the reference, and a copy with noise and a few hard edges
+// as the image under test, similar to a regression frame with small rendering differences.
+static void build_image(std::vector<float> &texels, unsigned size, bool distort)
+{
+	std::mt19937 rnd(1337);
+	std::uniform_real_distribution<float> noise(-0.02f, 0.02f);
+	texels.resize(size * size * 4);
+
+	for (unsigned y = 0; y < size; y++)
+	{
+		for (unsigned x = 0; x < size; x++)
+		{
+			float *t = &texels[4 * (y * size + x)];
+			t[0] = float(x) / float(size);
+			t[1] = float(y) / float(size);
+			t[2] = ((x / 64 + y / 64) & 1) ? 0.75f : 0.25f;
+			t[3] = 1.0f;
+
+			if (distort)
+			{
+				for (unsigned c = 0; c < 3; c++)
+					t[c] = muglm::clamp(t[c] + noise(rnd), 0.0f, 1.0f);
+				if (((x + y) & 255) == 0)
+					t[2] = 1.0f - t[2];
+			}
+		}
+	}
+}
+
+static MemoryMappedTexture create_texture(const std::vector<float> &texels, unsigned size, VkFormat format)
+{
+	MemoryMappedTexture tex;
+	tex.set_2d(format, size, size);
+	if (!tex.map_write_scratch())
+		return {};
+
+	auto &layout = tex.get_layout();
+	for (unsigned y = 0; y < size; y++)
+	{
+		for (unsigned x = 0; x < size; x++)
+		{
+			const float *t = &texels[4 * (y * size + x)];
+			if (format == VK_FORMAT_R8G8B8A8_UNORM)
+			{
+				auto *dst = layout.data_2d<uint8_t>(x, y);
+				for (unsigned c = 0; c < 4; c++)
+					dst[c] = uint8_t(t[c] * 255.0f + 0.5f);
+			}
+			else if (format == VK_FORMAT_R16G16B16A16_SFLOAT)
+			{
+				auto *dst = layout.data_2d<uint16_t>(x, y);
+				for (unsigned c = 0; c < 4; c++)
+					dst[c] = muglm::floatToHalf(t[c]);
+			}
+			else
+				memcpy(layout.data_2d<float>(x, y), t, 4 * sizeof(float));
+		}
+	}
+
+	return tex;
+}
+
+// The per-pixel loop image-compare used before, as a baseline.
+static double legacy_psnr(const TextureFormatLayout &a, const TextureFormatLayout &b)
+{
+	int width = a.get_width();
+	int height = a.get_height();
+	auto *src_a = static_cast<const uint8_t *>(a.data());
+	auto *src_b = static_cast<const uint8_t *>(b.data());
+
+	double peak_energy = 255.0 * 255.0 * width * height * 3.0;
+	double error_energy = 0.0;
+	for (int pix = 0; pix < width * height; pix++, src_a += 4, src_b += 4)
+	{
+		for (unsigned c = 0; c < 3; c++)
+		{
+			int diff = src_a[c] - src_b[c];
+			error_energy += diff * diff;
+		}
+	}
+
+	return 10.0 * muglm::log10(peak_energy / error_energy);
+}
+
+static double time_metrics(const TextureFormatLayout &a, const TextureFormatLayout &b,
+                           ImageMetricFlags flags, ImageMetrics &metrics, ThreadGroup *group)
+{
+	auto start = Util::get_current_time_nsecs();
+	if (!compute_image_metrics(a, b, flags, metrics, group))
+		return -1.0;
+	auto end = Util::get_current_time_nsecs();
+	return 1e-9 * double(end - start);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned size = argc >= 2 ? unsigned(strtoul(argv[1], nullptr, 0)) : 2048;
+	unsigned num_threads = argc >= 3 ? unsigned(strtoul(argv[2], nullptr, 0)) : 4;
+
+	if (!size || !num_threads)
+	{
+		LOGE("Usage: image-metrics-bench [size] [threads]\n");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<float> reference, distorted;
+	build_image(reference, size, false);
+	build_image(distorted, size, true);
+
+	ThreadGroup group;
+	group.start(num_threads, 0, {});
+
+	const ImageMetricFlags all_metrics = IMAGE_METRIC_PSNR_BIT | IMAGE_METRIC_SSIM_BIT | IMAGE_METRIC_FLIP_BIT;
+	double mpixels = 1e-6 * double(size) * double(size);
+	LOGI("Image metrics %u x %u, %u threads.\n", size, size, num_threads);
+
+	static const struct
+	{
+		VkFormat format;
+		const char *name;
+	} formats[] = {
+		{ VK_FORMAT_R8G8B8A8_UNORM, "RGBA8" },
+		{ VK_FORMAT_R16G16B16A16_SFLOAT, "RGBA16F" },
+		{ VK_FORMAT_R32G32B32A32_SFLOAT, "RGBA32F" },
+	};
+
+	for (auto &fmt : formats)
+	{
+		auto a = create_texture(reference, size, fmt.format);
+		auto b = create_texture(distorted, size, fmt.format);
+		if (a.empty() || b.empty())
+		{
+			LOGE("Failed to create textures.\n");
+			return EXIT_FAILURE;
+		}
+
+		ImageMetrics psnr_metrics, inline_metrics, threaded_metrics;
+		double psnr_time = time_metrics(a.get_layout(), b.get_layout(), IMAGE_METRIC_PSNR_BIT, psnr_metrics, nullptr);
+		double inline_time = time_metrics(a.get_layout(), b.get_layout(), all_metrics, inline_metrics, nullptr);
+		double threaded_time = time_metrics(a.get_layout(), b.get_layout(), all_metrics, threaded_metrics, &group);
+
+		if (psnr_time < 0.0 || inline_time < 0.0 || threaded_time < 0.0)
+			return EXIT_FAILURE;
+
+		// Strips are reduced in a fixed order, so threading must not change the result.
+		if (memcmp(&inline_metrics, &threaded_metrics, sizeof(ImageMetrics)) != 0)
+		{
+			LOGE("%s: threaded metrics do not match inline metrics.\n", fmt.name);
+			return EXIT_FAILURE;
+		}
+
+		LOGI("%s: PSNR %.2f dB, SSIM %.5f, FLIP %.5f\n", fmt.name,
+		     inline_metrics.psnr_rgb, inline_metrics.ssim, inline_metrics.flip);
+
+		if (fmt.format == VK_FORMAT_R8G8B8A8_UNORM)
+		{
+			auto start = Util::get_current_time_nsecs();
+			double psnr = legacy_psnr(a.get_layout(), b.get_layout());
+			auto end = Util::get_current_time_nsecs();
+			double legacy_time = 1e-9 * double(end - start);
+
+			if (muglm::abs(psnr - psnr_metrics.psnr_rgb) > 0.01)
+			{
+				LOGE("PSNR mismatch, expected %.3f dB, got %.3f dB.\n", psnr, psnr_metrics.psnr_rgb);
+				return EXIT_FAILURE;
+			}
+
+			LOGI("  Legacy PSNR: %.2f MP / s\n", mpixels / legacy_time);
+		}
+
+		LOGI("  PSNR, inline: %.2f MP / s\n", mpixels / psnr_time);
+		LOGI("  All metrics, inline: %.2f MP / s\n", mpixels / inline_time);
+		LOGI("  All metrics, threaded: %.2f MP / s (%.2fx)\n", mpixels / threaded_time, inline_time / threaded_time);
+	}
+}
@@ -0,0 +1,106 @@
+#include "device.hpp"
+#include "context.hpp"
+#include "memory_defragmenter.hpp"
+#include "logging.hpp"
+#include <vector>
+#include <stdlib.h>
+
+using namespace Vulkan;
+
+static uint64_t count_blocks(MemoryDefragmenter &defrag)
+{
+	Util::FragmentationStats stats[VK_MAX_MEMORY_HEAPS];
+	defrag.get_fragmentation_stats(stats);
+	uint64_t count = 0;
+	for (auto &s : stats)
+		count += s.heap_count;
+	return count;
+}
+
+int main()
+{
+	if (!Context::init_loader(nullptr))
+		return EXIT_FAILURE;
+	Context ctx;
+	if (!ctx.init_instance_and_device(nullptr, 0, nullptr, 0))
+		return EXIT_FAILURE;
+	Device dev;
+	dev.set_context(ctx);
+
+	MemoryDefragmenter defrag(dev);
+
+	// 64 KiB lands in the Medium class, whose heaps are nested two levels deep inside a block.
+	BufferCreateInfo info = {};
+	info.size = 64 * 1024;
+	info.domain = BufferDomain::Device;
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+	             VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+	             VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	// 256 MiB in total, i.e. a handful of blocks.
+	constexpr unsigned NumBuffers = 4 * 1024;
+	std::vector<BufferHandle> buffers(NumBuffers);
+	for (auto &buffer : buffers)
+	{
+		buffer = dev.create_buffer(info);
+		if (!buffer)
+		{
+			LOGE("Failed to create buffer.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	unsigned moved = 0;
+	bool failed = false;
+
+	// Keep every fourth buffer. Every block becomes sparse and its nested heaps are left with holes,
+	// which is exactly where replacements must not go.
+	for (unsigned i = 0; i < NumBuffers; i++)
+	{
+		if (i & 3)
+		{
+			buffers[i].reset();
+			continue;
+		}
+
+		defrag.register_buffer(buffers[i], [&, i](const BufferHandle &buffer) {
+			if (DeviceAllocator::get_block_id(buffer->get_allocation()) ==
+			    DeviceAllocator::get_block_id(buffers[i]->get_allocation()))
+			{
+				LOGE("Buffer %u was relocated into the block it was evacuated from.\n", i);
+				failed = true;
+			}
+			buffers[i] = buffer;
+			moved++;
+		});
+	}
+
+	dev.wait_idle();
+	uint64_t blocks_before = count_blocks(defrag);
+
+	if (!defrag.begin_pass())
+	{
+		LOGE("Expected sparse blocks to evacuate.\n");
+		return EXIT_FAILURE;
+	}
+
+	while (defrag.step())
+		dev.next_frame_context();
+	dev.wait_idle();
+
+	uint64_t blocks_after = count_blocks(defrag);
+	LOGI("Relocated %u buffers, %llu blocks -> %llu blocks.\n", moved,
+	     static_cast<unsigned long long>(blocks_before),
+	     static_cast<unsigned long long>(blocks_after));
+
+	if (failed)
+		return EXIT_FAILURE;
+
+	if (moved == 0 || blocks_after >= blocks_before)
+	{
+		LOGE("Evacuated blocks were not released.\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
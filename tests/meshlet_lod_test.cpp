@@ -0,0 +1,222 @@
+#include "meshlet_export.hpp"
+#include "meshlet.hpp"
+#include "global_managers_init.hpp"
+#include "filesystem.hpp"
+#include "logging.hpp"
+#include "math.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan::Meshlet;
+
+// A bumpy grid, which simplifies well, but not trivially.
+static SceneFormats::Mesh build_grid_mesh(unsigned size)
+{
+	std::vector<vec3> positions;
+	std::vector<uint32_t> indices;
+
+	for (unsigned y = 0; y <= size; y++)
+	{
+		for (unsigned x = 0; x <= size; x++)
+		{
+			vec2 p = 2.0f * vec2(float(x), float(y)) / float(size) - 1.0f;
+			positions.emplace_back(p.x, p.y, 0.1f * sinf(4.0f * p.x) * cosf(3.0f * p.y));
+		}
+	}
+
+	for (unsigned y = 0; y < size; y++)
+	{
+		for (unsigned x = 0; x < size; x++)
+		{
+			uint32_t i = y * (size + 1) + x;
+			uint32_t quad[] = { i, i + 1, i + size + 1, i + size + 1, i + 1, i + size + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	SceneFormats::Mesh mesh;
+	mesh.index_type = VK_INDEX_TYPE_UINT32;
+	mesh.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	mesh.count = uint32_t(indices.size());
+	mesh.indices.resize(indices.size() * sizeof(uint32_t));
+	memcpy(mesh.indices.data(), indices.data(), mesh.indices.size());
+
+	mesh.attribute_layout[int(MeshAttribute::Position)].format = VK_FORMAT_R32G32B32_SFLOAT;
+	mesh.position_stride = sizeof(vec3);
+	mesh.positions.resize(positions.size() * sizeof(vec3));
+	memcpy(mesh.positions.data(), positions.data(), mesh.positions.size());
+	mesh.static_aabb = AABB(vec3(-1.0f), vec3(1.0f));
+	return mesh;
+}
+
+static uint32_t get_primitive_count(const MeshView &view, uint32_t meshlet_index)
+{
+	return view.streams[meshlet_index * view.format_header->stream_count + int(StreamType::Primitive)].u.counts.prim_count;
+}
+
+// Selects every meshlet whose own error is acceptable, but whose parent's error is not.
+static uint32_t count_cut_primitives(const MeshView &view, float threshold)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < view.num_lod_bounds; i++)
+	{
+		auto &lod = view.lod_bounds[i];
+		if (lod.error <= threshold && lod.parent_error > threshold)
+			count += get_primitive_count(view, i);
+	}
+	return count;
+}
+
+static bool validate_hierarchy(const MeshView &view)
+{
+	auto &header = *view.format_header;
+	if (header.lod_level_count < 2)
+	{
+		LOGE("Expected more than one LOD level, got %u.\n", header.lod_level_count);
+		return false;
+	}
+
+	uint32_t level = 0;
+	for (uint32_t i = 0; i < view.num_lod_bounds; i++)
+	{
+		auto &lod = view.lod_bounds[i];
+
+		// Padding at the end of a level.
+		if (!get_primitive_count(view, i))
+		{
+			if (i < view.num_bounds || lod.error != std::numeric_limits<float>::max())
+			{
+				LOGE("Unexpected empty meshlet %u.\n", i);
+				return false;
+			}
+			continue;
+		}
+
+		if (lod.level != level)
+		{
+			if (lod.level != level + 1 || (i % ChunkFactor) != 0)
+			{
+				LOGE("LOD level %u does not start on a chunk boundary.\n", lod.level);
+				return false;
+			}
+			level = lod.level;
+		}
+
+		if ((i < view.num_bounds) != (level == 0))
+		{
+			LOGE("Full detail meshlets must come first.\n");
+			return false;
+		}
+
+		if (level == 0 && lod.error != 0.0f)
+		{
+			LOGE("Full detail meshlet %u has non-zero error.\n", i);
+			return false;
+		}
+
+		if (lod.error > lod.parent_error)
+		{
+			LOGE("Error is not monotonic for meshlet %u.\n", i);
+			return false;
+		}
+	}
+
+	if (level + 1 != header.lod_level_count)
+	{
+		LOGE("Expected %u LOD levels, found %u.\n", header.lod_level_count, level + 1);
+		return false;
+	}
+
+	// Any error threshold must select a complete cut, and coarser thresholds must not add triangles.
+	std::vector<float> thresholds;
+	for (uint32_t i = 0; i < view.num_lod_bounds; i++)
+		if (get_primitive_count(view, i) && view.lod_bounds[i].error != std::numeric_limits<float>::max())
+			thresholds.push_back(view.lod_bounds[i].error);
+	std::sort(thresholds.begin(), thresholds.end());
+	thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+
+	uint32_t prev_count = UINT32_MAX;
+	for (float threshold : thresholds)
+	{
+		uint32_t count = count_cut_primitives(view, threshold);
+		if (count == 0 || count > prev_count)
+		{
+			LOGE("Invalid cut at error %g, %u primitives.\n", threshold, count);
+			return false;
+		}
+		prev_count = count;
+	}
+
+	if (thresholds.empty() || thresholds.front() != 0.0f || prev_count >= view.total_primitives)
+	{
+		LOGE("Coarsest cut did not reduce the primitive count.\n");
+		return false;
+	}
+
+	LOGI("%u LOD levels, %u -> %u primitives.\n", header.lod_level_count, view.total_primitives, prev_count);
+	return true;
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_FILESYSTEM_BIT);
+
+	auto mesh = build_grid_mesh(64);
+	if (!Meshlet::export_mesh_to_meshlet("memory://base.msh", mesh, MeshStyle::Wireframe) ||
+	    !Meshlet::export_mesh_to_meshlet("memory://lod.msh", mesh, MeshStyle::Wireframe,
+	                                     Meshlet::EXPORT_LOD_HIERARCHY_BIT))
+	{
+		LOGE("Failed to export meshlet.\n");
+		return EXIT_FAILURE;
+	}
+
+	auto base_file = GRANITE_FILESYSTEM()->open("memory://base.msh", FileMode::ReadOnly);
+	auto lod_file = GRANITE_FILESYSTEM()->open("memory://lod.msh", FileMode::ReadOnly);
+	if (!base_file || !lod_file)
+		return EXIT_FAILURE;
+
+	auto base_mapping = base_file->map();
+	auto lod_mapping = lod_file->map();
+	if (!base_mapping || !lod_mapping)
+		return EXIT_FAILURE;
+
+	auto base = create_mesh_view(*base_mapping);
+	auto lod = create_mesh_view(*lod_mapping);
+	if (!base.format_header || !lod.format_header)
+	{
+		LOGE("Failed to parse meshlet.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (base.format_header->lod_level_count != 1 || base.num_lod_bounds != base.num_bounds)
+	{
+		LOGE("Plain export must not contain LOD levels.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Runtimes which ignore the hierarchy must observe exactly the plain export.
+	if (lod.num_bounds != base.num_bounds || lod.num_bounds_256 != base.num_bounds_256 ||
+	    lod.total_primitives != base.total_primitives || lod.total_vertices != base.total_vertices ||
+	    memcmp(lod.bounds, base.bounds, base.num_bounds * sizeof(Bound)) != 0 ||
+	    memcmp(lod.bounds_256, base.bounds_256, base.num_bounds_256 * sizeof(Bound)) != 0)
+	{
+		LOGE("Full detail level differs from plain export.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (base.total_primitives != mesh.count / 3)
+	{
+		LOGE("Primitive count mismatch, expected %u, got %u.\n", mesh.count / 3, base.total_primitives);
+		return EXIT_FAILURE;
+	}
+
+	if (!validate_hierarchy(lod))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
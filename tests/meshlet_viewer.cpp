@@ -100,11 +100,15 @@ struct MeshletViewerApplication : Granite::Application, Granite::EventHandler //
 			materials.push_back(GRANITE_MATERIAL_MANAGER()->register_material(&albedo, 1, nullptr, 0));
 		}
 
+		::Granite::Meshlet::ExportFlags export_flags = 0;
+		if (Util::get_environment_bool("MESHLET_LOD_HIERARCHY", false))
+			export_flags |= ::Granite::Meshlet::EXPORT_LOD_HIERARCHY_BIT;
+
 		unsigned count = 0;
 		for (auto &mesh : parser.get_meshes())
 		{
 			auto internal_path = std::string("memory://mesh") + std::to_string(count++);
-			if (!::Granite::Meshlet::export_mesh_to_meshlet(internal_path, mesh, MeshStyle::Textured))
+			if (!::Granite::Meshlet::export_mesh_to_meshlet(internal_path, mesh, MeshStyle::Textured, export_flags))
 				throw std::runtime_error("Failed to export meshlet.");
 
 			mesh_assets.push_back(GRANITE_ASSET_MANAGER()->register_asset(
@@ -1235,6 +1239,7 @@ Application *application_create(int argc, char **argv)
 	cbs.add("--wave32", [](Util::CLIParser &parser) { Util::set_environment("WAVE32", parser.next_string()); });
 	cbs.add("--precull", [](Util::CLIParser &parser) { Util::set_environment("PRECULL", parser.next_string()); });
 	cbs.add("--vertex-id", [](Util::CLIParser &parser) { Util::set_environment("VERTEX_ID", parser.next_string()); });
+	cbs.add("--lod-hierarchy", [](Util::CLIParser &) { Util::set_environment("MESHLET_LOD_HIERARCHY", "1"); });
 	cbs.default_handler = [&](const char *arg) { path = arg; };
 
 	Util::CLIParser parser(std::move(cbs), argc - 1, argv + 1);
@@ -182,7 +182,7 @@ static void decode_mesh(std::vector<uvec3> &out_index_buffer,
                         const MeshView &mesh)
 {
 	uint32_t base_vertex_offset = 0;
-	for (uint32_t meshlet_index = 0; meshlet_index < mesh.format_header->meshlet_count; meshlet_index++)
+	for (uint32_t meshlet_index = 0; meshlet_index < mesh.num_bounds; meshlet_index++)
 	{
 		decode_mesh_index_buffer(out_index_buffer, mesh, meshlet_index, base_vertex_offset);
 		decode_attribute_buffer(out_positions, mesh, meshlet_index, StreamType::Position);
@@ -227,7 +227,7 @@ static void decode_mesh_gpu_bench(Vulkan::Device &dev, const MeshView &mesh)
 	buf_info.domain = Vulkan::BufferDomain::Device;
 	auto readback_decoded_attr_buffer = dev.create_buffer(buf_info);
 
-	buf_info.size = mesh.format_header->meshlet_count * 20;
+	buf_info.size = mesh.num_bounds * 20;
 	buf_info.domain = Vulkan::BufferDomain::Device;
 	auto readback_indirect_buffer = dev.create_buffer(buf_info);
 
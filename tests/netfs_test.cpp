@@ -0,0 +1,192 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fs-netfs.hpp"
+#include "netfs_server.hpp"
+#include "os_filesystem.hpp"
+#include "global_managers_init.hpp"
+#include "filesystem.hpp"
+#include "logging.hpp"
+#include <random>
+#include <thread>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace Granite;
+
+static bool verify_range(File &file, const std::vector<uint8_t> &reference, uint64_t offset, size_t size)
+{
+	auto mapping = file.map_subset(offset, size);
+	if (!mapping)
+	{
+		LOGE("Failed to map [%llu, +%zu].\n", static_cast<unsigned long long>(offset), size);
+		return false;
+	}
+
+	if (memcmp(mapping->data(), reference.data() + offset, size) != 0)
+	{
+		LOGE("Mismatch in [%llu, +%zu].\n", static_cast<unsigned long long>(offset), size);
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_FILESYSTEM_BIT);
+
+	char dir_template[] = "/tmp/netfs-test-XXXXXX";
+	if (!mkdtemp(dir_template))
+		return EXIT_FAILURE;
+
+	auto *fs = GRANITE_FILESYSTEM();
+	fs->register_protocol("netfs-test", std::make_unique<OSFilesystem>(dir_template));
+
+	// Compressible data, but not trivially so.
+	std::vector<uint8_t> reference(5 * 1024 * 1024 + 123);
+	std::mt19937 rnd(1234);
+	for (auto &v : reference)
+		v = uint8_t(rnd() % 16);
+	if (!fs->write_buffer_to_file("netfs-test://data.bin", reference.data(), reference.size()))
+		return EXIT_FAILURE;
+
+	uint16_t port = uint16_t(20000 + getpid() % 10000);
+	NetFSServer server(port);
+	std::thread server_thread([&server, ctx = std::shared_ptr<Global::GlobalManagers>(Global::create_thread_context())]() {
+		Global::set_thread_context(*ctx);
+		server.run();
+	});
+
+	bool success = true;
+	{
+		NetFSOptions options;
+		options.port = port;
+		options.block_size = 64 * 1024;
+		options.max_request_size = 1024 * 1024;
+		NetworkFilesystem client(options);
+		client.set_protocol("netfs-test");
+
+		FileStat s = {};
+		if (!client.stat("data.bin", s) || s.size != reference.size() || s.type != PathType::File)
+		{
+			LOGE("Stat failed.\n");
+			success = false;
+		}
+
+		auto list = client.list("");
+		if (list.size() != 1 || list.front().path != "data.bin")
+		{
+			LOGE("List failed.\n");
+			success = false;
+		}
+
+		auto file = client.open("data.bin", FileMode::ReadOnly);
+		if (!file || file->get_size() != reference.size())
+		{
+			LOGE("Failed to open remote file.\n");
+			success = false;
+		}
+
+		if (file)
+		{
+			// Many threads hammering random ranges exercise pipelining on one connection.
+			std::vector<std::thread> threads;
+			std::atomic<bool> thread_success{true};
+			for (unsigned t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&, t]() {
+					std::mt19937 thread_rnd(t);
+					for (unsigned i = 0; i < 64; i++)
+					{
+						size_t size = 1 + thread_rnd() % (512 * 1024);
+						uint64_t offset = thread_rnd() % (reference.size() - size);
+						if (!verify_range(*file, reference, offset, size))
+							thread_success = false;
+					}
+				});
+			}
+			for (auto &thr : threads)
+				thr.join();
+			success = success && thread_success;
+
+			if (!verify_range(*file, reference, 0, reference.size()) ||
+			    !verify_range(*file, reference, reference.size() - 1, 1) ||
+			    !verify_range(*file, reference, 0, 0))
+			{
+				success = false;
+			}
+
+			// Everything is cached now, this must not touch the network.
+			auto before = client.get_statistics();
+			if (!verify_range(*file, reference, 1000, 3 * 1024 * 1024))
+				success = false;
+			auto after = client.get_statistics();
+
+			LOGI("Cache hits: %llu, misses: %llu, requests: %llu, received: %llu bytes.\n",
+			     static_cast<unsigned long long>(after.cache_hits),
+			     static_cast<unsigned long long>(after.cache_misses),
+			     static_cast<unsigned long long>(after.requests),
+			     static_cast<unsigned long long>(after.bytes_received));
+
+			if (after.requests != before.requests || after.cache_hits <= before.cache_hits)
+			{
+				LOGE("Expected cache hits.\n");
+				success = false;
+			}
+
+			if (file->map_subset(reference.size() - 10, 11))
+			{
+				LOGE("Out of bounds map must fail.\n");
+				success = false;
+			}
+		}
+
+		auto write_file = client.open("written.bin", FileMode::WriteOnly);
+		if (write_file)
+		{
+			auto mapping = write_file->map_write(4096);
+			memcpy(mapping->mutable_data(), reference.data(), 4096);
+		}
+
+		auto written = fs->open_readonly_mapping("netfs-test://written.bin");
+		if (!written || written->get_size() != 4096 || memcmp(written->data(), reference.data(), 4096) != 0)
+		{
+			LOGE("Remote write failed.\n");
+			success = false;
+		}
+	}
+
+	server.kill();
+	server_thread.join();
+
+	fs->remove("netfs-test://data.bin");
+	fs->remove("netfs-test://written.bin");
+	rmdir(dir_template);
+	Global::deinit();
+
+	if (!success)
+		return EXIT_FAILURE;
+
+	LOGI("All tests passed.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#include "physics_system.hpp"
+#include "global_managers_init.hpp"
+#include "scene.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <random>
+#include <vector>
+#include <cmath>
+#include <stdlib.h>
+
+using namespace Granite;
+
+static double elapsed_ms(int64_t start)
+{
+	return 1e-6 * double(Util::get_current_time_nsecs() - start);
+}
+
+int main(int argc, char **argv)
+{
+	Global::init(Global::MANAGER_FEATURE_EVENT_BIT |
+	             Global::MANAGER_FEATURE_FILESYSTEM_BIT |
+	             Global::MANAGER_FEATURE_THREAD_GROUP_BIT);
+
+	unsigned num_queries = argc >= 2 ? unsigned(strtoul(argv[1], nullptr, 0)) : 16 * 1024;
+	int ret = EXIT_SUCCESS;
+
+	{
+		Scene scene;
+		PhysicsSystem physics;
+		std::vector<NodeHandle> nodes;
+
+		// A field of static boxes on a plane, similar to level geometry for line-of-sight and occlusion rays.
+		physics.add_infinite_plane(vec4(0.0f, 1.0f, 0.0f, 0.0f), {});
+		PhysicsSystem::MaterialInfo info;
+		info.type = PhysicsSystem::InteractionType::Static;
+		info.mass = 0.0f;
+
+		for (unsigned z = 0; z < 48; z++)
+		{
+			for (unsigned x = 0; x < 48; x++)
+			{
+				auto node = scene.create_node();
+				node->transform.translation = vec3(4.0f * float(x) - 96.0f, 1.0f, 4.0f * float(z) - 96.0f);
+				node->transform.scale = vec3(1.0f, 1.0f + float((x * 7 + z * 3) % 4), 1.0f);
+				physics.add_cube(node.get(), info);
+				nodes.push_back(std::move(node));
+			}
+		}
+
+		std::mt19937 rnd(1234);
+		std::uniform_real_distribution<float> pos_dist(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> height_dist(0.5f, 6.0f);
+		std::uniform_int_distribution<int> lane_dist(0, 47);
+		std::vector<vec3> origins(num_queries);
+		std::vector<vec3> directions(num_queries);
+		std::vector<float> lengths(num_queries);
+
+		for (unsigned i = 0; i < num_queries; i++)
+		{
+			// Start in the lanes between boxes, so no query starts out inside geometry.
+			origins[i] = vec3(4.0f * float(lane_dist(rnd)) - 94.0f, height_dist(rnd), 4.0f * float(lane_dist(rnd)) - 94.0f);
+			vec3 target = vec3(pos_dist(rnd), height_dist(rnd) - 1.0f, pos_dist(rnd));
+			lengths[i] = length(target - origins[i]);
+			directions[i] = (target - origins[i]) / lengths[i];
+		}
+
+		// Reference: one serial query at a time.
+		std::vector<RaycastResult> reference(num_queries);
+		auto start = Util::get_current_time_nsecs();
+		for (unsigned i = 0; i < num_queries; i++)
+			reference[i] = physics.query_closest_hit_ray(origins[i], directions[i], lengths[i]);
+		double serial_time = elapsed_ms(start);
+
+		PhysicsSystem::QueryBatch batch;
+		batch.type = PhysicsSystem::QueryType::Ray;
+		batch.count = num_queries;
+		batch.origins = origins.data();
+		batch.directions = directions.data();
+		batch.lengths = lengths.data();
+
+		PhysicsSystem::QueryBatchResults results;
+		start = Util::get_current_time_nsecs();
+		physics.query_batch(batch, results);
+		double batch_time = elapsed_ms(start);
+
+		unsigned num_hits = 0;
+		for (unsigned i = 0; i < num_queries; i++)
+		{
+			bool ref_hit = reference[i].handle != nullptr;
+			if (ref_hit != bool(results.hit[i]) || results.handles[i] != reference[i].handle ||
+			    std::abs(results.t[i] - reference[i].t) > 1e-3f)
+			{
+				LOGE("Ray %u: batched result does not match serial query.\n", i);
+				ret = EXIT_FAILURE;
+				break;
+			}
+			num_hits += results.hit[i];
+		}
+
+		LOGI("%u rays (%u hits): serial %.3f ms, batched %.3f ms.\n", num_queries, num_hits, serial_time, batch_time);
+
+		// A sweep never travels further than the equivalent ray.
+		batch.type = PhysicsSystem::QueryType::SphereSweep;
+		batch.radius = 0.25f;
+		start = Util::get_current_time_nsecs();
+		physics.query_batch(batch, results);
+		double sweep_time = elapsed_ms(start);
+
+		for (unsigned i = 0; i < num_queries && ret == EXIT_SUCCESS; i++)
+		{
+			if (reference[i].handle && (!results.hit[i] || results.t[i] > reference[i].t + 1e-3f))
+			{
+				LOGE("Sweep %u travels further than its ray.\n", i);
+				ret = EXIT_FAILURE;
+			}
+		}
+
+		LOGI("%u sphere sweeps: batched %.3f ms.\n", num_queries, sweep_time);
+
+		// Spheres centered in the boxes must overlap them, and spheres high above the boxes must not.
+		std::vector<vec3> centers;
+		for (auto &node : nodes)
+			centers.push_back(node->transform.translation);
+		for (auto &node : nodes)
+			centers.push_back(node->transform.translation + vec3(0.0f, 20.0f, 0.0f));
+
+		PhysicsSystem::QueryBatch overlap;
+		overlap.type = PhysicsSystem::QueryType::SphereOverlap;
+		overlap.count = unsigned(centers.size());
+		overlap.origins = centers.data();
+		overlap.radius = 0.5f;
+
+		start = Util::get_current_time_nsecs();
+		physics.query_batch(overlap, results);
+		double overlap_time = elapsed_ms(start);
+
+		for (unsigned i = 0; i < overlap.count && ret == EXIT_SUCCESS; i++)
+		{
+			bool expect_hit = i < nodes.size();
+			if (bool(results.hit[i]) != expect_hit || (expect_hit && results.t[i] > 0.0f))
+			{
+				LOGE("Overlap %u: expected %s.\n", i, expect_hit ? "hit" : "miss");
+				ret = EXIT_FAILURE;
+			}
+		}
+
+		LOGI("%u sphere overlaps: batched %.3f ms.\n", overlap.count, overlap_time);
+	}
+
+	Global::deinit();
+	return ret;
+}
@@ -0,0 +1,94 @@
+#include "physics_system.hpp"
+#include "global_managers_init.hpp"
+#include "scene.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <vector>
+#include <cmath>
+#include <stdlib.h>
+
+using namespace Granite;
+
+// Drops num_boxes unit cubes in a loose grid of 32x32 columns onto an infinite plane,
+// and reports how long each PhysicsSystem::iterate() takes while they fall and settle.
+static bool run_stress(unsigned num_boxes, unsigned num_frames)
+{
+	Scene scene;
+	PhysicsSystem physics;
+	std::vector<NodeHandle> nodes;
+	nodes.reserve(num_boxes);
+
+	physics.add_infinite_plane(vec4(0.0f, 1.0f, 0.0f, 0.0f), {});
+
+	PhysicsSystem::MaterialInfo info;
+	info.mass = 1.0f;
+
+	for (unsigned i = 0; i < num_boxes; i++)
+	{
+		auto node = scene.create_node();
+		node->transform.scale = vec3(0.5f);
+		node->transform.translation = vec3(2.5f * float(i % 32) - 40.0f,
+		                                   3.0f * float(i / 1024) + 1.0f,
+		                                   2.5f * float((i / 32) % 32) - 40.0f);
+		// A slight tilt so the boxes tumble when they land.
+		node->transform.rotation = angleAxis(0.1f * float(i % 7), normalize(vec3(1.0f, 0.0f, 1.0f)));
+		physics.add_cube(node.get(), info);
+		nodes.push_back(std::move(node));
+	}
+
+	double total_time = 0.0;
+	double worst_time = 0.0;
+	for (unsigned frame = 0; frame < num_frames; frame++)
+	{
+		auto start = Util::get_current_time_nsecs();
+		physics.iterate(1.0 / 60.0);
+		double t = 1e-6 * double(Util::get_current_time_nsecs() - start);
+		total_time += t;
+		worst_time = std::max(worst_time, t);
+		scene.update_all_transforms();
+	}
+
+	for (auto &node : nodes)
+	{
+		auto &pos = node->transform.translation;
+		if (!std::isfinite(pos.x) || !std::isfinite(pos.y) || !std::isfinite(pos.z) || pos.y < -1.0f)
+		{
+			LOGE("Box ended up at (%f, %f, %f).\n", pos.x, pos.y, pos.z);
+			return false;
+		}
+	}
+
+	// The bottom layer starts at y = 1 and should have landed on the plane by now.
+	if (num_frames >= 60 && nodes.front()->transform.translation.y > 0.75f)
+	{
+		LOGE("Box transforms were not written back.\n");
+		return false;
+	}
+
+	double avg = total_time / double(num_frames);
+	LOGI("%6u bodies: %8.3f ms / step avg, %8.3f ms worst, %6.3f us / body.\n",
+	     num_boxes, avg, worst_time, 1000.0 * avg / double(num_boxes));
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	Global::init(Global::MANAGER_FEATURE_EVENT_BIT |
+	             Global::MANAGER_FEATURE_FILESYSTEM_BIT |
+	             Global::MANAGER_FEATURE_THREAD_GROUP_BIT);
+
+	unsigned num_frames = argc >= 2 ? unsigned(strtoul(argv[1], nullptr, 0)) : 120;
+	const unsigned counts[] = { 1000, 4000, 16000, 32000 };
+
+	for (unsigned count : counts)
+	{
+		if (!run_stress(count, num_frames))
+		{
+			Global::deinit();
+			return EXIT_FAILURE;
+		}
+	}
+
+	Global::deinit();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include "render_graph.hpp"
+#include "global_managers_init.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <random>
+#include <string>
+#include <stdlib.h>
+
+using namespace Granite;
+
+// A chain of post-processing style passes, where every pass also samples a few random earlier outputs,
+// similar to a large frame graph with lots of cross-pass reads.
+static void build_graph(RenderGraph &graph, unsigned num_passes)
+{
+	std::mt19937 rnd(42);
+
+	AttachmentInfo info;
+	info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	info.size_x = 0.5f;
+	info.size_y = 0.5f;
+
+	for (unsigned i = 0; i < num_passes; i++)
+	{
+		auto &pass = graph.add_pass("pass" + std::to_string(i), RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+
+		if (i + 1 == num_passes)
+		{
+			AttachmentInfo backbuffer;
+			backbuffer.format = VK_FORMAT_R8G8B8A8_UNORM;
+			pass.add_color_output("backbuffer", backbuffer);
+		}
+		else
+			pass.add_color_output("rt" + std::to_string(i), info);
+
+		if (i > 0)
+		{
+			pass.add_texture_input("rt" + std::to_string(i - 1));
+			std::uniform_int_distribution<unsigned> dist(0, i - 1);
+			for (unsigned j = 0; j < 3; j++)
+				pass.add_texture_input("rt" + std::to_string(dist(rnd)));
+		}
+	}
+
+	graph.set_backbuffer_source("backbuffer");
+}
+
+static void set_dimensions(RenderGraph &graph, unsigned width, unsigned height)
+{
+	ResourceDimensions dim;
+	dim.width = width;
+	dim.height = height;
+	dim.format = VK_FORMAT_R8G8B8A8_UNORM;
+	graph.set_backbuffer_dimensions(dim);
+}
+
+// G-buffer -> lighting, where lighting also samples a shadow map.
+// The shadow pass has to be scheduled before the G-buffer pass, or the G-buffer and lighting passes cannot merge.
+static bool check_gbuffer_merge(bool shadow_first)
+{
+	RenderGraph graph;
+	set_dimensions(graph, 1920, 1080);
+
+	AttachmentInfo shadow;
+	shadow.format = VK_FORMAT_D16_UNORM;
+	shadow.size_class = SizeClass::Absolute;
+	shadow.size_x = 1024.0f;
+	shadow.size_y = 1024.0f;
+
+	AttachmentInfo albedo;
+	albedo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	AttachmentInfo depth;
+	depth.format = VK_FORMAT_D32_SFLOAT;
+
+	const auto add_shadow = [&]() {
+		auto &pass = graph.add_pass("shadow", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+		pass.set_depth_stencil_output("shadow", shadow);
+	};
+
+	if (shadow_first)
+		add_shadow();
+
+	auto &gbuffer = graph.add_pass("gbuffer", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+	gbuffer.add_color_output("albedo", albedo);
+	gbuffer.set_depth_stencil_output("depth", depth);
+
+	if (!shadow_first)
+		add_shadow();
+
+	auto &lighting = graph.add_pass("lighting", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+	lighting.add_attachment_input("albedo");
+	lighting.set_depth_stencil_input("depth");
+	lighting.add_texture_input("shadow");
+	AttachmentInfo backbuffer;
+	backbuffer.format = VK_FORMAT_R8G8B8A8_UNORM;
+	lighting.add_color_output("backbuffer", backbuffer);
+
+	graph.set_backbuffer_source("backbuffer");
+	graph.bake();
+
+	unsigned shadow_index = graph.find_pass("shadow")->get_physical_pass_index();
+	unsigned gbuffer_index = graph.find_pass("gbuffer")->get_physical_pass_index();
+	unsigned lighting_index = graph.find_pass("lighting")->get_physical_pass_index();
+
+	if (gbuffer_index != lighting_index || shadow_index >= gbuffer_index)
+	{
+		LOGE("G-buffer and lighting did not merge (shadow: %u, gbuffer: %u, lighting: %u).\n",
+		     shadow_index, gbuffer_index, lighting_index);
+		return false;
+	}
+
+	return true;
+}
+
+static double bake_ms(RenderGraph &graph)
+{
+	auto start = Util::get_current_time_nsecs();
+	graph.bake();
+	return 1e-6 * double(Util::get_current_time_nsecs() - start);
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+
+	if (!check_gbuffer_merge(true) || !check_gbuffer_merge(false))
+	{
+		Global::deinit();
+		return EXIT_FAILURE;
+	}
+
+	{
+		const unsigned pass_counts[] = { 50, 100, 250, 500, 1000 };
+		for (unsigned num_passes : pass_counts)
+		{
+			// No device is set, so only the CPU side of baking is measured.
+			RenderGraph graph;
+			set_dimensions(graph, 1920, 1080);
+
+			build_graph(graph, num_passes);
+			double cold = bake_ms(graph);
+
+			// Same topology, e.g. an application which rebuilds its graph on swapchain changes.
+			graph.reset();
+			build_graph(graph, num_passes);
+			double rebake = bake_ms(graph);
+
+			graph.reset();
+			set_dimensions(graph, 2560, 1440);
+			build_graph(graph, num_passes);
+			double resize = bake_ms(graph);
+
+			LOGI("%4u passes: cold bake %8.3f ms, rebake %8.3f ms, resize rebake %8.3f ms.\n",
+			     num_passes, cold, rebake, resize);
+		}
+	}
+
+	Global::deinit();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#include "rgtc_compressor.hpp"
+#include "thread_group.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Granite;
+
+// Normal-map like content: smooth gradients with varying amounts of noise,
+// so flat, low-contrast and partition searched blocks are all represented.
+static void build_blocks(std::vector<uint8_t> &red, std::vector<uint8_t> &green, unsigned blocks_x, unsigned blocks_y)
+{
+	std::mt19937 rnd(1337);
+	red.resize(blocks_x * blocks_y * 16);
+	green.resize(blocks_x * blocks_y * 16);
+
+	unsigned width = blocks_x * 4;
+	unsigned height = blocks_y * 4;
+
+	for (unsigned y = 0; y < height; y++)
+	{
+		for (unsigned x = 0; x < width; x++)
+		{
+			unsigned block = (y >> 2) * blocks_x + (x >> 2);
+			unsigned index = block * 16 + (y & 3) * 4 + (x & 3);
+			int amplitude = int((block * 7) % 5) * 16;
+			std::uniform_int_distribution<int> noise(-amplitude, amplitude);
+
+			int r = int(255 * x / width) + noise(rnd);
+			int g = int(255 * y / height) + noise(rnd);
+			red[index] = uint8_t(std::min(std::max(r, 0), 255));
+			green[index] = uint8_t(std::min(std::max(g, 0), 255));
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned size = argc >= 2 ? unsigned(strtoul(argv[1], nullptr, 0)) : 2048;
+	unsigned num_threads = argc >= 3 ? unsigned(strtoul(argv[2], nullptr, 0)) : 4;
+
+	if (size < 4 || !num_threads)
+	{
+		LOGE("Usage: rgtc-bench [size] [threads]\n");
+		return EXIT_FAILURE;
+	}
+
+	unsigned blocks_x = size / 4;
+	unsigned blocks_y = size / 4;
+	unsigned num_blocks = blocks_x * blocks_y;
+
+	std::vector<uint8_t> red, green;
+	build_blocks(red, green, blocks_x, blocks_y);
+
+	std::vector<uint8_t> reference(num_blocks * 16);
+	std::vector<uint8_t> batched(num_blocks * 16);
+
+	auto start = Util::get_current_time_nsecs();
+	for (unsigned i = 0; i < num_blocks; i++)
+		compress_rgtc_red_green_block(reference.data() + i * 16, red.data() + i * 16, green.data() + i * 16);
+	auto end = Util::get_current_time_nsecs();
+	double scalar_time = 1e-9 * double(end - start);
+
+	start = Util::get_current_time_nsecs();
+	for (unsigned y = 0; y < blocks_y; y++)
+	{
+		unsigned offset = y * blocks_x;
+		compress_rgtc_red_green_blocks(batched.data() + offset * 16,
+		                               red.data() + offset * 16, green.data() + offset * 16, blocks_x);
+	}
+	end = Util::get_current_time_nsecs();
+	double batched_time = 1e-9 * double(end - start);
+
+	if (memcmp(reference.data(), batched.data(), reference.size()) != 0)
+	{
+		LOGE("Batched BC5 output does not match per-block output.\n");
+		return EXIT_FAILURE;
+	}
+
+	ThreadGroup group;
+	group.start(num_threads, 0, {});
+
+	// Task layout of the old CompressorState path, one task per block.
+	std::fill(batched.begin(), batched.end(), 0);
+	start = Util::get_current_time_nsecs();
+	{
+		auto task = group.create_task();
+		for (unsigned i = 0; i < num_blocks; i++)
+		{
+			task->enqueue_task([&, i]() {
+				compress_rgtc_red_green_block(batched.data() + i * 16, red.data() + i * 16, green.data() + i * 16);
+			});
+		}
+		task->flush();
+		task->wait();
+	}
+	end = Util::get_current_time_nsecs();
+	double per_block_task_time = 1e-9 * double(end - start);
+
+	// Strips of block rows per task.
+	std::fill(batched.begin(), batched.end(), 0);
+	start = Util::get_current_time_nsecs();
+	{
+		auto task = group.create_task();
+		unsigned rows_per_task = std::max(1u, 1024u / blocks_x);
+		for (unsigned y = 0; y < blocks_y; y += rows_per_task)
+		{
+			unsigned num_rows = std::min(rows_per_task, blocks_y - y);
+			task->enqueue_task([&, y, num_rows]() {
+				unsigned offset = y * blocks_x;
+				compress_rgtc_red_green_blocks(batched.data() + offset * 16,
+				                               red.data() + offset * 16, green.data() + offset * 16,
+				                               num_rows * blocks_x);
+			});
+		}
+		task->flush();
+		task->wait();
+	}
+	end = Util::get_current_time_nsecs();
+	double strip_task_time = 1e-9 * double(end - start);
+
+	if (memcmp(reference.data(), batched.data(), reference.size()) != 0)
+	{
+		LOGE("Threaded BC5 output does not match per-block output.\n");
+		return EXIT_FAILURE;
+	}
+
+	double mblocks = 1e-6 * double(num_blocks);
+	LOGI("BC5 %u x %u, %u threads.\n", size, size, num_threads);
+	LOGI("  Per-block encode: %.2f M blocks / s\n", mblocks / scalar_time);
+	LOGI("  Batched encode: %.2f M blocks / s (%.2fx)\n", mblocks / batched_time, scalar_time / batched_time);
+	LOGI("  Threaded, task per block: %.2f M blocks / s\n", mblocks / per_block_task_time);
+	LOGI("  Threaded, task per strip: %.2f M blocks / s (%.2fx)\n",
+	     mblocks / strip_task_time, per_block_task_time / strip_task_time);
+}
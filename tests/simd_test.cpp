@@ -98,11 +98,49 @@ static void test_quat()
 	}
 }
 
+static void test_batched_model_transform()
+{
+	ModelTransformBatch batch;
+	mat_affine reference[ModelTransformBatch::Size];
+
+	for (unsigned i = 0; i < ModelTransformBatch::Size; i++)
+	{
+		float f = float(i);
+		vec3 scale(1.0f + 0.1f * f, 2.0f - 0.2f * f, 0.5f + 0.3f * f);
+		quat rot = angleAxis(0.3f * f, normalize(vec3(0.1f + f, 0.2f, 0.3f - f)));
+		vec3 trans(f, -2.0f * f, 3.0f);
+
+		mat_affine parent;
+		compute_model_transform(parent, vec3(1.5f), angleAxis(-0.2f * f, vec3(0.0f, 1.0f, 0.0f)),
+		                        vec3(-f, 1.0f, 2.0f * f), mat_affine(1.0f));
+
+		compute_model_transform(reference[i], scale, rot, trans, parent);
+		batch.set_lane(i, scale, rot, trans, parent);
+	}
+
+	compute_model_transforms(batch);
+
+	for (unsigned i = 0; i < ModelTransformBatch::Size; i++)
+	{
+		mat_affine world;
+		batch.get_lane(i, world);
+		for (unsigned row = 0; row < 3; row++)
+		{
+			if (distance(world[row], reference[i][row]) > 0.0001f)
+			{
+				LOGE("Error in batched model transform!\n");
+				exit(1);
+			}
+		}
+	}
+}
+
 int main()
 {
 	test_matrix_multiply();
 	test_frustum_cull();
 	test_aabb_transform();
 	test_quat();
+	test_batched_model_transform();
 	LOGI(":D\n");
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "texture_decoder_cpu.hpp"
+#include "thread_group.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+// Headless throughput of the CPU decoder, reported as GB/s of decoded output.
+static constexpr unsigned Width = 2048;
+static constexpr unsigned Height = 2048;
+static constexpr unsigned Iterations = 4;
+
+struct Format
+{
+	VkFormat format;
+	const char *name;
+};
+
+static const Format formats[] = {
+	{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, "BC1 RGB" },
+	{ VK_FORMAT_BC1_RGBA_UNORM_BLOCK, "BC1 RGBA" },
+	{ VK_FORMAT_BC2_UNORM_BLOCK, "BC2" },
+	{ VK_FORMAT_BC3_UNORM_BLOCK, "BC3" },
+	{ VK_FORMAT_BC4_UNORM_BLOCK, "BC4" },
+	{ VK_FORMAT_BC5_UNORM_BLOCK, "BC5" },
+	{ VK_FORMAT_BC6H_UFLOAT_BLOCK, "BC6H" },
+	{ VK_FORMAT_BC7_UNORM_BLOCK, "BC7" },
+	{ VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, "ETC2 RGB8" },
+	{ VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, "ETC2 RGBA8" },
+	{ VK_FORMAT_EAC_R11G11_UNORM_BLOCK, "EAC RG11" },
+	{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK, "ASTC 4x4" },
+	{ VK_FORMAT_ASTC_8x8_UNORM_BLOCK, "ASTC 8x8" },
+};
+
+static bool check_bc1_known_answer()
+{
+	// color0 is white, color1 is black. Selectors alternate between the two endpoints.
+	const uint32_t block[2] = { 0x0000ffffu, 0x44444444u };
+	TextureFormatLayout layout;
+	layout.set_2d(VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 4);
+	layout.set_buffer(const_cast<uint32_t *>(block), sizeof(block));
+
+	MemoryMappedTexture decoded;
+	if (!decode_compressed_image_cpu(decoded, layout, VK_FORMAT_UNDEFINED))
+	{
+		LOGE("Failed to decode BC1 block.\n");
+		return false;
+	}
+
+	auto &decoded_layout = decoded.get_layout();
+	for (unsigned y = 0; y < 4; y++)
+	{
+		for (unsigned x = 0; x < 4; x++)
+		{
+			auto *rgba = decoded_layout.data_2d<uint8_t>(x, y);
+			uint8_t expected = (x & 1) ? 0x00 : 0xff;
+			if (rgba[0] != expected || rgba[1] != expected || rgba[2] != expected || rgba[3] != 0xff)
+			{
+				LOGE("BC1 mismatch at (%u, %u): %u %u %u %u.\n", x, y, rgba[0], rgba[1], rgba[2], rgba[3]);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool run_format(const Format &format, ThreadGroup &group, std::mt19937 &rnd)
+{
+	TextureFormatLayout layout;
+	layout.set_2d(format.format, Width, Height);
+	std::vector<uint32_t> payload((layout.get_required_size() + 3) / 4);
+	for (auto &p : payload)
+		p = rnd();
+	layout.set_buffer(payload.data(), payload.size() * sizeof(uint32_t));
+
+	MemoryMappedTexture reference;
+	if (!decode_compressed_image_cpu(reference, layout, VK_FORMAT_UNDEFINED))
+	{
+		LOGE("%s: failed to decode.\n", format.name);
+		return false;
+	}
+	size_t decoded_size = reference.get_layout().get_required_size();
+
+	double single_time = 0.0;
+	double threaded_time = 0.0;
+
+	for (unsigned i = 0; i < Iterations; i++)
+	{
+		MemoryMappedTexture single, threaded;
+
+		auto start = Util::get_current_time_nsecs();
+		decode_compressed_image_cpu(single, layout, VK_FORMAT_UNDEFINED);
+		auto mid = Util::get_current_time_nsecs();
+		decode_compressed_image_cpu(threaded, layout, VK_FORMAT_UNDEFINED, &group);
+		auto end = Util::get_current_time_nsecs();
+
+		single_time += 1e-9 * double(mid - start);
+		threaded_time += 1e-9 * double(end - mid);
+
+		// Block rows are independent, so threading must not change the result.
+		if (memcmp(reference.get_layout().data(), threaded.get_layout().data(), decoded_size) != 0 ||
+		    memcmp(reference.get_layout().data(), single.get_layout().data(), decoded_size) != 0)
+		{
+			LOGE("%s: decoded output is not deterministic.\n", format.name);
+			return false;
+		}
+	}
+
+	double bytes = double(decoded_size) * Iterations;
+	LOGI("%-12s %8.3f GB/s single, %8.3f GB/s threaded.\n", format.name,
+	     1e-9 * bytes / single_time, 1e-9 * bytes / threaded_time);
+	return true;
+}
+
+int main()
+{
+	if (!check_bc1_known_answer())
+		return EXIT_FAILURE;
+
+	ThreadGroup group;
+	group.start(std::max(1u, std::thread::hardware_concurrency()), 0, {});
+
+	std::mt19937 rnd(1234);
+	for (auto &format : formats)
+		if (!run_format(format, group, rnd))
+			return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -24,11 +24,13 @@
 #include "context.hpp"
 #include "global_managers_init.hpp"
 #include "texture_decoder.hpp"
+#include "texture_decoder_cpu.hpp"
 #include "memory_mapped_texture.hpp"
 #include "math.hpp"
 #include "muglm/muglm_impl.hpp"
 #include "thread_group.hpp"
 #include <random>
+#include <string.h>
 
 #ifdef HAVE_ASTC_DECODER
 #include "astcenc.h"
@@ -243,6 +245,73 @@ static bool compare_rgba16f(Device &device,
 	return true;
 }
 
+static bool compare_readback(Device &device,
+                             const Buffer &reference, const Buffer &decoded,
+                             VkFormat readback_format, unsigned width, unsigned height, int max_diff)
+{
+	switch (readback_format)
+	{
+	case VK_FORMAT_R8_UNORM:
+		return compare_r8(device, reference, decoded, width, height, max_diff);
+	case VK_FORMAT_R8G8_UNORM:
+		return compare_rg8(device, reference, decoded, width, height, max_diff);
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return compare_rgba8(device, reference, decoded, width, height, max_diff);
+	case VK_FORMAT_R16_SFLOAT:
+		return compare_r16f(device, reference, decoded, width, height);
+	case VK_FORMAT_R16G16_SFLOAT:
+		return compare_rg16f(device, reference, decoded, width, height);
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return compare_rgba16f(device, reference, decoded, width, height);
+	default:
+		return false;
+	}
+}
+
+// Decodes level 0 with the CPU fallback, and packs it the same way as the readback of the compute decoder.
+static BufferHandle decode_cpu(Device &device, const TextureFormatLayout &layout, VkFormat readback_format)
+{
+	MemoryMappedTexture decoded;
+	if (!decode_compressed_image_cpu(decoded, layout, readback_format, GRANITE_THREAD_GROUP()))
+		return {};
+
+	auto &decoded_layout = decoded.get_layout();
+	size_t decoded_size = TextureFormatLayout::format_block_size(decoded_layout.get_format(), VK_IMAGE_ASPECT_COLOR_BIT);
+	size_t readback_size = TextureFormatLayout::format_block_size(readback_format, VK_IMAGE_ASPECT_COLOR_BIT);
+	if (readback_size > decoded_size)
+		return {};
+
+	Vulkan::BufferCreateInfo buffer_info = {};
+	buffer_info.size = layout.get_width() * layout.get_height() * readback_size;
+	buffer_info.domain = BufferDomain::CachedHost;
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	auto buffer = device.create_buffer(buffer_info);
+
+	auto *mapped = static_cast<uint8_t *>(device.map_host_buffer(*buffer, MEMORY_ACCESS_WRITE_BIT));
+	for (unsigned y = 0; y < layout.get_height(); y++)
+	{
+		for (unsigned x = 0; x < layout.get_width(); x++)
+		{
+			memcpy(mapped + (y * layout.get_width() + x) * readback_size,
+			       decoded_layout.data_opaque(x, y, 0, 0), readback_size);
+		}
+	}
+	device.unmap_host_buffer(*buffer, MEMORY_ACCESS_WRITE_BIT);
+
+	return buffer;
+}
+
+// The CPU fallback must agree with the compute decoder.
+static bool verify_cpu_decode(Device &device, const TextureFormatLayout &layout, const Buffer &decoded,
+                              VkFormat readback_format, unsigned width, unsigned height, int max_diff)
+{
+	auto readback_cpu = decode_cpu(device, layout, readback_format);
+	if (!readback_cpu)
+		return false;
+	return compare_readback(device, decoded, *readback_cpu, readback_format, width, height, max_diff);
+}
+
 #ifdef HAVE_ASTC_DECODER
 static BufferHandle decode_astc_cpu(Device &device, const TextureFormatLayout &layout, VkFormat readback_format)
 {
@@ -406,6 +475,9 @@ static bool test_astc_weights(Device &device, VkFormat format, VkFormat readback
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	if (readback_format == VK_FORMAT_R16G16B16A16_SFLOAT)
 		return compare_rgba16f(device, *readback_reference, *readback_decoded, width, height);
 	else if (readback_format == VK_FORMAT_R8G8B8A8_SRGB || readback_format == VK_FORMAT_R8G8B8A8_UNORM)
@@ -478,6 +550,9 @@ static bool test_astc_endpoint_formats(Device &device, VkFormat format, VkFormat
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	if (readback_format == VK_FORMAT_R16G16B16A16_SFLOAT)
 		return compare_rgba16f(device, *readback_reference, *readback_decoded, width, height);
 	else if (readback_format == VK_FORMAT_R8G8B8A8_SRGB || readback_format == VK_FORMAT_R8G8B8A8_UNORM)
@@ -556,6 +631,9 @@ static bool test_astc_partitions(Device &device, VkFormat format, VkFormat readb
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	if (readback_format == VK_FORMAT_R16G16B16A16_SFLOAT)
 		return compare_rgba16f(device, *readback_reference, *readback_decoded, width, height);
 	else if (readback_format == VK_FORMAT_R8G8B8A8_SRGB || readback_format == VK_FORMAT_R8G8B8A8_UNORM)
@@ -633,6 +711,9 @@ static bool test_astc_partitions_complex(Device &device, VkFormat format, VkForm
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	if (readback_format == VK_FORMAT_R16G16B16A16_SFLOAT)
 		return compare_rgba16f(device, *readback_reference, *readback_decoded, width, height);
 	else if (readback_format == VK_FORMAT_R8G8B8A8_SRGB || readback_format == VK_FORMAT_R8G8B8A8_UNORM)
@@ -729,6 +810,9 @@ static bool test_astc_void_extent(Device &device, VkFormat format, VkFormat read
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	if (readback_format == VK_FORMAT_R16G16B16A16_SFLOAT)
 		return compare_rgba16f(device, *readback_reference, *readback_decoded, width, height);
 	else if (readback_format == VK_FORMAT_R8G8B8A8_SRGB || readback_format == VK_FORMAT_R8G8B8A8_UNORM)
@@ -786,6 +870,9 @@ static bool test_astc_block_mode(Device &device, VkFormat format, VkFormat readb
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	if (readback_format == VK_FORMAT_R16G16B16A16_SFLOAT)
 		return compare_rgba16f(device, *readback_reference, *readback_decoded, width, height);
 	else if (readback_format == VK_FORMAT_R8G8B8A8_SRGB || readback_format == VK_FORMAT_R8G8B8A8_UNORM)
@@ -979,6 +1066,9 @@ static bool test_bc6(Device &device, VkFormat format)
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, VK_FORMAT_R16G16B16A16_SFLOAT, width, height, 0))
+		return false;
+
 	return compare_rgba16f(device, *readback_reference, *readback_decoded, width, height);
 }
 
@@ -1018,6 +1108,9 @@ static bool test_bc7(Device &device, VkFormat format, VkFormat readback_format)
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	return compare_rgba8(device, *readback_reference, *readback_decoded, width, height, 0);
 }
 
@@ -1057,6 +1150,9 @@ static bool test_eac(Device &device, VkFormat format, VkFormat readback_format)
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	if (readback_format == VK_FORMAT_R16G16_SFLOAT)
 		return compare_rg16f(device, *readback_reference, *readback_decoded, width, height);
 	else if (readback_format == VK_FORMAT_R16_SFLOAT)
@@ -1101,6 +1197,9 @@ static bool test_etc2(Device &device, VkFormat format, VkFormat readback_format)
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 0))
+		return false;
+
 	return compare_rgba8(device, *readback_reference, *readback_decoded, width, height, 0);
 }
 
@@ -1137,6 +1236,9 @@ static bool test_rgtc(Device &device, VkFormat format, VkFormat readback_format)
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 1))
+		return false;
+
 	if (readback_format == VK_FORMAT_R8_UNORM)
 		return compare_r8(device, *readback_reference, *readback_decoded, width, height, 1);
 	else if (readback_format == VK_FORMAT_R8G8_UNORM)
@@ -1178,6 +1280,9 @@ static bool test_s3tc(Device &device, VkFormat format, VkFormat readback_format)
 	device.submit(cmd, &fence);
 	fence->wait();
 
+	if (!verify_cpu_decode(device, layout, *readback_decoded, readback_format, width, height, 1))
+		return false;
+
 	return compare_rgba8(device, *readback_reference, *readback_decoded, width, height, 1);
 }
 
@@ -0,0 +1,210 @@
+#include "transient_memory_planner.hpp"
+#include "logging.hpp"
+#include <random>
+#include <algorithm>
+#include <vector>
+#include <stdlib.h>
+
+using namespace Granite;
+
+static bool validate_plan(const std::vector<TransientResourceRequest> &requests, const TransientMemoryPlan &plan,
+                          uint64_t max_block_size)
+{
+	for (unsigned i = 0; i < requests.size(); i++)
+	{
+		auto &a = requests[i];
+		auto &pa = plan.placements[i];
+
+		if (pa.offset & (a.alignment - 1))
+		{
+			LOGE("Resource %u is misaligned.\n", i);
+			return false;
+		}
+
+		if (pa.offset + a.size > plan.block_sizes[pa.block])
+		{
+			LOGE("Resource %u is outside its block.\n", i);
+			return false;
+		}
+
+		if (plan.block_groups[pa.block] != a.group)
+		{
+			LOGE("Resource %u is placed in a block of another group.\n", i);
+			return false;
+		}
+
+		for (unsigned j = i + 1; j < requests.size(); j++)
+		{
+			auto &b = requests[j];
+			auto &pb = plan.placements[j];
+			if (pa.block != pb.block || !TransientMemoryPlanner::lifetimes_overlap(a, b))
+				continue;
+
+			bool disjoint = pa.offset + a.size <= pb.offset || pb.offset + b.size <= pa.offset;
+			if (!disjoint)
+			{
+				LOGE("Resources %u and %u overlap in both time and memory.\n", i, j);
+				return false;
+			}
+		}
+	}
+
+	// Blocks may only exceed the limit if a single resource requires it.
+	std::vector<uint64_t> largest(plan.block_sizes.size());
+	for (unsigned i = 0; i < requests.size(); i++)
+		largest[plan.placements[i].block] = std::max(largest[plan.placements[i].block], requests[i].size);
+	for (unsigned block = 0; block < plan.block_sizes.size(); block++)
+	{
+		if (plan.block_sizes[block] > std::max(max_block_size, largest[block]))
+		{
+			LOGE("Block %u grows past the maximum size.\n", block);
+			return false;
+		}
+	}
+
+	if (plan.total_size < plan.peak_live_size || plan.total_size > plan.unaliased_size + 64 * 1024 * requests.size())
+	{
+		LOGE("Implausible plan footprint.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static TransientMemoryPlan plan_requests(const std::vector<TransientResourceRequest> &requests, uint64_t max_block_size)
+{
+	TransientMemoryPlanner planner;
+	planner.set_max_block_size(max_block_size);
+	for (auto &request : requests)
+		planner.add_resource(request);
+	return planner.plan();
+}
+
+static TransientResourceRequest image(unsigned width, unsigned height, unsigned bpp, unsigned first, unsigned last)
+{
+	TransientResourceRequest request;
+	request.size = uint64_t(width) * height * bpp;
+	request.alignment = 64 * 1024;
+	request.first_pass = first;
+	request.last_pass = last;
+	return request;
+}
+
+// Deferred shading into HDR lighting, followed by a bloom chain and tonemapping.
+// Most transients have different dimensions, so exact-match aliasing cannot share any memory.
+static bool test_deferred_chain()
+{
+	std::vector<TransientResourceRequest> requests;
+	requests.push_back(image(2560, 1440, 4, 0, 1)); // albedo
+	requests.push_back(image(2560, 1440, 4, 0, 1)); // normal
+	requests.push_back(image(2560, 1440, 4, 0, 1)); // pbr
+	requests.push_back(image(2560, 1440, 4, 0, 2)); // depth
+	requests.push_back(image(2560, 1440, 8, 1, 3)); // hdr lighting
+	unsigned width = 1280, height = 720;
+	for (unsigned pass = 3; pass < 8; pass++, width /= 2, height /= 2)
+		requests.push_back(image(width, height, 8, pass, pass + 1)); // bloom downsample
+	for (unsigned pass = 8; pass < 12; pass++, width *= 2, height *= 2)
+		requests.push_back(image(width * 2, height * 2, 8, pass, pass + 1)); // bloom upsample
+	requests.push_back(image(2560, 1440, 4, 12, 13)); // tonemapped
+	requests.push_back(image(2560, 1440, 4, 13, 14)); // post AA
+
+	auto plan = plan_requests(requests, UINT64_MAX);
+	if (!validate_plan(requests, plan, UINT64_MAX))
+		return false;
+
+	LOGI("Deferred chain: %u blocks, %.2f MiB planned, %.2f MiB unaliased, %.2f MiB peak live.\n",
+	     unsigned(plan.block_sizes.size()),
+	     double(plan.total_size) / (1024.0 * 1024.0),
+	     double(plan.unaliased_size) / (1024.0 * 1024.0),
+	     double(plan.peak_live_size) / (1024.0 * 1024.0));
+
+	// The G-buffer is alive together with HDR lighting, so peak live size is the best any plan can do.
+	if (plan.total_size >= plan.unaliased_size || plan.total_size * 10 > plan.peak_live_size * 11)
+	{
+		LOGE("Expected the plan to be within 10%% of the peak live size.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_groups_and_block_limit()
+{
+	std::vector<TransientResourceRequest> requests;
+	for (unsigned i = 0; i < 8; i++)
+	{
+		auto request = image(1024, 1024, 4, i, i);
+		request.group = i & 1;
+		requests.push_back(request);
+	}
+
+	auto plan = plan_requests(requests, UINT64_MAX);
+	if (!validate_plan(requests, plan, UINT64_MAX))
+		return false;
+
+	if (plan.block_sizes.size() != 2 || plan.total_size != 2 * requests[0].size)
+	{
+		LOGE("Expected one shared block per group.\n");
+		return false;
+	}
+
+	// All resources are live at once, so a block limit forces one block per pair.
+	requests.clear();
+	for (unsigned i = 0; i < 8; i++)
+		requests.push_back(image(1024, 1024, 4, 0, 0));
+
+	uint64_t limit = 2 * requests[0].size;
+	plan = plan_requests(requests, limit);
+	if (!validate_plan(requests, plan, limit))
+		return false;
+
+	if (plan.block_sizes.size() != 4)
+	{
+		LOGE("Expected the block limit to split resources in four blocks.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_random_graphs()
+{
+	std::mt19937 rnd(1234);
+
+	for (unsigned iter = 0; iter < 500; iter++)
+	{
+		std::vector<TransientResourceRequest> requests(rnd() % 64 + 1);
+		unsigned num_passes = rnd() % 32 + 1;
+
+		for (auto &request : requests)
+		{
+			request.size = rnd() % (16 * 1024 * 1024) + 1;
+			request.alignment = uint64_t(1) << (rnd() % 17);
+			request.first_pass = rnd() % num_passes;
+			request.last_pass = request.first_pass + rnd() % (num_passes - request.first_pass);
+			request.group = rnd() % 3 == 0 ? 1 : 0;
+		}
+
+		uint64_t limit = (iter & 1) ? UINT64_MAX : 32 * 1024 * 1024;
+		auto plan = plan_requests(requests, limit);
+		if (!validate_plan(requests, plan, limit))
+		{
+			LOGE("Random graph %u failed.\n", iter);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main()
+{
+	if (!test_deferred_chain())
+		return EXIT_FAILURE;
+	if (!test_groups_and_block_limit())
+		return EXIT_FAILURE;
+	if (!test_random_graphs())
+		return EXIT_FAILURE;
+
+	LOGI("All transient memory planner tests passed.\n");
+}
@@ -0,0 +1,318 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "wsi_pacer.hpp"
+#include "cli_parser.hpp"
+#include "global_managers_init.hpp"
+#include "filesystem.hpp"
+#include "string_helpers.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <deque>
+#include <stdlib.h>
+
+// Deterministic stand-in for a fixed rate display with present timing feedback.
+// Each frame has some CPU time before submission, GPU time, and a compositor delay
+// which must pass between GPU completion and the vblank the frame is latched on.
+
+struct SimClock : FixedRefreshRatePacer::Clock
+{
+	int64_t now = 0;
+
+	int64_t get_time_ns() override
+	{
+		return now;
+	}
+
+	void sleep_until_ns(int64_t time_ns) override
+	{
+		now = std::max(now, time_ns);
+	}
+};
+
+struct FrameParams
+{
+	uint64_t cpu_ns;
+	uint64_t gpu_ns;
+	uint64_t compositor_ns;
+};
+
+using FrameGenerator = std::function<FrameParams (uint64_t, std::mt19937 &)>;
+
+struct Scenario
+{
+	std::string name;
+	FrameGenerator generator;
+};
+
+struct SimResult
+{
+	double mean_latency_ms;
+	double p50_latency_ms;
+	double p99_latency_ms;
+	unsigned gpu_misses;
+	unsigned compositor_misses;
+	unsigned frames;
+	double final_gap_ms;
+};
+
+static constexpr uint64_t FrameTimeNS = 16666667;
+static constexpr unsigned WarmupFrames = 120;
+
+static SimResult simulate(const Scenario &scenario, FixedRefreshRatePacer::Policy policy,
+                          double percentile, unsigned num_frames)
+{
+	SimClock clock;
+	FixedRefreshRatePacer pacer;
+	pacer.set_clock(&clock);
+	pacer.set_policy(policy);
+	pacer.set_target_percentile(percentile);
+
+	std::mt19937 rnd(1234);
+
+	struct Pending
+	{
+		uint64_t present_id;
+		uint64_t queue_done_ns;
+		uint64_t complete_ns;
+	};
+	std::deque<Pending> pending;
+	std::vector<uint64_t> complete_times(num_frames + 1);
+	std::vector<double> latencies;
+	latencies.reserve(num_frames);
+
+	SimResult result = {};
+	int64_t last_vblank = -1;
+
+	for (uint64_t present_id = 1; present_id <= num_frames; present_id++)
+	{
+		// Swapchain backpressure, at most two frames in flight.
+		if (present_id > 2)
+			clock.now = std::max<int64_t>(clock.now, int64_t(complete_times[present_id - 2]));
+
+		while (!pending.empty() && pending.front().complete_ns <= uint64_t(clock.now))
+		{
+			pacer.set_frame_time_ns(FrameTimeNS);
+			pacer.update_feedback(pending.front().present_id, pending.front().queue_done_ns, pending.front().complete_ns);
+			pending.pop_front();
+		}
+
+		pacer.begin_frame_submission(present_id);
+
+		auto params = scenario.generator(present_id, rnd);
+		uint64_t submit_ns = uint64_t(clock.now) + params.cpu_ns;
+		uint64_t queue_done_ns = submit_ns + params.gpu_ns;
+
+		// Latch on the first vblank the compositor can make, but never more than one frame per vblank.
+		int64_t intended_vblank = last_vblank + 1;
+		int64_t vblank = int64_t((queue_done_ns + params.compositor_ns + FrameTimeNS - 1) / FrameTimeNS);
+		vblank = std::max(vblank, intended_vblank);
+		uint64_t complete_ns = uint64_t(vblank) * FrameTimeNS;
+
+		if (present_id > WarmupFrames)
+		{
+			if (vblank > intended_vblank && last_vblank >= 0)
+			{
+				if (queue_done_ns > uint64_t(intended_vblank) * FrameTimeNS)
+					result.gpu_misses++;
+				else
+					result.compositor_misses++;
+			}
+			latencies.push_back(1e-6 * double(complete_ns - uint64_t(clock.now)));
+		}
+
+		last_vblank = vblank;
+		complete_times[present_id] = complete_ns;
+		pending.push_back({ present_id, queue_done_ns, complete_ns });
+		clock.now = int64_t(submit_ns);
+	}
+
+	result.frames = unsigned(latencies.size());
+	if (!latencies.empty())
+	{
+		double sum = 0.0;
+		for (auto l : latencies)
+			sum += l;
+		result.mean_latency_ms = sum / double(latencies.size());
+		std::sort(latencies.begin(), latencies.end());
+		result.p50_latency_ms = latencies[latencies.size() / 2];
+		result.p99_latency_ms = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+	}
+
+	result.final_gap_ms = 1e-6 * double(pacer.get_estimated_present_gap_ns());
+	return result;
+}
+
+static uint64_t ms_to_ns(double ms)
+{
+	return uint64_t(std::max(ms, 0.0) * 1e6);
+}
+
+static std::vector<Scenario> synthesize_scenarios()
+{
+	std::vector<Scenario> scenarios;
+
+	scenarios.push_back({ "steady", [](uint64_t, std::mt19937 &rnd) {
+		std::uniform_real_distribution<double> noise(-0.1, 0.1);
+		return FrameParams{ ms_to_ns(0.5), ms_to_ns(2.0 + noise(rnd)), ms_to_ns(1.0 + noise(rnd)) };
+	}});
+
+	scenarios.push_back({ "jitter", [](uint64_t, std::mt19937 &rnd) {
+		std::normal_distribution<double> gpu(2.0, 0.5);
+		std::exponential_distribution<double> compositor_tail(4.0);
+		return FrameParams{ ms_to_ns(0.5), ms_to_ns(gpu(rnd)), ms_to_ns(1.0 + compositor_tail(rnd)) };
+	}});
+
+	scenarios.push_back({ "gpu-spikes", [](uint64_t present_id, std::mt19937 &rnd) {
+		std::uniform_real_distribution<double> noise(-0.1, 0.1);
+		double gpu = (present_id % 97) == 0 ? 14.0 : 2.0 + noise(rnd);
+		return FrameParams{ ms_to_ns(0.5), ms_to_ns(gpu), ms_to_ns(1.0 + noise(rnd)) };
+	}});
+
+	scenarios.push_back({ "compositor-hiccups", [](uint64_t, std::mt19937 &rnd) {
+		std::uniform_real_distribution<double> noise(-0.1, 0.1);
+		std::uniform_int_distribution<int> hiccup(0, 99);
+		double compositor = hiccup(rnd) == 0 ? 6.0 : 1.0 + noise(rnd);
+		return FrameParams{ ms_to_ns(0.5), ms_to_ns(2.0 + noise(rnd)), ms_to_ns(compositor) };
+	}});
+
+	return scenarios;
+}
+
+// One frame per line: CPU, GPU and compositor time in milliseconds.
+static bool load_trace(const std::string &path, Scenario &scenario)
+{
+	std::string text;
+	if (!GRANITE_FILESYSTEM()->read_file_to_string(path, text))
+	{
+		LOGE("Failed to read trace %s.\n", path.c_str());
+		return false;
+	}
+
+	auto frames = std::make_shared<std::vector<FrameParams>>();
+	for (auto &line : Util::split_no_empty(text, "\n"))
+	{
+		if (line[0] == '#')
+			continue;
+		auto elems = Util::split_no_empty(line, " \t,");
+		if (elems.size() != 3)
+		{
+			LOGE("Invalid trace line: %s\n", line.c_str());
+			return false;
+		}
+		frames->push_back({ ms_to_ns(std::stod(elems[0])), ms_to_ns(std::stod(elems[1])), ms_to_ns(std::stod(elems[2])) });
+	}
+
+	if (frames->empty())
+	{
+		LOGE("Trace is empty.\n");
+		return false;
+	}
+
+	scenario.name = path;
+	scenario.generator = [frames](uint64_t present_id, std::mt19937 &) {
+		return (*frames)[(present_id - 1) % frames->size()];
+	};
+	return true;
+}
+
+static void print_help()
+{
+	LOGI("Usage: wsi-pacer-sim [--frames <count>] [--percentile <0.5 - 1.0>] [--trace <path>]\n");
+}
+
+int main(int argc, char **argv)
+{
+	Granite::Global::init(Granite::Global::MANAGER_FEATURE_FILESYSTEM_BIT);
+
+	unsigned num_frames = 3600;
+	double percentile = 0.99;
+	std::string trace_path;
+
+	Util::CLICallbacks cbs;
+	cbs.add("--frames", [&](Util::CLIParser &parser) { num_frames = parser.next_uint(); });
+	cbs.add("--percentile", [&](Util::CLIParser &parser) { percentile = parser.next_double(); });
+	cbs.add("--trace", [&](Util::CLIParser &parser) { trace_path = parser.next_string(); });
+	cbs.add("--help", [](Util::CLIParser &parser) { print_help(); parser.end(); });
+	cbs.error_handler = [] { print_help(); };
+
+	Util::CLIParser parser(std::move(cbs), argc - 1, argv + 1);
+	if (!parser.parse())
+		return EXIT_FAILURE;
+	else if (parser.is_ended_state())
+		return EXIT_SUCCESS;
+
+	if (num_frames <= WarmupFrames)
+	{
+		LOGE("Need more than %u frames.\n", WarmupFrames);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Scenario> scenarios;
+	if (!trace_path.empty())
+	{
+		Scenario scenario;
+		if (!load_trace(trace_path, scenario))
+			return EXIT_FAILURE;
+		scenarios.push_back(std::move(scenario));
+	}
+	else
+		scenarios = synthesize_scenarios();
+
+	static const struct
+	{
+		FixedRefreshRatePacer::Policy policy;
+		const char *name;
+	} policies[] = {
+		{ FixedRefreshRatePacer::Policy::ConfidencePromotion, "confidence" },
+		{ FixedRefreshRatePacer::Policy::LatencyPercentile, "percentile" },
+	};
+
+	bool success = true;
+	LOGI("%-20s %-12s %10s %10s %10s %10s %12s %10s\n",
+	     "scenario", "policy", "mean ms", "p50 ms", "p99 ms", "gpu miss", "comp. miss", "gap ms");
+
+	for (auto &scenario : scenarios)
+	{
+		for (auto &policy : policies)
+		{
+			auto result = simulate(scenario, policy.policy, percentile, num_frames);
+			LOGI("%-20s %-12s %10.3f %10.3f %10.3f %10u %12u %10.3f\n",
+			     scenario.name.c_str(), policy.name,
+			     result.mean_latency_ms, result.p50_latency_ms, result.p99_latency_ms,
+			     result.gpu_misses, result.compositor_misses, result.final_gap_ms);
+
+			// A stable workload must settle without stutter and well below a full frame of latency.
+			if (scenario.name == "steady" &&
+			    (result.compositor_misses + result.gpu_misses > result.frames / 100 ||
+			     result.p50_latency_ms > 1e-6 * double(FrameTimeNS)))
+			{
+				LOGE("Policy %s failed to settle on steady workload.\n", policy.name);
+				success = false;
+			}
+		}
+	}
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -173,7 +173,7 @@ void ThreadGroup::start(unsigned num_threads_foreground,
 	std::string path;
 	if (Util::get_environment("GRANITE_TIMELINE_TRACE", path))
 	{
-		LOGI("Enabling JSON timeline tracing to %s.\n", path.c_str());
+		LOGI("Enabling binary timeline tracing to %s. Convert with timeline-trace-convert.\n", path.c_str());
 		timeline_trace_file = std::make_unique<Util::TimelineTraceFile>(path);
 	}
 #endif
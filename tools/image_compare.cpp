@@ -29,6 +29,7 @@
 #include "texture_files.hpp"
 #include "thread_group.hpp"
 #include "global_managers_init.hpp"
+#include "image_metrics.hpp"
 #include <algorithm>
 #include <string.h>
 #include <vector>
@@ -77,47 +78,60 @@ static void save_diff_image(const std::string &path,
 		LOGE("Failed to save diff-png to %s.\n", path.c_str());
 }
 
-static double compare_images(const MemoryMappedTexture &a, const MemoryMappedTexture &b)
+static void save_error_map(const std::string &path, const std::vector<float> &error_map, int width, int height)
 {
-	if (a.get_layout().get_format() != b.get_layout().get_format())
+	std::vector<uint8_t> buffer(width * height * 4);
+	for (int pix = 0; pix < width * height; pix++)
 	{
-		LOGE("Format mismatch.\n");
-		return 0.0;
+		auto v = uint8_t(muglm::clamp(error_map[pix] * 255.0f + 0.5f, 0.0f, 255.0f));
+		buffer[4 * pix + 0] = v;
+		buffer[4 * pix + 1] = v;
+		buffer[4 * pix + 2] = v;
+		buffer[4 * pix + 3] = 255;
 	}
 
-	if (a.get_layout().get_format() != VK_FORMAT_R8G8B8A8_SRGB &&
-	    a.get_layout().get_format() != VK_FORMAT_R8G8B8A8_UNORM)
+	if (!stbi_write_png(path.c_str(), width, height, 4, buffer.data(), width * 4))
+		LOGE("Failed to save error map to %s.\n", path.c_str());
+}
+
+struct Thresholds
+{
+	double psnr = -1.0;
+	double ssim = -1.0;
+	double flip = -1.0;
+};
+
+static void log_metrics(const ImageMetrics &metrics, ImageMetricFlags flags)
+{
+	LOGI("PSNR: %.f dB (R: %.f dB, G: %.f dB, B: %.f dB, A: %.f dB)\n",
+	     metrics.psnr_rgb, metrics.psnr[0], metrics.psnr[1], metrics.psnr[2], metrics.psnr[3]);
+	if (flags & IMAGE_METRIC_SSIM_BIT)
+		LOGI("SSIM: %.5f\n", metrics.ssim);
+	if (flags & IMAGE_METRIC_FLIP_BIT)
+		LOGI("FLIP: %.5f\n", metrics.flip);
+}
+
+static bool check_thresholds(const ImageMetrics &metrics, const Thresholds &thresholds)
+{
+	if (thresholds.psnr >= 0.0 && metrics.psnr_rgb < thresholds.psnr)
 	{
-		LOGE("Unsupported format.\n");
-		return 0.0;
+		LOGE("PSNR is too low, failure!\n");
+		return false;
 	}
 
-	if (a.get_layout().get_width() != b.get_layout().get_width() ||
-	    a.get_layout().get_height() != b.get_layout().get_height())
+	if (thresholds.ssim >= 0.0 && metrics.ssim < thresholds.ssim)
 	{
-		LOGE("Dimension mismatch.\n");
-		return 0.0;
+		LOGE("SSIM is too low, failure!\n");
+		return false;
 	}
 
-	int width = a.get_layout().get_width();
-	int height = a.get_layout().get_height();
-
-	auto *src_a = static_cast<const uint8_t *>(a.get_layout().data());
-	auto *src_b = static_cast<const uint8_t *>(b.get_layout().data());
-
-	double peak_energy = 255.0 * 255.0 * width * height * 3.0;
-	double error_energy = 0.0;
-	for (int pix = 0; pix < width * height; pix++, src_a += 4, src_b += 4)
+	if (thresholds.flip >= 0.0 && metrics.flip > thresholds.flip)
 	{
-		int diff_r = src_a[0] - src_b[0];
-		int diff_g = src_a[1] - src_b[1];
-		int diff_b = src_a[2] - src_b[2];
-		error_energy += diff_r * diff_r;
-		error_energy += diff_g * diff_g;
-		error_energy += diff_b * diff_b;
+		LOGE("FLIP error is too high, failure!\n");
+		return false;
 	}
 
-	return 10.0 * muglm::log10(peak_energy / error_energy);
+	return true;
 }
 
 int main(int argc, char *argv[])
@@ -128,16 +142,36 @@ int main(int argc, char *argv[])
 	{
 		std::vector<std::string> inputs;
 		std::string diff;
-		double threshold = -1.0;
+		std::string error_map;
+		Thresholds thresholds;
+		ImageMetricFlags flags = IMAGE_METRIC_PSNR_BIT;
 	} args;
 	CLICallbacks cbs;
 
 	cbs.add("--threshold", [&](CLIParser &parser) {
-		args.threshold = parser.next_double();
+		args.thresholds.psnr = parser.next_double();
+	});
+	cbs.add("--ssim", [&](CLIParser &) {
+		args.flags |= IMAGE_METRIC_SSIM_BIT;
+	});
+	cbs.add("--ssim-threshold", [&](CLIParser &parser) {
+		args.thresholds.ssim = parser.next_double();
+		args.flags |= IMAGE_METRIC_SSIM_BIT;
+	});
+	cbs.add("--flip", [&](CLIParser &) {
+		args.flags |= IMAGE_METRIC_FLIP_BIT;
+	});
+	cbs.add("--flip-threshold", [&](CLIParser &parser) {
+		args.thresholds.flip = parser.next_double();
+		args.flags |= IMAGE_METRIC_FLIP_BIT;
 	});
 	cbs.add("--diff", [&](CLIParser &parser) {
 		args.diff = parser.next_string();
 	});
+	cbs.add("--error-map", [&](CLIParser &parser) {
+		args.error_map = parser.next_string();
+		args.flags |= IMAGE_METRIC_FLIP_BIT;
+	});
 	cbs.default_handler = [&](const char *arg) {
 		args.inputs.push_back(arg);
 	};
@@ -178,24 +212,28 @@ int main(int argc, char *argv[])
 			return 1;
 		}
 
-		std::vector<double> psnrs(a_list.size());
-		std::vector<bool> ignore(a_list.size());
+		enum class Status : uint8_t
+		{
+			OK,
+			LoadFailed,
+			Incompatible
+		};
+		std::vector<ImageMetrics> metrics(a_list.size());
+		// Written from parallel tasks, so no bit-packed vector<bool> here.
+		std::vector<Status> status(a_list.size(), Status::OK);
 
 		auto task = workers.create_task();
 
+		// Images are already compared in parallel, so each comparison runs inline on its worker.
 		for (unsigned i = 0; i < a_list.size(); i++)
 		{
-			task->enqueue_task([&a_list, &b_list, &psnrs, &ignore, i]() {
+			task->enqueue_task([&a_list, &b_list, &metrics, &status, &args, i]() {
 				auto a = load_texture_from_file(*GRANITE_FILESYSTEM(), a_list[i].path);
 				auto b = load_texture_from_file(*GRANITE_FILESYSTEM(), b_list[i].path);
 				if (a.empty() || b.empty())
-				{
-					psnrs[i] = 0.0;
-					ignore[i] = true;
-				}
-
-				psnrs[i] = compare_images(a, b);
-
+					status[i] = Status::LoadFailed;
+				else if (!compute_image_metrics(a.get_layout(), b.get_layout(), args.flags, metrics[i]))
+					status[i] = Status::Incompatible;
 			});
 		}
 
@@ -204,19 +242,21 @@ int main(int argc, char *argv[])
 
 		for (unsigned i = 0; i < a_list.size(); i++)
 		{
-			if (ignore[i])
-				continue;
-
-			LOGI("%s | %s | PSNR: %.f dB\n", a_list[i].path.c_str(), b_list[i].path.c_str(), psnrs[i]);
-
-			if (args.threshold >= 0.0)
+			if (status[i] == Status::LoadFailed)
+			{
+				LOGE("Failed to load texture: %s | %s\n", a_list[i].path.c_str(), b_list[i].path.c_str());
+				return 1;
+			}
+			else if (status[i] == Status::Incompatible)
 			{
-				if (psnrs[i] < args.threshold)
-				{
-					LOGE("PSNR is too low, failure!\n");
-					return 1;
-				}
+				LOGE("Mismatched dimensions or formats: %s | %s\n", a_list[i].path.c_str(), b_list[i].path.c_str());
+				return 1;
 			}
+
+			LOGI("%s | %s\n", a_list[i].path.c_str(), b_list[i].path.c_str());
+			log_metrics(metrics[i], args.flags);
+			if (!check_thresholds(metrics[i], args.thresholds))
+				return 1;
 		}
 	}
 	else
@@ -241,17 +281,25 @@ int main(int argc, char *argv[])
 			save_diff_image(args.diff, a, b);
 		}
 
-		double psnr = compare_images(a, b);
-		LOGI("PSNR: %.f dB\n", psnr);
+		int width = int(a.get_layout().get_width());
+		int height = int(a.get_layout().get_height());
+		std::vector<float> error_map;
+		if (!args.error_map.empty())
+			error_map.resize(width * height);
 
-		if (args.threshold >= 0.0)
+		ImageMetrics metrics;
+		if (!compute_image_metrics(a.get_layout(), b.get_layout(), args.flags, metrics, &workers,
+		                           error_map.empty() ? nullptr : error_map.data()))
 		{
-			if (psnr < args.threshold)
-			{
-				LOGE("PSNR is too low, failure!\n");
-				return 1;
-			}
+			return 1;
 		}
+
+		if (!error_map.empty())
+			save_error_map(args.error_map, error_map, width, height);
+
+		log_metrics(metrics, args.flags);
+		if (!check_thresholds(metrics, args.thresholds))
+			return 1;
 	}
 
 	return 0;
@@ -0,0 +1,571 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "timeline_trace_file.hpp"
+#include "cli_parser.hpp"
+#include "logging.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdlib.h>
+#include <float.h>
+#include <cmath>
+
+using namespace Util;
+using namespace Util::TimelineTrace;
+
+struct Trace
+{
+	std::vector<std::string> strings;
+	std::vector<Record> records;
+
+	const std::string &get_string(uint32_t id) const
+	{
+		static const std::string empty;
+		return id < strings.size() ? strings[id] : empty;
+	}
+};
+
+static bool load_trace(const char *path, Trace &trace)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+	{
+		LOGE("Failed to open %s.\n", path);
+		return false;
+	}
+
+	FileHeader header = {};
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+	    header.version != Version || header.record_size != sizeof(Record))
+	{
+		LOGE("%s is not a timeline trace file.\n", path);
+		fclose(file);
+		return false;
+	}
+
+	BlockHeader block;
+	std::vector<char> string_data;
+	while (fread(&block, sizeof(block), 1, file) == 1)
+	{
+		if (block.type == BlockType::Strings)
+		{
+			string_data.resize(block.count);
+			if (fread(string_data.data(), 1, block.count, file) != block.count)
+				break;
+
+			size_t offset = 0;
+			while (offset + 2 * sizeof(uint32_t) <= string_data.size())
+			{
+				uint32_t words[2];
+				memcpy(words, string_data.data() + offset, sizeof(words));
+				offset += sizeof(words);
+				if (offset + words[1] > string_data.size())
+					break;
+
+				if (words[0] >= trace.strings.size())
+					trace.strings.resize(words[0] + 1);
+				trace.strings[words[0]].assign(string_data.data() + offset, words[1]);
+				offset += words[1];
+			}
+		}
+		else if (block.type == BlockType::Records)
+		{
+			size_t offset = trace.records.size();
+			trace.records.resize(offset + block.count);
+			if (fread(trace.records.data() + offset, sizeof(Record), block.count, file) != block.count)
+			{
+				// Truncated file, e.g. application crashed. Keep what we have.
+				trace.records.resize(offset);
+				break;
+			}
+		}
+		else
+		{
+			LOGE("Unknown block type %u.\n", unsigned(block.type));
+			break;
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+static double get_counter_value(const Record &record)
+{
+	double value;
+	memcpy(&value, &record.payload, sizeof(value));
+	return value;
+}
+
+// JSON has no representation of NaN or infinity.
+static std::string format_json_number(double value)
+{
+	if (std::isnan(value))
+		return "null";
+	if (std::isinf(value))
+		value = value > 0.0 ? DBL_MAX : -DBL_MAX;
+
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.17g", value);
+	return buf;
+}
+
+static std::string escape_json(const std::string &str)
+{
+	std::string escaped;
+	escaped.reserve(str.size());
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped.push_back('\\');
+			escaped.push_back(c);
+		}
+		else if (uint8_t(c) < 0x20)
+		{
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", unsigned(uint8_t(c)));
+			escaped += buf;
+		}
+		else
+			escaped.push_back(c);
+	}
+	return escaped;
+}
+
+static uint64_t get_base_timestamp(const Trace &trace)
+{
+	uint64_t base = UINT64_MAX;
+	for (auto &record : trace.records)
+		base = std::min(base, record.timestamp_ns);
+	return base == UINT64_MAX ? 0 : base;
+}
+
+static bool write_chrome_json(const Trace &trace, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+	{
+		LOGE("Failed to open %s for writing.\n", path);
+		return false;
+	}
+
+	uint64_t base_ts = get_base_timestamp(trace);
+	fputs("[\n", file);
+	bool first = true;
+
+	for (auto &record : trace.records)
+	{
+		// Unknown records from newer writers are skipped.
+		if (record.type > RecordType::FlowEnd)
+			continue;
+
+		auto name = escape_json(trace.get_string(record.name));
+		auto tid = escape_json(trace.get_string(record.tid));
+		double ts_us = 1e-3 * double(int64_t(record.timestamp_ns - base_ts));
+
+		if (!first)
+			fputs(",\n", file);
+		first = false;
+
+		switch (record.type)
+		{
+		case RecordType::Slice:
+		{
+			double dur_us = 1e-3 * double(int64_t(record.payload - record.timestamp_ns));
+			fprintf(file, "{ \"name\": \"%s\", \"ph\": \"X\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %.3f, \"dur\": %.3f }",
+			        name.c_str(), tid.c_str(), record.pid, ts_us, dur_us);
+			break;
+		}
+
+		case RecordType::Instant:
+			fprintf(file, "{ \"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %.3f }",
+			        name.c_str(), tid.c_str(), record.pid, ts_us);
+			break;
+
+		case RecordType::Counter:
+			fprintf(file, "{ \"name\": \"%s\", \"ph\": \"C\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %.3f, \"args\": { \"value\": %s } }",
+			        name.c_str(), tid.c_str(), record.pid, ts_us, format_json_number(get_counter_value(record)).c_str());
+			break;
+
+		case RecordType::FlowBegin:
+		case RecordType::FlowEnd:
+			fprintf(file, "{ \"name\": \"%s\", \"cat\": \"flow\", \"ph\": \"%s\", \"bp\": \"e\", \"id\": %llu, \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %.3f }",
+			        name.c_str(), record.type == RecordType::FlowBegin ? "s" : "f",
+			        static_cast<unsigned long long>(record.payload), tid.c_str(), record.pid, ts_us);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	fputs("\n]\n", file);
+	fclose(file);
+	return true;
+}
+
+// Minimal protobuf encoder for the subset of perfetto/trace/trace_packet.proto we need.
+struct ProtoWriter
+{
+	std::vector<uint8_t> buffer;
+
+	void varint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			buffer.push_back(uint8_t(value | 0x80));
+			value >>= 7;
+		}
+		buffer.push_back(uint8_t(value));
+	}
+
+	void tag(uint32_t field, uint32_t wire_type)
+	{
+		varint((uint64_t(field) << 3) | wire_type);
+	}
+
+	void u64(uint32_t field, uint64_t value)
+	{
+		tag(field, 0);
+		varint(value);
+	}
+
+	void fixed64(uint32_t field, uint64_t value)
+	{
+		tag(field, 1);
+		for (unsigned i = 0; i < 8; i++)
+			buffer.push_back(uint8_t(value >> (8 * i)));
+	}
+
+	void f64(uint32_t field, double value)
+	{
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		fixed64(field, bits);
+	}
+
+	void bytes(uint32_t field, const void *data, size_t size)
+	{
+		tag(field, 2);
+		varint(size);
+		auto *ptr = static_cast<const uint8_t *>(data);
+		buffer.insert(buffer.end(), ptr, ptr + size);
+	}
+
+	void string(uint32_t field, const std::string &str)
+	{
+		bytes(field, str.data(), str.size());
+	}
+
+	void message(uint32_t field, const ProtoWriter &msg)
+	{
+		bytes(field, msg.buffer.data(), msg.buffer.size());
+	}
+};
+
+namespace Perfetto
+{
+enum
+{
+	Trace_packet = 1,
+
+	TracePacket_timestamp = 8,
+	TracePacket_trusted_packet_sequence_id = 10,
+	TracePacket_track_event = 11,
+	TracePacket_track_descriptor = 60,
+
+	TrackDescriptor_uuid = 1,
+	TrackDescriptor_name = 2,
+	TrackDescriptor_process = 3,
+	TrackDescriptor_thread = 4,
+	TrackDescriptor_parent_uuid = 5,
+	TrackDescriptor_counter = 8,
+
+	ProcessDescriptor_pid = 1,
+	ProcessDescriptor_process_name = 6,
+
+	ThreadDescriptor_pid = 1,
+	ThreadDescriptor_tid = 2,
+	ThreadDescriptor_thread_name = 5,
+
+	TrackEvent_type = 9,
+	TrackEvent_track_uuid = 11,
+	TrackEvent_name = 23,
+	TrackEvent_double_counter_value = 44,
+	TrackEvent_flow_ids = 47,
+	TrackEvent_terminating_flow_ids = 48,
+
+	TypeSliceBegin = 1,
+	TypeSliceEnd = 2,
+	TypeInstant = 3,
+	TypeCounter = 4
+};
+}
+
+struct TrackItem
+{
+	uint64_t timestamp_ns;
+	uint32_t type;
+	const Record *record;
+};
+
+static void write_packet(FILE *file, const ProtoWriter &packet)
+{
+	ProtoWriter trace;
+	trace.message(Perfetto::Trace_packet, packet);
+	fwrite(trace.buffer.data(), 1, trace.buffer.size(), file);
+}
+
+static void write_track_event(FILE *file, uint64_t track_uuid, const TrackItem &item, const Trace &trace)
+{
+	ProtoWriter event;
+	event.u64(Perfetto::TrackEvent_type, item.type);
+	event.u64(Perfetto::TrackEvent_track_uuid, track_uuid);
+
+	if (item.type != Perfetto::TypeSliceEnd && item.type != Perfetto::TypeCounter)
+		event.string(Perfetto::TrackEvent_name, trace.get_string(item.record->name));
+
+	if (item.type == Perfetto::TypeCounter)
+		event.f64(Perfetto::TrackEvent_double_counter_value, get_counter_value(*item.record));
+	else if (item.record->type == RecordType::FlowBegin)
+		event.fixed64(Perfetto::TrackEvent_flow_ids, item.record->payload);
+	else if (item.record->type == RecordType::FlowEnd)
+		event.fixed64(Perfetto::TrackEvent_terminating_flow_ids, item.record->payload);
+
+	ProtoWriter packet;
+	packet.u64(Perfetto::TracePacket_timestamp, item.timestamp_ns);
+	packet.u64(Perfetto::TracePacket_trusted_packet_sequence_id, 1);
+	packet.message(Perfetto::TracePacket_track_event, event);
+	write_packet(file, packet);
+}
+
+// Slices on a track must be strictly nested. Sort slices by start time, longest first,
+// and clamp any child which overlaps the end of its parent.
+static std::vector<TrackItem> build_track_items(std::vector<const Record *> &records)
+{
+	std::sort(records.begin(), records.end(), [](const Record *a, const Record *b) {
+		if (a->timestamp_ns != b->timestamp_ns)
+			return a->timestamp_ns < b->timestamp_ns;
+		return a->payload > b->payload;
+	});
+
+	std::vector<TrackItem> items;
+	std::vector<TrackItem> stack;
+
+	for (auto *record : records)
+	{
+		if (record->type != RecordType::Slice)
+		{
+			while (!stack.empty() && stack.back().timestamp_ns <= record->timestamp_ns)
+			{
+				items.push_back(stack.back());
+				stack.pop_back();
+			}
+			items.push_back({ record->timestamp_ns, Perfetto::TypeInstant, record });
+			continue;
+		}
+
+		while (!stack.empty() && stack.back().timestamp_ns <= record->timestamp_ns)
+		{
+			items.push_back(stack.back());
+			stack.pop_back();
+		}
+
+		uint64_t end_ns = record->payload;
+		if (!stack.empty())
+			end_ns = std::min(end_ns, stack.back().timestamp_ns);
+
+		items.push_back({ record->timestamp_ns, Perfetto::TypeSliceBegin, record });
+		stack.push_back({ end_ns, Perfetto::TypeSliceEnd, record });
+	}
+
+	while (!stack.empty())
+	{
+		items.push_back(stack.back());
+		stack.pop_back();
+	}
+
+	return items;
+}
+
+static bool write_perfetto(const Trace &trace, const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (!file)
+	{
+		LOGE("Failed to open %s for writing.\n", path);
+		return false;
+	}
+
+	// Perfetto wants non-zero PIDs and integer TIDs, so remap everything.
+	// UUIDs are assigned as: processes, then threads, then counters.
+	std::map<uint32_t, uint64_t> process_uuids;
+	std::map<std::pair<uint32_t, uint32_t>, std::vector<const Record *>> thread_tracks;
+	std::map<std::pair<uint32_t, uint32_t>, std::vector<const Record *>> counter_tracks;
+
+	for (auto &record : trace.records)
+	{
+		if (record.type == RecordType::Slice && record.payload < record.timestamp_ns)
+			continue;
+
+		process_uuids[record.pid] = 0;
+		if (record.type == RecordType::Counter)
+			counter_tracks[{ record.pid, record.name }].push_back(&record);
+		else
+			thread_tracks[{ record.pid, record.tid }].push_back(&record);
+	}
+
+	uint64_t uuid = 1;
+
+	for (auto &process : process_uuids)
+	{
+		process.second = uuid++;
+
+		char name[32];
+		snprintf(name, sizeof(name), "pid %u", process.first);
+
+		ProtoWriter desc;
+		desc.u64(Perfetto::ProcessDescriptor_pid, process.first + 1);
+		desc.string(Perfetto::ProcessDescriptor_process_name, name);
+
+		ProtoWriter track;
+		track.u64(Perfetto::TrackDescriptor_uuid, process.second);
+		track.message(Perfetto::TrackDescriptor_process, desc);
+
+		ProtoWriter packet;
+		packet.message(Perfetto::TracePacket_track_descriptor, track);
+		write_packet(file, packet);
+	}
+
+	for (auto &thread : thread_tracks)
+	{
+		uint64_t thread_uuid = uuid++;
+
+		ProtoWriter desc;
+		desc.u64(Perfetto::ThreadDescriptor_pid, thread.first.first + 1);
+		desc.u64(Perfetto::ThreadDescriptor_tid, thread_uuid);
+		desc.string(Perfetto::ThreadDescriptor_thread_name, trace.get_string(thread.first.second));
+
+		ProtoWriter track;
+		track.u64(Perfetto::TrackDescriptor_uuid, thread_uuid);
+		track.message(Perfetto::TrackDescriptor_thread, desc);
+
+		ProtoWriter packet;
+		packet.message(Perfetto::TracePacket_track_descriptor, track);
+		write_packet(file, packet);
+
+		for (auto &item : build_track_items(thread.second))
+			write_track_event(file, thread_uuid, item, trace);
+	}
+
+	for (auto &counter : counter_tracks)
+	{
+		uint64_t counter_uuid = uuid++;
+
+		ProtoWriter track;
+		track.u64(Perfetto::TrackDescriptor_uuid, counter_uuid);
+		track.u64(Perfetto::TrackDescriptor_parent_uuid, process_uuids[counter.first.first]);
+		track.string(Perfetto::TrackDescriptor_name, trace.get_string(counter.first.second));
+		track.message(Perfetto::TrackDescriptor_counter, ProtoWriter());
+
+		ProtoWriter packet;
+		packet.message(Perfetto::TracePacket_track_descriptor, track);
+		write_packet(file, packet);
+
+		std::stable_sort(counter.second.begin(), counter.second.end(), [](const Record *a, const Record *b) {
+			return a->timestamp_ns < b->timestamp_ns;
+		});
+
+		for (auto *record : counter.second)
+			write_track_event(file, counter_uuid, { record->timestamp_ns, Perfetto::TypeCounter, record }, trace);
+	}
+
+	fclose(file);
+	return true;
+}
+
+static void print_help()
+{
+	LOGI("Usage: timeline-trace-convert <input.bin> --output <path> [--format <json|perfetto>]\n");
+	LOGI("If --format is not specified, .json outputs are written as Chrome JSON, anything else as Perfetto protobuf.\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct Arguments
+	{
+		std::string input;
+		std::string output;
+		std::string format;
+	} args;
+
+	CLICallbacks cbs;
+	cbs.add("--output", [&](CLIParser &parser) { args.output = parser.next_string(); });
+	cbs.add("--format", [&](CLIParser &parser) { args.format = parser.next_string(); });
+	cbs.add("--help", [](CLIParser &parser) { print_help(); parser.end(); });
+	cbs.default_handler = [&](const char *arg) { args.input = arg; };
+	cbs.error_handler = [] { print_help(); };
+
+	CLIParser parser(std::move(cbs), argc - 1, argv + 1);
+	if (!parser.parse())
+		return EXIT_FAILURE;
+	else if (parser.is_ended_state())
+		return EXIT_SUCCESS;
+
+	if (args.input.empty() || args.output.empty())
+	{
+		print_help();
+		return EXIT_FAILURE;
+	}
+
+	if (args.format.empty())
+	{
+		bool is_json = args.output.size() >= 5 &&
+		               args.output.compare(args.output.size() - 5, 5, ".json") == 0;
+		args.format = is_json ? "json" : "perfetto";
+	}
+
+	Trace trace;
+	if (!load_trace(args.input.c_str(), trace))
+		return EXIT_FAILURE;
+
+	LOGI("Loaded %zu records, %zu strings.\n", trace.records.size(), trace.strings.size());
+
+	bool ret;
+	if (args.format == "json")
+		ret = write_chrome_json(trace, args.output.c_str());
+	else if (args.format == "perfetto")
+		ret = write_perfetto(trace, args.output.c_str());
+	else
+	{
+		LOGE("Unknown format: %s.\n", args.format.c_str());
+		ret = false;
+	}
+
+	return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -73,6 +73,11 @@ public:
 		return longest_run;
 	}
 
+	inline uint32_t get_used_block_count() const
+	{
+		return NumSubBlocks - popcount32(free_blocks[0]);
+	}
+
 	void allocate(uint32_t num_blocks, uint32_t &mask, uint32_t &offset);
 	void free(uint32_t mask);
 
@@ -88,6 +93,14 @@ struct LegionHeap : Util::IntrusiveListEnabled<LegionHeap<BackingAllocation>>
 {
 	BackingAllocation allocation;
 	Util::LegionAllocator heap;
+
+	// Bytes handed out to leaf allocations, including any nested heaps.
+	// Maintained by derived allocators which care about fragmentation.
+	uint64_t live_size = 0;
+
+	// Retired heaps do not service new allocations.
+	// They are released as usual when their last allocation is freed.
+	bool retired = false;
 };
 
 template <typename BackingAllocation>
@@ -95,6 +108,7 @@ struct AllocationArena
 {
 	Util::IntrusiveList<LegionHeap<BackingAllocation>> heaps[Util::LegionAllocator::NumSubBlocks];
 	Util::IntrusiveList<LegionHeap<BackingAllocation>> full_heaps;
+	Util::IntrusiveList<LegionHeap<BackingAllocation>> retired_heaps;
 	uint32_t heap_availability_mask = 0;
 };
 
@@ -105,6 +119,46 @@ struct SuballocationResult
 	uint32_t mask;
 };
 
+// Opt-in telemetry for an ArenaAllocator. Sizes are in bytes, rounded up to sub-blocks.
+// Live size of an arena includes any nested heaps which are sub-allocated from it.
+struct ArenaAllocatorStats
+{
+	uint32_t sub_block_size = 0;
+	uint32_t heap_count = 0;
+	uint32_t peak_heap_count = 0;
+	uint64_t live_size = 0;
+	uint64_t peak_live_size = 0;
+
+	// Counted while stats are enabled.
+	uint64_t allocation_count = 0;
+	uint64_t free_count = 0;
+	uint64_t heap_allocation_count = 0;
+	uint64_t heap_free_count = 0;
+
+	// Index N counts allocations of N + 1 sub-blocks.
+	uint64_t allocation_size_histogram[LegionAllocator::NumSubBlocks] = {};
+	// Index N counts heaps whose longest run of free sub-blocks is N, sampled when queried.
+	uint32_t longest_free_run_histogram[LegionAllocator::NumSubBlocks + 1] = {};
+
+	// Peaks are summed, so the accumulated peak is an upper bound.
+	void accumulate(const ArenaAllocatorStats &other)
+	{
+		sub_block_size = sub_block_size > other.sub_block_size ? sub_block_size : other.sub_block_size;
+		heap_count += other.heap_count;
+		peak_heap_count += other.peak_heap_count;
+		live_size += other.live_size;
+		peak_live_size += other.peak_live_size;
+		allocation_count += other.allocation_count;
+		free_count += other.free_count;
+		heap_allocation_count += other.heap_allocation_count;
+		heap_free_count += other.heap_free_count;
+		for (uint32_t i = 0; i < LegionAllocator::NumSubBlocks; i++)
+			allocation_size_histogram[i] += other.allocation_size_histogram[i];
+		for (uint32_t i = 0; i <= LegionAllocator::NumSubBlocks; i++)
+			longest_free_run_histogram[i] += other.longest_free_run_histogram[i];
+	}
+};
+
 template <typename DerivedAllocator, typename BackingAllocation>
 class ArenaAllocator
 {
@@ -117,6 +171,8 @@ public:
 
 		if (heap_arena.full_heaps.begin())
 			error = true;
+		if (heap_arena.retired_heaps.begin())
+			error = true;
 
 		for (auto &h : heap_arena.heaps)
 			if (h.begin())
@@ -162,6 +218,8 @@ public:
 
 			auto &heap = *itr;
 			static_cast<DerivedAllocator *>(this)->prepare_allocation(alloc, itr, suballocate(num_blocks, heap));
+			if (stats_enabled)
+				record_allocation(num_blocks, false);
 
 			unsigned new_index = heap.heap.get_longest_run() - 1;
 
@@ -198,6 +256,8 @@ public:
 
 		// This cannot fail.
 		static_cast<DerivedAllocator *>(this)->prepare_allocation(alloc, node, suballocate(num_blocks, heap));
+		if (stats_enabled)
+			record_allocation(num_blocks, true);
 
 		if (heap.heap.full())
 		{
@@ -217,6 +277,23 @@ public:
 	{
 		auto *heap = itr.get();
 		auto &block = heap->heap;
+
+		if (stats_enabled)
+			record_free(mask, block.get_used_block_count() == popcount32(mask));
+
+		if (heap->retired)
+		{
+			block.free(mask);
+			if (block.empty())
+			{
+				static_cast<DerivedAllocator *>(this)->free_backing_heap(&heap->allocation);
+				heap_arena.retired_heaps.erase(heap);
+				heap->retired = false;
+				object_pool->free(heap);
+			}
+			return;
+		}
+
 		bool was_full = block.full();
 
 		unsigned index = block.get_longest_run() - 1;
@@ -257,6 +334,98 @@ public:
 		object_pool = object_pool_;
 	}
 
+	// Stops a heap from servicing new allocations so that its live allocations can be moved elsewhere.
+	inline void retire_heap(MiniHeap *heap)
+	{
+		if (heap->retired)
+			return;
+
+		if (heap->heap.full())
+		{
+			heap_arena.full_heaps.erase(heap);
+		}
+		else
+		{
+			unsigned index = heap->heap.get_longest_run() - 1;
+			heap_arena.heaps[index].erase(heap);
+			if (!heap_arena.heaps[index].begin())
+				heap_arena.heap_availability_mask &= ~(1u << index);
+		}
+
+		heap_arena.retired_heaps.insert_front(heap);
+		heap->retired = true;
+	}
+
+	// Puts every retired heap which still has live allocations back into circulation.
+	inline void restore_retired_heaps()
+	{
+		while (auto itr = heap_arena.retired_heaps.begin())
+		{
+			auto *heap = itr.get();
+			heap->retired = false;
+
+			if (heap->heap.full())
+			{
+				heap_arena.full_heaps.move_to_front(heap_arena.retired_heaps, itr);
+			}
+			else
+			{
+				unsigned index = heap->heap.get_longest_run() - 1;
+				heap_arena.heaps[index].move_to_front(heap_arena.retired_heaps, itr);
+				heap_arena.heap_availability_mask |= 1u << index;
+			}
+		}
+	}
+
+	// Counters start from zero, while live size and heap count are seeded from the current state.
+	inline void set_stats_enabled(bool enable)
+	{
+		stats_enabled = enable;
+		if (enable)
+		{
+			stats = {};
+			get_stats(stats);
+			stats.peak_live_size = stats.live_size;
+			stats.peak_heap_count = stats.heap_count;
+			for (auto &count : stats.longest_free_run_histogram)
+				count = 0;
+		}
+	}
+
+	inline bool get_stats_enabled() const
+	{
+		return stats_enabled;
+	}
+
+	inline void get_stats(ArenaAllocatorStats &out_stats) const
+	{
+		if (stats_enabled)
+			out_stats = stats;
+		else
+			out_stats = {};
+
+		out_stats.sub_block_size = sub_block_size;
+		out_stats.heap_count = 0;
+		out_stats.live_size = 0;
+		for_each_heap([&](const MiniHeap &heap) {
+			out_stats.heap_count++;
+			out_stats.live_size += uint64_t(heap.heap.get_used_block_count()) << sub_block_size_log2;
+			out_stats.longest_free_run_histogram[heap.heap.get_longest_run()]++;
+		});
+	}
+
+	template <typename Func>
+	inline void for_each_heap(const Func &func) const
+	{
+		for (auto itr = heap_arena.full_heaps.begin(); itr; ++itr)
+			func(*itr);
+		for (auto &list : heap_arena.heaps)
+			for (auto itr = list.begin(); itr; ++itr)
+				func(*itr);
+		for (auto itr = heap_arena.retired_heaps.begin(); itr; ++itr)
+			func(*itr);
+	}
+
 protected:
 	AllocationArena<BackingAllocation> heap_arena;
 	ObjectPool<LegionHeap<BackingAllocation>> *object_pool = nullptr;
@@ -264,7 +433,38 @@ protected:
 	uint32_t sub_block_size = 1;
 	uint32_t sub_block_size_log2 = 0;
 
+	ArenaAllocatorStats stats;
+	bool stats_enabled = false;
+
 private:
+	inline void record_allocation(uint32_t num_blocks, bool new_heap)
+	{
+		stats.allocation_count++;
+		stats.allocation_size_histogram[num_blocks - 1]++;
+		stats.live_size += uint64_t(num_blocks) << sub_block_size_log2;
+		if (stats.live_size > stats.peak_live_size)
+			stats.peak_live_size = stats.live_size;
+
+		if (new_heap)
+		{
+			stats.heap_allocation_count++;
+			stats.heap_count++;
+			if (stats.heap_count > stats.peak_heap_count)
+				stats.peak_heap_count = stats.heap_count;
+		}
+	}
+
+	inline void record_free(uint32_t mask, bool frees_heap)
+	{
+		stats.free_count++;
+		stats.live_size -= uint64_t(popcount32(mask)) << sub_block_size_log2;
+		if (frees_heap)
+		{
+			stats.heap_free_count++;
+			stats.heap_count--;
+		}
+	}
+
 	inline SuballocationResult suballocate(uint32_t num_blocks, MiniHeap &heap)
 	{
 		SuballocationResult res = {};
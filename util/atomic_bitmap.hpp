@@ -0,0 +1,233 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+#include "bitops.hpp"
+
+namespace Util
+{
+// Fixed size bitmap which can be set concurrently from any thread.
+// A summary level keeps one bit per non-zero word, so iteration and clearing
+// only touch words which were actually written to.
+// Iteration yields set bits in increasing order, and each bit only once, no matter how many times it was set.
+class AtomicBitmap
+{
+public:
+	void init(unsigned num_bits_log2)
+	{
+		assert(num_bits_log2 >= 6);
+		num_bits = 1u << num_bits_log2;
+		num_words = num_bits / 64;
+		num_summary_words = (num_words + 63) / 64;
+		words.reset(new std::atomic<uint64_t>[num_words]);
+		summary.reset(new std::atomic<uint64_t>[num_summary_words]);
+		for (uint32_t i = 0; i < num_words; i++)
+			words[i].store(0, std::memory_order_relaxed);
+		for (uint32_t i = 0; i < num_summary_words; i++)
+			summary[i].store(0, std::memory_order_relaxed);
+	}
+
+	uint32_t get_num_bits() const
+	{
+		return num_bits;
+	}
+
+	uint32_t get_num_words() const
+	{
+		return num_words;
+	}
+
+	// Thread-safe. Returns true if the bit was not set before.
+	bool set(uint32_t index)
+	{
+		assert(index < num_bits);
+		if (index >= num_bits)
+			return false;
+
+		uint64_t mask = uint64_t(1) << (index & 63);
+		return (set_word_bits(index >> 6, mask) & mask) == 0;
+	}
+
+	// Thread-safe.
+	void set_range(uint32_t offset, uint32_t count)
+	{
+		assert(offset + count <= num_bits);
+		if (offset >= num_bits)
+			return;
+		if (count > num_bits - offset)
+			count = num_bits - offset;
+
+		while (count)
+		{
+			uint32_t bit = offset & 63;
+			uint32_t to_set = 64 - bit < count ? 64 - bit : count;
+			uint64_t mask = to_set == 64 ? ~uint64_t(0) : (((uint64_t(1) << to_set) - 1) << bit);
+			set_word_bits(offset >> 6, mask);
+			offset += to_set;
+			count -= to_set;
+		}
+	}
+
+	bool test(uint32_t index) const
+	{
+		assert(index < num_bits);
+		return (words[index >> 6].load(std::memory_order_relaxed) & (uint64_t(1) << (index & 63))) != 0;
+	}
+
+	// Not thread-safe against concurrent set().
+	void clear()
+	{
+		for (uint32_t s = 0; s < num_summary_words; s++)
+		{
+			uint64_t summary_bits = summary[s].load(std::memory_order_relaxed);
+			while (summary_bits)
+			{
+				uint32_t bit = trailing_zeroes64(summary_bits);
+				summary_bits &= summary_bits - 1;
+				words[s * 64 + bit].store(0, std::memory_order_relaxed);
+			}
+			summary[s].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	size_t count() const
+	{
+		size_t total = 0;
+		for_each_word([&](uint32_t, uint64_t bits) {
+			total += popcount64(bits);
+		});
+		return total;
+	}
+
+	// Calls func(word_index, bits) for every non-zero word in [first_word, end_word).
+	template <typename Func>
+	void for_each_word(uint32_t first_word, uint32_t end_word, const Func &func) const
+	{
+		if (end_word > num_words)
+			end_word = num_words;
+		if (first_word >= end_word)
+			return;
+
+		for (uint32_t s = first_word / 64, end_s = (end_word + 63) / 64; s < end_s; s++)
+		{
+			uint64_t summary_bits = summary[s].load(std::memory_order_relaxed);
+			while (summary_bits)
+			{
+				uint32_t word_index = s * 64 + trailing_zeroes64(summary_bits);
+				summary_bits &= summary_bits - 1;
+				if (word_index < first_word || word_index >= end_word)
+					continue;
+
+				uint64_t bits = words[word_index].load(std::memory_order_relaxed);
+				if (bits)
+					func(word_index, bits);
+			}
+		}
+	}
+
+	template <typename Func>
+	void for_each_word(const Func &func) const
+	{
+		for_each_word(0, num_words, func);
+	}
+
+	// Calls func(index) for every set bit in increasing order.
+	template <typename Func>
+	void for_each_bit(const Func &func) const
+	{
+		for_each_word([&](uint32_t word_index, uint64_t bits) {
+			for_each_bit64(bits, [&](uint32_t bit) {
+				func(word_index * 64 + bit);
+			});
+		});
+	}
+
+	// Calls func(offset, count) for every maximal run of set bits in increasing order.
+	// Runs are merged across word boundaries.
+	template <typename Func>
+	void for_each_run(const Func &func) const
+	{
+		uint32_t run_begin = 0;
+		uint32_t run_end = 0;
+
+		for_each_word([&](uint32_t word_index, uint64_t bits) {
+			uint32_t base = word_index * 64;
+			while (bits)
+			{
+				uint32_t first = trailing_zeroes64(bits);
+				uint64_t remaining = bits >> first;
+				// ctz of zero is undefined, which is what trailing_ones64 would hit on a full word.
+				uint32_t len = remaining == ~uint64_t(0) ? 64 - first : trailing_ones64(remaining);
+				uint32_t begin = base + first;
+
+				if (run_end != run_begin && run_end == begin)
+				{
+					run_end += len;
+				}
+				else
+				{
+					if (run_end != run_begin)
+						func(run_begin, run_end - run_begin);
+					run_begin = begin;
+					run_end = begin + len;
+				}
+
+				if (first + len >= 64)
+					bits = 0;
+				else
+					bits &= ~((uint64_t(1) << (first + len)) - 1);
+			}
+		});
+
+		if (run_end != run_begin)
+			func(run_begin, run_end - run_begin);
+	}
+
+private:
+	std::unique_ptr<std::atomic<uint64_t>[]> words;
+	std::unique_ptr<std::atomic<uint64_t>[]> summary;
+	uint32_t num_bits = 0;
+	uint32_t num_words = 0;
+	uint32_t num_summary_words = 0;
+
+	uint64_t set_word_bits(uint32_t word_index, uint64_t mask)
+	{
+		auto &word = words[word_index];
+
+		// Avoid the RMW if the bits are already set, which is the common case for repeated updates.
+		uint64_t old_bits = word.load(std::memory_order_relaxed);
+		if ((old_bits & mask) == mask)
+			return old_bits;
+
+		old_bits = word.fetch_or(mask, std::memory_order_relaxed);
+		if (old_bits == 0)
+			summary[word_index >> 6].fetch_or(uint64_t(1) << (word_index & 63), std::memory_order_relaxed);
+		return old_bits;
+	}
+};
+}
@@ -0,0 +1,274 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "object_pool.hpp"
+#include "intrusive_list.hpp"
+#include "intrusive_hash_map.hpp"
+#include "read_write_lock.hpp"
+#include <atomic>
+#include <stdint.h>
+
+namespace Util
+{
+// Sharded variant of LRUCache which can be used from multiple threads without external locking.
+// find_and_mark_as_recent(), find_or_allocate() and allocate() may be called concurrently.
+// allocate() publishes the entry before the caller fills it in, so for lookup-or-create from
+// multiple threads, use find_or_allocate(), which initializes the entry under the shard lock.
+// prune(), evict() and erase() are intended to be called at a frame boundary, and pointers returned
+// by find_and_mark_as_recent() and allocate() are valid until then.
+// Recency is approximated CLOCK style. A hit only sets a reference bit on the entry,
+// and prune() gives referenced entries a second chance instead of keeping an exact LRU order.
+template <typename T, unsigned NumShards = 16>
+class ConcurrentLRUCache
+{
+	static_assert((NumShards & (NumShards - 1)) == 0, "NumShards must be POT.");
+
+public:
+	void set_total_cost(uint64_t cost)
+	{
+		total_cost_limit = cost;
+	}
+
+	uint64_t get_current_cost() const
+	{
+		return total_cost.load(std::memory_order_relaxed);
+	}
+
+	T *find_and_mark_as_recent(uint64_t cookie)
+	{
+		Hash hash = get_hash(cookie);
+		auto &shard = get_shard(hash);
+		RWSpinLockReadHolder holder{shard.lock};
+
+		auto *entry = shard.hashmap.find(hash);
+		if (!entry)
+			return nullptr;
+
+		// Avoid dirtying the cache line for entries which are hit all the time.
+		auto &e = *entry->get();
+		if (!e.referenced.load(std::memory_order_relaxed))
+			e.referenced.store(true, std::memory_order_relaxed);
+		return &e.t;
+	}
+
+	T *allocate(uint64_t cookie, uint64_t cost)
+	{
+		Hash hash = get_hash(cookie);
+		auto &shard = get_shard(hash);
+		RWSpinLockWriteHolder holder{shard.lock};
+
+		auto *hash_entry = shard.hashmap.find(hash);
+		if (hash_entry)
+		{
+			auto &e = *hash_entry->get();
+			total_cost.fetch_add(cost - e.cost, std::memory_order_relaxed);
+			e.cost = cost;
+			e.referenced.store(true, std::memory_order_relaxed);
+			return &e.t;
+		}
+
+		return &insert(shard, hash, cost)->t;
+	}
+
+	// Returns the existing entry, or creates one and calls init(T &) on it before any other thread can see it.
+	template <typename Func>
+	T *find_or_allocate(uint64_t cookie, uint64_t cost, const Func &init)
+	{
+		if (auto *t = find_and_mark_as_recent(cookie))
+			return t;
+
+		Hash hash = get_hash(cookie);
+		auto &shard = get_shard(hash);
+		RWSpinLockWriteHolder holder{shard.lock};
+
+		// Someone else might have created it while we were not holding the lock.
+		auto *hash_entry = shard.hashmap.find(hash);
+		if (hash_entry)
+		{
+			auto &e = *hash_entry->get();
+			e.referenced.store(true, std::memory_order_relaxed);
+			return &e.t;
+		}
+
+		auto *entry = insert(shard, hash, cost);
+		init(entry->t);
+		return &entry->t;
+	}
+
+	// Evicts entries until the total cost is within the limit.
+	// Shards are swept round-robin, so pressure is spread evenly over all of them.
+	uint64_t prune()
+	{
+		uint64_t total_pruned = 0;
+		while (total_cost.load(std::memory_order_relaxed) > total_cost_limit)
+		{
+			bool any_entries = false;
+			for (unsigned i = 0; i < NumShards && total_cost.load(std::memory_order_relaxed) > total_cost_limit; i++)
+			{
+				auto &shard = shards[prune_shard];
+				prune_shard = (prune_shard + 1) & (NumShards - 1);
+
+				RWSpinLockWriteHolder holder{shard.lock};
+				if (shard.ring.empty())
+					continue;
+				any_entries = true;
+
+				auto itr = shard.ring.rbegin();
+				if (itr->referenced.load(std::memory_order_relaxed))
+				{
+					// Second chance.
+					itr->referenced.store(false, std::memory_order_relaxed);
+					shard.ring.move_to_front(shard.ring, itr);
+				}
+				else
+				{
+					total_cost.fetch_sub(itr->cost, std::memory_order_relaxed);
+					total_pruned += itr->cost;
+					shard.ring.erase(itr);
+					shard.hashmap.erase(itr->hash);
+					shard.pool.free(itr.get());
+				}
+			}
+
+			if (!any_entries)
+				break;
+		}
+		return total_pruned;
+	}
+
+	// Makes the entry the next candidate for pruning.
+	bool evict(uint64_t cookie)
+	{
+		Hash hash = get_hash(cookie);
+		auto &shard = get_shard(hash);
+		RWSpinLockWriteHolder holder{shard.lock};
+
+		auto *entry = shard.hashmap.find(hash);
+		if (entry)
+		{
+			entry->get()->referenced.store(false, std::memory_order_relaxed);
+			shard.ring.move_to_back(shard.ring, entry->get());
+			return true;
+		}
+		else
+			return false;
+	}
+
+	bool erase(uint64_t cookie)
+	{
+		Hash hash = get_hash(cookie);
+		auto &shard = get_shard(hash);
+		RWSpinLockWriteHolder holder{shard.lock};
+
+		auto *entry = shard.hashmap.find(hash);
+		if (entry)
+		{
+			auto itr = entry->get();
+			total_cost.fetch_sub(itr->cost, std::memory_order_relaxed);
+			shard.hashmap.erase(entry);
+			shard.ring.erase(itr);
+			shard.pool.free(itr.get());
+			return true;
+		}
+		else
+			return false;
+	}
+
+	// Not thread safe, visits every entry in unspecified order.
+	template <typename Func>
+	void for_each(Func &&func)
+	{
+		for (auto &shard : shards)
+			for (auto &entry : shard.ring)
+				func(entry.t);
+	}
+
+	~ConcurrentLRUCache()
+	{
+		for (auto &shard : shards)
+		{
+			while (!shard.ring.empty())
+			{
+				auto itr = shard.ring.begin();
+				shard.ring.erase(itr);
+				shard.pool.free(itr.get());
+			}
+		}
+	}
+
+private:
+	struct CacheEntry : IntrusiveListEnabled<CacheEntry>
+	{
+		uint64_t cost;
+		Hash hash;
+		std::atomic<bool> referenced;
+		T t;
+	};
+
+	using HashEntry = IntrusivePODWrapper<typename IntrusiveList<CacheEntry>::Iterator>;
+
+	// Keep the locks of adjacent shards on separate cache lines.
+	struct alignas(64) Shard
+	{
+		RWSpinLock lock;
+		ObjectPool<CacheEntry> pool;
+		IntrusiveList<CacheEntry> ring;
+		IntrusiveHashMap<HashEntry> hashmap;
+	};
+
+	Shard shards[NumShards];
+	std::atomic<uint64_t> total_cost{0};
+	uint64_t total_cost_limit = 0;
+	unsigned prune_shard = 0;
+
+	CacheEntry *insert(Shard &shard, Hash hash, uint64_t cost)
+	{
+		total_cost.fetch_add(cost, std::memory_order_relaxed);
+
+		auto *entry = shard.pool.allocate();
+		entry->cost = cost;
+		entry->hash = hash;
+		entry->referenced.store(false, std::memory_order_relaxed);
+
+		// The clock hand sweeps from the back, so new entries are visited last.
+		shard.ring.insert_front(entry);
+		shard.hashmap.emplace_replace(hash, shard.ring.begin());
+		return entry;
+	}
+
+	Shard &get_shard(Hash hash)
+	{
+		// The hash map indexes with the low bits, so pick shards with the high bits.
+		return shards[(hash >> 32) & (NumShards - 1)];
+	}
+
+	static Hash get_hash(uint64_t cookie)
+	{
+		Hasher h;
+		h.u64(cookie);
+		return h.get();
+	}
+};
+}
@@ -0,0 +1,160 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "defragmentation_planner.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace Util
+{
+void DefragmentationPlanner::set_options(const DefragmentationOptions &options_)
+{
+	options = options_;
+}
+
+const DefragmentationOptions &DefragmentationPlanner::get_options() const
+{
+	return options;
+}
+
+bool DefragmentationPlanner::is_sparse(const DefragmentationHeapInfo &heap) const
+{
+	return double(heap.live_size) <= double(heap.size) * double(options.max_occupancy);
+}
+
+FragmentationStats DefragmentationPlanner::compute_stats(const DefragmentationHeapInfo *heaps, size_t count) const
+{
+	FragmentationStats stats;
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &heap = heaps[i];
+		stats.heap_count++;
+		stats.heap_size += heap.size;
+		stats.live_size += heap.live_size;
+		if (is_sparse(heap))
+		{
+			stats.sparse_heap_count++;
+			stats.sparse_heap_size += heap.size;
+			stats.sparse_live_size += heap.live_size;
+		}
+	}
+	return stats;
+}
+
+void DefragmentationPlanner::select_heaps(const DefragmentationHeapInfo *heaps, size_t count,
+                                          std::vector<uint64_t> &selected) const
+{
+	selected.clear();
+
+	std::vector<const DefragmentationHeapInfo *> candidates;
+	uint64_t slack = 0;
+	uint64_t max_heap_size = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &heap = heaps[i];
+		slack += heap.size - std::min(heap.live_size, heap.size);
+		max_heap_size = std::max(max_heap_size, heap.size);
+		if (is_sparse(heap) && heap.movable_size >= heap.live_size)
+			candidates.push_back(&heap);
+	}
+
+	if (!max_heap_size)
+		return;
+
+	// The emptiest heaps are the cheapest to evacuate.
+	std::sort(candidates.begin(), candidates.end(),
+	          [](const DefragmentationHeapInfo *a, const DefragmentationHeapInfo *b) {
+		          if (a->live_size != b->live_size)
+			          return a->live_size < b->live_size;
+		          return a->heap_id < b->heap_id;
+	          });
+
+	uint64_t moved = 0;
+	for (auto *candidate : candidates)
+	{
+		if (selected.size() >= options.max_heaps_per_pass)
+			break;
+
+		// The evacuated heap no longer contributes slack.
+		uint64_t candidate_slack = candidate->size - std::min(candidate->live_size, candidate->size);
+		uint64_t new_slack = slack - candidate_slack;
+		uint64_t new_moved = moved + candidate->live_size;
+
+		// Whatever does not fit in the slack of the remaining heaps ends up in fresh heaps.
+		// Only proceed if that still releases at least one heap.
+		uint64_t overflow = new_moved > new_slack ? new_moved - new_slack : 0;
+		uint64_t new_heaps = (overflow + max_heap_size - 1) / max_heap_size;
+		if (new_heaps >= selected.size() + 1)
+			break;
+
+		selected.push_back(candidate->heap_id);
+		slack = new_slack;
+		moved = new_moved;
+	}
+}
+
+uint32_t DefragmentationPlanner::plan_moves(const DefragmentationAllocationInfo *allocations, size_t count,
+                                            const std::vector<uint64_t> &selected,
+                                            std::vector<DefragmentationMove> &moves) const
+{
+	moves.clear();
+
+	std::unordered_map<uint64_t, uint32_t> heap_order;
+	for (uint32_t i = 0; i < uint32_t(selected.size()); i++)
+		heap_order[selected[i]] = i;
+
+	std::vector<const DefragmentationAllocationInfo *> candidates;
+	for (size_t i = 0; i < count; i++)
+		if (heap_order.count(allocations[i].heap_id))
+			candidates.push_back(&allocations[i]);
+
+	std::sort(candidates.begin(), candidates.end(),
+	          [&](const DefragmentationAllocationInfo *a, const DefragmentationAllocationInfo *b) {
+		          uint32_t a_order = heap_order[a->heap_id];
+		          uint32_t b_order = heap_order[b->heap_id];
+		          if (a_order != b_order)
+			          return a_order < b_order;
+		          if (a->size != b->size)
+			          return a->size > b->size;
+		          return a->object_id < b->object_id;
+	          });
+
+	uint32_t step = 0;
+	uint64_t step_bytes = 0;
+	moves.reserve(candidates.size());
+
+	for (auto *alloc : candidates)
+	{
+		if (step_bytes && step_bytes + alloc->size > options.max_bytes_per_step)
+		{
+			step++;
+			step_bytes = 0;
+		}
+
+		moves.push_back({ alloc->object_id, alloc->heap_id, alloc->size, step });
+		step_bytes += alloc->size;
+	}
+
+	return moves.empty() ? 0 : step + 1;
+}
+}
@@ -0,0 +1,110 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace Util
+{
+// Backend agnostic planning for heap compaction.
+// Heaps and allocations are described by opaque 64-bit identifiers,
+// so the same logic drives the Vulkan DeviceAllocator and CPU-side mocks.
+struct DefragmentationHeapInfo
+{
+	uint64_t heap_id;
+	uint64_t size;
+	uint64_t live_size;
+	// Live bytes which can be relocated. Heaps with pinned allocations are never evacuated.
+	uint64_t movable_size;
+};
+
+struct DefragmentationAllocationInfo
+{
+	uint64_t object_id;
+	uint64_t heap_id;
+	uint64_t size;
+};
+
+struct DefragmentationMove
+{
+	uint64_t object_id;
+	uint64_t heap_id;
+	uint64_t size;
+	uint32_t step;
+};
+
+struct DefragmentationOptions
+{
+	// Heaps with a live fraction at or below this are considered sparse.
+	float max_occupancy = 0.5f;
+	// Upper bound on bytes copied per step. An allocation larger than this gets a step of its own.
+	uint64_t max_bytes_per_step = 32 * 1024 * 1024;
+	// Upper bound on heaps evacuated in one pass.
+	uint32_t max_heaps_per_pass = 4;
+};
+
+struct FragmentationStats
+{
+	uint64_t heap_count = 0;
+	uint64_t heap_size = 0;
+	uint64_t live_size = 0;
+	uint64_t sparse_heap_count = 0;
+	uint64_t sparse_heap_size = 0;
+	uint64_t sparse_live_size = 0;
+
+	// Fraction of heap memory which does not hold live allocations.
+	float get_fragmentation() const
+	{
+		return heap_size ? 1.0f - float(double(live_size) / double(heap_size)) : 0.0f;
+	}
+};
+
+class DefragmentationPlanner
+{
+public:
+	void set_options(const DefragmentationOptions &options);
+	const DefragmentationOptions &get_options() const;
+
+	FragmentationStats compute_stats(const DefragmentationHeapInfo *heaps, size_t count) const;
+
+	// Picks sparse heaps to evacuate, emptiest first.
+	// A heap is only picked if evacuating it is expected to release memory,
+	// i.e. its live allocations fit into the slack of the heaps we keep.
+	void select_heaps(const DefragmentationHeapInfo *heaps, size_t count,
+	                  std::vector<uint64_t> &selected) const;
+
+	// Collects allocations which live in selected heaps and splits them into steps
+	// bounded by max_bytes_per_step. Heaps are drained in selection order
+	// so that the first heaps can be released as early as possible.
+	// Returns the number of steps.
+	uint32_t plan_moves(const DefragmentationAllocationInfo *allocations, size_t count,
+	                    const std::vector<uint64_t> &selected,
+	                    std::vector<DefragmentationMove> &moves) const;
+
+private:
+	DefragmentationOptions options;
+	bool is_sparse(const DefragmentationHeapInfo &heap) const;
+};
+}
@@ -24,17 +24,122 @@
 #include "timeline_trace_file.hpp"
 #include "thread_name.hpp"
 #include "timer.hpp"
+#include "hash.hpp"
+#include <unordered_map>
+#include <chrono>
 #include <string.h>
 #include <stdio.h>
 
 namespace Util
 {
-static thread_local char trace_tid[32];
+using namespace TimelineTrace;
+
+struct TimelineTraceFile::ThreadBuffer
+{
+	enum { Capacity = 16 * 1024, Mask = Capacity - 1 };
+
+	// Single producer (owning thread), single consumer (IO thread).
+	// Keep the indices on separate cache lines to avoid false sharing.
+	std::atomic<uint32_t> write_index;
+	char padding0[64 - sizeof(std::atomic<uint32_t>)];
+	std::atomic<uint32_t> read_index;
+	char padding1[64 - sizeof(std::atomic<uint32_t>)];
+	std::atomic<uint64_t> dropped;
+	Record records[Capacity];
+};
+
+namespace
+{
+struct StringTable
+{
+	std::mutex lock;
+	std::unordered_map<Hash, uint32_t> ids;
+	std::vector<std::string> strings;
+};
+
+struct StringCacheEntry
+{
+	Hash hash;
+	uint32_t id;
+};
+
+struct ThreadBufferCache
+{
+	uint64_t serial;
+	TimelineTraceFile::ThreadBuffer *buffer;
+};
+}
+
+static thread_local uint32_t trace_tid;
+static thread_local char trace_tid_name[32];
 static thread_local TimelineTraceFile *trace_file;
+static thread_local ThreadBufferCache thread_buffer_cache;
+static thread_local StringCacheEntry string_cache[256];
+static std::atomic<uint64_t> file_serial_counter;
+static std::atomic<uint32_t> anonymous_thread_counter;
+
+static StringTable &get_string_table()
+{
+	// Intentionally leaked. Threads may still emit events during static teardown.
+	static StringTable *table = []() {
+		auto *t = new StringTable;
+		t->strings.emplace_back();
+		t->ids[Hasher().get()] = 0;
+		return t;
+	}();
+	return *table;
+}
+
+uint32_t TimelineTraceFile::intern_string(const char *str)
+{
+	if (!str || *str == '\0')
+		return 0;
+
+	Hasher h;
+	h.string(str);
+	Hash hash = h.get();
+
+	auto &entry = string_cache[hash & 0xff];
+	if (entry.hash == hash && entry.id != 0)
+		return entry.id;
+
+	auto &table = get_string_table();
+	uint32_t id;
+	{
+		std::lock_guard<std::mutex> holder{table.lock};
+		auto itr = table.ids.find(hash);
+		if (itr != table.ids.end())
+		{
+			id = itr->second;
+		}
+		else
+		{
+			id = uint32_t(table.strings.size());
+			table.strings.emplace_back(str);
+			table.ids[hash] = id;
+		}
+	}
+
+	entry.hash = hash;
+	entry.id = id;
+	return id;
+}
+
+static uint32_t get_current_tid()
+{
+	if (trace_tid == 0)
+	{
+		snprintf(trace_tid_name, sizeof(trace_tid_name), "thread-%u",
+		         anonymous_thread_counter.fetch_add(1, std::memory_order_relaxed));
+		trace_tid = TimelineTraceFile::intern_string(trace_tid_name);
+	}
+	return trace_tid;
+}
 
 void TimelineTraceFile::set_tid(const char *tid)
 {
-	snprintf(trace_tid, sizeof(trace_tid), "%s", tid);
+	snprintf(trace_tid_name, sizeof(trace_tid_name), "%s", tid);
+	trace_tid = intern_string(trace_tid_name);
 }
 
 void TimelineTraceFile::set_per_thread(TimelineTraceFile *file)
@@ -57,11 +162,101 @@ void TimelineTraceFile::Event::set_tid(const char *tid_)
 	snprintf(tid, sizeof(tid), "%s", tid_);
 }
 
+TimelineTraceFile::ThreadBuffer *TimelineTraceFile::get_thread_buffer()
+{
+	if (thread_buffer_cache.serial == serial)
+		return thread_buffer_cache.buffer;
+
+	// Slow path, first event on this thread for this file.
+	auto *buffer = new ThreadBuffer;
+	buffer->write_index.store(0, std::memory_order_relaxed);
+	buffer->read_index.store(0, std::memory_order_relaxed);
+	buffer->dropped.store(0, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		thread_buffers.emplace_back(buffer);
+	}
+
+	thread_buffer_cache.serial = serial;
+	thread_buffer_cache.buffer = buffer;
+	return buffer;
+}
+
+void TimelineTraceFile::push_record(const Record &record)
+{
+	auto *buffer = get_thread_buffer();
+	uint32_t write_index = buffer->write_index.load(std::memory_order_relaxed);
+	uint32_t read_index = buffer->read_index.load(std::memory_order_acquire);
+	uint32_t used = write_index - read_index;
+
+	if (used >= ThreadBuffer::Capacity)
+	{
+		buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer->records[write_index & ThreadBuffer::Mask] = record;
+	buffer->write_index.store(write_index + 1, std::memory_order_release);
+
+	// Kick the IO thread early if we're filling up. Lost wakeups are fine since the IO thread polls.
+	if (used + 1 == ThreadBuffer::Capacity / 2)
+	{
+		flush_requested.store(true, std::memory_order_relaxed);
+		cond.notify_one();
+	}
+}
+
+static Record make_record(RecordType type, uint32_t name, uint32_t tid, uint32_t pid,
+                          uint64_t timestamp_ns, uint64_t payload)
+{
+	Record record = {};
+	record.type = type;
+	record.name = name;
+	record.tid = tid;
+	record.pid = pid;
+	record.timestamp_ns = timestamp_ns;
+	record.payload = payload;
+	return record;
+}
+
+void TimelineTraceFile::emit_slice(const char *name, uint64_t start_ns, uint64_t end_ns, uint32_t pid)
+{
+	push_record(make_record(RecordType::Slice, intern_string(name), get_current_tid(), pid, start_ns, end_ns));
+}
+
+void TimelineTraceFile::emit_instant(const char *name, uint32_t pid)
+{
+	push_record(make_record(RecordType::Instant, intern_string(name), get_current_tid(), pid,
+	                        get_current_time_nsecs(), 0));
+}
+
+void TimelineTraceFile::emit_counter(const char *name, double value, uint32_t pid)
+{
+	uint64_t payload;
+	memcpy(&payload, &value, sizeof(payload));
+	push_record(make_record(RecordType::Counter, intern_string(name), get_current_tid(), pid,
+	                        get_current_time_nsecs(), payload));
+}
+
+void TimelineTraceFile::emit_flow_begin(const char *name, uint64_t flow_id, uint32_t pid)
+{
+	push_record(make_record(RecordType::FlowBegin, intern_string(name), get_current_tid(), pid,
+	                        get_current_time_nsecs(), flow_id));
+}
+
+void TimelineTraceFile::emit_flow_end(const char *name, uint64_t flow_id, uint32_t pid)
+{
+	push_record(make_record(RecordType::FlowEnd, intern_string(name), get_current_tid(), pid,
+	                        get_current_time_nsecs(), flow_id));
+}
+
 TimelineTraceFile::Event *TimelineTraceFile::begin_event(const char *desc, uint32_t pid)
 {
 	auto *e = event_pool.allocate();
 	e->pid = pid;
-	e->set_tid(trace_tid);
+	get_current_tid();
+	e->set_tid(trace_tid_name);
 	e->set_desc(desc);
 	e->start_ns = get_current_time_nsecs();
 	return e;
@@ -80,9 +275,12 @@ TimelineTraceFile::Event *TimelineTraceFile::allocate_event()
 
 void TimelineTraceFile::submit_event(Event *e)
 {
-	std::lock_guard<std::mutex> holder{lock};
-	queued_events.push(e);
-	cond.notify_one();
+	if (e->start_ns <= e->end_ns)
+	{
+		uint32_t tid = e->tid[0] != '\0' ? intern_string(e->tid) : get_current_tid();
+		push_record(make_record(RecordType::Slice, intern_string(e->desc), tid, e->pid, e->start_ns, e->end_ns));
+	}
+	event_pool.free(e);
 }
 
 void TimelineTraceFile::end_event(Event *e)
@@ -93,74 +291,155 @@ void TimelineTraceFile::end_event(Event *e)
 
 TimelineTraceFile::TimelineTraceFile(const std::string &path)
 {
+	serial = file_serial_counter.fetch_add(1, std::memory_order_relaxed) + 1;
 	thr = std::thread(&TimelineTraceFile::looper, this, path);
 }
 
 void TimelineTraceFile::looper(std::string path)
 {
-	set_current_thread_name("json-trace-io");
+	set_current_thread_name("timeline-trace-io");
 
-	FILE *file = fopen(path.c_str(), "w");
+	FILE *file = fopen(path.c_str(), "wb");
 	if (!file)
 		LOGE("Failed to open file: %s.\n", path.c_str());
 
 	if (file)
-		fputs("[\n", file);
+	{
+		FileHeader header = {};
+		memcpy(header.magic, Magic, sizeof(Magic));
+		header.version = Version;
+		header.record_size = sizeof(Record);
+		fwrite(&header, sizeof(header), 1, file);
+	}
 
-	uint64_t base_ts = get_current_time_nsecs();
+	auto &table = get_string_table();
+	size_t strings_written = 0;
+	std::vector<Record> records;
+	std::vector<char> string_data;
+	bool done = false;
 
-	for (;;)
-	{
-		Event *e;
+	// Must be called with the lock held.
+	// Registration of new thread buffers is rare, so it's fine to drain with the lock held.
+	const auto drain_records = [&]() {
+		records.clear();
+		for (auto &buffer : thread_buffers)
 		{
-			std::unique_lock<std::mutex> holder{lock};
-			cond.wait(holder, [this]() {
-				return !queued_events.empty();
-			});
-			e = queued_events.front();
-			queued_events.pop();
+			uint32_t read_index = buffer->read_index.load(std::memory_order_relaxed);
+			uint32_t write_index = buffer->write_index.load(std::memory_order_acquire);
+			for (uint32_t i = read_index; i != write_index; i++)
+				records.push_back(buffer->records[i & ThreadBuffer::Mask]);
+			buffer->read_index.store(write_index, std::memory_order_release);
+		}
+	};
+
+	const auto write_blocks = [&]() {
+		// Any string referenced by the records we just drained was interned before the record was pushed,
+		// so it is guaranteed to be visible here.
+		string_data.clear();
+		{
+			std::lock_guard<std::mutex> holder{table.lock};
+			for (; strings_written < table.strings.size(); strings_written++)
+			{
+				auto &str = table.strings[strings_written];
+				uint32_t words[2] = { uint32_t(strings_written), uint32_t(str.size()) };
+				string_data.insert(string_data.end(),
+				                   reinterpret_cast<const char *>(words),
+				                   reinterpret_cast<const char *>(words) + sizeof(words));
+				string_data.insert(string_data.end(), str.begin(), str.end());
+			}
 		}
 
-		if (!e)
-			break;
+		if (!file)
+			return;
 
-		auto start_us = int64_t(e->start_ns - base_ts) * 1e-3;
-		auto end_us = int64_t(e->end_ns - base_ts) * 1e-3;
+		if (!string_data.empty())
+		{
+			BlockHeader block = { BlockType::Strings, uint32_t(string_data.size()) };
+			fwrite(&block, sizeof(block), 1, file);
+			fwrite(string_data.data(), 1, string_data.size(), file);
+		}
 
-		if (file && start_us <= end_us)
+		if (!records.empty())
 		{
-			fprintf(file, "{ \"name\": \"%s\", \"ph\": \"B\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %f },\n",
-			        e->desc, e->tid, e->pid, start_us);
-			fprintf(file, "{ \"name\": \"%s\", \"ph\": \"E\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %f },\n",
-			        e->desc, e->tid, e->pid, end_us);
+			BlockHeader block = { BlockType::Records, uint32_t(records.size()) };
+			fwrite(&block, sizeof(block), 1, file);
+			fwrite(records.data(), sizeof(Record), records.size(), file);
 		}
+	};
 
-		event_pool.free(e);
+	while (!done)
+	{
+		{
+			std::unique_lock<std::mutex> holder{lock};
+			cond.wait_for(holder, std::chrono::milliseconds(10), [this]() {
+				return dead || flush_requested.load(std::memory_order_relaxed);
+			});
+			flush_requested.store(false, std::memory_order_relaxed);
+			done = dead;
+			drain_records();
+		}
+
+		write_blocks();
+	}
+
+	// Other threads may have pushed events while the last blocks were written, e.g. scoped events
+	// ending during teardown, so drain one final time.
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		drain_records();
 	}
+	write_blocks();
 
-	// Intentionally truncate the JSON so that we can emit "," after the last element.
 	if (file)
 		fclose(file);
 }
 
 TimelineTraceFile::~TimelineTraceFile()
 {
-	submit_event(nullptr);
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		dead = true;
+		cond.notify_one();
+	}
+
 	if (thr.joinable())
 		thr.join();
+
+	uint64_t dropped = 0;
+	uint64_t unwritten = 0;
+	for (auto &buffer : thread_buffers)
+	{
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+		unwritten += buffer->write_index.load(std::memory_order_acquire) -
+		             buffer->read_index.load(std::memory_order_relaxed);
+	}
+
+	if (dropped)
+		LOGW("Timeline trace dropped %llu events. IO thread could not keep up.\n",
+		     static_cast<unsigned long long>(dropped));
+	if (unwritten)
+		LOGW("Timeline trace dropped %llu events which were emitted after the trace was closed.\n",
+		     static_cast<unsigned long long>(unwritten));
 }
 
-TimelineTraceFile::ScopedEvent::ScopedEvent(TimelineTraceFile *file_, const char *tag, uint32_t pid)
+TimelineTraceFile::ScopedEvent::ScopedEvent(TimelineTraceFile *file_, const char *tag, uint32_t pid_)
 	: file(file_)
 {
 	if (file && tag && *tag != '\0')
-		event = file->begin_event(tag, pid);
+	{
+		name = intern_string(tag);
+		pid = pid_;
+		start_ns = get_current_time_nsecs();
+	}
 }
 
 TimelineTraceFile::ScopedEvent::~ScopedEvent()
 {
-	if (event)
-		file->end_event(event);
+	if (file && name)
+	{
+		file->push_record(make_record(RecordType::Slice, name, get_current_tid(), pid,
+		                              start_ns, get_current_time_nsecs()));
+	}
 }
 
 TimelineTraceFile::ScopedEvent &
@@ -168,12 +447,18 @@ TimelineTraceFile::ScopedEvent::operator=(TimelineTraceFile::ScopedEvent &&other
 {
 	if (this != &other)
 	{
-		if (event)
-			file->end_event(event);
-		event = other.event;
+		if (file && name)
+		{
+			file->push_record(make_record(RecordType::Slice, name, get_current_tid(), pid,
+			                              start_ns, get_current_time_nsecs()));
+		}
+
 		file = other.file;
-		other.event = nullptr;
+		name = other.name;
+		pid = other.pid;
+		start_ns = other.start_ns;
 		other.file = nullptr;
+		other.name = 0;
 	}
 	return *this;
 }
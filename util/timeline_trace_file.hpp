@@ -27,11 +27,68 @@
 #include <condition_variable>
 #include <mutex>
 #include <memory>
-#include <queue>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
 #include "object_pool.hpp"
 
 namespace Util
 {
+// Binary timeline trace format.
+// The file begins with a FileHeader, followed by a sequence of blocks.
+// Each block starts with a BlockHeader.
+// String blocks define interned strings as { u32 id, u32 length, char data[length] } tuples.
+// Record blocks contain BlockHeader::count tightly packed Records.
+// A string is always defined in the file before any record referring to it.
+// Use the timeline-trace-convert tool to turn the binary file into Chrome JSON or Perfetto protobuf.
+namespace TimelineTrace
+{
+static constexpr char Magic[8] = { 'G', 'R', 'T', 'R', 'A', 'C', 'E', '\0' };
+static constexpr uint32_t Version = 1;
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+};
+
+enum class BlockType : uint32_t
+{
+	Strings = 0,
+	Records = 1
+};
+
+struct BlockHeader
+{
+	BlockType type;
+	// For string blocks, size of payload in bytes. For record blocks, number of records.
+	uint32_t count;
+};
+
+enum class RecordType : uint8_t
+{
+	Slice = 0,
+	Instant = 1,
+	Counter = 2,
+	FlowBegin = 3,
+	FlowEnd = 4
+};
+
+struct Record
+{
+	RecordType type;
+	uint8_t reserved[3];
+	uint32_t name; // Interned string ID.
+	uint32_t tid; // Interned string ID.
+	uint32_t pid;
+	uint64_t timestamp_ns;
+	// Slice: end timestamp. Counter: bit-cast double value. Flows: flow ID.
+	uint64_t payload;
+};
+static_assert(sizeof(Record) == 32, "Unexpected size of Record.");
+}
+
 class TimelineTraceFile
 {
 public:
@@ -42,6 +99,20 @@ public:
 	static TimelineTraceFile *get_per_thread();
 	static void set_per_thread(TimelineTraceFile *file);
 
+	// Interned strings are global to the process and are never freed.
+	// 0 is always the empty string.
+	static uint32_t intern_string(const char *str);
+
+	// Compact events. These go to a per-thread lock-free ring buffer and never block.
+	// If the IO thread cannot keep up, events are dropped, and the drop count is reported on shutdown.
+	void emit_slice(const char *name, uint64_t start_ns, uint64_t end_ns, uint32_t pid = 0);
+	void emit_instant(const char *name, uint32_t pid = 0);
+	void emit_counter(const char *name, double value, uint32_t pid = 0);
+	void emit_flow_begin(const char *name, uint64_t flow_id, uint32_t pid = 0);
+	void emit_flow_end(const char *name, uint64_t flow_id, uint32_t pid = 0);
+
+	// Legacy event interface. Useful when the event belongs to a different timeline than the calling thread,
+	// e.g. GPU timestamps. Strings are interned on submission.
 	struct Event
 	{
 		char desc[256];
@@ -68,17 +139,28 @@ public:
 		ScopedEvent(ScopedEvent &&other) noexcept;
 		ScopedEvent &operator=(ScopedEvent &&other) noexcept;
 		TimelineTraceFile *file = nullptr;
-		Event *event = nullptr;
+		uint32_t name = 0;
+		uint32_t pid = 0;
+		uint64_t start_ns = 0;
 	};
 
+	struct ThreadBuffer;
+
 private:
 	void looper(std::string path);
+	void push_record(const TimelineTrace::Record &record);
+	ThreadBuffer *get_thread_buffer();
+
 	std::thread thr;
 	std::mutex lock;
 	std::condition_variable cond;
+	bool dead = false;
+	std::atomic<bool> flush_requested{false};
+
+	std::vector<std::unique_ptr<ThreadBuffer>> thread_buffers;
+	uint64_t serial;
 
 	ThreadSafeObjectPool<Event> event_pool;
-	std::queue<Event *> queued_events;
 };
 
 #ifndef GRANITE_SHIPPING
@@ -79,6 +79,7 @@ CommandBuffer::CommandBuffer(Device *device_, VkCommandBuffer cmd_, VkPipelineCa
 			(features.vk13_props.maxSubgroupSize << 8);
 
 	device->lock.read_only_cache.lock_read();
+	desc_set_cache_enable = device->descriptor_set_caching.load(std::memory_order_relaxed);
 
 	if (type == Type::Generic || type == Type::AsyncCompute)
 	{
@@ -1632,6 +1633,9 @@ bool CommandBuffer::flush_compute_pipeline(bool synchronous)
 	current_pipeline = pipeline_state.program->get_pipeline(pipeline_state.hash);
 	if (current_pipeline.pipeline == VK_NULL_HANDLE)
 	{
+#ifdef GRANITE_VULKAN_FOSSILIZE
+		device->notify_pipeline_warmup_miss(pipeline_state.hash, synchronous);
+#endif
 		current_pipeline = build_compute_pipeline(
 			device, pipeline_state,
 			synchronous ? CompileMode::Sync : CompileMode::FailOnCompileRequired);
@@ -1762,7 +1766,12 @@ bool CommandBuffer::flush_graphics_pipeline(bool synchronous)
 	update_hash_graphics_pipeline(pipeline_state, &active_vbos);
 	current_pipeline = pipeline_state.program->get_pipeline(pipeline_state.hash);
 	if (current_pipeline.pipeline == VK_NULL_HANDLE)
+	{
+#ifdef GRANITE_VULKAN_FOSSILIZE
+		device->notify_pipeline_warmup_miss(pipeline_state.hash, synchronous);
+#endif
 		current_pipeline = build_graphics_pipeline(device, pipeline_state, mode);
+	}
 	return current_pipeline.pipeline != VK_NULL_HANDLE;
 }
 
@@ -3498,15 +3507,74 @@ void CommandBuffer::flush_descriptor_set(uint32_t set, VkDescriptorSet *sets,
 	validate_descriptor_binds(set);
 #endif
 
-	auto vk_set = pipeline_state.layout->get_allocator(set)->request_descriptor_set(thread_index, device->frame_context_index);
+	auto *allocator = pipeline_state.layout->get_allocator(set);
+	VkDescriptorSet vk_set;
+	bool written = false;
+
+	if (desc_set_cache_enable)
+	{
+		auto cached = allocator->request_cached_descriptor_set(thread_index, hash_descriptor_set(set));
+		vk_set = cached.first;
+		written = cached.second;
+	}
+	else
+		vk_set = allocator->request_descriptor_set(thread_index, device->frame_context_index);
+
+	if (!written)
+	{
+		VkDescriptorUpdateTemplate update_template = pipeline_state.layout->get_update_template(set);
+		VK_ASSERT(update_template);
+		table.vkUpdateDescriptorSetWithTemplate(device->get_device(), vk_set, update_template, bindings.bindings[set]);
+	}
 
-	VkDescriptorUpdateTemplate update_template = pipeline_state.layout->get_update_template(set);
-	VK_ASSERT(update_template);
-	table.vkUpdateDescriptorSetWithTemplate(device->get_device(), vk_set, update_template, bindings.bindings[set]);
 	sets[set_count++] = vk_set;
 	allocated_sets[set] = vk_set;
 }
 
+Util::Hash CommandBuffer::hash_descriptor_set(uint32_t set) const
+{
+	// Cookies are never reused, so a destroyed resource can never produce a false hit.
+	// Stale sets referring to it simply age out of the cache.
+	auto &set_layout = pipeline_state.layout->get_resource_layout().sets[set];
+	auto &b = bindings.bindings[set];
+	Hasher h;
+
+	for_each_bit(set_layout.uniform_buffer_mask | set_layout.storage_buffer_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.meta[binding].array_size;
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			h.u64(bindings.cookies[set][binding + i]);
+			h.u64(b[binding + i].buffer.offset);
+			h.u64(b[binding + i].buffer.range);
+		}
+	});
+
+	for_each_bit(set_layout.rtas_mask | set_layout.sampled_texel_buffer_mask | set_layout.storage_texel_buffer_mask,
+	             [&](uint32_t binding) {
+		unsigned array_size = set_layout.meta[binding].array_size;
+		for (unsigned i = 0; i < array_size; i++)
+			h.u64(bindings.cookies[set][binding + i]);
+	});
+
+	for_each_bit(set_layout.sampled_image_mask | set_layout.separate_image_mask |
+	             set_layout.storage_image_mask | set_layout.input_attachment_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.meta[binding].array_size;
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			h.u64(bindings.cookies[set][binding + i]);
+			h.u32(b[binding + i].image.fp.imageLayout);
+		}
+	});
+
+	for_each_bit(set_layout.sampled_image_mask | set_layout.sampler_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.meta[binding].array_size;
+		for (unsigned i = 0; i < array_size; i++)
+			h.u64(bindings.secondary_cookies[set][binding + i]);
+	});
+
+	return h.get();
+}
+
 void CommandBuffer::rebind_descriptor_heap_set(uint32_t set)
 {
 	VkPushDataInfoEXT info = { VK_STRUCTURE_TYPE_PUSH_DATA_INFO_EXT };
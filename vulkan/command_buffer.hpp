@@ -935,6 +935,7 @@ private:
 	void flush_descriptor_set(
 		uint32_t set, VkDescriptorSet *sets,
 		uint32_t &first_set, uint32_t &set_count);
+	Util::Hash hash_descriptor_set(uint32_t set) const;
 	void push_descriptor_set(uint32_t set);
 	void rebind_descriptor_set(
 		uint32_t set, VkDescriptorSet *sets,
@@ -969,6 +970,7 @@ private:
 	VkDeviceAddress desc_heap_cached_table[VULKAN_NUM_DESCRIPTOR_SETS];
 	bool desc_buffer_enable = false;
 	bool desc_heap_enable = false;
+	bool desc_set_cache_enable = false;
 
 	void set_texture(unsigned set, unsigned binding,
 	                 VkImageView float_view, VkImageView integer_view, VkImageLayout layout,
@@ -42,6 +42,7 @@ DescriptorSetAllocator::DescriptorSetAllocator(Hash hash, Device *device_, const
 	{
 		unsigned count = device_->num_thread_indices * device_->per_frame.size();
 		per_thread_and_frame.resize(count);
+		per_thread_cache.resize(device_->num_thread_indices);
 	}
 
 	if (bindless && !device->get_device_features().vk12_features.descriptorIndexing)
@@ -354,7 +355,79 @@ void DescriptorSetAllocator::begin_frame()
 		// It would be safe to set all offsets to 0 here, but that's a little wasteful.
 		for (uint32_t i = 0; i < device->num_thread_indices; i++)
 			per_thread_and_frame[i * device->per_frame.size() + device->frame_context_index].offset = 0;
+
+		if (device->num_thread_indices != per_thread_cache.size())
+			per_thread_cache.resize(device->num_thread_indices);
+
+		// Only age the cache on frames where a thread actually uses it.
+		for (auto &state : per_thread_cache)
+			state.should_begin = true;
+	}
+}
+
+bool DescriptorSetAllocator::allocate_cached_descriptor_pool(PerThreadCache &state)
+{
+	VkDescriptorPoolCreateInfo info = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	info.maxSets = VULKAN_NUM_SETS_PER_POOL;
+	if (!pool_size.empty())
+	{
+		info.poolSizeCount = pool_size.size();
+		info.pPoolSizes = pool_size.data();
+	}
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if (table.vkCreateDescriptorPool(device->get_device(), &info, nullptr, &pool) != VK_SUCCESS)
+	{
+		LOGE("Failed to create descriptor pool.\n");
+		return false;
+	}
+
+	VkDescriptorSet sets[VULKAN_NUM_SETS_PER_POOL];
+	VkDescriptorSetLayout layouts[VULKAN_NUM_SETS_PER_POOL];
+	std::fill(std::begin(layouts), std::end(layouts), set_layout_pool);
+
+	VkDescriptorSetAllocateInfo alloc = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	alloc.descriptorPool = pool;
+	alloc.descriptorSetCount = VULKAN_NUM_SETS_PER_POOL;
+	alloc.pSetLayouts = layouts;
+
+	if (table.vkAllocateDescriptorSets(device->get_device(), &alloc, sets) != VK_SUCCESS)
+	{
+		LOGE("Failed to allocate descriptor sets.\n");
+		table.vkDestroyDescriptorPool(device->get_device(), pool, nullptr);
+		return false;
+	}
+
+	state.pools.push_back(pool);
+	for (auto set : sets)
+		state.set_nodes.make_vacant(set);
+	return true;
+}
+
+std::pair<VkDescriptorSet, bool> DescriptorSetAllocator::request_cached_descriptor_set(unsigned thread_index, Hash hash)
+{
+	VK_ASSERT(!bindless);
+	auto &state = per_thread_cache[thread_index];
+
+	if (state.should_begin)
+	{
+		state.set_nodes.begin_frame();
+		state.should_begin = false;
 	}
+
+	auto *node = state.set_nodes.request(hash);
+	if (node)
+		return { node->set, true };
+
+	node = state.set_nodes.request_vacant(hash);
+	if (!node)
+	{
+		if (!allocate_cached_descriptor_pool(state))
+			return { VK_NULL_HANDLE, false };
+		node = state.set_nodes.request_vacant(hash);
+	}
+
+	return { node->set, false };
 }
 
 VkDescriptorSet DescriptorSetAllocator::request_descriptor_set(unsigned thread_index, unsigned frame_index)
@@ -432,6 +505,15 @@ void DescriptorSetAllocator::clear()
 		state.offset = 0;
 		state.object_pool = {};
 	}
+
+	for (auto &state : per_thread_cache)
+	{
+		state.set_nodes.clear();
+		for (auto &pool : state.pools)
+			table.vkDestroyDescriptorPool(device->get_device(), pool, nullptr);
+		state.pools.clear();
+		state.should_begin = true;
+	}
 }
 
 DescriptorSetAllocator::~DescriptorSetAllocator()
@@ -148,6 +148,11 @@ public:
 	void begin_frame();
 	VkDescriptorSet request_descriptor_set(unsigned thread_index, unsigned frame_context);
 
+	// Persistent descriptor sets keyed by a hash of their contents, which survive across frame contexts.
+	// If the second member is true, the set has already been written with the same contents.
+	// Sets are only recycled after they have not been requested for VULKAN_DESCRIPTOR_RING_SIZE frames.
+	std::pair<VkDescriptorSet, bool> request_cached_descriptor_set(unsigned thread_index, Util::Hash hash);
+
 	VkDescriptorSetLayout get_layout_for_pool() const
 	{
 		return set_layout_pool;
@@ -214,6 +219,27 @@ private:
 	};
 
 	std::vector<PerThreadAndFrame> per_thread_and_frame;
+
+	struct CachedSetNode : Util::TemporaryHashmapEnabled<CachedSetNode>, Util::IntrusiveListEnabled<CachedSetNode>
+	{
+		explicit CachedSetNode(VkDescriptorSet set_)
+			: set(set_)
+		{
+		}
+
+		VkDescriptorSet set;
+	};
+
+	struct PerThreadCache
+	{
+		Util::TemporaryHashmap<CachedSetNode, VULKAN_DESCRIPTOR_RING_SIZE, true> set_nodes;
+		std::vector<VkDescriptorPool> pools;
+		bool should_begin = true;
+	};
+
+	std::vector<PerThreadCache> per_thread_cache;
+	bool allocate_cached_descriptor_pool(PerThreadCache &state);
+
 	std::vector<VkDescriptorPoolSize> pool_size;
 	bool bindless = false;
 };
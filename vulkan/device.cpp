@@ -1050,6 +1050,18 @@ unsigned Device::query_initialization_progress(InitializationStage) const
 void Device::wait_shader_caches()
 {
 }
+
+void Device::set_pipeline_warmup_thread_budget(unsigned)
+{
+}
+
+void Device::pause_pipeline_warmup()
+{
+}
+
+void Device::resume_pipeline_warmup()
+{
+}
 #endif
 
 void Device::init_timeline_semaphores()
@@ -2670,6 +2682,10 @@ void Device::next_frame_context()
 {
 	DRAIN_FRAME_LOCK();
 
+#ifdef GRANITE_VULKAN_FOSSILIZE
+	advance_pipeline_warmup_frame();
+#endif
+
 	if (frame_context_begin_ts)
 	{
 		auto frame_context_end_ts = write_calibrated_timestamp_nolock();
@@ -3866,6 +3882,43 @@ void Device::get_memory_budget(HeapBudget *budget)
 	managers.memory.get_memory_budget(budget);
 }
 
+void Device::get_memory_fragmentation(const Util::DefragmentationPlanner &planner, Util::FragmentationStats *stats)
+{
+	LOCK_MEMORY();
+	managers.memory.get_fragmentation_stats(planner, stats);
+}
+
+void Device::begin_memory_defragmentation(const Util::DefragmentationPlanner &planner,
+                                          const std::unordered_map<uint64_t, uint64_t> &movable_sizes,
+                                          std::vector<uint64_t> &blocks)
+{
+	LOCK_MEMORY();
+	managers.memory.begin_defragmentation(planner, movable_sizes, blocks);
+}
+
+void Device::end_memory_defragmentation()
+{
+	LOCK_MEMORY();
+	managers.memory.end_defragmentation();
+}
+
+void Device::set_descriptor_set_caching_enabled(bool enable)
+{
+	descriptor_set_caching.store(enable, std::memory_order_relaxed);
+}
+
+void Device::set_allocation_stats_enabled(bool enable)
+{
+	LOCK_MEMORY();
+	managers.memory.set_allocation_stats_enabled(enable);
+}
+
+void Device::get_allocation_stats(Util::ArenaAllocatorStats *stats)
+{
+	LOCK_MEMORY();
+	managers.memory.get_allocation_stats(stats);
+}
+
 ImageHandle Device::create_image(const ImageCreateInfo &create_info, const ImageInitialData *initial)
 {
 	if (initial)
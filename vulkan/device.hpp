@@ -467,6 +467,22 @@ public:
 
 	void get_memory_budget(HeapBudget *budget);
 
+	// See MemoryDefragmenter. Stats are reported per memory heap.
+	void get_memory_fragmentation(const Util::DefragmentationPlanner &planner, Util::FragmentationStats *stats);
+	void begin_memory_defragmentation(const Util::DefragmentationPlanner &planner,
+	                                  const std::unordered_map<uint64_t, uint64_t> &movable_sizes,
+	                                  std::vector<uint64_t> &blocks);
+	void end_memory_defragmentation();
+
+	// Opt-in reuse of descriptor sets across frame contexts. When a set is flushed with the same resources
+	// as a recently written set, the old set is bound as-is instead of being rewritten.
+	// Only affects devices which use plain descriptor sets, i.e. not descriptor buffers or heaps.
+	void set_descriptor_set_caching_enabled(bool enable);
+
+	// Opt-in sub-allocator telemetry, indexed by MemoryClass.
+	void set_allocation_stats_enabled(bool enable);
+	void get_allocation_stats(Util::ArenaAllocatorStats *stats);
+
 	const Sampler &get_stock_sampler(StockSampler sampler) const;
 
 #ifdef GRANITE_VULKAN_SYSTEM_HANDLES
@@ -496,6 +512,16 @@ public:
 	// >= 100 done
 	unsigned query_initialization_progress(InitializationStage status) const;
 
+	// Pipelines in the Fossilize database are warmed up on background threads, in the order they were
+	// first used in earlier runs. Pipelines which miss in a command buffer jump to the front of the queue.
+	// The thread budget is the number of concurrent warmup workers and can be changed at any time.
+	// Excess workers retire after their current compile.
+	void set_pipeline_warmup_thread_budget(unsigned num_threads);
+	// While paused, no new pipeline compiles are started, e.g. while recording a latency sensitive frame.
+	// Compiles which are already in flight complete as normal.
+	void pause_pipeline_warmup();
+	void resume_pipeline_warmup();
+
 	// For some platforms, the device and queue might be shared, possibly across threads, so need some mechanism to
 	// lock the global device and queue.
 	void set_queue_lock(std::function<void ()> lock_callback,
@@ -588,6 +614,7 @@ private:
 
 	DeviceFeatures ext;
 	bool debug_marker_sensitive = false;
+	std::atomic_bool descriptor_set_caching{false};
 	void init_stock_samplers();
 	void init_stock_sampler(StockSampler sampler, float max_aniso, float lod_bias);
 	void init_timeline_semaphores();
@@ -930,6 +957,16 @@ private:
 	void flush_pipeline_state();
 	void block_until_shader_module_ready();
 	void block_until_pipeline_ready();
+
+	unsigned pipeline_warmup_thread_budget = 4;
+	void kick_pipeline_warmup();
+	void kick_pipeline_warmup_workers();
+	void run_pipeline_warmup_worker();
+	void notify_pipeline_warmup_miss(Fossilize::Hash hash, bool synchronous);
+	void note_pipeline_first_use(Fossilize::Hash hash);
+	void advance_pipeline_warmup_frame();
+	void load_pipeline_first_use();
+	void flush_pipeline_first_use();
 #endif
 
 	ImplementationWorkarounds workarounds;
@@ -25,12 +25,14 @@
 #include "thread_group.hpp"
 #include "fossilize_db.hpp"
 #include "dynamic_array.hpp"
+#include <algorithm>
 
 namespace Vulkan
 {
 Device::RecorderState::RecorderState()
 {
 	recorder_ready.store(false, std::memory_order_relaxed);
+	frame_index.store(0, std::memory_order_relaxed);
 }
 
 Device::RecorderState::~RecorderState()
@@ -42,6 +44,7 @@ Device::ReplayerState::ReplayerState()
 	progress.prepare.store(0, std::memory_order_relaxed);
 	progress.modules.store(0, std::memory_order_relaxed);
 	progress.pipelines.store(0, std::memory_order_relaxed);
+	warmup.ready.store(false, std::memory_order_relaxed);
 }
 
 Device::ReplayerState::~ReplayerState()
@@ -131,6 +134,8 @@ void Device::register_compute_pipeline(Fossilize::Hash hash, const VkComputePipe
 	if (!recorder_state)
 		return;
 
+	note_pipeline_first_use(hash);
+
 	if (!recorder_state->recorder_ready.load(std::memory_order_acquire))
 	{
 		LOGW("Attempting to register compute pipeline before recorder is ready.\n");
@@ -160,6 +165,8 @@ void Device::register_graphics_pipeline(Fossilize::Hash hash, const VkGraphicsPi
 	if (!recorder_state)
 		return;
 
+	note_pipeline_first_use(hash);
+
 	if (!recorder_state->recorder_ready.load(std::memory_order_acquire))
 	{
 		LOGW("Attempting to register graphics pipeline before recorder is ready.\n");
@@ -352,6 +359,13 @@ bool Device::fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphics
 		return true;
 	}
 
+	// A command buffer might have compiled this on demand while it was queued up.
+	if (ret->get_pipeline(hash).pipeline != VK_NULL_HANDLE)
+	{
+		replayer_state->progress.pipelines.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
 #ifdef VULKAN_DEBUG
 	LOGI("Replaying graphics pipeline.\n");
 #endif
@@ -458,6 +472,12 @@ bool Device::fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePi
 		return true;
 	}
 
+	if (ret->get_pipeline(hash).pipeline != VK_NULL_HANDLE)
+	{
+		replayer_state->progress.pipelines.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
 #ifdef VULKAN_DEBUG
 	LOGI("Replaying compute pipeline.\n");
 #endif
@@ -895,6 +915,8 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 			return;
 		}
 
+		load_pipeline_first_use();
+
 		replayer_state->db.reset(
 			Fossilize::create_stream_archive_database(read_real_path.c_str(), Fossilize::DatabaseMode::ReadOnly));
 
@@ -1040,36 +1062,17 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 	parse_compute_task->set_desc("foz-parse-compute");
 	group->add_dependency(*parse_compute_task, *prepare_task);
 
-	auto compile_graphics_task = group->create_task();
-	auto compile_compute_task = group->create_task();
-	compile_graphics_task->set_desc("foz-compile-graphics");
-	compile_compute_task->set_desc("foz-compile-compute");
-	group->add_dependency(*compile_graphics_task, *parse_modules_task);
-	group->add_dependency(*compile_graphics_task, *parse_graphics_task);
-	group->add_dependency(*compile_compute_task, *parse_modules_task);
-	group->add_dependency(*compile_compute_task, *parse_compute_task);
-	for (unsigned i = 0; i < NumTasks; i++)
-	{
-		compile_graphics_task->enqueue_task([this, i]() {
-			size_t start = (i * replayer_state->graphics_pipelines.size()) / NumTasks;
-			size_t end = ((i + 1) * replayer_state->graphics_pipelines.size()) / NumTasks;
-			for (; start < end; start++)
-			{
-				auto &pipe = replayer_state->graphics_pipelines[start];
-				fossilize_replay_graphics_pipeline(pipe.first, *pipe.second);
-			}
-		});
+	// Pipelines are compiled by the warmup service, see kick_pipeline_warmup().
+	auto warmup_kick_task = group->create_task([this]() {
+		kick_pipeline_warmup();
+	});
+	warmup_kick_task->set_desc("foz-warmup-kick");
+	group->add_dependency(*warmup_kick_task, *parse_modules_task);
+	group->add_dependency(*warmup_kick_task, *parse_graphics_task);
+	group->add_dependency(*warmup_kick_task, *parse_compute_task);
 
-		compile_compute_task->enqueue_task([this, i]() {
-			size_t start = (i * replayer_state->compute_pipelines.size()) / NumTasks;
-			size_t end = ((i + 1) * replayer_state->compute_pipelines.size()) / NumTasks;
-			for (; start < end; start++)
-			{
-				auto &pipe = replayer_state->compute_pipelines[start];
-				fossilize_replay_compute_pipeline(pipe.first, *pipe.second);
-			}
-		});
-	}
+	replayer_state->warmup.done = group->create_task();
+	replayer_state->warmup.done->set_desc("foz-warmup-done");
 
 	replayer_state->complete = get_system_handles().thread_group->create_task([this]() {
 		LOGI("Fossilize replay completed!\n  Modules: %zu\n  Graphics: %zu\n  Compute: %zu\n",
@@ -1085,6 +1088,14 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 		cleanup(replayer_state->base_replayer);
 		cleanup(replayer_state->graphics_replayer);
 		cleanup(replayer_state->compute_replayer);
+		{
+			std::lock_guard<std::mutex> holder{replayer_state->warmup.lock};
+			replayer_state->warmup.ready.store(false, std::memory_order_relaxed);
+			replayer_state->warmup.lookup.clear();
+			replayer_state->warmup.entries.clear();
+			replayer_state->warmup.claimed.clear();
+			replayer_state->warmup.promoted.clear();
+		}
 		replayer_state->graphics_pipelines.clear();
 		replayer_state->compute_pipelines.clear();
 		replayer_state->module_hashes.clear();
@@ -1093,8 +1104,7 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 		replayer_state->db.reset();
 	});
 	replayer_state->complete->set_desc("foz-replay-complete");
-	group->add_dependency(*replayer_state->complete, *compile_graphics_task);
-	group->add_dependency(*replayer_state->complete, *compile_compute_task);
+	group->add_dependency(*replayer_state->complete, *replayer_state->warmup.done);
 	group->add_dependency(*replayer_state->complete, *shader_compilation);
 	replayer_state->complete->flush();
 
@@ -1102,8 +1112,7 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 	replayer_state->module_ready->flush();
 
 	auto compile_task = group->create_task();
-	group->add_dependency(*compile_task, *compile_graphics_task);
-	group->add_dependency(*compile_task, *compile_compute_task);
+	group->add_dependency(*compile_task, *replayer_state->warmup.done);
 	replayer_state->pipeline_ready = std::move(compile_task);
 	replayer_state->pipeline_ready->flush();
 }
@@ -1112,6 +1121,7 @@ void Device::flush_pipeline_state()
 {
 	if (replayer_state)
 	{
+		resume_pipeline_warmup();
 		if (replayer_state->complete)
 			replayer_state->complete->wait();
 		replayer_state.reset();
@@ -1119,11 +1129,346 @@ void Device::flush_pipeline_state()
 
 	if (recorder_state)
 	{
+		flush_pipeline_first_use();
 		recorder_state->recorder.tear_down_recording_thread();
 		recorder_state.reset();
 	}
 }
 
+void Device::kick_pipeline_warmup()
+{
+	auto &warmup = replayer_state->warmup;
+	size_t count;
+
+	{
+		std::lock_guard<std::mutex> holder{warmup.lock};
+		auto &entries = warmup.entries;
+		entries.reserve(replayer_state->graphics_pipelines.size() + replayer_state->compute_pipelines.size());
+
+		for (size_t i = 0, n = replayer_state->graphics_pipelines.size(); i < n; i++)
+			entries.push_back({ replayer_state->graphics_pipelines[i].first, UINT32_MAX, uint32_t(i), false });
+		for (size_t i = 0, n = replayer_state->compute_pipelines.size(); i < n; i++)
+			entries.push_back({ replayer_state->compute_pipelines[i].first, UINT32_MAX, uint32_t(i), true });
+
+		{
+			std::lock_guard<std::mutex> first_use_holder{recorder_state->first_use_lock};
+			auto &first_use = recorder_state->first_use_frame;
+			for (auto &entry : entries)
+			{
+				auto itr = first_use.find(entry.hash);
+				if (itr != first_use.end())
+					entry.first_use_frame = itr->second;
+			}
+		}
+
+		// Pipelines never observed in a run go last, in database order.
+		std::stable_sort(entries.begin(), entries.end(), [](const ReplayerState::WarmupEntry &a,
+		                                                    const ReplayerState::WarmupEntry &b) {
+			return a.first_use_frame < b.first_use_frame;
+		});
+
+		warmup.claimed.resize(entries.size());
+		for (size_t i = 0, n = entries.size(); i < n; i++)
+			warmup.lookup[entries[i].hash] = uint32_t(i);
+
+		warmup.remaining = entries.size();
+		count = entries.size();
+	}
+
+	warmup.ready.store(true, std::memory_order_release);
+
+	if (count == 0)
+	{
+		warmup.done_signalled = true;
+		warmup.done->flush();
+	}
+	else
+		kick_pipeline_warmup_workers();
+}
+
+void Device::kick_pipeline_warmup_workers()
+{
+	auto &warmup = replayer_state->warmup;
+	unsigned to_spawn = 0;
+
+	{
+		std::lock_guard<std::mutex> holder{warmup.lock};
+		if (warmup.paused || warmup.remaining == 0)
+			return;
+
+		// Upper bound, some of these may have been claimed already.
+		size_t pending = warmup.promoted.size() + (warmup.entries.size() - warmup.cursor);
+		while (warmup.active_workers < pipeline_warmup_thread_budget && to_spawn < pending)
+		{
+			warmup.active_workers++;
+			to_spawn++;
+		}
+	}
+
+	auto *group = get_system_handles().thread_group;
+	for (unsigned i = 0; i < to_spawn; i++)
+	{
+		auto task = group->create_task([this]() {
+			run_pipeline_warmup_worker();
+		});
+		task->set_desc("foz-warmup");
+		task->set_task_class(Granite::TaskClass::Background);
+		task->flush();
+	}
+}
+
+void Device::run_pipeline_warmup_worker()
+{
+	auto &warmup = replayer_state->warmup;
+
+	for (;;)
+	{
+		uint32_t entry_index = UINT32_MAX;
+		Granite::TaskGroupHandle done;
+
+		{
+			std::lock_guard<std::mutex> holder{warmup.lock};
+
+			if (!warmup.paused && warmup.active_workers <= pipeline_warmup_thread_budget)
+			{
+				while (!warmup.promoted.empty() && entry_index == UINT32_MAX)
+				{
+					uint32_t index = warmup.promoted.back();
+					warmup.promoted.pop_back();
+					if (!warmup.claimed[index])
+						entry_index = index;
+				}
+
+				while (warmup.cursor < warmup.entries.size() && entry_index == UINT32_MAX)
+				{
+					uint32_t index = uint32_t(warmup.cursor++);
+					if (!warmup.claimed[index])
+						entry_index = index;
+				}
+			}
+
+			if (entry_index == UINT32_MAX)
+			{
+				// The last worker out signals completion. Nothing in replayer_state can be touched after that.
+				warmup.active_workers--;
+				if (warmup.remaining == 0 && warmup.active_workers == 0 && !warmup.done_signalled)
+				{
+					warmup.done_signalled = true;
+					done = warmup.done;
+				}
+			}
+			else
+				warmup.claimed[entry_index] = 1;
+		}
+
+		if (entry_index == UINT32_MAX)
+		{
+			if (done)
+				done->flush();
+			return;
+		}
+
+		auto &entry = warmup.entries[entry_index];
+		if (entry.compute)
+		{
+			auto &pipe = replayer_state->compute_pipelines[entry.index];
+			fossilize_replay_compute_pipeline(pipe.first, *pipe.second);
+		}
+		else
+		{
+			auto &pipe = replayer_state->graphics_pipelines[entry.index];
+			fossilize_replay_graphics_pipeline(pipe.first, *pipe.second);
+		}
+
+		std::lock_guard<std::mutex> holder{warmup.lock};
+		warmup.remaining--;
+	}
+}
+
+void Device::notify_pipeline_warmup_miss(Fossilize::Hash hash, bool synchronous)
+{
+	if (!replayer_state || !replayer_state->warmup.ready.load(std::memory_order_acquire))
+		return;
+
+	auto &warmup = replayer_state->warmup;
+	Granite::TaskGroupHandle done;
+
+	{
+		std::lock_guard<std::mutex> holder{warmup.lock};
+		auto itr = warmup.lookup.find(hash);
+		if (itr == warmup.lookup.end() || warmup.claimed[itr->second])
+			return;
+
+		if (synchronous)
+		{
+			// The command buffer compiles this inline, so there is no point in warming it up.
+			warmup.claimed[itr->second] = 1;
+			replayer_state->progress.pipelines.fetch_add(1, std::memory_order_release);
+			warmup.remaining--;
+			if (warmup.remaining == 0 && warmup.active_workers == 0 && !warmup.done_signalled)
+			{
+				warmup.done_signalled = true;
+				done = warmup.done;
+			}
+		}
+		else
+		{
+			// The command buffer will try again later, so make sure it's next in line.
+			warmup.promoted.push_back(itr->second);
+		}
+	}
+
+	if (done)
+		done->flush();
+	else if (!synchronous)
+		kick_pipeline_warmup_workers();
+}
+
+void Device::set_pipeline_warmup_thread_budget(unsigned num_threads)
+{
+	num_threads = std::max<unsigned>(num_threads, 1);
+
+	if (!replayer_state)
+	{
+		pipeline_warmup_thread_budget = num_threads;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> holder{replayer_state->warmup.lock};
+		pipeline_warmup_thread_budget = num_threads;
+	}
+
+	if (replayer_state->warmup.ready.load(std::memory_order_acquire))
+		kick_pipeline_warmup_workers();
+}
+
+void Device::pause_pipeline_warmup()
+{
+	if (!replayer_state)
+		return;
+
+	std::lock_guard<std::mutex> holder{replayer_state->warmup.lock};
+	replayer_state->warmup.paused = true;
+}
+
+void Device::resume_pipeline_warmup()
+{
+	if (!replayer_state)
+		return;
+
+	{
+		std::lock_guard<std::mutex> holder{replayer_state->warmup.lock};
+		if (!replayer_state->warmup.paused)
+			return;
+		replayer_state->warmup.paused = false;
+	}
+
+	if (replayer_state->warmup.ready.load(std::memory_order_acquire))
+		kick_pipeline_warmup_workers();
+}
+
+void Device::note_pipeline_first_use(Fossilize::Hash hash)
+{
+	uint32_t frame = recorder_state->frame_index.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> holder{recorder_state->first_use_lock};
+	auto &first_use = recorder_state->first_use_frame;
+	auto itr = first_use.find(hash);
+	if (itr == first_use.end())
+	{
+		first_use[hash] = frame;
+		recorder_state->first_use_dirty = true;
+	}
+	else if (frame < itr->second)
+	{
+		itr->second = frame;
+		recorder_state->first_use_dirty = true;
+	}
+}
+
+void Device::advance_pipeline_warmup_frame()
+{
+	if (recorder_state)
+		recorder_state->frame_index.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace
+{
+struct FirstUseHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t count;
+};
+
+struct FirstUseEntry
+{
+	uint64_t hash;
+	uint32_t frame;
+	uint32_t reserved;
+};
+
+static constexpr uint32_t FirstUseMagic = 0x46555047; // GPUF
+static constexpr uint32_t FirstUseVersion = 1;
+}
+
+void Device::load_pipeline_first_use()
+{
+	auto file = get_system_handles().filesystem->open_readonly_mapping("cache://fossilize/first_use.bin");
+	if (!file)
+		return;
+
+	size_t size = file->get_size();
+	auto *header = file->data<FirstUseHeader>();
+	if (size < sizeof(*header) || header->magic != FirstUseMagic || header->version != FirstUseVersion ||
+	    header->count > (size - sizeof(*header)) / sizeof(FirstUseEntry))
+	{
+		LOGW("Ignoring invalid pipeline first use data.\n");
+		return;
+	}
+
+	auto *entries = reinterpret_cast<const FirstUseEntry *>(header + 1);
+
+	// Anything observed in this run before we got here takes precedence if it's earlier.
+	std::lock_guard<std::mutex> holder{recorder_state->first_use_lock};
+	auto &first_use = recorder_state->first_use_frame;
+	for (uint64_t i = 0; i < header->count; i++)
+	{
+		auto itr = first_use.find(entries[i].hash);
+		if (itr == first_use.end())
+			first_use[entries[i].hash] = entries[i].frame;
+		else if (entries[i].frame < itr->second)
+			itr->second = entries[i].frame;
+	}
+}
+
+void Device::flush_pipeline_first_use()
+{
+	std::lock_guard<std::mutex> holder{recorder_state->first_use_lock};
+	if (!recorder_state->first_use_dirty)
+		return;
+
+	auto &first_use = recorder_state->first_use_frame;
+	size_t size = sizeof(FirstUseHeader) + first_use.size() * sizeof(FirstUseEntry);
+	auto file = get_system_handles().filesystem->open_transactional_mapping("cache://fossilize/first_use.bin", size);
+	if (!file)
+	{
+		LOGW("Failed to write pipeline first use data.\n");
+		return;
+	}
+
+	auto *header = file->mutable_data<FirstUseHeader>();
+	header->magic = FirstUseMagic;
+	header->version = FirstUseVersion;
+	header->count = first_use.size();
+
+	auto *entries = reinterpret_cast<FirstUseEntry *>(header + 1);
+	for (auto &use : first_use)
+		*entries++ = { use.first, use.second, 0 };
+
+	recorder_state->first_use_dirty = false;
+}
+
 unsigned Device::query_initialization_progress(InitializationStage status) const
 {
 	if (!replayer_state)
@@ -1174,6 +1519,7 @@ void Device::block_until_pipeline_ready()
 {
 	if (!replayer_state || !replayer_state->pipeline_ready)
 		return;
+	resume_pipeline_warmup();
 	replayer_state->pipeline_ready->wait();
 }
 
@@ -24,6 +24,8 @@
 
 #include "device.hpp"
 #include "thread_group.hpp"
+#include "hashmap.hpp"
+#include <mutex>
 
 namespace Vulkan
 {
@@ -35,6 +37,13 @@ struct Device::RecorderState
 	std::unique_ptr<Fossilize::DatabaseInterface> db;
 	Fossilize::StateRecorder recorder;
 	std::atomic_bool recorder_ready;
+
+	// Frame index where a pipeline was first requested, merged with what earlier runs observed.
+	// Drives the warmup order on the next run.
+	std::mutex first_use_lock;
+	Util::HashMap<uint32_t> first_use_frame;
+	std::atomic_uint32_t frame_index;
+	bool first_use_dirty = false;
 };
 
 static constexpr unsigned NumTasks = 4;
@@ -58,6 +67,33 @@ struct Device::ReplayerState
 	std::vector<std::pair<Fossilize::Hash, VkGraphicsPipelineCreateInfo *>> graphics_pipelines;
 	std::vector<std::pair<Fossilize::Hash, VkComputePipelineCreateInfo *>> compute_pipelines;
 
+	struct WarmupEntry
+	{
+		Fossilize::Hash hash;
+		uint32_t first_use_frame;
+		// Index into graphics_pipelines or compute_pipelines.
+		uint32_t index;
+		bool compute;
+	};
+
+	struct
+	{
+		std::mutex lock;
+		std::vector<WarmupEntry> entries;
+		std::vector<uint8_t> claimed;
+		// Entries which missed in a command buffer, most recent last.
+		std::vector<uint32_t> promoted;
+		Util::HashMap<uint32_t> lookup;
+		size_t cursor = 0;
+		size_t remaining = 0;
+		unsigned active_workers = 0;
+		bool paused = false;
+		bool done_signalled = false;
+		std::atomic_bool ready;
+		// Completes when every entry has been compiled or dropped.
+		Granite::TaskGroupHandle done;
+	} warmup;
+
 	struct
 	{
 		std::atomic_uint32_t pipelines;
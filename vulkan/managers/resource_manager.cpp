@@ -492,7 +492,7 @@ void ResourceManager::instantiate_asset_mesh(Granite::AssetManager &manager_,
 
 	if (ret)
 	{
-		size_t total_streams = view.format_header->meshlet_count * view.format_header->stream_count;
+		size_t total_streams = view.num_bounds * view.format_header->stream_count;
 		size_t total_padded_streams = view.num_bounds_256 * Meshlet::ChunkFactor * view.format_header->stream_count;
 
 		if (mesh_encoding == MeshEncoding::MeshletEncoded)
@@ -600,7 +600,8 @@ void ResourceManager::instantiate_asset_mesh(Granite::AssetManager &manager_,
 			cost += view.format_header->payload_size_words * mesh_payload_allocator.get_element_size(0);
 			cost += view.num_bounds_256 * mesh_header_allocator.get_element_size(0);
 			cost += view.num_bounds_256 * mesh_header_allocator.get_element_size(1);
-			cost += view.format_header->meshlet_count * view.format_header->stream_count * mesh_stream_allocator.get_element_size(0);
+			cost += view.num_bounds_256 * Meshlet::ChunkFactor * view.format_header->stream_count *
+			        mesh_stream_allocator.get_element_size(0);
 		}
 		else
 		{
@@ -610,8 +611,8 @@ void ResourceManager::instantiate_asset_mesh(Granite::AssetManager &manager_,
 			cost += view.total_vertices * attribute_buffer_allocator.get_element_size(2);
 			if (mesh_encoding != MeshEncoding::Classic)
 			{
-				cost += view.format_header->meshlet_count * indirect_buffer_allocator.get_element_size(0);
-				cost += view.format_header->meshlet_count * indirect_buffer_allocator.get_element_size(1);
+				cost += view.num_bounds_256 * indirect_buffer_allocator.get_element_size(0);
+				cost += view.num_bounds_256 * indirect_buffer_allocator.get_element_size(1);
 			}
 		}
 	}
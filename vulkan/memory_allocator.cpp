@@ -101,10 +101,29 @@ ExternalHandle DeviceAllocation::export_handle(Device &device)
 	return h;
 }
 
+MiniHeap *DeviceAllocation::get_root_heap()
+{
+	if (!alloc)
+		return nullptr;
+
+	auto *root = heap.get();
+	while (root->allocation.alloc)
+		root = root->allocation.heap.get();
+	return root;
+}
+
+const MiniHeap *DeviceAllocation::get_root_heap() const
+{
+	return const_cast<DeviceAllocation *>(this)->get_root_heap();
+}
+
 void DeviceAllocation::free_immediate(DeviceAllocator &allocator)
 {
 	if (alloc)
+	{
+		get_root_heap()->live_size -= size;
 		free_immediate();
+	}
 	else if (base)
 	{
 		allocator.internal_free_no_recycle(size, memory_type, base);
@@ -116,10 +135,14 @@ void DeviceAllocation::free_global(DeviceAllocator &allocator, uint32_t size_, u
 {
 	if (base)
 	{
-		allocator.internal_free(size_, memory_type_, mode, base, host_base != nullptr);
+		if (release_on_free)
+			allocator.internal_free_no_recycle(size_, memory_type_, base);
+		else
+			allocator.internal_free(size_, memory_type_, mode, base, host_base != nullptr);
 		base = VK_NULL_HANDLE;
 		mask = 0;
 		offset = 0;
+		release_on_free = false;
 	}
 }
 
@@ -266,6 +289,7 @@ bool Allocator::allocate(uint32_t size, uint32_t alignment, AllocationMode mode,
 				if (alloc->host_base)
 					alloc->host_base += aligned_offset - alloc->offset;
 				alloc->offset = aligned_offset;
+				alloc->get_root_heap()->live_size += alloc->size;
 				VK_ASSERT(alloc->mode == mode);
 				VK_ASSERT(alloc->memory_type == memory_type);
 			}
@@ -573,6 +597,149 @@ void DeviceAllocator::get_memory_budget(HeapBudget *heap_budgets)
 	get_memory_budget_nolock(heap_budgets);
 }
 
+template <typename Func>
+void DeviceAllocator::for_each_block(uint32_t memory_type, AllocationMode mode, const Func &func)
+{
+	// Only the top-level class owns VkDeviceMemory blocks, the other classes nest inside it.
+	auto &clazz = allocators[memory_type]->get_class_allocator(MemoryClass::Huge, mode);
+	clazz.for_each_heap([&](MiniHeap &heap) {
+		func(clazz, heap);
+	});
+}
+
+uint64_t DeviceAllocator::get_block_id(const DeviceAllocation &alloc)
+{
+	return uint64_t(reinterpret_cast<uintptr_t>(alloc.get_root_heap()));
+}
+
+void DeviceAllocator::set_allocation_stats_enabled(bool enable)
+{
+	for (auto &allocator : allocators)
+		for (int clazz = 0; clazz < Util::ecast(MemoryClass::Count); clazz++)
+			for (int mode = 0; mode < Util::ecast(AllocationMode::Count); mode++)
+				allocator->get_class_allocator(MemoryClass(clazz), AllocationMode(mode)).set_stats_enabled(enable);
+}
+
+void DeviceAllocator::get_allocation_stats(Util::ArenaAllocatorStats *stats)
+{
+	for (int clazz = 0; clazz < Util::ecast(MemoryClass::Count); clazz++)
+	{
+		stats[clazz] = {};
+		for (auto &allocator : allocators)
+		{
+			for (int mode = 0; mode < Util::ecast(AllocationMode::Count); mode++)
+			{
+				Util::ArenaAllocatorStats class_stats;
+				allocator->get_class_allocator(MemoryClass(clazz), AllocationMode(mode)).get_stats(class_stats);
+				stats[clazz].accumulate(class_stats);
+			}
+		}
+	}
+}
+
+void DeviceAllocator::get_fragmentation_stats(const Util::DefragmentationPlanner &planner,
+                                              Util::FragmentationStats *heap_stats)
+{
+	std::vector<Util::DefragmentationHeapInfo> blocks[VK_MAX_MEMORY_HEAPS];
+
+	for (uint32_t type = 0; type < mem_props.memoryTypeCount; type++)
+	{
+		auto &blocks_in_heap = blocks[mem_props.memoryTypes[type].heapIndex];
+		for (int mode = 0; mode < Util::ecast(AllocationMode::Count); mode++)
+		{
+			for_each_block(type, AllocationMode(mode), [&](ClassAllocator &clazz, MiniHeap &heap) {
+				blocks_in_heap.push_back({ uint64_t(reinterpret_cast<uintptr_t>(&heap)),
+				                           clazz.get_max_allocation_size(), heap.live_size, heap.live_size });
+			});
+		}
+	}
+
+	for (uint32_t i = 0; i < mem_props.memoryHeapCount; i++)
+		heap_stats[i] = planner.compute_stats(blocks[i].data(), blocks[i].size());
+}
+
+void DeviceAllocator::begin_defragmentation(const Util::DefragmentationPlanner &planner,
+                                            const std::unordered_map<uint64_t, uint64_t> &movable_sizes,
+                                            std::vector<uint64_t> &selected_blocks)
+{
+	std::vector<Util::DefragmentationHeapInfo> blocks;
+	std::vector<uint64_t> selected;
+	selected_blocks.clear();
+
+	// Relocations stay within the same memory type and mode,
+	// so each combination is planned in isolation.
+	for (uint32_t type = 0; type < mem_props.memoryTypeCount; type++)
+	{
+		for (int mode = 0; mode < Util::ecast(AllocationMode::Count); mode++)
+		{
+			ClassAllocator *owner = nullptr;
+			blocks.clear();
+
+			for_each_block(type, AllocationMode(mode), [&](ClassAllocator &clazz, MiniHeap &heap) {
+				owner = &clazz;
+				if (!heap.retired)
+				{
+					uint64_t id = uint64_t(reinterpret_cast<uintptr_t>(&heap));
+					auto itr = movable_sizes.find(id);
+					blocks.push_back({ id, clazz.get_max_allocation_size(), heap.live_size,
+					                   itr != movable_sizes.end() ? itr->second : 0 });
+				}
+			});
+
+			if (blocks.empty())
+				continue;
+
+			planner.select_heaps(blocks.data(), blocks.size(), selected);
+			for (auto id : selected)
+			{
+				auto *heap = reinterpret_cast<MiniHeap *>(uintptr_t(id));
+				heap->allocation.release_on_free = true;
+				owner->retire_heap(heap);
+				selected_blocks.push_back(id);
+			}
+
+			if (!selected.empty())
+				retire_nested_heaps(type, AllocationMode(mode));
+		}
+	}
+}
+
+void DeviceAllocator::retire_nested_heaps(uint32_t memory_type, AllocationMode mode)
+{
+	// Smaller classes sub-allocate their heaps from a block, and would otherwise keep
+	// handing out free space inside a retired block, relocations included.
+	std::vector<MiniHeap *> nested;
+	for (int clazz = 0; clazz < Util::ecast(MemoryClass::Huge); clazz++)
+	{
+		auto &allocator = allocators[memory_type]->get_class_allocator(MemoryClass(clazz), mode);
+
+		nested.clear();
+		allocator.for_each_heap([&](MiniHeap &heap) {
+			if (!heap.retired && heap.allocation.get_root_heap()->retired)
+				nested.push_back(&heap);
+		});
+
+		for (auto *heap : nested)
+			allocator.retire_heap(heap);
+	}
+}
+
+void DeviceAllocator::end_defragmentation()
+{
+	for (uint32_t type = 0; type < mem_props.memoryTypeCount; type++)
+	{
+		for (int mode = 0; mode < Util::ecast(AllocationMode::Count); mode++)
+		{
+			for_each_block(type, AllocationMode(mode), [&](ClassAllocator &, MiniHeap &heap) {
+				if (heap.retired)
+					heap.allocation.release_on_free = false;
+			});
+			for (int clazz = 0; clazz < Util::ecast(MemoryClass::Count); clazz++)
+				allocators[type]->get_class_allocator(MemoryClass(clazz), AllocationMode(mode)).restore_retired_heaps();
+		}
+	}
+}
+
 bool DeviceAllocator::internal_allocate(
 	uint32_t size, uint32_t memory_type, AllocationMode mode,
 	VkDeviceMemory *memory, uint8_t **host_memory,
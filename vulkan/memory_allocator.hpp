@@ -32,10 +32,12 @@
 #include "enum_cast.hpp"
 #include "vulkan_common.hpp"
 #include "arena_allocator.hpp"
+#include "defragmentation_planner.hpp"
 #include <assert.h>
 #include <memory>
 #include <stddef.h>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 namespace Vulkan
@@ -138,6 +140,11 @@ private:
 
 	AllocationMode mode = AllocationMode::Count;
 	uint8_t memory_type = 0;
+	// Set on blocks which are being evacuated, so they are not kept around for recycling.
+	bool release_on_free = false;
+
+	MiniHeap *get_root_heap();
+	const MiniHeap *get_root_heap() const;
 
 	void free_global(DeviceAllocator &allocator, uint32_t size, uint32_t memory_type);
 	void free_immediate();
@@ -268,6 +275,25 @@ public:
 
 	void get_memory_budget(HeapBudget *heaps);
 
+	// Defragmentation support. Only blocks which are sub-allocated from are considered,
+	// dedicated and global allocations never move. Stats are reported per memory heap.
+	void get_fragmentation_stats(const Util::DefragmentationPlanner &planner, Util::FragmentationStats *heaps);
+	// Selects sparse blocks per memory type and allocation mode, and retires them
+	// so that new allocations (including relocations) are placed elsewhere.
+	// movable_sizes maps block IDs to the number of bytes the caller is able to relocate.
+	void begin_defragmentation(const Util::DefragmentationPlanner &planner,
+	                           const std::unordered_map<uint64_t, uint64_t> &movable_sizes,
+	                           std::vector<uint64_t> &blocks);
+	// Blocks which could not be fully evacuated go back into circulation.
+	void end_defragmentation();
+	// Identifies the block an allocation lives in, or 0 if it is not sub-allocated.
+	static uint64_t get_block_id(const DeviceAllocation &alloc);
+
+	// Opt-in allocation telemetry. Stats are indexed by MemoryClass,
+	// and accumulated over all memory types and allocation modes.
+	void set_allocation_stats_enabled(bool enable);
+	void get_allocation_stats(Util::ArenaAllocatorStats *stats);
+
 	bool internal_allocate(uint32_t size, uint32_t memory_type, AllocationMode mode,
 	                       VkDeviceMemory *memory, uint8_t **host_memory,
 	                       VkObjectType object_type, uint64_t dedicated_object, ExternalHandle *external);
@@ -299,6 +325,10 @@ private:
 	std::vector<Heap> heaps;
 	bool memory_heap_is_budget_critical[VK_MAX_MEMORY_HEAPS] = {};
 	void get_memory_budget_nolock(HeapBudget *heaps);
+
+	template <typename Func>
+	void for_each_block(uint32_t memory_type, AllocationMode mode, const Func &func);
+	void retire_nested_heaps(uint32_t memory_type, AllocationMode mode);
 };
 
 // Avoid cross-dependency in header.
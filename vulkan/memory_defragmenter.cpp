@@ -0,0 +1,311 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "memory_defragmenter.hpp"
+#include "device.hpp"
+#include "format.hpp"
+
+namespace Vulkan
+{
+MemoryDefragmenter::MemoryDefragmenter(Device &device_)
+	: device(device_)
+{
+}
+
+MemoryDefragmenter::~MemoryDefragmenter()
+{
+	end_pass();
+}
+
+uint64_t MemoryDefragmenter::register_buffer(BufferHandle buffer, BufferRebindFunc rebind)
+{
+	uint64_t id = next_id++;
+	auto &entry = entries[id];
+	entry.buffer = std::move(buffer);
+	entry.rebind_buffer = std::move(rebind);
+	return id;
+}
+
+uint64_t MemoryDefragmenter::register_image(ImageHandle image, VkImageLayout layout, ImageRebindFunc rebind)
+{
+	uint64_t id = next_id++;
+	auto &entry = entries[id];
+	entry.image = std::move(image);
+	entry.layout = layout;
+	entry.rebind_image = std::move(rebind);
+	return id;
+}
+
+void MemoryDefragmenter::unregister(uint64_t id)
+{
+	entries.erase(id);
+}
+
+void MemoryDefragmenter::set_options(const Util::DefragmentationOptions &options)
+{
+	planner.set_options(options);
+}
+
+const Util::DefragmentationOptions &MemoryDefragmenter::get_options() const
+{
+	return planner.get_options();
+}
+
+void MemoryDefragmenter::get_fragmentation_stats(Util::FragmentationStats *stats)
+{
+	device.get_memory_fragmentation(planner, stats);
+}
+
+const DeviceAllocation &MemoryDefragmenter::get_allocation(const Entry &entry) const
+{
+	return entry.buffer ? entry.buffer->get_allocation() : entry.image->get_allocation();
+}
+
+bool MemoryDefragmenter::is_relocatable(const Entry &entry) const
+{
+	if (entry.buffer)
+	{
+		if ((entry.buffer->get_create_info().misc & BUFFER_MISC_EXTERNAL_MEMORY_BIT) != 0)
+			return false;
+	}
+	else
+	{
+		auto &info = entry.image->get_create_info();
+		if (info.domain != ImageDomain::Physical || info.num_memory_aliases || info.pnext ||
+		    (info.misc & IMAGE_MISC_EXTERNAL_MEMORY_BIT) != 0 ||
+		    (info.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0 ||
+		    entry.image->is_swapchain_image())
+		{
+			return false;
+		}
+	}
+
+	return DeviceAllocator::get_block_id(get_allocation(entry)) != 0;
+}
+
+BufferHandle MemoryDefragmenter::create_replacement(const Buffer &buffer)
+{
+	auto info = buffer.get_create_info();
+	info.misc &= ~BUFFER_MISC_ZERO_INITIALIZE_BIT;
+	return device.create_buffer(info);
+}
+
+ImageHandle MemoryDefragmenter::create_replacement(const Image &image)
+{
+	auto info = image.get_create_info();
+	info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	info.misc &= ~IMAGE_MISC_GENERATE_MIPS_BIT;
+	return device.create_image(info);
+}
+
+bool MemoryDefragmenter::begin_pass()
+{
+	if (active)
+		return true;
+
+	// Only blocks where every live allocation is registered with us are worth evacuating.
+	std::unordered_map<uint64_t, uint64_t> movable_sizes;
+	std::vector<Util::DefragmentationAllocationInfo> allocations;
+	allocations.reserve(entries.size());
+
+	for (auto &entry : entries)
+	{
+		if (!is_relocatable(entry.second))
+			continue;
+
+		auto &alloc = get_allocation(entry.second);
+		uint64_t block = DeviceAllocator::get_block_id(alloc);
+		movable_sizes[block] += alloc.get_size();
+		allocations.push_back({ entry.first, block, alloc.get_size() });
+	}
+
+	device.begin_memory_defragmentation(planner, movable_sizes, blocks);
+	planner.plan_moves(allocations.data(), allocations.size(), blocks, moves);
+	move_index = 0;
+
+	if (moves.empty())
+	{
+		device.end_memory_defragmentation();
+		blocks.clear();
+		return false;
+	}
+
+	active = true;
+	return true;
+}
+
+void MemoryDefragmenter::end_pass()
+{
+	if (!active)
+		return;
+
+	device.end_memory_defragmentation();
+	blocks.clear();
+	moves.clear();
+	move_index = 0;
+	active = false;
+}
+
+static void copy_image(CommandBuffer &cmd, const Image &dst, const Image &src)
+{
+	VkImageSubresourceLayers subresource = {};
+	subresource.aspectMask = format_to_aspect_mask(src.get_format());
+	subresource.layerCount = src.get_create_info().layers;
+
+	for (uint32_t level = 0; level < src.get_create_info().levels; level++)
+	{
+		subresource.mipLevel = level;
+		cmd.copy_image(dst, src, {}, {},
+		               { src.get_width(level), src.get_height(level), src.get_depth(level) },
+		               subresource, subresource);
+	}
+}
+
+bool MemoryDefragmenter::step()
+{
+	if (!active)
+		return false;
+
+	struct Relocation
+	{
+		Entry *entry;
+		BufferHandle buffer;
+		ImageHandle image;
+	};
+	std::vector<Relocation> relocations;
+
+	uint32_t current_step = moves[move_index].step;
+	for (; move_index < moves.size() && moves[move_index].step == current_step; move_index++)
+	{
+		auto &move = moves[move_index];
+		auto itr = entries.find(move.object_id);
+		if (itr == entries.end())
+			continue;
+
+		// Owner may have unregistered and registered something else in the meantime.
+		auto &entry = itr->second;
+		if (DeviceAllocator::get_block_id(get_allocation(entry)) != move.heap_id)
+			continue;
+
+		Relocation relocation = { &entry, {}, {} };
+		if (entry.buffer)
+			relocation.buffer = create_replacement(*entry.buffer);
+		else
+			relocation.image = create_replacement(*entry.image);
+
+		if (!relocation.buffer && !relocation.image)
+		{
+			LOGW("Failed to allocate replacement resource, skipping relocation.\n");
+			continue;
+		}
+
+		// Relocating back into the block we are evacuating would keep it alive forever.
+		auto &replacement_alloc = relocation.buffer ? relocation.buffer->get_allocation() :
+		                          relocation.image->get_allocation();
+		if (DeviceAllocator::get_block_id(replacement_alloc) == move.heap_id)
+		{
+			LOGW("Replacement resource was placed in the block being evacuated, skipping relocation.\n");
+			continue;
+		}
+
+		relocations.push_back(std::move(relocation));
+	}
+
+	if (!relocations.empty())
+	{
+		auto cmd = device.request_command_buffer();
+
+		cmd->barrier(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+		             VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+
+		for (auto &relocation : relocations)
+		{
+			if (!relocation.image)
+				continue;
+
+			auto &src = *relocation.entry->image;
+			auto &dst = *relocation.image;
+			cmd->image_barrier(src, relocation.entry->layout, src.get_layout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
+			                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0,
+			                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+			cmd->image_barrier(dst, VK_IMAGE_LAYOUT_UNDEFINED, dst.get_layout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
+			                   VK_PIPELINE_STAGE_NONE, 0,
+			                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+		}
+
+		for (auto &relocation : relocations)
+		{
+			if (relocation.buffer)
+				cmd->copy_buffer(*relocation.buffer, *relocation.entry->buffer);
+			else
+				copy_image(*cmd, *relocation.image, *relocation.entry->image);
+		}
+
+		for (auto &relocation : relocations)
+		{
+			if (!relocation.image)
+				continue;
+
+			auto &src = *relocation.entry->image;
+			auto &dst = *relocation.image;
+			cmd->image_barrier(src, src.get_layout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL), relocation.entry->layout,
+			                   VK_PIPELINE_STAGE_2_COPY_BIT, 0,
+			                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0);
+			cmd->image_barrier(dst, dst.get_layout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL), relocation.entry->layout,
+			                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			                   VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+		}
+
+		cmd->barrier(VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		             VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+		device.submit(cmd);
+
+		// The old resources are released through deferred deletion once the copies are done with them.
+		for (auto &relocation : relocations)
+		{
+			auto &entry = *relocation.entry;
+			if (relocation.buffer)
+			{
+				entry.buffer = std::move(relocation.buffer);
+				if (entry.rebind_buffer)
+					entry.rebind_buffer(entry.buffer);
+			}
+			else
+			{
+				entry.image = std::move(relocation.image);
+				if (entry.rebind_image)
+					entry.rebind_image(entry.image);
+			}
+		}
+	}
+
+	if (move_index >= moves.size())
+	{
+		end_pass();
+		return false;
+	}
+
+	return true;
+}
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "buffer.hpp"
+#include "image.hpp"
+#include "defragmentation_planner.hpp"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace Vulkan
+{
+class Device;
+
+// Incrementally compacts sparsely used VkDeviceMemory blocks.
+// Only resources registered here are relocatable. A relocation creates a replacement resource
+// outside the blocks being evacuated, copies the contents on the graphics queue and hands the
+// replacement to the rebind callback. Anything derived from the old resource (views, descriptors,
+// device addresses) must be refreshed by the owner. The old resource is released through the
+// regular deferred deletion, and evacuated blocks are freed once their last allocation is gone.
+class MemoryDefragmenter
+{
+public:
+	explicit MemoryDefragmenter(Device &device);
+	~MemoryDefragmenter();
+
+	MemoryDefragmenter(const MemoryDefragmenter &) = delete;
+	void operator=(const MemoryDefragmenter &) = delete;
+
+	using BufferRebindFunc = std::function<void (const BufferHandle &)>;
+	using ImageRebindFunc = std::function<void (const ImageHandle &)>;
+
+	// The defragmenter holds a reference until the resource is unregistered.
+	uint64_t register_buffer(BufferHandle buffer, BufferRebindFunc rebind);
+	// Image must be created with TRANSFER_SRC usage and be in `layout` whenever command buffers are submitted.
+	uint64_t register_image(ImageHandle image, VkImageLayout layout, ImageRebindFunc rebind);
+	void unregister(uint64_t id);
+
+	void set_options(const Util::DefragmentationOptions &options);
+	const Util::DefragmentationOptions &get_options() const;
+
+	// Per memory heap, sized for VK_MAX_MEMORY_HEAPS.
+	void get_fragmentation_stats(Util::FragmentationStats *stats);
+
+	// Selects blocks to evacuate and plans moves.
+	// Returns false if there is nothing worth moving.
+	bool begin_pass();
+
+	// Relocates at most max_bytes_per_step worth of resources. Intended to be called once per frame,
+	// before any command buffer which uses registered resources is requested.
+	// Returns true while the pass has remaining work.
+	bool step();
+
+	// Abandons remaining moves. Partially evacuated blocks are used for allocation again.
+	void end_pass();
+
+	bool is_pass_active() const
+	{
+		return active;
+	}
+
+private:
+	Device &device;
+	Util::DefragmentationPlanner planner;
+
+	struct Entry
+	{
+		BufferHandle buffer;
+		ImageHandle image;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		BufferRebindFunc rebind_buffer;
+		ImageRebindFunc rebind_image;
+	};
+
+	std::unordered_map<uint64_t, Entry> entries;
+	uint64_t next_id = 1;
+
+	std::vector<uint64_t> blocks;
+	std::vector<Util::DefragmentationMove> moves;
+	size_t move_index = 0;
+	bool active = false;
+
+	bool is_relocatable(const Entry &entry) const;
+	const DeviceAllocation &get_allocation(const Entry &entry) const;
+	BufferHandle create_replacement(const Buffer &buffer);
+	ImageHandle create_replacement(const Image &image);
+};
+}
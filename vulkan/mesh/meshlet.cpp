@@ -54,36 +54,48 @@ MeshView create_mesh_view(const Granite::FileMapping &mapping)
 	view.format_header = reinterpret_cast<const FormatHeader *>(ptr);
 	ptr += sizeof(*view.format_header);
 
-	if (end_ptr - ptr < ptrdiff_t(view.format_header->meshlet_count * sizeof(Bound)))
+	auto &header = *view.format_header;
+	if (header.base_meshlet_count > header.meshlet_count)
+		return {};
+
+	if (end_ptr - ptr < ptrdiff_t(header.meshlet_count * sizeof(Bound)))
 		return {};
 	view.bounds = reinterpret_cast<const Bound *>(ptr);
-	ptr += view.format_header->meshlet_count * sizeof(Bound);
+	ptr += header.meshlet_count * sizeof(Bound);
 
-	size_t num_bounds_256 = (view.format_header->meshlet_count + ChunkFactor - 1) / ChunkFactor;
+	size_t num_bounds_256 = (header.meshlet_count + ChunkFactor - 1) / ChunkFactor;
 
 	if (end_ptr - ptr < ptrdiff_t(num_bounds_256 * sizeof(Bound)))
 		return {};
 	view.bounds_256 = reinterpret_cast<const Bound *>(ptr);
 	ptr += num_bounds_256 * sizeof(Bound);
 
-	view.num_bounds = view.format_header->meshlet_count;
-	view.num_bounds_256 = num_bounds_256;
+	if (end_ptr - ptr < ptrdiff_t(header.meshlet_count * sizeof(LODBound)))
+		return {};
+	view.lod_bounds = reinterpret_cast<const LODBound *>(ptr);
+	ptr += header.meshlet_count * sizeof(LODBound);
+
+	// Runtimes which do not select a LOD cut only observe the full detail level.
+	view.num_bounds = header.base_meshlet_count;
+	view.num_bounds_256 = (header.base_meshlet_count + ChunkFactor - 1) / ChunkFactor;
+	view.num_lod_bounds = header.meshlet_count;
+	view.num_lod_bounds_256 = num_bounds_256;
 
-	if (end_ptr - ptr < ptrdiff_t(view.format_header->meshlet_count * view.format_header->stream_count * sizeof(Stream)))
+	if (end_ptr - ptr < ptrdiff_t(header.meshlet_count * header.stream_count * sizeof(Stream)))
 		return {};
 	view.streams = reinterpret_cast<const Stream *>(ptr);
-	ptr += view.format_header->meshlet_count * view.format_header->stream_count * sizeof(Stream);
+	ptr += header.meshlet_count * header.stream_count * sizeof(Stream);
 
-	if (!view.format_header->payload_size_words)
+	if (!header.payload_size_words)
 		return {};
 
-	if (end_ptr - ptr < ptrdiff_t(view.format_header->payload_size_words * sizeof(PayloadWord)))
+	if (end_ptr - ptr < ptrdiff_t(header.payload_size_words * sizeof(PayloadWord)))
 		return {};
 	view.payload = reinterpret_cast<const PayloadWord *>(ptr);
 
-	for (uint32_t i = 0, n = view.format_header->meshlet_count; i < n; i++)
+	for (uint32_t i = 0, n = view.num_bounds; i < n; i++)
 	{
-		auto counts = view.streams[i * view.format_header->stream_count].u.counts;
+		auto counts = view.streams[i * header.stream_count].u.counts;
 		view.total_primitives += counts.prim_count;
 		view.total_vertices += counts.vert_count;
 	}
@@ -96,7 +108,7 @@ static void upload_indirect_buffer(CommandBuffer &cmd, const Vulkan::Buffer &ind
                                    uint32_t global_prim_offset, uint32_t global_vert_offset)
 {
 	size_t total_padded_meshlets = view.num_bounds_256 * ChunkFactor;
-	size_t total_meshlets = view.format_header->meshlet_count;
+	size_t total_meshlets = view.num_bounds;
 
 	uint32_t prim_offset = global_prim_offset;
 	uint32_t vert_offset = global_vert_offset;
@@ -180,7 +192,7 @@ bool decode_mesh(CommandBuffer &cmd, const DecodeInfo &info, const MeshView &vie
 	buf_info.domain = BufferDomain::LinkedDeviceHost;
 	buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
-	buf_info.size = view.format_header->meshlet_count * view.format_header->stream_count * sizeof(*view.streams);
+	buf_info.size = view.num_bounds * view.format_header->stream_count * sizeof(*view.streams);
 	auto meshlet_stream_buffer = cmd.get_device().create_buffer(buf_info, view.streams);
 
 	bool meshlet_runtime = info.runtime_style == RuntimeStyle::Meshlet;
@@ -216,8 +228,8 @@ bool decode_mesh(CommandBuffer &cmd, const DecodeInfo &info, const MeshView &vie
 	std::vector<Offsets> decode_offsets;
 	Offsets offsets = {};
 
-	decode_offsets.reserve(view.format_header->meshlet_count);
-	for (uint32_t i = 0; i < view.format_header->meshlet_count; i++)
+	decode_offsets.reserve(view.num_bounds);
+	for (uint32_t i = 0; i < view.num_bounds; i++)
 	{
 		if (info.runtime_style == RuntimeStyle::MDI && (info.flags & DECODE_MODE_UNROLLED_MESH) == 0)
 		{
@@ -242,7 +254,7 @@ bool decode_mesh(CommandBuffer &cmd, const DecodeInfo &info, const MeshView &vie
 
 	cmd.set_storage_buffer(0, 6, *output_offsets_buffer);
 
-	uint32_t wg_x = (view.format_header->meshlet_count + 7) / 8;
+	uint32_t wg_x = (view.num_bounds + 7) / 8;
 
 	struct Push
 	{
@@ -254,7 +266,7 @@ bool decode_mesh(CommandBuffer &cmd, const DecodeInfo &info, const MeshView &vie
 
 	push.primitive_offset = info.push.primitive_offset;
 	push.vertex_offset = info.push.vertex_offset;
-	push.meshlet_count = view.format_header->meshlet_count;
+	push.meshlet_count = view.num_bounds;
 	push.wg_offset = 0;
 
 	const uint32_t max_wgx = cmd.get_device().get_gpu_properties().limits.maxComputeWorkGroupCount[0];
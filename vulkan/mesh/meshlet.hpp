@@ -83,6 +83,22 @@ struct Bound
 	float cone_axis_cutoff[4];
 };
 
+// Per-meshlet LOD information for the cluster hierarchy.
+// A meshlet is part of the selected cut if its own error is acceptable, but its parent's error is not.
+// Error values are in object space and should be projected with their respective spheres.
+// All meshlets generated from the same cluster group share the same sphere and error.
+struct LODBound
+{
+	float center[3];
+	float radius;
+	float parent_center[3];
+	float parent_radius;
+	float error;
+	float parent_error;
+	uint32_t level;
+	uint32_t padding;
+};
+
 enum class StreamType
 {
 	Primitive = 0, // RGB8_UINT (fixed 5-bit encoding, fixed base value of 0)
@@ -106,6 +122,10 @@ struct FormatHeader
 	uint32_t stream_count;
 	uint32_t meshlet_count;
 	uint32_t payload_size_words;
+	// Full detail meshlets are always placed first.
+	// Every LOD level starts on a ChunkFactor aligned meshlet index.
+	uint32_t base_meshlet_count;
+	uint32_t lod_level_count;
 };
 
 using PayloadWord = uint32_t;
@@ -115,15 +135,20 @@ struct MeshView
 	const FormatHeader *format_header;
 	const Bound *bounds;
 	const Bound *bounds_256;
+	const LODBound *lod_bounds;
 	const Stream *streams;
 	const PayloadWord *payload;
+	// Only covers the full detail level.
 	uint32_t total_primitives;
 	uint32_t total_vertices;
 	uint32_t num_bounds;
 	uint32_t num_bounds_256;
+	// Covers every meshlet in the LOD hierarchy.
+	uint32_t num_lod_bounds;
+	uint32_t num_lod_bounds_256;
 };
 
-static const char magic[8] = { 'M', 'E', 'S', 'H', 'L', 'E', 'T', '4' };
+static const char magic[8] = { 'M', 'E', 'S', 'H', 'L', 'E', 'T', '5' };
 
 MeshView create_mesh_view(const Granite::FileMapping &mapping);
 
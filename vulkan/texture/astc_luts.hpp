@@ -0,0 +1,81 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Granite
+{
+// Lookup tables shared by the ASTC compute decoder and the CPU fallback decoder.
+constexpr size_t astc_num_quantization_modes = 17;
+constexpr size_t astc_num_weight_modes = 16;
+
+struct ASTCLutHolder
+{
+	ASTCLutHolder();
+
+	void init_color_endpoint();
+	void init_weight_luts();
+	void init_trits_quints();
+
+	struct
+	{
+		size_t unquant_offset = 0;
+		uint8_t unquant_lut[2048];
+		uint16_t lut[9][128][4];
+		size_t unquant_lut_offsets[astc_num_quantization_modes];
+	} color_endpoint;
+
+	struct
+	{
+		size_t unquant_offset = 0;
+		uint8_t unquant_lut[2048];
+		uint8_t lut[astc_num_weight_modes][4];
+	} weights;
+
+	struct
+	{
+		uint16_t trits_quints[256 + 128];
+	} integer;
+
+	struct PartitionTable
+	{
+		PartitionTable() = default;
+		PartitionTable(unsigned width, unsigned height);
+		std::vector<uint8_t> lut_buffer;
+		unsigned lut_width = 0;
+		unsigned lut_height = 0;
+	};
+
+	std::mutex table_lock;
+	std::unordered_map<unsigned, PartitionTable> tables;
+
+	PartitionTable &get_partition_table(unsigned width, unsigned height);
+};
+
+ASTCLutHolder &get_astc_luts();
+}
@@ -0,0 +1,3553 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "texture_decoder_cpu.hpp"
+#include "astc_luts.hpp"
+#include "thread_group.hpp"
+#include "logging.hpp"
+#include "muglm/muglm_impl.hpp"
+#include "simd_headers.hpp"
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || (defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define CPU_DECODER_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define CPU_DECODER_SIMD_NEON 1
+#endif
+
+// Straight ports of the compute decoders in assets/shaders/decode/.
+// The decoders work on one block at a time and keep the structure of the shaders,
+// so that a fix on either side can be carried over to the other.
+
+using namespace muglm;
+
+namespace Granite
+{
+namespace
+{
+// Blocks are decoded into one of these before being copied to the output,
+// which takes care of partial blocks on the right and bottom edges.
+struct DecodedBlock
+{
+	union
+	{
+		uint8_t rgba8[12 * 12][4];
+		uint16_t rgba16[12 * 12][4];
+	};
+};
+
+// Payloads are padded with an extra zero word, since extract_bits() may read one word past the
+// 128-bit payload for bit ranges which straddle the end.
+struct BlockPayload
+{
+	uint32_t words[5];
+};
+}
+
+static inline uint32_t bitfield_extract(uint32_t v, int offset, int bits)
+{
+	if (bits <= 0)
+		return 0;
+	if (bits >= 32)
+		return v >> offset;
+	return (v >> offset) & ((1u << bits) - 1u);
+}
+
+static inline int bitfield_extract_signed(int v, int offset, int bits)
+{
+	if (bits <= 0)
+		return 0;
+	return int(uint32_t(v) << (32 - offset - bits)) >> (32 - bits);
+}
+
+static inline uint32_t bitfield_reverse(uint32_t v)
+{
+	v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+	v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+	v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+	v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+	return (v >> 16) | (v << 16);
+}
+
+static inline int bit_count(uint32_t v)
+{
+	int count = 0;
+	for (; v; v &= v - 1)
+		count++;
+	return count;
+}
+
+static inline int find_lsb(uint32_t v)
+{
+	if (!v)
+		return -1;
+	int lsb = 0;
+	while ((v & 1u) == 0)
+	{
+		v >>= 1;
+		lsb++;
+	}
+	return lsb;
+}
+
+static inline int find_msb(int v)
+{
+	if (v <= 0)
+		return -1;
+	int msb = 0;
+	while (v >>= 1)
+		msb++;
+	return msb;
+}
+
+static int extract_bits(const uint32_t *payload, int offset, int bits)
+{
+	if (bits <= 0 || offset < 0 || offset >= 128)
+		return 0;
+
+	int last_offset = offset + bits - 1;
+	if ((last_offset >> 5) == (offset >> 5))
+		return int(bitfield_extract(payload[offset >> 5], offset & 31, bits));
+
+	int first_bits = 32 - (offset & 31);
+	uint32_t result_first = bitfield_extract(payload[offset >> 5], offset & 31, first_bits);
+	uint32_t result_second = bitfield_extract(payload[(offset >> 5) + 1], 0, bits - first_bits);
+	return int(result_first | (result_second << first_bits));
+}
+
+static int extract_bits_sign(const uint32_t *payload, int offset, int bits)
+{
+	if (bits <= 0 || offset < 0 || offset >= 128)
+		return 0;
+
+	int last_offset = offset + bits - 1;
+	if ((last_offset >> 5) == (offset >> 5))
+		return bitfield_extract_signed(int(payload[offset >> 5]), offset & 31, bits);
+
+	int first_bits = 32 - (offset & 31);
+	uint32_t result_first = bitfield_extract(payload[offset >> 5], offset & 31, first_bits);
+	int result_second = bitfield_extract_signed(int(payload[(offset >> 5) + 1]), 0, bits - first_bits);
+	return int(result_first | uint32_t(result_second << first_bits));
+}
+
+static int extract_bits_reverse(const uint32_t *payload, int offset, int bits)
+{
+	if (bits <= 0 || offset < 0 || offset >= 128)
+		return 0;
+
+	int last_offset = offset + bits - 1;
+	uint32_t result;
+	if ((last_offset >> 5) == (offset >> 5))
+		result = bitfield_extract(payload[offset >> 5], offset & 31, bits);
+	else
+	{
+		int first_bits = 32 - (offset & 31);
+		uint32_t result_first = bitfield_extract(payload[offset >> 5], offset & 31, first_bits);
+		uint32_t result_second = bitfield_extract(payload[(offset >> 5) + 1], 0, bits - first_bits);
+		result = result_first | (result_second << first_bits);
+	}
+	return int(bitfield_reverse(result) >> (32 - bits));
+}
+
+static inline uint8_t float_to_unorm8(float v)
+{
+	v = std::min(std::max(v, 0.0f), 1.0f);
+	return uint8_t(v * 255.0f + 0.5f);
+}
+
+// Storage image writes to FP16 round to nearest even,
+// muglm::floatToHalf() rounds ties away from zero, so we need our own.
+static uint16_t float_to_half_rtne(float v)
+{
+	uint32_t u;
+	memcpy(&u, &v, sizeof(u));
+
+	uint32_t sign = (u >> 16) & 0x8000u;
+	uint32_t abs_u = u & 0x7fffffffu;
+
+	if (abs_u >= 0x7f800000u)
+		return uint16_t(sign | 0x7c00u | (abs_u > 0x7f800000u ? 0x200u : 0u));
+	if (abs_u >= 0x477ff000u)
+		return uint16_t(sign | 0x7c00u);
+
+	if (abs_u < 0x38800000u)
+	{
+		// Denormal or zero. Add the implicit one and shift into place with RTNE.
+		if (abs_u < 0x33000000u)
+			return uint16_t(sign);
+		uint32_t mantissa = (abs_u & 0x7fffffu) | 0x800000u;
+		int shift = 126 - int(abs_u >> 23);
+		uint32_t result = mantissa >> shift;
+		uint32_t rem = mantissa & ((1u << shift) - 1u);
+		uint32_t half_point = 1u << (shift - 1);
+		if (rem > half_point || (rem == half_point && (result & 1u)))
+			result++;
+		return uint16_t(sign | result);
+	}
+
+	uint32_t rebased = abs_u - 0x38000000u;
+	uint32_t result = rebased >> 13;
+	uint32_t rem = rebased & 0x1fffu;
+	if (rem > 0x1000u || (rem == 0x1000u && (result & 1u)))
+		result++;
+	return uint16_t(sign | result);
+}
+
+// S3TC / RGTC
+// Every texel of a block is one of a few palette entries. The palette is built once per block with the same
+// float math as the shaders, and texels are expanded 16 at a time, with SIMD where available.
+// Palettes and indices are kept in registers, since going through small arrays stalls on store forwarding.
+// Selects 16 bytes out of a palette with 8 entries, returned as two little-endian words.
+static inline void expand_rgtc_indices(uint64_t &lo, uint64_t &hi, uint64_t palette, const uint32_t *payload)
+{
+	uint64_t indices = (uint64_t(payload[0]) >> 16) | (uint64_t(payload[1]) << 16);
+	lo = 0;
+	hi = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		lo |= ((palette >> (8 * ((indices >> (3 * i)) & 7))) & 0xff) << (8 * i);
+		hi |= ((palette >> (8 * ((indices >> (3 * i + 24)) & 7))) & 0xff) << (8 * i);
+	}
+}
+
+#if CPU_DECODER_SIMD_SSE2
+static inline __m128i float_to_unorm8(__m128 v)
+{
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+static inline __m128 mix(__m128 a, __m128 b, __m128 one_minus_lerp, __m128 lerp)
+{
+	return _mm_add_ps(_mm_mul_ps(a, one_minus_lerp), _mm_mul_ps(b, lerp));
+}
+
+static uint64_t build_rgtc_palette(const uint32_t *payload)
+{
+	float ep0 = float(int(payload[0] & 0xffu)) / 255.0f;
+	float ep1 = float((payload[0] >> 8) & 0xffu) / 255.0f;
+	__m128 vep0 = _mm_set1_ps(ep0);
+	__m128 vep1 = _mm_set1_ps(ep1);
+
+	// Endpoints themselves fall out of the lerp with weights of 0 and 1 exactly.
+	__m128 lo, hi;
+	if (ep0 > ep1)
+	{
+		const float t[8] = {
+			0.0f, 1.0f,
+			(1.0f / 7.0f) * 1.0f, (1.0f / 7.0f) * 2.0f, (1.0f / 7.0f) * 3.0f,
+			(1.0f / 7.0f) * 4.0f, (1.0f / 7.0f) * 5.0f, (1.0f / 7.0f) * 6.0f,
+		};
+		lo = mix(vep0, vep1, _mm_setr_ps(1.0f - t[0], 1.0f - t[1], 1.0f - t[2], 1.0f - t[3]),
+		         _mm_setr_ps(t[0], t[1], t[2], t[3]));
+		hi = mix(vep0, vep1, _mm_setr_ps(1.0f - t[4], 1.0f - t[5], 1.0f - t[6], 1.0f - t[7]),
+		         _mm_setr_ps(t[4], t[5], t[6], t[7]));
+	}
+	else
+	{
+		const float t[6] = {
+			0.0f, 1.0f,
+			(1.0f / 5.0f) * 1.0f, (1.0f / 5.0f) * 2.0f, (1.0f / 5.0f) * 3.0f, (1.0f / 5.0f) * 4.0f,
+		};
+		lo = mix(vep0, vep1, _mm_setr_ps(1.0f - t[0], 1.0f - t[1], 1.0f - t[2], 1.0f - t[3]),
+		         _mm_setr_ps(t[0], t[1], t[2], t[3]));
+		hi = mix(vep0, vep1, _mm_setr_ps(1.0f - t[4], 1.0f - t[5], 0.0f, 0.0f),
+		         _mm_setr_ps(t[4], t[5], 0.0f, 0.0f));
+		hi = _mm_or_ps(_mm_and_ps(hi, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, 0, 0))),
+		               _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	__m128i bytes = _mm_packs_epi32(float_to_unorm8(lo), float_to_unorm8(hi));
+	bytes = _mm_packus_epi16(bytes, bytes);
+
+	uint64_t palette;
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(&palette), bytes);
+	return palette;
+}
+
+// SSSE3 shuffles are not part of the baseline, so palette lookups are compare and select.
+static void decode_s3tc_color(uint8_t (*rgba)[4], uint32_t color0, uint32_t color1, uint32_t selectors,
+                              bool opaque_mode, bool punch_through_alpha)
+{
+	const __m128 scale = _mm_setr_ps(31.0f, 63.0f, 31.0f, 1.0f);
+	__m128 ep0 = _mm_div_ps(_mm_cvtepi32_ps(_mm_setr_epi32(
+			int((color0 >> 11) & 31), int((color0 >> 5) & 63), int(color0 & 31), 1)), scale);
+	__m128 ep1 = _mm_div_ps(_mm_cvtepi32_ps(_mm_setr_epi32(
+			int((color1 >> 11) & 31), int((color1 >> 5) & 63), int(color1 & 31), 1)), scale);
+
+	__m128 ep2, ep3;
+	if (opaque_mode)
+	{
+		const float t2 = 1.0f / 3.0f;
+		const float t3 = (1.0f / 3.0f) * 2.0f;
+		ep2 = mix(ep0, ep1, _mm_set1_ps(1.0f - t2), _mm_set1_ps(t2));
+		ep3 = mix(ep0, ep1, _mm_set1_ps(1.0f - t3), _mm_set1_ps(t3));
+	}
+	else
+	{
+		ep2 = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_add_ps(ep0, ep1));
+		ep3 = _mm_setzero_ps();
+	}
+
+	__m128i palette = _mm_packus_epi16(_mm_packs_epi32(float_to_unorm8(ep0), float_to_unorm8(ep1)),
+	                                   _mm_packs_epi32(float_to_unorm8(ep2), float_to_unorm8(ep3)));
+
+	// Alpha is either opaque, or zero for the punch-through entry.
+	bool transparent = !opaque_mode && punch_through_alpha;
+	palette = _mm_or_si128(_mm_and_si128(palette, _mm_set1_epi32(0x00ffffff)),
+	                       _mm_setr_epi32(int(0xff000000u), int(0xff000000u), int(0xff000000u),
+	                                      transparent ? 0 : int(0xff000000u)));
+
+	// Each lane looks at its own 2-bit selector in place, so no per-lane shifts are needed.
+	const __m128i sel1 = _mm_setr_epi32(1 << 0, 1 << 2, 1 << 4, 1 << 6);
+	const __m128i sel2 = _mm_setr_epi32(2 << 0, 2 << 2, 2 << 4, 2 << 6);
+	const __m128i sel3 = _mm_setr_epi32(3 << 0, 3 << 2, 3 << 4, 3 << 6);
+	const __m128i p0 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(0, 0, 0, 0));
+	const __m128i p1 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(1, 1, 1, 1));
+	const __m128i p2 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(2, 2, 2, 2));
+	const __m128i p3 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(3, 3, 3, 3));
+	auto *ptr = reinterpret_cast<__m128i *>(rgba[0]);
+
+	for (int i = 0; i < 4; i++)
+	{
+		__m128i sel = _mm_and_si128(_mm_set1_epi32(int(selectors >> (8 * i))), sel3);
+		__m128i c01 = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi32(sel, _mm_setzero_si128()), p0),
+		                           _mm_and_si128(_mm_cmpeq_epi32(sel, sel1), p1));
+		__m128i c23 = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi32(sel, sel2), p2),
+		                           _mm_and_si128(_mm_cmpeq_epi32(sel, sel3), p3));
+		_mm_storeu_si128(ptr + i, _mm_or_si128(c01, c23));
+	}
+}
+
+static inline __m128i load_channel(uint64_t lo, uint64_t hi)
+{
+	return _mm_set_epi64x(int64_t(hi), int64_t(lo));
+}
+
+static inline void insert_alpha(uint8_t (*rgba)[4], __m128i a)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgb_mask = _mm_set1_epi32(0x00ffffff);
+	__m128i lo = _mm_unpacklo_epi8(zero, a);
+	__m128i hi = _mm_unpackhi_epi8(zero, a);
+	const __m128i a32[4] = {
+		_mm_unpacklo_epi16(zero, lo), _mm_unpackhi_epi16(zero, lo),
+		_mm_unpacklo_epi16(zero, hi), _mm_unpackhi_epi16(zero, hi),
+	};
+
+	auto *ptr = reinterpret_cast<__m128i *>(rgba[0]);
+	for (int i = 0; i < 4; i++)
+		_mm_storeu_si128(ptr + i, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(ptr + i), rgb_mask), a32[i]));
+}
+
+static inline void insert_alpha(uint8_t (*rgba)[4], uint64_t lo, uint64_t hi)
+{
+	insert_alpha(rgba, load_channel(lo, hi));
+}
+
+// BC2 alpha is 4-bit, and n / 15 in unorm8 is exactly n * 17.
+static inline void insert_alpha_4bit(uint8_t (*rgba)[4], const uint32_t *payload)
+{
+	const __m128i nibble_mask = _mm_set1_epi8(0xf);
+	__m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(payload));
+	__m128i a = _mm_unpacklo_epi8(_mm_and_si128(packed, nibble_mask),
+	                              _mm_and_si128(_mm_srli_epi16(packed, 4), nibble_mask));
+	insert_alpha(rgba, _mm_or_si128(a, _mm_slli_epi16(a, 4)));
+}
+
+static inline void interleave_rg(uint8_t (*rgba)[4], uint64_t r_lo, uint64_t r_hi, uint64_t g_lo, uint64_t g_hi)
+{
+	const __m128i ba = _mm_set1_epi16(int16_t(0xff00));
+	__m128i r = load_channel(r_lo, r_hi);
+	__m128i g = load_channel(g_lo, g_hi);
+	__m128i lo = _mm_unpacklo_epi8(r, g);
+	__m128i hi = _mm_unpackhi_epi8(r, g);
+	auto *ptr = reinterpret_cast<__m128i *>(rgba[0]);
+	_mm_storeu_si128(ptr + 0, _mm_unpacklo_epi16(lo, ba));
+	_mm_storeu_si128(ptr + 1, _mm_unpackhi_epi16(lo, ba));
+	_mm_storeu_si128(ptr + 2, _mm_unpacklo_epi16(hi, ba));
+	_mm_storeu_si128(ptr + 3, _mm_unpackhi_epi16(hi, ba));
+}
+#else
+static void decode_s3tc_endpoint_color(float *rgb, uint32_t color)
+{
+	rgb[0] = float((color >> 11) & 31) / 31.0f;
+	rgb[1] = float((color >> 5) & 63) / 63.0f;
+	rgb[2] = float((color >> 0) & 31) / 31.0f;
+}
+
+static uint64_t build_rgtc_palette(const uint32_t *payload)
+{
+	float ep0 = float(int(payload[0] & 0xffu)) / 255.0f;
+	float ep1 = float((payload[0] >> 8) & 0xffu) / 255.0f;
+	bool range7 = ep0 > ep1;
+
+	uint64_t palette = 0;
+	for (uint32_t bits = 0; bits < 8; bits++)
+	{
+		float res;
+
+		if (bits < 2)
+			res = bits != 0 ? ep1 : ep0;
+		else if (range7)
+			res = muglm::mix(ep0, ep1, (1.0f / 7.0f) * float(bits - 1));
+		else if (bits > 5)
+			res = float(bits & 1);
+		else
+			res = muglm::mix(ep0, ep1, (1.0f / 5.0f) * float(bits - 1));
+
+		palette |= uint64_t(float_to_unorm8(res)) << (8 * bits);
+	}
+
+	return palette;
+}
+
+static void build_s3tc_palette(uint32_t *palette, uint32_t color0, uint32_t color1,
+                               bool opaque_mode, bool punch_through_alpha)
+{
+	float ep0[3], ep1[3];
+	decode_s3tc_endpoint_color(ep0, color0);
+	decode_s3tc_endpoint_color(ep1, color1);
+
+	for (int bits = 0; bits < 4; bits++)
+	{
+		float rgba[4] = {};
+
+		if (opaque_mode)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				if (bits < 2)
+					rgba[c] = bits != 0 ? ep1[c] : ep0[c];
+				else
+					rgba[c] = muglm::mix(ep0[c], ep1[c], (1.0f / 3.0f) * float(bits - 1));
+			}
+			rgba[3] = 1.0f;
+		}
+		else if (bits != 3)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				if (bits == 0)
+					rgba[c] = ep0[c];
+				else if (bits == 1)
+					rgba[c] = ep1[c];
+				else
+					rgba[c] = 0.5f * (ep0[c] + ep1[c]);
+			}
+			rgba[3] = 1.0f;
+		}
+
+		if (!punch_through_alpha)
+			rgba[3] = 1.0f;
+
+		palette[bits] = 0;
+		for (int c = 0; c < 4; c++)
+			palette[bits] |= uint32_t(float_to_unorm8(rgba[c])) << (8 * c);
+	}
+}
+#endif
+
+#if CPU_DECODER_SIMD_NEON
+static void decode_s3tc_color(uint8_t (*rgba)[4], uint32_t color0, uint32_t color1, uint32_t selectors,
+                              bool opaque_mode, bool punch_through_alpha)
+{
+	uint32_t palette[4];
+	build_s3tc_palette(palette, color0, color1, opaque_mode, punch_through_alpha);
+
+	uint8x16_t table = vreinterpretq_u8_u64(vcombine_u64(
+			vcreate_u64(uint64_t(palette[0]) | (uint64_t(palette[1]) << 32)),
+			vcreate_u64(uint64_t(palette[2]) | (uint64_t(palette[3]) << 32))));
+	const int32_t lane_shifts[4] = { 0, -2, -4, -6 };
+	int32x4_t shifts = vld1q_s32(lane_shifts);
+
+	for (int texel = 0; texel < 16; texel += 4)
+	{
+		uint32x4_t sel = vandq_u32(vshlq_u32(vdupq_n_u32(selectors >> (2 * texel)), shifts), vdupq_n_u32(3));
+		// Entry i occupies bytes 4 * i to 4 * i + 3 of the table.
+		uint32x4_t offsets = vmlaq_n_u32(vdupq_n_u32(0x03020100), sel, 0x04040404);
+		vst1q_u8(rgba[texel], vqtbl1q_u8(table, vreinterpretq_u8_u32(offsets)));
+	}
+}
+
+static inline uint8x16_t load_channel(uint64_t lo, uint64_t hi)
+{
+	return vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(lo), vcreate_u64(hi)));
+}
+
+static inline void insert_alpha(uint8_t (*rgba)[4], uint8x16_t a)
+{
+	uint8x16x4_t v = vld4q_u8(rgba[0]);
+	v.val[3] = a;
+	vst4q_u8(rgba[0], v);
+}
+
+static inline void insert_alpha(uint8_t (*rgba)[4], uint64_t lo, uint64_t hi)
+{
+	insert_alpha(rgba, load_channel(lo, hi));
+}
+
+// BC2 alpha is 4-bit, and n / 15 in unorm8 is exactly n * 17.
+static inline void insert_alpha_4bit(uint8_t (*rgba)[4], const uint32_t *payload)
+{
+	uint8x8_t packed = vreinterpret_u8_u32(vld1_u32(payload));
+	uint8x8x2_t nibbles = vzip_u8(vand_u8(packed, vdup_n_u8(0xf)), vshr_n_u8(packed, 4));
+	uint8x16_t a = vcombine_u8(nibbles.val[0], nibbles.val[1]);
+	insert_alpha(rgba, vmulq_u8(a, vdupq_n_u8(17)));
+}
+
+static inline void interleave_rg(uint8_t (*rgba)[4], uint64_t r_lo, uint64_t r_hi, uint64_t g_lo, uint64_t g_hi)
+{
+	uint8x16x4_t v;
+	v.val[0] = load_channel(r_lo, r_hi);
+	v.val[1] = load_channel(g_lo, g_hi);
+	v.val[2] = vdupq_n_u8(0);
+	v.val[3] = vdupq_n_u8(0xff);
+	vst4q_u8(rgba[0], v);
+}
+#elif !CPU_DECODER_SIMD_SSE2
+static void decode_s3tc_color(uint8_t (*rgba)[4], uint32_t color0, uint32_t color1, uint32_t selectors,
+                              bool opaque_mode, bool punch_through_alpha)
+{
+	uint32_t palette[4];
+	build_s3tc_palette(palette, color0, color1, opaque_mode, punch_through_alpha);
+
+	for (int i = 0; i < 16; i++)
+	{
+		uint32_t v = palette[(selectors >> (2 * i)) & 3];
+		for (int c = 0; c < 4; c++)
+			rgba[i][c] = uint8_t(v >> (8 * c));
+	}
+}
+
+static inline void insert_alpha(uint8_t (*rgba)[4], uint64_t lo, uint64_t hi)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		rgba[i][3] = uint8_t(lo >> (8 * i));
+		rgba[i + 8][3] = uint8_t(hi >> (8 * i));
+	}
+}
+
+static inline void insert_alpha_4bit(uint8_t (*rgba)[4], const uint32_t *payload)
+{
+	for (int i = 0; i < 16; i++)
+		rgba[i][3] = uint8_t(((payload[i >> 3] >> (4 * (i & 7))) & 0xf) * 17);
+}
+
+static inline void interleave_rg(uint8_t (*rgba)[4], uint64_t r_lo, uint64_t r_hi, uint64_t g_lo, uint64_t g_hi)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		rgba[i][0] = uint8_t(r_lo >> (8 * i));
+		rgba[i][1] = uint8_t(g_lo >> (8 * i));
+		rgba[i + 8][0] = uint8_t(r_hi >> (8 * i));
+		rgba[i + 8][1] = uint8_t(g_hi >> (8 * i));
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		rgba[i][2] = 0;
+		rgba[i][3] = 0xff;
+	}
+}
+#endif
+
+static void decode_s3tc_block(DecodedBlock &block, const uint32_t *payload, bool use_alpha, int bc_version)
+{
+	const uint32_t *color_payload = bc_version == 1 ? payload : payload + 2;
+	uint32_t color0 = color_payload[0] & 0xffffu;
+	uint32_t color1 = color_payload[0] >> 16u;
+	bool opaque_mode = bc_version > 1 || color0 > color1;
+
+	decode_s3tc_color(block.rgba8, color0, color1, color_payload[1], opaque_mode, use_alpha && bc_version == 1);
+
+	if (use_alpha && bc_version == 2)
+	{
+		insert_alpha_4bit(block.rgba8, payload);
+	}
+	else if (use_alpha && bc_version == 3)
+	{
+		uint64_t lo, hi;
+		expand_rgtc_indices(lo, hi, build_rgtc_palette(payload), payload);
+		insert_alpha(block.rgba8, lo, hi);
+	}
+}
+
+static void decode_rgtc_block(DecodedBlock &block, const uint32_t *payload, bool dual_component)
+{
+	uint64_t r_lo, r_hi, g_lo = 0, g_hi = 0;
+	expand_rgtc_indices(r_lo, r_hi, build_rgtc_palette(payload), payload);
+	if (dual_component)
+		expand_rgtc_indices(g_lo, g_hi, build_rgtc_palette(payload + 2), payload + 2);
+	interleave_rg(block.rgba8, r_lo, r_hi, g_lo, g_hi);
+}
+
+// ETC2 / EAC
+static inline uint32_t flip_endian(uint32_t v)
+{
+	return ((v & 0xffu) << 24u) | (((v >> 8u) & 0xffu) << 16u) | (((v >> 16u) & 0xffu) << 8u) | (v >> 24u);
+}
+
+static const int etc1_color_modifier_table[8][2] = {
+	{ 2, 8 },
+	{ 5, 17 },
+	{ 9, 29 },
+	{ 13, 42 },
+	{ 18, 60 },
+	{ 24, 80 },
+	{ 33, 106 },
+	{ 47, 183 },
+};
+
+static const int etc2_alpha_modifier_table[16][4] = {
+	{ 2, 5, 8, 14 },
+	{ 2, 6, 9, 12 },
+	{ 1, 4, 7, 12 },
+	{ 1, 3, 5, 12 },
+	{ 2, 5, 7, 11 },
+	{ 2, 6, 8, 10 },
+	{ 3, 6, 7, 10 },
+	{ 2, 4, 7, 10 },
+	{ 1, 5, 7, 9 },
+	{ 1, 4, 7, 9 },
+	{ 1, 3, 7, 9 },
+	{ 1, 4, 6, 9 },
+	{ 2, 3, 6, 9 },
+	{ 0, 1, 2, 9 },
+	{ 3, 5, 7, 8 },
+	{ 2, 4, 6, 8 },
+};
+
+static const int etc2_distance_table[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static int decode_etc2_alpha_modifier(const uint32_t *payload, int linear_pixel, int table)
+{
+	int bit_offset = 45 - 3 * linear_pixel;
+	int lsb_index = int(bitfield_extract(payload[bit_offset >> 5], bit_offset & 31, 2));
+	bit_offset += 2;
+	int msb = int((payload[bit_offset >> 5] >> (bit_offset & 31)) & 1);
+	return etc2_alpha_modifier_table[table][lsb_index] ^ (msb - 1);
+}
+
+static uint32_t decode_etc2_alpha(const uint32_t *payload, int linear_pixel)
+{
+	int base = int(bitfield_extract(payload[1], 24, 8));
+	int multiplier = int(bitfield_extract(payload[1], 20, 4));
+	int table = int(bitfield_extract(payload[1], 16, 4));
+	int a = base + decode_etc2_alpha_modifier(payload, linear_pixel, table) * multiplier;
+	return uint32_t(muglm::clamp(a, 0, 0xff));
+}
+
+static uint32_t decode_eac_alpha(const uint32_t *payload, int linear_pixel)
+{
+	int base = int(bitfield_extract(payload[1], 24, 8)) * 8 + 4;
+	int multiplier = std::max(int(bitfield_extract(payload[1], 20, 4)) * 8, 1);
+	int table = int(bitfield_extract(payload[1], 16, 4));
+	int a = base + decode_etc2_alpha_modifier(payload, linear_pixel, table) * multiplier;
+	return uint32_t(muglm::clamp(a, 0, 2047));
+}
+
+static void decode_etc2_pixel(uint8_t *output, const uint32_t *color_payload, const uint32_t *alpha_payload,
+                              int alpha_bits, int x, int y)
+{
+	int pixel_coord[2] = { x, y };
+	int linear_pixel = 4 * x + y;
+
+	uint32_t alpha_result = alpha_bits == 8 ? decode_etc2_alpha(alpha_payload, linear_pixel) : 0xffu;
+
+	int rgb_result[3] = {};
+	int base_rgb[3] = {};
+	uint32_t flip = color_payload[1] & 1u;
+	uint32_t subblock = (uint32_t(pixel_coord[flip]) & 2u) >> 1u;
+	bool etc1_compat = false;
+	bool punchthrough = alpha_bits == 1 && (color_payload[1] & 2u) == 0u;
+
+	if (alpha_bits != 1 && (color_payload[1] & 2u) == 0u)
+	{
+		// Individual mode (ETC1)
+		etc1_compat = true;
+		base_rgb[0] = int((color_payload[1] >> (28 - 4 * subblock)) & 0xf) * 0x11;
+		base_rgb[1] = int((color_payload[1] >> (20 - 4 * subblock)) & 0xf) * 0x11;
+		base_rgb[2] = int((color_payload[1] >> (12 - 4 * subblock)) & 0xf) * 0x11;
+	}
+	else
+	{
+		int r = int(bitfield_extract(color_payload[1], 27, 5));
+		int rd = bitfield_extract_signed(int(color_payload[1]), 24, 3);
+		int g = int(bitfield_extract(color_payload[1], 19, 5));
+		int gd = bitfield_extract_signed(int(color_payload[1]), 16, 3);
+		int b = int(bitfield_extract(color_payload[1], 11, 5));
+		int bd = bitfield_extract_signed(int(color_payload[1]), 8, 3);
+
+		int r1 = r + rd;
+		int g1 = g + gd;
+		int b1 = b + bd;
+
+		if (uint32_t(r1) > 31)
+		{
+			// T mode
+			int tr1 = int(bitfield_extract(color_payload[1], 56 - 32, 2)) |
+			          (int(bitfield_extract(color_payload[1], 59 - 32, 2)) << 2);
+			int tg1 = int(bitfield_extract(color_payload[1], 52 - 32, 4));
+			int tb1 = int(bitfield_extract(color_payload[1], 48 - 32, 4));
+			int tr2 = int(bitfield_extract(color_payload[1], 44 - 32, 4));
+			int tg2 = int(bitfield_extract(color_payload[1], 40 - 32, 4));
+			int tb2 = int(bitfield_extract(color_payload[1], 36 - 32, 4));
+			uint32_t da = (bitfield_extract(color_payload[1], 34 - 32, 2) << 1) | (color_payload[1] & 1u);
+			int dist = etc2_distance_table[da];
+
+			int msb = int((color_payload[0] >> (15 + linear_pixel)) & 2u);
+			int lsb = int((color_payload[0] >> linear_pixel) & 1u);
+			int index = msb | lsb;
+
+			if (punchthrough)
+				punchthrough = index == 2;
+
+			if (index == 0)
+			{
+				rgb_result[0] = tr1 * 0x11;
+				rgb_result[1] = tg1 * 0x11;
+				rgb_result[2] = tb1 * 0x11;
+			}
+			else
+			{
+				int mod = 2 - index;
+				rgb_result[0] = muglm::clamp(tr2 * 0x11 + mod * dist, 0, 255);
+				rgb_result[1] = muglm::clamp(tg2 * 0x11 + mod * dist, 0, 255);
+				rgb_result[2] = muglm::clamp(tb2 * 0x11 + mod * dist, 0, 255);
+			}
+		}
+		else if (uint32_t(g1) > 31)
+		{
+			// H mode
+			int hr1 = int(bitfield_extract(color_payload[1], 59 - 32, 4));
+			int hg1 = (int(bitfield_extract(color_payload[1], 56 - 32, 3)) << 1) |
+			          int((color_payload[1] >> 20u) & 1u);
+			int hb1 = int(bitfield_extract(color_payload[1], 47 - 32, 3)) |
+			          int((color_payload[1] >> 16u) & 8u);
+			int hr2 = int(bitfield_extract(color_payload[1], 43 - 32, 4));
+			int hg2 = int(bitfield_extract(color_payload[1], 39 - 32, 4));
+			int hb2 = int(bitfield_extract(color_payload[1], 35 - 32, 4));
+			uint32_t da = color_payload[1] & 4u;
+			uint32_t db = color_payload[1] & 1u;
+			uint32_t d = da + 2 * db;
+			d += uint32_t((hr1 * 0x10000 + hg1 * 0x100 + hb1) >= (hr2 * 0x10000 + hg2 * 0x100 + hb2));
+			int dist = etc2_distance_table[d];
+			int msb = int((color_payload[0] >> (15 + linear_pixel)) & 2u);
+			int lsb = int((color_payload[0] >> linear_pixel) & 1u);
+
+			if (punchthrough)
+				punchthrough = (msb + lsb) == 2;
+
+			int mod = 1 - 2 * lsb;
+			rgb_result[0] = muglm::clamp((msb != 0 ? hr2 : hr1) * 0x11 + mod * dist, 0, 0xff);
+			rgb_result[1] = muglm::clamp((msb != 0 ? hg2 : hg1) * 0x11 + mod * dist, 0, 0xff);
+			rgb_result[2] = muglm::clamp((msb != 0 ? hb2 : hb1) * 0x11 + mod * dist, 0, 0xff);
+		}
+		else if (uint32_t(b1) > 31)
+		{
+			// Planar mode
+			int pr = int(bitfield_extract(color_payload[1], 57 - 32, 6));
+			int pg = int(bitfield_extract(color_payload[1], 49 - 32, 6)) |
+			         (int(color_payload[1] >> 18) & 0x40);
+			int pb = int(bitfield_extract(color_payload[1], 39 - 32, 3)) |
+			         (int(bitfield_extract(color_payload[1], 43 - 32, 2)) << 3) |
+			         (int(color_payload[1] >> 11) & 0x20);
+			int rh = int(color_payload[1] & 1u) |
+			         (int(bitfield_extract(color_payload[1], 2, 5)) << 1);
+			int rv = int(bitfield_extract(color_payload[0], 13, 6));
+			int gh = int(bitfield_extract(color_payload[0], 25, 7));
+			int gv = int(bitfield_extract(color_payload[0], 6, 7));
+			int bh = int(bitfield_extract(color_payload[0], 19, 6));
+			int bv = int(bitfield_extract(color_payload[0], 0, 6));
+
+			pr = (pr << 2) | (pr >> 4);
+			rh = (rh << 2) | (rh >> 4);
+			rv = (rv << 2) | (rv >> 4);
+			pg = (pg << 1) | (pg >> 6);
+			gh = (gh << 1) | (gh >> 6);
+			gv = (gv << 1) | (gv >> 6);
+			pb = (pb << 2) | (pb >> 4);
+			bh = (bh << 2) | (bh >> 4);
+			bv = (bv << 2) | (bv >> 4);
+
+			const int rgb[3] = { pr, pg, pb };
+			const int h[3] = { rh, gh, bh };
+			const int v[3] = { rv, gv, bv };
+			for (int c = 0; c < 3; c++)
+			{
+				int dx = (h[c] - rgb[c]) * x;
+				int dy = (v[c] - rgb[c]) * y;
+				rgb_result[c] = muglm::clamp(rgb[c] + ((dx + dy + 2) >> 2), 0, 255);
+			}
+			punchthrough = false;
+		}
+		else
+		{
+			// Differential mode (ETC1)
+			etc1_compat = true;
+			const int base[3] = { r, g, b };
+			const int delta[3] = { rd, gd, bd };
+			for (int c = 0; c < 3; c++)
+			{
+				base_rgb[c] = base[c] + int(subblock) * delta[c];
+				base_rgb[c] = (base_rgb[c] << 3) | (base_rgb[c] >> 2);
+			}
+		}
+	}
+
+	if (etc1_compat)
+	{
+		uint32_t etc1_table_index = bitfield_extract(color_payload[1], 5 - 3 * int(subblock != 0u), 3);
+		int msb = int((color_payload[0] >> (15 + linear_pixel)) & 2u);
+		int lsb = int((color_payload[0] >> linear_pixel) & 1u);
+		int sgn = 1 - msb;
+		if (punchthrough)
+		{
+			sgn *= lsb;
+			punchthrough = (msb + lsb) == 2;
+		}
+		int offset = etc1_color_modifier_table[etc1_table_index][lsb] * sgn;
+		for (int c = 0; c < 3; c++)
+			rgb_result[c] = muglm::clamp(base_rgb[c] + offset, 0, 255);
+	}
+
+	if (alpha_bits == 1 && punchthrough)
+	{
+		rgb_result[0] = 0;
+		rgb_result[1] = 0;
+		rgb_result[2] = 0;
+		alpha_result = 0;
+	}
+
+	output[0] = uint8_t(rgb_result[0]);
+	output[1] = uint8_t(rgb_result[1]);
+	output[2] = uint8_t(rgb_result[2]);
+	output[3] = uint8_t(alpha_result);
+}
+
+static void decode_etc2_block(DecodedBlock &block, const uint32_t *payload, int alpha_bits)
+{
+	uint32_t color_payload[2], alpha_payload[2];
+	if (alpha_bits == 8)
+	{
+		alpha_payload[0] = flip_endian(payload[1]);
+		alpha_payload[1] = flip_endian(payload[0]);
+		color_payload[0] = flip_endian(payload[3]);
+		color_payload[1] = flip_endian(payload[2]);
+	}
+	else
+	{
+		color_payload[0] = flip_endian(payload[1]);
+		color_payload[1] = flip_endian(payload[0]);
+	}
+
+	for (int y = 0; y < 4; y++)
+		for (int x = 0; x < 4; x++)
+			decode_etc2_pixel(block.rgba8[4 * y + x], color_payload, alpha_payload, alpha_bits, x, y);
+}
+
+static void decode_eac_block(DecodedBlock &block, const uint32_t *payload, int components)
+{
+	uint32_t r_payload[2] = { flip_endian(payload[1]), flip_endian(payload[0]) };
+	uint32_t g_payload[2] = {};
+	if (components == 2)
+	{
+		g_payload[0] = flip_endian(payload[3]);
+		g_payload[1] = flip_endian(payload[2]);
+	}
+
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			int linear_pixel = 4 * x + y;
+			auto *rgba = block.rgba16[4 * y + x];
+			rgba[0] = float_to_half_rtne(float(decode_eac_alpha(r_payload, linear_pixel)) / 2047.0f);
+			rgba[1] = components == 2 ?
+			          float_to_half_rtne(float(decode_eac_alpha(g_payload, linear_pixel)) / 2047.0f) : 0;
+			rgba[2] = 0;
+			rgba[3] = 0x3c00;
+		}
+	}
+}
+
+// BC7 / BC6H
+namespace
+{
+struct BC7Interpolation
+{
+	ivec4 ep0, ep1;
+	int color_weight, alpha_weight, rotation;
+};
+
+struct BC6Interpolation
+{
+	ivec3 ep0, ep1;
+	int weight;
+};
+}
+
+static const int weight_table2[4] = { 0, 21, 43, 64 };
+static const int weight_table3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const int weight_table4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+#define BC7_P3(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p) \
+	((uint32_t(a) << 0) | (uint32_t(b) << 2) | (uint32_t(c) << 4) | (uint32_t(d) << 6) | \
+	(uint32_t(e) << 8) | (uint32_t(f) << 10) | (uint32_t(g) << 12) | (uint32_t(h) << 14) | \
+	(uint32_t(i) << 16) | (uint32_t(j) << 18) | (uint32_t(k) << 20) | (uint32_t(l) << 22) | \
+	(uint32_t(m) << 24) | (uint32_t(n) << 26) | (uint32_t(o) << 28) | (uint32_t(p) << 30))
+
+static const uint32_t partition_table3[64] = {
+	BC7_P3(0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2),
+	BC7_P3(0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1),
+	BC7_P3(0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1),
+	BC7_P3(0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1),
+	BC7_P3(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2),
+	BC7_P3(0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2),
+	BC7_P3(0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P3(0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1),
+
+	BC7_P3(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2),
+	BC7_P3(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2),
+	BC7_P3(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2),
+	BC7_P3(0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2),
+	BC7_P3(0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2),
+	BC7_P3(0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2),
+	BC7_P3(0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2),
+	BC7_P3(0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0),
+
+	BC7_P3(0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2),
+	BC7_P3(0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0),
+	BC7_P3(0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2),
+	BC7_P3(0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1),
+	BC7_P3(0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2),
+	BC7_P3(0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1),
+	BC7_P3(0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2),
+	BC7_P3(0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0),
+
+	BC7_P3(0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0),
+	BC7_P3(0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2),
+	BC7_P3(0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0),
+	BC7_P3(0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1),
+	BC7_P3(0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2),
+	BC7_P3(0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2),
+	BC7_P3(0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1),
+	BC7_P3(0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1),
+
+	BC7_P3(0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2),
+	BC7_P3(0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1),
+	BC7_P3(0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2),
+	BC7_P3(0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0),
+	BC7_P3(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0),
+	BC7_P3(0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0),
+	BC7_P3(0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0),
+	BC7_P3(0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1),
+
+	BC7_P3(0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1),
+	BC7_P3(0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2),
+	BC7_P3(0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1),
+	BC7_P3(0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2),
+	BC7_P3(0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1),
+	BC7_P3(0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1),
+	BC7_P3(0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1),
+	BC7_P3(0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1),
+
+	BC7_P3(0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2),
+	BC7_P3(0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1),
+	BC7_P3(0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2),
+	BC7_P3(0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2),
+	BC7_P3(0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2),
+	BC7_P3(0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2),
+	BC7_P3(0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2),
+	BC7_P3(0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2),
+
+	BC7_P3(0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2),
+	BC7_P3(0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2),
+	BC7_P3(0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2),
+	BC7_P3(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2),
+	BC7_P3(0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1),
+	BC7_P3(0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2),
+	BC7_P3(0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2),
+	BC7_P3(0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0)
+};
+
+#define BC7_P2(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p) \
+	((uint32_t(a) << 0) | (uint32_t(b) << 1) | (uint32_t(c) << 2) | (uint32_t(d) << 3) | \
+	(uint32_t(e) << 4) | (uint32_t(f) << 5) | (uint32_t(g) << 6) | (uint32_t(h) << 7) | \
+	(uint32_t(i) << 8) | (uint32_t(j) << 9) | (uint32_t(k) << 10) | (uint32_t(l) << 11) | \
+	(uint32_t(m) << 12) | (uint32_t(n) << 13) | (uint32_t(o) << 14) | (uint32_t(p) << 15))
+static const uint32_t partition_table2[64] = {
+	BC7_P2(0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1),
+	BC7_P2(0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1),
+	BC7_P2(0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1),
+	BC7_P2(0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1),
+	BC7_P2(0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P2(0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1),
+
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1),
+	BC7_P2(0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1),
+	BC7_P2(0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1),
+
+	BC7_P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1),
+	BC7_P2(0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0),
+	BC7_P2(0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0),
+	BC7_P2(0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+	BC7_P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0),
+	BC7_P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0),
+	BC7_P2(0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1),
+
+	BC7_P2(0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0),
+	BC7_P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0),
+	BC7_P2(0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0),
+	BC7_P2(0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0),
+	BC7_P2(0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0),
+	BC7_P2(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0),
+	BC7_P2(0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0),
+	BC7_P2(0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0),
+
+	BC7_P2(0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1),
+	BC7_P2(0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1),
+	BC7_P2(0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0),
+	BC7_P2(0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0),
+	BC7_P2(0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0),
+	BC7_P2(0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0),
+	BC7_P2(0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1),
+	BC7_P2(0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1),
+
+	BC7_P2(0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0),
+	BC7_P2(0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0),
+	BC7_P2(0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0),
+	BC7_P2(0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0),
+	BC7_P2(0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0),
+	BC7_P2(0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1),
+	BC7_P2(0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1),
+	BC7_P2(0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0),
+
+	BC7_P2(0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0),
+	BC7_P2(0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0),
+	BC7_P2(0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0),
+	BC7_P2(0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0),
+	BC7_P2(0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1),
+	BC7_P2(0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1),
+	BC7_P2(0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0),
+	BC7_P2(0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0),
+
+	BC7_P2(0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1),
+	BC7_P2(0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1),
+	BC7_P2(0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1),
+	BC7_P2(0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1),
+	BC7_P2(0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1),
+	BC7_P2(0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0),
+	BC7_P2(0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0),
+	BC7_P2(0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1)
+};
+
+static const int anchor_table2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15,
+	15, 2, 8, 2, 2, 8, 8, 15,
+	2, 8, 2, 2, 8, 8, 2, 2,
+	15, 15, 6, 8, 2, 8, 15, 15,
+	2, 8, 2, 2, 2, 15, 15, 6,
+	6, 2, 6, 8, 15, 15, 2, 2,
+	15, 15, 15, 15, 15, 2, 2, 15
+};
+
+static const ivec2 anchor_table3[64] = {
+	ivec2(3, 15), ivec2(3, 8), ivec2(15, 8), ivec2(15, 3), ivec2(8, 15), ivec2(3, 15), ivec2(15, 3), ivec2(15, 8),
+	ivec2(8, 15), ivec2(8, 15), ivec2(6, 15), ivec2(6, 15), ivec2(6, 15), ivec2(5, 15), ivec2(3, 15), ivec2(3, 8),
+	ivec2(3, 15), ivec2(3, 8), ivec2(8, 15), ivec2(15, 3), ivec2(3, 15), ivec2(3, 8), ivec2(6, 15), ivec2(10, 8),
+	ivec2(5, 3), ivec2(8, 15), ivec2(8, 6), ivec2(6, 10), ivec2(8, 15), ivec2(5, 15), ivec2(15, 10), ivec2(15, 8),
+	ivec2(8, 15), ivec2(15, 3), ivec2(3, 15), ivec2(5, 10), ivec2(6, 10), ivec2(10, 8), ivec2(8, 9), ivec2(15, 10),
+	ivec2(15, 6), ivec2(3, 15), ivec2(15, 8), ivec2(5, 15), ivec2(15, 3), ivec2(15, 6), ivec2(15, 6), ivec2(15, 8),
+	ivec2(3, 15), ivec2(15, 3), ivec2(5, 15), ivec2(5, 15), ivec2(5, 15), ivec2(8, 15), ivec2(5, 15), ivec2(10, 15),
+	ivec2(5, 15), ivec2(10, 15), ivec2(8, 15), ivec2(13, 15), ivec2(15, 3), ivec2(12, 15), ivec2(3, 15), ivec2(3, 8)
+
+};
+
+static BC7Interpolation decode_bc7_mode0(const uint32_t *payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 1, 4);
+	int part = (partition_table3[part_index] >> (2 * linear_pixel)) & 3;
+	int bit_offset = part * 8;
+
+	int r0 = extract_bits(payload, 5 + bit_offset, 4);
+	int r1 = extract_bits(payload, 9 + bit_offset, 4);
+	int g0 = extract_bits(payload, 29 + bit_offset, 4);
+	int g1 = extract_bits(payload, 33 + bit_offset, 4);
+	int b0 = extract_bits(payload, 53 + bit_offset, 4);
+	int b1 = extract_bits(payload, 57 + bit_offset, 4);
+
+	int sep0 = extract_bits(payload, 77 + part * 2, 1);
+	int sep1 = extract_bits(payload, 78 + part * 2, 1);
+
+	ivec2 anchor_pixels = anchor_table3[part_index];
+	int index = extract_bits(
+			payload,
+			std::max(82 + linear_pixel * 3 - int(linear_pixel > anchor_pixels.x) - int(linear_pixel > anchor_pixels.y), 83),
+			(linear_pixel == anchor_pixels.y || linear_pixel == anchor_pixels.x || linear_pixel == 0) ? 2 : 3);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 4) | (sep0 << 3) | (rgb0 >> 1);
+	rgb1 = (rgb1 << 4) | (sep1 << 3) | (rgb1 >> 1);
+
+	int w = weight_table3[index];
+	return { ivec4(rgb0, 0xff), ivec4(rgb1, 0xff), w, w, 0 };
+}
+
+static BC7Interpolation decode_bc7_mode1(const uint32_t *payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 2, 6);
+	int part = (partition_table2[part_index] >> linear_pixel) & 1;
+	int bit_offset = part * 12;
+
+	int r0 = extract_bits(payload, 8 + bit_offset, 6);
+	int r1 = extract_bits(payload, 14 + bit_offset, 6);
+	int g0 = extract_bits(payload, 32 + bit_offset, 6);
+	int g1 = extract_bits(payload, 38 + bit_offset, 6);
+	int b0 = extract_bits(payload, 56 + bit_offset, 6);
+	int b1 = extract_bits(payload, 62 + bit_offset, 6);
+	int sep = extract_bits(payload, 80 + part, 1) << 1;
+
+	int anchor_pixel = anchor_table2[part_index];
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == anchor_pixel || linear_pixel == 0) ? 2 : 3);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 2) | sep | (rgb0 >> 5);
+	rgb1 = (rgb1 << 2) | sep | (rgb1 >> 5);
+
+	int w = weight_table3[index];
+	return { ivec4(rgb0, 0xff), ivec4(rgb1, 0xff), w, w, 0 };
+}
+
+static BC7Interpolation decode_bc7_mode2(const uint32_t *payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 3, 6);
+	int part = (partition_table3[part_index] >> (2 * linear_pixel)) & 3;
+	int bit_offset = part * 10;
+
+	int r0 = extract_bits(payload, 9 + bit_offset, 5);
+	int r1 = extract_bits(payload, 14 + bit_offset, 5);
+	int g0 = extract_bits(payload, 39 + bit_offset, 5);
+	int g1 = extract_bits(payload, 44 + bit_offset, 5);
+	int b0 = extract_bits(payload, 69 + bit_offset, 5);
+	int b1 = extract_bits(payload, 74 + bit_offset, 5);
+
+	ivec2 anchor_pixels = anchor_table3[part_index];
+	int index = extract_bits(
+			payload,
+			std::max(98 + linear_pixel * 2 - int(linear_pixel > anchor_pixels.x) - int(linear_pixel > anchor_pixels.y), 99),
+			(linear_pixel == anchor_pixels.y || linear_pixel == anchor_pixels.x || linear_pixel == 0) ? 1 : 2);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 3) | (rgb0 >> 2);
+	rgb1 = (rgb1 << 3) | (rgb1 >> 2);
+
+	int w = weight_table2[index];
+	return { ivec4(rgb0, 0xff), ivec4(rgb1, 0xff), w, w, 0 };
+}
+
+static BC7Interpolation decode_bc7_mode3(const uint32_t *payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 4, 6);
+	int part = (partition_table2[part_index] >> linear_pixel) & 1;
+	int bit_offset = part * 14;
+
+	int r0 = extract_bits(payload, 10 + bit_offset, 7);
+	int r1 = extract_bits(payload, 17 + bit_offset, 7);
+	int g0 = extract_bits(payload, 38 + bit_offset, 7);
+	int g1 = extract_bits(payload, 45 + bit_offset, 7);
+	int b0 = extract_bits(payload, 66 + bit_offset, 7);
+	int b1 = extract_bits(payload, 73 + bit_offset, 7);
+
+	int sep0 = extract_bits(payload, 94 + part * 2, 1);
+	int sep1 = extract_bits(payload, 95 + part * 2, 1);
+
+	int anchor_pixel = anchor_table2[part_index];
+
+	int index = extract_bits(
+		payload,
+		std::max(97 + linear_pixel * 2 - int(linear_pixel > anchor_pixel), 98),
+		(linear_pixel == anchor_pixel || linear_pixel == 0) ? 1 : 2);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 1) | sep0;
+	rgb1 = (rgb1 << 1) | sep1;
+
+	int w = weight_table2[index];
+	return { ivec4(rgb0, 0xff), ivec4(rgb1, 0xff), w, w, 0 };
+}
+
+static BC7Interpolation decode_bc7_mode4(const uint32_t *payload, int linear_pixel)
+{
+	int rot = extract_bits(payload, 5, 2);
+	bool isb = (payload[0] & 0x80u) != 0u;
+	int r0 = extract_bits(payload, 8, 5);
+	int r1 = extract_bits(payload, 13, 5);
+	int g0 = extract_bits(payload, 18, 5);
+	int g1 = extract_bits(payload, 23, 5);
+	int b0 = extract_bits(payload, 28, 5);
+	int b1 = extract_bits(payload, 33, 5);
+	int a0 = extract_bits(payload, 38, 6);
+	int a1 = extract_bits(payload, 44, 6);
+
+	int primary_index = extract_bits(
+			payload,
+			std::max(49 + linear_pixel * 2, 50),
+			linear_pixel == 0 ? 1 : 2);
+	int secondary_index = extract_bits(
+			payload,
+			std::max(80 + linear_pixel * 3, 81),
+			linear_pixel == 0 ? 2 : 3);
+
+	int color_weight = weight_table2[primary_index];
+	int alpha_weight = weight_table3[secondary_index];
+
+	if (isb)
+	{
+		int tmp = color_weight;
+		color_weight = alpha_weight;
+		alpha_weight = tmp;
+	}
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 3) | (rgb0 >> 2);
+	rgb1 = (rgb1 << 3) | (rgb1 >> 2);
+	a0 = (a0 << 2) | (a0 >> 4);
+	a1 = (a1 << 2) | (a1 >> 4);
+	return { ivec4(rgb0, a0), ivec4(rgb1, a1), color_weight, alpha_weight, rot };
+}
+
+static BC7Interpolation decode_bc7_mode5(const uint32_t *payload, int linear_pixel)
+{
+	int rot = extract_bits(payload, 6, 2);
+	int r0 = extract_bits(payload, 8, 7);
+	int r1 = extract_bits(payload, 15, 7);
+	int g0 = extract_bits(payload, 22, 7);
+	int g1 = extract_bits(payload, 29, 7);
+	int b0 = extract_bits(payload, 36, 7);
+	int b1 = extract_bits(payload, 43, 7);
+	int a0 = extract_bits(payload, 50, 8);
+	int a1 = extract_bits(payload, 58, 8);
+
+	int primary_index = extract_bits(
+			payload,
+			std::max(65 + linear_pixel * 2, 66),
+			linear_pixel == 0 ? 1 : 2);
+	int secondary_index = extract_bits(
+			payload,
+			std::max(96 + linear_pixel * 2, 97),
+			linear_pixel == 0 ? 1 : 2);
+
+	int color_weight = weight_table2[primary_index];
+	int alpha_weight = weight_table2[secondary_index];
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 1) | (rgb0 >> 6);
+	rgb1 = (rgb1 << 1) | (rgb1 >> 6);
+	return { ivec4(rgb0, a0), ivec4(rgb1, a1), color_weight, alpha_weight, rot };
+}
+
+static BC7Interpolation decode_bc7_mode6(const uint32_t *payload, int linear_pixel)
+{
+	int sep0 = extract_bits(payload, 63, 1);
+	int sep1 = extract_bits(payload, 64, 1);
+	int r0 = extract_bits(payload, 7, 7);
+	int r1 = extract_bits(payload, 14, 7);
+	int g0 = extract_bits(payload, 21, 7);
+	int g1 = extract_bits(payload, 28, 7);
+	int b0 = extract_bits(payload, 35, 7);
+	int b1 = extract_bits(payload, 42, 7);
+	int a0 = extract_bits(payload, 49, 7);
+	int a1 = extract_bits(payload, 56, 7);
+
+	ivec4 ep0 = ivec4(r0, g0, b0, a0) * 2 + sep0;
+	ivec4 ep1 = ivec4(r1, g1, b1, a1) * 2 + sep1;
+
+	int index = extract_bits(
+			payload,
+			std::max(64 + linear_pixel * 4, 65),
+			linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return { ep0, ep1, w, w, 0 };
+}
+
+static BC7Interpolation decode_bc7_mode7(const uint32_t *payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 8, 6);
+	int part = (partition_table2[part_index] >> linear_pixel) & 1;
+	int bit_offset = part * 10;
+
+	int r0 = extract_bits(payload, 14 + bit_offset, 5);
+	int r1 = extract_bits(payload, 19 + bit_offset, 5);
+	int g0 = extract_bits(payload, 34 + bit_offset, 5);
+	int g1 = extract_bits(payload, 39 + bit_offset, 5);
+	int b0 = extract_bits(payload, 54 + bit_offset, 5);
+	int b1 = extract_bits(payload, 59 + bit_offset, 5);
+	int a0 = extract_bits(payload, 74 + bit_offset, 5);
+	int a1 = extract_bits(payload, 79 + bit_offset, 5);
+
+	int sep0 = extract_bits(payload, 94 + part * 2, 1);
+	int sep1 = extract_bits(payload, 95 + part * 2, 1);
+
+	int anchor_pixel = anchor_table2[part_index];
+
+	int index = extract_bits(
+		payload,
+		std::max(97 + linear_pixel * 2 - int(linear_pixel > anchor_pixel), 98),
+		(linear_pixel == anchor_pixel || linear_pixel == 0) ? 1 : 2);
+
+	ivec4 rgba0 = ivec4(r0, g0, b0, a0);
+	ivec4 rgba1 = ivec4(r1, g1, b1, a1);
+	rgba0 = (rgba0 << 3) | (rgba0 >> 3) | (sep0 << 2);
+	rgba1 = (rgba1 << 3) | (rgba1 >> 3) | (sep1 << 2);
+
+	int w = weight_table2[index];
+	return { rgba0, rgba1, w, w, 0 };
+}
+
+static void decode_bc7_block(DecodedBlock &block, const uint32_t *payload)
+{
+	int mode = find_lsb(payload[0]);
+
+	for (int linear_pixel = 0; linear_pixel < 16; linear_pixel++)
+	{
+		BC7Interpolation interp;
+
+		switch (mode)
+		{
+		case 0:
+			interp = decode_bc7_mode0(payload, linear_pixel);
+			break;
+
+		case 1:
+			interp = decode_bc7_mode1(payload, linear_pixel);
+			break;
+
+		case 2:
+			interp = decode_bc7_mode2(payload, linear_pixel);
+			break;
+
+		case 3:
+			interp = decode_bc7_mode3(payload, linear_pixel);
+			break;
+
+		case 4:
+			interp = decode_bc7_mode4(payload, linear_pixel);
+			break;
+
+		case 5:
+			interp = decode_bc7_mode5(payload, linear_pixel);
+			break;
+
+		case 6:
+			interp = decode_bc7_mode6(payload, linear_pixel);
+			break;
+
+		case 7:
+			interp = decode_bc7_mode7(payload, linear_pixel);
+			break;
+
+		default:
+			interp = { ivec4(0), ivec4(0), 0, 0, 0 };
+			break;
+		}
+
+		int rgba[4];
+		for (int c = 0; c < 3; c++)
+			rgba[c] = ((64 - interp.color_weight) * interp.ep0[c] + interp.color_weight * interp.ep1[c] + 32) >> 6;
+		rgba[3] = ((64 - interp.alpha_weight) * interp.ep0.w + interp.alpha_weight * interp.ep1.w + 32) >> 6;
+
+		// Rotation swaps alpha with one of the color channels.
+		if (interp.rotation != 0)
+			std::swap(rgba[3], rgba[interp.rotation - 1]);
+
+		for (int c = 0; c < 4; c++)
+			block.rgba8[linear_pixel][c] = uint8_t(rgba[c]);
+	}
+}
+
+static ivec3 unquantize_endpoint(ivec3 ep, int bits, bool is_signed)
+{
+	ivec3 unq;
+	for (int c = 0; c < 3; c++)
+	{
+		if (is_signed)
+		{
+			int v = bitfield_extract_signed(ep[c], 0, bits);
+			if (bits < 16)
+			{
+				int abs_v = std::abs(v);
+				int u = ((abs_v << 15) + 0x4000) >> (bits - 1);
+				if (v == 0)
+					u = 0;
+				if (abs_v >= (1 << (bits - 1)) - 1)
+					u = 0x7fff;
+				unq[c] = v < 0 ? -u : u;
+			}
+			else
+				unq[c] = v;
+		}
+		else
+		{
+			int v = int(bitfield_extract(uint32_t(ep[c]), 0, bits));
+			if (bits < 15)
+			{
+				int u = ((v << 15) + 0x4000) >> (bits - 1);
+				if (v == 0)
+					u = 0;
+				if (v == (1 << bits) - 1)
+					u = 0xffff;
+				unq[c] = u;
+			}
+			else
+				unq[c] = v;
+		}
+	}
+	return unq;
+}
+
+static BC6Interpolation decode_bc6_mode0(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10);
+	int g0 = extract_bits(payload, 15, 10);
+	int b0 = extract_bits(payload, 25, 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 2, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 3, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) | (extract_bits(payload, 70, 1) << 2) |
+				(extract_bits(payload, 76, 1) << 3) | (extract_bits_sign(payload, 4, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 10, is_signed);
+	ep1 = unquantize_endpoint(ep1, 10, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode1(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 7);
+	int g0 = extract_bits(payload, 15, 7);
+	int b0 = extract_bits(payload, 25, 7);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 6);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits(payload, 24, 1) << 4) | (extract_bits_sign(payload, 2, 1) << 5);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits(payload, 14, 1) << 4) | (extract_bits_sign(payload, 22, 1) << 5);
+
+		int r3 = extract_bits_sign(payload, 71, 6);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 3, 2) << 4);
+		int b3 = extract_bits(payload, 12, 2) | (extract_bits(payload, 23, 1) << 2) | (extract_bits(payload, 32, 1) << 3) |
+				(extract_bits(payload, 34, 1) << 4) | (extract_bits_sign(payload, 33, 1) << 5);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 6);
+		int g1 = extract_bits_sign(payload, 45, 6);
+		int b1 = extract_bits_sign(payload, 55, 6);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 7, is_signed);
+	ep1 = unquantize_endpoint(ep1, 7, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode2(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 40, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 49, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 59, 1) << 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits_sign(payload, 41, 4);
+		int b2 = extract_bits_sign(payload, 61, 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits_sign(payload, 51, 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits_sign(payload, 76, 1) << 3);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 4);
+		int b1 = extract_bits_sign(payload, 55, 4);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 11, is_signed);
+	ep1 = unquantize_endpoint(ep1, 11, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode3(const uint32_t *payload, int linear_pixel, bool is_signed)
+{
+	int r0 = extract_bits(payload, 5, 10);
+	int g0 = extract_bits(payload, 15, 10);
+	int b0 = extract_bits(payload, 25, 10);
+	int r1 = extract_bits(payload, 35, 10);
+	int g1 = extract_bits(payload, 45, 10);
+	int b1 = extract_bits(payload, 55, 10);
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 10, is_signed);
+	ep1 = unquantize_endpoint(ep1, 10, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode6(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 39, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 50, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 59, 1) << 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 4);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 75, 1) << 4);
+		int b2 = extract_bits_sign(payload, 61, 4);
+
+		int r3 = extract_bits_sign(payload, 71, 4);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 69, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits_sign(payload, 76, 1) << 3);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 4);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 4);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 11, is_signed);
+	ep1 = unquantize_endpoint(ep1, 11, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode7(const uint32_t *payload, int linear_pixel, bool is_signed)
+{
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 44, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 54, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 64, 1) << 10);
+
+	int r1 = extract_bits_sign(payload, 35, 9);
+	int g1 = extract_bits_sign(payload, 45, 9);
+	int b1 = extract_bits_sign(payload, 55, 9);
+
+	r1 += r0;
+	g1 += g0;
+	b1 += b0;
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 11, is_signed);
+	ep1 = unquantize_endpoint(ep1, 11, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode10(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 39, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 49, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 60, 1) << 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 4);
+		int g2 = extract_bits_sign(payload, 41, 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 4);
+		int g3 = extract_bits_sign(payload, 51, 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 69, 2) << 1) |
+				(extract_bits(payload, 76, 1) << 3) | (extract_bits_sign(payload, 75, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 4);
+		int g1 = extract_bits_sign(payload, 45, 4);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 11, is_signed);
+	ep1 = unquantize_endpoint(ep1, 11, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode11(const uint32_t *payload, int linear_pixel, bool is_signed)
+{
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits_reverse(payload, 43, 2) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits_reverse(payload, 53, 2) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits_reverse(payload, 63, 2) << 10);
+
+	int r1 = extract_bits_sign(payload, 35, 8);
+	int g1 = extract_bits_sign(payload, 45, 8);
+	int b1 = extract_bits_sign(payload, 55, 8);
+
+	r1 += r0;
+	g1 += g0;
+	b1 += b0;
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 12, is_signed);
+	ep1 = unquantize_endpoint(ep1, 12, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode14(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 9);
+	int g0 = extract_bits(payload, 15, 9);
+	int b0 = extract_bits(payload, 25, 9);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 24, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 14, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) |
+				(extract_bits(payload, 76, 1) << 3) | (extract_bits_sign(payload, 34, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 9, is_signed);
+	ep1 = unquantize_endpoint(ep1, 9, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode15(const uint32_t *payload, int linear_pixel, bool is_signed)
+{
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits_reverse(payload, 39, 6) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits_reverse(payload, 49, 6) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits_reverse(payload, 59, 6) << 10);
+
+	int r1 = extract_bits_sign(payload, 35, 4);
+	int g1 = extract_bits_sign(payload, 45, 4);
+	int b1 = extract_bits_sign(payload, 55, 4);
+
+	r1 += r0;
+	g1 += g0;
+	b1 += b0;
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 16, is_signed);
+	ep1 = unquantize_endpoint(ep1, 16, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode18(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 8);
+	int g0 = extract_bits(payload, 15, 8);
+	int b0 = extract_bits(payload, 25, 8);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 6);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 24, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 14, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 6);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 13, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 23, 1) << 2) | (extract_bits_sign(payload, 33, 2) << 3);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 6);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 8, is_signed);
+	ep1 = unquantize_endpoint(ep1, 8, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode22(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 8);
+	int g0 = extract_bits(payload, 15, 8);
+	int b0 = extract_bits(payload, 25, 8);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits(payload, 24, 1) << 4) | (extract_bits_sign(payload, 23, 1) << 5);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 14, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits(payload, 40, 1) << 4) | (extract_bits_sign(payload, 33, 1) << 5);
+		int b3 = extract_bits(payload, 13, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits(payload, 76, 1) << 3) |
+				(extract_bits_sign(payload, 34, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 6);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 8, is_signed);
+	ep1 = unquantize_endpoint(ep1, 8, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode26(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 8);
+	int g0 = extract_bits(payload, 15, 8);
+	int b0 = extract_bits(payload, 25, 8);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 24, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits(payload, 14, 1) << 4) | (extract_bits_sign(payload, 23, 1) << 5);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 13, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits(payload, 76, 1) << 3) |
+				(extract_bits(payload, 34, 1) << 4) | (extract_bits_sign(payload, 33, 1) << 5);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 6);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 8, is_signed);
+	ep1 = unquantize_endpoint(ep1, 8, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static BC6Interpolation decode_bc6_mode30(const uint32_t *payload, int linear_pixel, bool is_signed, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	if (part != 0)
+	{
+		int r2 = extract_bits(payload, 65, 6);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits(payload, 24, 1) << 4) | (extract_bits(payload, 21, 1) << 5);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits(payload, 14, 1) << 4) | (extract_bits(payload, 22, 1) << 5);
+
+		int r3 = extract_bits(payload, 71, 6);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits(payload, 11, 1) << 4) | (extract_bits(payload, 31, 1) << 5);
+		int b3 = extract_bits(payload, 12, 2) | (extract_bits(payload, 23, 1) << 2) |
+			(extract_bits(payload, 32, 1) << 3) | (extract_bits(payload, 34, 1) << 4) | (extract_bits(payload, 33, 1) << 5);
+
+		ep0 = ivec3(r2, g2, b2);
+		ep1 = ivec3(r3, g3, b3);
+	}
+	else
+	{
+		int r0 = extract_bits(payload, 5, 6);
+		int g0 = extract_bits(payload, 15, 6);
+		int b0 = extract_bits(payload, 25, 6);
+
+		int r1 = extract_bits(payload, 35, 6);
+		int g1 = extract_bits(payload, 45, 6);
+		int b1 = extract_bits(payload, 55, 6);
+
+		ep0 = ivec3(r0, g0, b0);
+		ep1 = ivec3(r1, g1, b1);
+	}
+
+	ep0 = unquantize_endpoint(ep0, 6, is_signed);
+	ep1 = unquantize_endpoint(ep1, 6, is_signed);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return { ep0, ep1, w };
+}
+
+static void decode_bc6_block(DecodedBlock &block, const uint32_t *payload, bool is_signed)
+{
+	int mode = extract_bits(payload, 0, 5);
+	int part_index = extract_bits(payload, 77, 5);
+	int anchor_pixel = anchor_table2[part_index];
+
+	for (int linear_pixel = 0; linear_pixel < 16; linear_pixel++)
+	{
+		int part = int(partition_table2[part_index] >> linear_pixel) & 1;
+		BC6Interpolation interp;
+
+		if ((mode & 2) == 0)
+		{
+			if ((mode & 1) != 0)
+				interp = decode_bc6_mode1(payload, linear_pixel, is_signed, part, anchor_pixel);
+			else
+				interp = decode_bc6_mode0(payload, linear_pixel, is_signed, part, anchor_pixel);
+		}
+		else
+		{
+			switch (mode)
+			{
+			case 2:
+				interp = decode_bc6_mode2(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			case 3:
+				interp = decode_bc6_mode3(payload, linear_pixel, is_signed);
+				break;
+			case 6:
+				interp = decode_bc6_mode6(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			case 7:
+				interp = decode_bc6_mode7(payload, linear_pixel, is_signed);
+				break;
+			case 10:
+				interp = decode_bc6_mode10(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			case 11:
+				interp = decode_bc6_mode11(payload, linear_pixel, is_signed);
+				break;
+			case 14:
+				interp = decode_bc6_mode14(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			case 15:
+				interp = decode_bc6_mode15(payload, linear_pixel, is_signed);
+				break;
+			case 18:
+				interp = decode_bc6_mode18(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			case 22:
+				interp = decode_bc6_mode22(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			case 26:
+				interp = decode_bc6_mode26(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			case 30:
+				interp = decode_bc6_mode30(payload, linear_pixel, is_signed, part, anchor_pixel);
+				break;
+			default:
+				interp = { ivec3(0), ivec3(0), 0 };
+				break;
+			}
+		}
+
+		auto *rgba = block.rgba16[linear_pixel];
+		for (int c = 0; c < 3; c++)
+		{
+			int v = ((64 - interp.weight) * interp.ep0[c] + interp.weight * interp.ep1[c] + 32) >> 6;
+
+			// Squeeze range.
+			if (is_signed)
+			{
+				if (v < 0)
+					v = 0x8000 | ((-v * 31) >> 5);
+				else
+					v = (v * 31) >> 5;
+
+				// Fixup for -0.0. Seems to not be emitted by hardware decoder.
+				if (v == 0x8000)
+					v = 0;
+			}
+			else
+				v = (v * 31) >> 6;
+
+			rgba[c] = uint16_t(v);
+		}
+		rgba[3] = 0x3c00;
+	}
+}
+
+// ASTC
+namespace
+{
+enum ASTCDecodeMode
+{
+	ASTC_MODE_LDR = 0,
+	ASTC_MODE_HDR = 1,
+	ASTC_MODE_HDR_LDR_ALPHA = 2
+};
+
+struct ASTCBlockMode
+{
+	int weight_grid_width;
+	int weight_grid_height;
+	int weight_mode_index;
+	int num_partitions;
+	int seed;
+	int cem;
+	int config_bits;
+	int primary_config_bits;
+	bool dual_plane;
+	bool void_extent;
+};
+
+struct ASTCQuant
+{
+	int bits, trits, quints, offset;
+};
+
+struct ASTCEndpoints
+{
+	ivec4 ep0, ep1;
+	int decode_mode;
+	bool error;
+};
+
+struct ASTCContext
+{
+	const ASTCLutHolder *luts;
+	const ASTCLutHolder::PartitionTable *partition_table;
+	int block_width, block_height;
+	int normalize_x, normalize_y;
+	bool decode_8bit;
+};
+}
+
+static ivec4 astc_interpolate_endpoint(ivec4 ep0, ivec4 ep1, ivec4 weight, int decode_mode, bool decode_8bit)
+{
+	if (decode_mode == ASTC_MODE_HDR)
+	{
+		ep0 = ep0 << 4;
+		ep1 = ep1 << 4;
+	}
+	else if (decode_mode == ASTC_MODE_HDR_LDR_ALPHA)
+	{
+		ep0 = ivec4(ep0.xyz() << 4, ep0.w * 0x101);
+		ep1 = ivec4(ep1.xyz() << 4, ep1.w * 0x101);
+	}
+	else if (decode_8bit)
+	{
+		// Same sRGB caveat as the compute decoder, decode_unorm8 behavior is assumed.
+		ep0 = (ep0 << 8) | 0x80;
+		ep1 = (ep1 << 8) | 0x80;
+	}
+	else
+	{
+		ep0 = ep0 * 0x101;
+		ep1 = ep1 * 0x101;
+	}
+
+	return (ep0 * (64 - weight) + ep1 * weight + 32) >> 6;
+}
+
+static uint16_t astc_round_down_quantize_fp16(int color)
+{
+	// 0xffff -> 1.0, and for everything else we get roundDownQuantizeFP16(c / 0x10000).
+	if (color == 0xffff)
+		return 0x3c00;
+
+	int msb = find_msb(color);
+	int e = msb - 1;
+	if (e < 1)
+		return uint16_t(color << 8);
+
+	int m = ((color << 10) >> msb) & 0x3ff;
+	return uint16_t(m | (e << 10));
+}
+
+static void astc_decode_fp16(uint16_t *output, ivec4 color, int decode_mode)
+{
+	if (decode_mode != ASTC_MODE_LDR)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int e = color[c] >> 11;
+			int m = color[c] & 0x7ff;
+			int mt;
+			if (m < 512)
+				mt = 3 * m;
+			else if (m >= 1536)
+				mt = 5 * m - 2048;
+			else
+				mt = 4 * m - 512;
+
+			int decoded = (e << 10) + (mt >> 3);
+			// +Inf or NaN are decoded to 0x7bff (max finite value).
+			if ((decoded & 0x7fff) > 0x7c00 || decoded == 0x7c00)
+				decoded = 0x7bff;
+			output[c] = uint16_t(decoded);
+		}
+
+		if (decode_mode == ASTC_MODE_HDR_LDR_ALPHA)
+			output[3] = astc_round_down_quantize_fp16(color.w);
+	}
+	else
+	{
+		for (int c = 0; c < 4; c++)
+			output[c] = astc_round_down_quantize_fp16(color[c]);
+	}
+}
+
+static bool astc_decode_block_mode(ASTCBlockMode &mode, uint32_t word, int block_width, int block_height)
+{
+	mode = {};
+	mode.void_extent = (word & 0x1ffu) == 0x1fcu;
+	if (mode.void_extent)
+		return true;
+
+	bool error = false;
+	mode.dual_plane = (word & (1u << 10u)) != 0u;
+
+	uint32_t higher = (word >> 2u) & 3u;
+	uint32_t lower = word & 3u;
+
+	if (lower != 0)
+	{
+		mode.weight_mode_index = int((word >> 4u) & 1u);
+		mode.weight_mode_index |= int((word << 1u) & 6u);
+		mode.weight_mode_index |= int((word >> 6u) & 8u);
+
+		if (higher < 2u)
+		{
+			mode.weight_grid_width = int(bitfield_extract(word, 7, 2) + 4 + 4 * higher);
+			mode.weight_grid_height = int(bitfield_extract(word, 5, 2) + 2);
+		}
+		else if (higher == 2u)
+		{
+			mode.weight_grid_width = int(bitfield_extract(word, 5, 2) + 2);
+			mode.weight_grid_height = int(bitfield_extract(word, 7, 2) + 8);
+		}
+		else
+		{
+			if ((word & (1u << 8u)) != 0u)
+			{
+				mode.weight_grid_width = int(bitfield_extract(word, 7, 1) + 2);
+				mode.weight_grid_height = int(bitfield_extract(word, 5, 2) + 2);
+			}
+			else
+			{
+				mode.weight_grid_width = int(bitfield_extract(word, 5, 2) + 2);
+				mode.weight_grid_height = int(bitfield_extract(word, 7, 1) + 6);
+			}
+		}
+	}
+	else
+	{
+		int p3 = int(bitfield_extract(word, 9, 1));
+		int hi = int(bitfield_extract(word, 7, 2));
+		int lo = int(bitfield_extract(word, 5, 2));
+		if (hi == 0)
+		{
+			mode.weight_grid_width = 12;
+			mode.weight_grid_height = lo + 2;
+		}
+		else if (hi == 1)
+		{
+			mode.weight_grid_width = lo + 2;
+			mode.weight_grid_height = 12;
+		}
+		else if (hi == 2)
+		{
+			mode.dual_plane = false;
+			p3 = 0;
+			mode.weight_grid_width = lo + 6;
+			mode.weight_grid_height = int(bitfield_extract(word, 9, 2) + 6);
+		}
+		else
+		{
+			if (lo == 0)
+			{
+				mode.weight_grid_width = 6;
+				mode.weight_grid_height = 10;
+			}
+			else if (lo == 1)
+			{
+				mode.weight_grid_width = 10;
+				mode.weight_grid_height = 6;
+			}
+			else
+				error = true;
+		}
+
+		int p0 = int(bitfield_extract(word, 4, 1));
+		int p1 = int(bitfield_extract(word, 2, 1));
+		int p2 = int(bitfield_extract(word, 3, 1));
+		mode.weight_mode_index = p0 + (p1 << 1) + (p2 << 2) + (p3 << 3);
+	}
+
+	// See decode_block_mode() in astc.comp for the layout of the config bits.
+	const int CONFIG_BITS_BLOCK = 11;
+	const int CONFIG_BITS_PARTITION_MODE = 2;
+	const int CONFIG_BITS_SEED = 10;
+	const int CONFIG_BITS_PRIMARY_MULTI_CEM = 2;
+	const int CONFIG_BITS_CEM = 4;
+	const int CONFIG_BITS_EXTRA_CEM_PER_PARTITION = 3;
+	const int CONFIG_BITS_CCS = 2;
+
+	mode.num_partitions = int(bitfield_extract(word, CONFIG_BITS_BLOCK, CONFIG_BITS_PARTITION_MODE)) + 1;
+
+	if (mode.num_partitions > 1)
+	{
+		mode.seed = int(bitfield_extract(word, CONFIG_BITS_BLOCK + CONFIG_BITS_PARTITION_MODE, CONFIG_BITS_SEED));
+		mode.cem = int(bitfield_extract(word, CONFIG_BITS_BLOCK + CONFIG_BITS_PARTITION_MODE + CONFIG_BITS_SEED,
+		                                CONFIG_BITS_PRIMARY_MULTI_CEM + CONFIG_BITS_CEM));
+	}
+	else
+		mode.cem = int(bitfield_extract(word, CONFIG_BITS_BLOCK + CONFIG_BITS_PARTITION_MODE, CONFIG_BITS_CEM));
+
+	int config_bits;
+	if (mode.num_partitions > 1)
+	{
+		bool single_cem = (mode.cem & 3) == 0;
+		if (single_cem)
+		{
+			config_bits = CONFIG_BITS_BLOCK + CONFIG_BITS_PARTITION_MODE +
+			              CONFIG_BITS_SEED + CONFIG_BITS_PRIMARY_MULTI_CEM + CONFIG_BITS_CEM;
+		}
+		else
+		{
+			config_bits = CONFIG_BITS_BLOCK + CONFIG_BITS_PARTITION_MODE +
+			              CONFIG_BITS_SEED + CONFIG_BITS_PRIMARY_MULTI_CEM +
+			              CONFIG_BITS_EXTRA_CEM_PER_PARTITION * mode.num_partitions;
+		}
+	}
+	else
+	{
+		config_bits = CONFIG_BITS_BLOCK + CONFIG_BITS_PARTITION_MODE + CONFIG_BITS_CEM;
+	}
+
+	// Other config bits are packed before the weights.
+	int primary_config_bits;
+	if (mode.num_partitions > 1)
+	{
+		primary_config_bits = CONFIG_BITS_BLOCK + CONFIG_BITS_PARTITION_MODE + CONFIG_BITS_SEED +
+		                      CONFIG_BITS_PRIMARY_MULTI_CEM + CONFIG_BITS_CEM;
+	}
+	else
+		primary_config_bits = config_bits;
+
+	if (mode.dual_plane)
+		config_bits += CONFIG_BITS_CCS;
+
+	// This is not allowed.
+	if (mode.weight_grid_width > block_width || mode.weight_grid_height > block_height)
+		error = true;
+	if (mode.dual_plane && mode.num_partitions > 3)
+		error = true;
+
+	mode.config_bits = config_bits;
+	mode.primary_config_bits = primary_config_bits;
+	return !error;
+}
+
+static inline int idiv3_floor(int v)
+{
+	return (v * 0x5556) >> 16;
+}
+
+static inline int idiv3_ceil(int v)
+{
+	return idiv3_floor(v + 2);
+}
+
+static inline int idiv5_floor(int v)
+{
+	return (v * 0x3334) >> 16;
+}
+
+static inline int idiv5_ceil(int v)
+{
+	return idiv5_floor(v + 4);
+}
+
+static void astc_mask_payload(uint32_t *payload, int bits)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		int num_bits = bits - 32 * i;
+		if (num_bits <= 0)
+			payload[i] = 0;
+		else if (num_bits < 32)
+			payload[i] &= (1u << num_bits) - 1u;
+	}
+}
+
+static int astc_decode_integer_sequence(const uint32_t *payload, int start_bit, int index,
+                                        const ASTCQuant &quant, const ASTCLutHolder &luts)
+{
+	int ret;
+	if (quant.trits != 0)
+	{
+		// Trit-decoding.
+		int block = idiv5_floor(index);
+		int offset = index - block * 5;
+		start_bit += block * (5 * quant.bits + 8);
+
+		int t0_t1_offset = start_bit + (quant.bits * 1 + 0);
+		int t2_t3_offset = start_bit + (quant.bits * 2 + 2);
+		int t4_offset    = start_bit + (quant.bits * 3 + 4);
+		int t5_t6_offset = start_bit + (quant.bits * 4 + 5);
+		int t7_offset    = start_bit + (quant.bits * 5 + 7);
+
+		int t = (extract_bits(payload, t0_t1_offset, 2) << 0) |
+		        (extract_bits(payload, t2_t3_offset, 2) << 2) |
+		        (extract_bits(payload, t4_offset, 1) << 4) |
+		        (extract_bits(payload, t5_t6_offset, 2) << 5) |
+		        (extract_bits(payload, t7_offset, 1) << 7);
+
+		t = luts.integer.trits_quints[t];
+		t = (t >> (3 * offset)) & 7;
+
+		int m_offset = offset * quant.bits;
+		m_offset += idiv5_ceil(offset * 8);
+
+		if (quant.bits != 0)
+		{
+			int m = extract_bits(payload, m_offset + start_bit, quant.bits);
+			ret = (t << quant.bits) | m;
+		}
+		else
+			ret = t;
+	}
+	else if (quant.quints != 0)
+	{
+		// Quint-decoding
+		int block = idiv3_floor(index);
+		int offset = index - block * 3;
+		start_bit += block * (3 * quant.bits + 7);
+
+		int q0_q1_q2_offset = start_bit + (quant.bits * 1 + 0);
+		int q3_q4_offset    = start_bit + (quant.bits * 2 + 3);
+		int q5_q6_offset    = start_bit + (quant.bits * 3 + 5);
+
+		int q = (extract_bits(payload, q0_q1_q2_offset, 3) << 0) |
+		        (extract_bits(payload, q3_q4_offset, 2) << 3) |
+		        (extract_bits(payload, q5_q6_offset, 2) << 5);
+
+		q = luts.integer.trits_quints[256 + q];
+		q = (q >> (3 * offset)) & 7;
+
+		int m_offset = offset * quant.bits;
+		m_offset += idiv3_ceil(offset * 7);
+
+		if (quant.bits != 0)
+		{
+			int m = extract_bits(payload, m_offset + start_bit, quant.bits);
+			ret = (q << quant.bits) | m;
+		}
+		else
+			ret = q;
+	}
+	else
+	{
+		int bit = index * quant.bits;
+		ret = extract_bits(payload, start_bit + bit, quant.bits);
+	}
+	return ret;
+}
+
+// Unlike the compute decoder, which decodes the up to four grid weights a texel needs,
+// all grid weights are decoded once per block and interpolated per texel.
+static bool astc_decode_weight_grid(int *weights, int &weight_cost_bits, int &ccs,
+                                    const uint32_t *payload, const ASTCBlockMode &mode, const ASTCLutHolder &luts)
+{
+	const uint8_t *q = luts.weights.lut[mode.weight_mode_index];
+	ASTCQuant quant = { q[0], q[1], q[2], q[3] };
+	int num_weights = mode.weight_grid_width * mode.weight_grid_height;
+	num_weights <<= int(mode.dual_plane);
+	weight_cost_bits =
+			quant.bits * num_weights +
+			idiv5_ceil(num_weights * 8 * quant.trits) +
+			idiv3_ceil(num_weights * 7 * quant.quints);
+
+	// Decoders must deal with error conditions and return the correct error color.
+	if (weight_cost_bits < 24 || weight_cost_bits > 96 || num_weights > 64)
+		return false;
+
+	ccs = 0;
+	if (mode.dual_plane)
+	{
+		int extra_cem_bits = 0;
+		if ((mode.cem & 3) != 0)
+			extra_cem_bits = std::max(mode.num_partitions * 3 - 4, 0);
+		ccs = extract_bits(payload, 126 - weight_cost_bits - extra_cem_bits, 2);
+	}
+
+	// Weights are stored in reverse from the top of the block.
+	uint32_t reversed[5];
+	for (int i = 0; i < 4; i++)
+		reversed[i] = bitfield_reverse(payload[3 - i]);
+	reversed[4] = 0;
+	astc_mask_payload(reversed, weight_cost_bits);
+
+	for (int i = 0; i < num_weights; i++)
+	{
+		int weight = astc_decode_integer_sequence(reversed, 0, i, quant, luts);
+		weights[i] = luts.weights.unquant_lut[weight + quant.offset];
+	}
+
+	return true;
+}
+
+static int astc_weight_bilinear(const int *weights, int x, int y, int weight_resolution,
+                                int stride, int offset, int fx, int fy)
+{
+	int index = y * weight_resolution + x;
+	int p00 = weights[stride * index + offset];
+	int p10, p01, p11;
+
+	if (fx != 0)
+		p10 = weights[stride * (index + 1) + offset];
+	else
+		p10 = p00;
+
+	if (fy != 0)
+	{
+		p01 = weights[stride * (index + weight_resolution) + offset];
+		if (fx != 0)
+			p11 = weights[stride * (index + weight_resolution + 1) + offset];
+		else
+			p11 = p01;
+	}
+	else
+	{
+		p01 = p00;
+		p11 = p10;
+	}
+
+	int w11 = (fx * fy + 8) >> 4;
+	int w10 = fx - w11;
+	int w01 = fy - w11;
+	int w00 = 16 - fx - fy + w11;
+	return (p00 * w00 + p10 * w10 + p01 * w01 + p11 * w11 + 8) >> 4;
+}
+
+static ivec4 astc_blue_contract(int r, int g, int b, int a)
+{
+	return ivec4((r + b) >> 1, (g + b) >> 1, b, a);
+}
+
+static void astc_bit_transfer_signed(int &a, int &b)
+{
+	b >>= 1;
+	b |= a & 0x80;
+	a >>= 1;
+	a &= 0x3f;
+	a = bitfield_extract_signed(a, 0, 6);
+}
+
+static void astc_decode_endpoint_hdr_luma_direct(ivec4 &ep0, ivec4 &ep1, int v0, int v1)
+{
+	int y0, y1;
+	if (v1 >= v0)
+	{
+		y0 = v0 << 4;
+		y1 = v1 << 4;
+	}
+	else
+	{
+		y0 = (v1 << 4) + 8;
+		y1 = (v0 << 4) - 8;
+	}
+
+	ep0 = ivec4(y0, y0, y0, 0x780);
+	ep1 = ivec4(y1, y1, y1, 0x780);
+}
+
+static void astc_decode_endpoint_hdr_luma_direct_small_range(ivec4 &ep0, ivec4 &ep1, int v0, int v1)
+{
+	int y0, y1, d;
+
+	if ((v0 & 0x80) != 0)
+	{
+		y0 = ((v1 & 0xe0) << 4) | ((v0 & 0x7f) << 2);
+		d = (v1 & 0x1f) << 2;
+	}
+	else
+	{
+		y0 = ((v1 & 0xf0) << 4) | ((v0 & 0x7f) << 1);
+		d = (v1 & 0x0f) << 1;
+	}
+
+	y1 = std::min(y0 + d, 0xfff);
+
+	ep0 = ivec4(y0, y0, y0, 0x780);
+	ep1 = ivec4(y1, y1, y1, 0x780);
+}
+
+static void astc_decode_endpoint_hdr_rgb_scale(ivec4 &ep0, ivec4 &ep1, int v0, int v1, int v2, int v3)
+{
+	// Straight from the spec, see astc.comp.
+	int mode_value = ((v0 & 0xc0) >> 6) | ((v1 & 0x80) >> 5) | ((v2 & 0x80) >> 4);
+	int major_component;
+	int mode;
+
+	if ((mode_value & 0xc) != 0xc)
+	{
+		major_component = mode_value >> 2;
+		mode = mode_value & 3;
+	}
+	else if (mode_value != 0xf)
+	{
+		major_component = mode_value & 3;
+		mode = 4;
+	}
+	else
+	{
+		major_component = 0;
+		mode = 5;
+	}
+
+	int red = v0 & 0x3f;
+	int green = v1 & 0x1f;
+	int blue = v2 & 0x1f;
+	int scale = v3 & 0x1f;
+
+	int x0 = (v1 >> 6) & 1;
+	int x1 = (v1 >> 5) & 1;
+	int x2 = (v2 >> 6) & 1;
+	int x3 = (v2 >> 5) & 1;
+	int x4 = (v3 >> 7) & 1;
+	int x5 = (v3 >> 6) & 1;
+	int x6 = (v3 >> 5) & 1;
+
+	int ohm = 1 << mode;
+	if ((ohm & 0x30) != 0) green |= x0 << 6;
+	if ((ohm & 0x3a) != 0) green |= x1 << 5;
+	if ((ohm & 0x30) != 0) blue |= x2 << 6;
+	if ((ohm & 0x3a) != 0) blue |= x3 << 5;
+	if ((ohm & 0x3d) != 0) scale |= x6 << 5;
+	if ((ohm & 0x2d) != 0) scale |= x5 << 6;
+	if ((ohm & 0x04) != 0) scale |= x4 << 7;
+	if ((ohm & 0x3b) != 0) red |= x4 << 6;
+	if ((ohm & 0x04) != 0) red |= x3 << 6;
+	if ((ohm & 0x10) != 0) red |= x5 << 7;
+	if ((ohm & 0x0f) != 0) red |= x2 << 7;
+	if ((ohm & 0x05) != 0) red |= x1 << 8;
+	if ((ohm & 0x0a) != 0) red |= x0 << 8;
+	if ((ohm & 0x05) != 0) red |= x0 << 9;
+	if ((ohm & 0x02) != 0) red |= x6 << 9;
+	if ((ohm & 0x01) != 0) red |= x3 << 10;
+	if ((ohm & 0x02) != 0) red |= x5 << 10;
+
+	int shamt = std::max(mode, 1);
+	red <<= shamt;
+	green <<= shamt;
+	blue <<= shamt;
+	scale <<= shamt;
+
+	if (mode != 5)
+	{
+		green = red - green;
+		blue = red - blue;
+	}
+
+	if (major_component == 1)
+		std::swap(red, green);
+	else if (major_component == 2)
+		std::swap(red, blue);
+
+	ep1 = ivec4(clamp(ivec3(red, green, blue), ivec3(0), ivec3(0xfff)), 0x780);
+	ep0 = ivec4(clamp(ivec3(red, green, blue) - scale, ivec3(0), ivec3(0xfff)), 0x780);
+}
+
+static void astc_decode_endpoint_hdr_rgb_direct(ivec4 &ep0, ivec4 &ep1,
+                                                int v0, int v1, int v2, int v3, int v4, int v5)
+{
+	int major_component = ((v4 & 0x80) >> 7) | ((v5 & 0x80) >> 6);
+
+	if (major_component == 3)
+	{
+		ep0 = ivec4(v0 << 4, v2 << 4, (v4 & 0x7f) << 5, 0x780);
+		ep1 = ivec4(v1 << 4, v3 << 4, (v5 & 0x7f) << 5, 0x780);
+		return;
+	}
+
+	int mode = ((v1 & 0x80) >> 7) | ((v2 & 0x80) >> 6) | ((v3 & 0x80) >> 5);
+	int va = v0 | ((v1 & 0x40) << 2);
+	int vb0 = v2 & 0x3f;
+	int vb1 = v3 & 0x3f;
+	int vc = v1 & 0x3f;
+	int vd0 = v4 & 0x7f;
+	int vd1 = v5 & 0x7f;
+
+	int d_bits = 7 - (mode & 1);
+	if ((mode & 5) == 4)
+		d_bits -= 2;
+
+	vd0 = bitfield_extract_signed(vd0, 0, d_bits);
+	vd1 = bitfield_extract_signed(vd1, 0, d_bits);
+
+	int x0 = (v2 >> 6) & 1;
+	int x1 = (v3 >> 6) & 1;
+	int x2 = (v4 >> 6) & 1;
+	int x3 = (v5 >> 6) & 1;
+	int x4 = (v4 >> 5) & 1;
+	int x5 = (v5 >> 5) & 1;
+
+	int ohm = 1 << mode;
+	if ((ohm & 0xa4) != 0) va |= x0 << 9;
+	if ((ohm & 0x08) != 0) va |= x2 << 9;
+	if ((ohm & 0x50) != 0) va |= x4 << 9;
+	if ((ohm & 0x50) != 0) va |= x5 << 10;
+	if ((ohm & 0xa0) != 0) va |= x1 << 10;
+	if ((ohm & 0xc0) != 0) va |= x2 << 11;
+
+	if ((ohm & 0x04) != 0) vc |= x1 << 6;
+	if ((ohm & 0xe8) != 0) vc |= x3 << 6;
+	if ((ohm & 0x20) != 0) vc |= x2 << 7;
+
+	if ((ohm & 0x5b) != 0) vb0 |= x0 << 6;
+	if ((ohm & 0x5b) != 0) vb1 |= x1 << 6;
+	if ((ohm & 0x12) != 0) vb0 |= x2 << 7;
+	if ((ohm & 0x12) != 0) vb1 |= x3 << 7;
+
+	// vd0 and vd1 are signed, scale rather than shift them.
+	int shamt = (mode >> 1) ^ 3;
+	va <<= shamt;
+	vb0 <<= shamt;
+	vb1 <<= shamt;
+	vc <<= shamt;
+	vd0 *= 1 << shamt;
+	vd1 *= 1 << shamt;
+
+	ep1 = ivec4(clamp(ivec3(va, va - vb0, va - vb1), ivec3(0), ivec3(0xfff)), 0x780);
+	ep0 = ivec4(clamp(ivec3(va - vc, va - vb0 - vc - vd0, va - vb1 - vc - vd1), ivec3(0), ivec3(0xfff)), 0x780);
+
+	if (major_component == 1)
+	{
+		std::swap(ep0.x, ep0.y);
+		std::swap(ep1.x, ep1.y);
+	}
+	else if (major_component == 2)
+	{
+		std::swap(ep0.x, ep0.z);
+		std::swap(ep1.x, ep1.z);
+	}
+}
+
+static void astc_decode_endpoint_hdr_alpha(int &ep0, int &ep1, int v6, int v7)
+{
+	int mode = ((v6 >> 7) & 1) | ((v7 >> 6) & 2);
+	v6 &= 0x7f;
+	v7 &= 0x7f;
+
+	if (mode == 3)
+	{
+		ep0 = v6 << 5;
+		ep1 = v7 << 5;
+	}
+	else
+	{
+		v6 |= (v7 << (mode + 1)) & 0x780;
+		v7 &= 0x3f >> mode;
+		v7 ^= 0x20 >> mode;
+		v7 -= 0x20 >> mode;
+		v6 <<= 4 - mode;
+		v7 *= 1 << (4 - mode);
+		v7 += v6;
+		v7 = clamp(v7, 0, 0xfff);
+		ep0 = v6;
+		ep1 = v7;
+	}
+}
+
+static void astc_decode_endpoint(ASTCEndpoints &endpoints, const uint32_t *payload, int bit_offset,
+                                 const ASTCQuant &quant, int ep_mode, int base_endpoint_index,
+                                 const ASTCLutHolder &luts)
+{
+	int v[8] = {};
+	int num_values = 2 * ((ep_mode >> 2) + 1);
+	for (int i = 0; i < num_values; i++)
+	{
+		int value = astc_decode_integer_sequence(payload, bit_offset, i + base_endpoint_index, quant, luts);
+		v[i] = luts.color_endpoint.unquant_lut[quant.offset + value];
+	}
+
+	auto &ep0 = endpoints.ep0;
+	auto &ep1 = endpoints.ep1;
+
+	switch (ep_mode)
+	{
+	case 0:
+		// LDR luma direct
+		ep0 = ivec4(v[0], v[0], v[0], 0xff);
+		ep1 = ivec4(v[1], v[1], v[1], 0xff);
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+
+	case 1:
+	{
+		// LDR luma base offset
+		int l0 = (v[0] >> 2) | (v[1] & 0xc0);
+		int l1 = std::min(l0 + (v[1] & 0x3f), 0xff);
+		ep0 = ivec4(l0, l0, l0, 0xff);
+		ep1 = ivec4(l1, l1, l1, 0xff);
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+	}
+
+	case 2:
+		astc_decode_endpoint_hdr_luma_direct(ep0, ep1, v[0], v[1]);
+		endpoints.decode_mode = ASTC_MODE_HDR;
+		break;
+
+	case 3:
+		astc_decode_endpoint_hdr_luma_direct_small_range(ep0, ep1, v[0], v[1]);
+		endpoints.decode_mode = ASTC_MODE_HDR;
+		break;
+
+	case 4:
+		// LDR luma alpha direct
+		ep0 = ivec4(v[0], v[0], v[0], v[2]);
+		ep1 = ivec4(v[1], v[1], v[1], v[3]);
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+
+	case 5:
+	{
+		// LDR luma alpha base offset
+		astc_bit_transfer_signed(v[1], v[0]);
+		astc_bit_transfer_signed(v[3], v[2]);
+		int v0_v1 = clamp(v[0] + v[1], 0, 0xff);
+		int v2_v3 = clamp(v[2] + v[3], 0, 0xff);
+		int l0 = clamp(v[0], 0, 0xff);
+		int a0 = clamp(v[2], 0, 0xff);
+		ep0 = ivec4(l0, l0, l0, a0);
+		ep1 = ivec4(v0_v1, v0_v1, v0_v1, v2_v3);
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+	}
+
+	case 6:
+		// LDR RGB base scale
+		ep0 = ivec4((ivec3(v[0], v[1], v[2]) * v[3]) >> 8, 0xff);
+		ep1 = ivec4(v[0], v[1], v[2], 0xff);
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+
+	case 7:
+		astc_decode_endpoint_hdr_rgb_scale(ep0, ep1, v[0], v[1], v[2], v[3]);
+		endpoints.decode_mode = ASTC_MODE_HDR;
+		break;
+
+	case 8:
+	case 12:
+	{
+		// LDR RGB(A) direct
+		int a0 = ep_mode == 12 ? v[6] : 0xff;
+		int a1 = ep_mode == 12 ? v[7] : 0xff;
+		int s0 = v[0] + v[2] + v[4];
+		int s1 = v[1] + v[3] + v[5];
+		if (s1 >= s0)
+		{
+			ep0 = ivec4(v[0], v[2], v[4], a0);
+			ep1 = ivec4(v[1], v[3], v[5], a1);
+		}
+		else
+		{
+			ep0 = astc_blue_contract(v[1], v[3], v[5], a1);
+			ep1 = astc_blue_contract(v[0], v[2], v[4], a0);
+		}
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+	}
+
+	case 9:
+	case 13:
+	{
+		// LDR RGB(A) base offset
+		astc_bit_transfer_signed(v[1], v[0]);
+		astc_bit_transfer_signed(v[3], v[2]);
+		astc_bit_transfer_signed(v[5], v[4]);
+		if (ep_mode == 13)
+			astc_bit_transfer_signed(v[7], v[6]);
+
+		int a0 = ep_mode == 13 ? v[6] : 0xff;
+		int a1 = ep_mode == 13 ? v[6] + v[7] : 0xff;
+
+		if (v[1] + v[3] + v[5] >= 0)
+		{
+			ep0 = ivec4(v[0], v[2], v[4], a0);
+			ep1 = ivec4(v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+		}
+		else
+		{
+			ep0 = astc_blue_contract(v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+			ep1 = astc_blue_contract(v[0], v[2], v[4], a0);
+		}
+
+		ep0 = clamp(ep0, ivec4(0), ivec4(0xff));
+		ep1 = clamp(ep1, ivec4(0), ivec4(0xff));
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+	}
+
+	case 10:
+		// LDR RGB base scale plus two A
+		ep0 = ivec4((ivec3(v[0], v[1], v[2]) * v[3]) >> 8, v[4]);
+		ep1 = ivec4(v[0], v[1], v[2], v[5]);
+		endpoints.decode_mode = ASTC_MODE_LDR;
+		break;
+
+	case 11:
+	case 14:
+	case 15:
+		astc_decode_endpoint_hdr_rgb_direct(ep0, ep1, v[0], v[1], v[2], v[3], v[4], v[5]);
+		if (ep_mode == 14)
+		{
+			ep0.w = v[6];
+			ep1.w = v[7];
+			endpoints.decode_mode = ASTC_MODE_HDR_LDR_ALPHA;
+		}
+		else if (ep_mode == 15)
+		{
+			astc_decode_endpoint_hdr_alpha(ep0.w, ep1.w, v[6], v[7]);
+			endpoints.decode_mode = ASTC_MODE_HDR;
+		}
+		else
+			endpoints.decode_mode = ASTC_MODE_HDR;
+		break;
+
+	default:
+		break;
+	}
+}
+
+static int astc_compute_num_endpoint_pairs(int num_partitions, int cem)
+{
+	int ret;
+	if (num_partitions > 1)
+	{
+		bool single_cem = (cem & 3) == 0;
+		if (single_cem)
+			ret = ((cem >> 4) + 1) * num_partitions;
+		else
+			ret = (cem & 3) * num_partitions + bit_count(bitfield_extract(uint32_t(cem), 2, num_partitions));
+	}
+	else
+	{
+		ret = (cem >> 2) + 1;
+	}
+	return ret;
+}
+
+static void astc_decode_cem_base_endpoint(const uint32_t *payload, int weight_cost_bits, int &cem,
+                                          int &base_endpoint_index, int num_partitions, int partition_index)
+{
+	if (num_partitions > 1)
+	{
+		bool single_cem = (cem & 3) == 0;
+		if (single_cem)
+		{
+			cem >>= 2;
+			base_endpoint_index = ((cem >> 2) + 1) * partition_index;
+		}
+		else
+		{
+			if (partition_index != 0)
+			{
+				base_endpoint_index = (cem & 3) * partition_index +
+				                      bit_count(bitfield_extract(uint32_t(cem), 2, partition_index));
+			}
+			else
+				base_endpoint_index = 0;
+
+			int base_class = (cem & 3) - 1;
+			int extra_cem_bits = num_partitions * 3 - 4;
+			int extra_bits = extract_bits(payload, 128 - weight_cost_bits - extra_cem_bits, extra_cem_bits);
+			cem = (extra_bits << 4) | (cem >> 2);
+
+			int class_offset_bit = (cem >> partition_index) & 1;
+			int ep_bits = (cem >> (num_partitions + 2 * partition_index)) & 3;
+
+			cem = 4 * (base_class + class_offset_bit) + ep_bits;
+		}
+		base_endpoint_index *= 2;
+	}
+	else
+	{
+		base_endpoint_index = 0;
+	}
+}
+
+static bool astc_void_extent_color(ivec4 &color, int &decode_mode, const uint32_t *payload)
+{
+	int min_s = extract_bits(payload, 12, 13);
+	int max_s = extract_bits(payload, 12 + 13, 13);
+	int min_t = extract_bits(payload, 12 + 2 * 13, 13);
+	int max_t = extract_bits(payload, 12 + 3 * 13, 13);
+
+	int reserved = extract_bits(payload, 10, 2);
+	if (reserved != 3)
+		return false;
+
+	const int all_ones = (1 << 13) - 1;
+	if (min_s != all_ones || max_s != all_ones || min_t != all_ones || max_t != all_ones)
+		if (min_s >= max_s || min_t >= max_t)
+			return false;
+
+	decode_mode = (payload[0] & (1u << 9)) != 0u ? ASTC_MODE_HDR : ASTC_MODE_LDR;
+
+	int r = extract_bits(payload, 64, 16);
+	int g = extract_bits(payload, 64 + 16, 16);
+	int b = extract_bits(payload, 64 + 32, 16);
+	int a = extract_bits(payload, 64 + 48, 16);
+	color = ivec4(r, g, b, a);
+	return true;
+}
+
+static void astc_emit_decode_error(DecodedBlock &block, int index, bool decode_8bit)
+{
+	if (decode_8bit)
+	{
+		block.rgba8[index][0] = 0xff;
+		block.rgba8[index][1] = 0;
+		block.rgba8[index][2] = 0xff;
+		block.rgba8[index][3] = 0xff;
+	}
+	else
+	{
+		for (auto &c : block.rgba16[index])
+			c = 0xffff;
+	}
+}
+
+static void astc_emit_color(DecodedBlock &block, int index, const ivec4 &color, int decode_mode,
+                            bool void_extent, bool decode_8bit)
+{
+	if (decode_8bit)
+	{
+		for (int c = 0; c < 4; c++)
+			block.rgba8[index][c] = uint8_t(color[c] >> 8);
+	}
+	else if (void_extent && decode_mode == ASTC_MODE_HDR)
+	{
+		for (int c = 0; c < 4; c++)
+			block.rgba16[index][c] = uint16_t(color[c]);
+	}
+	else
+		astc_decode_fp16(block.rgba16[index], color, decode_mode);
+}
+
+static void decode_astc_block(DecodedBlock &block, const uint32_t *payload, const ASTCContext &ctx)
+{
+	auto &luts = *ctx.luts;
+	int num_texels = ctx.block_width * ctx.block_height;
+
+	ASTCBlockMode block_mode;
+	if (!astc_decode_block_mode(block_mode, payload[0], ctx.block_width, ctx.block_height))
+	{
+		for (int i = 0; i < num_texels; i++)
+			astc_emit_decode_error(block, i, ctx.decode_8bit);
+		return;
+	}
+
+	if (block_mode.void_extent)
+	{
+		ivec4 color;
+		int decode_mode = ASTC_MODE_LDR;
+		bool valid = astc_void_extent_color(color, decode_mode, payload);
+		for (int i = 0; i < num_texels; i++)
+		{
+			if (valid)
+				astc_emit_color(block, i, color, decode_mode, true, ctx.decode_8bit);
+			else
+				astc_emit_decode_error(block, i, ctx.decode_8bit);
+		}
+		return;
+	}
+
+	int weights[64];
+	int weight_cost_bits = 0;
+	int ccs = 0;
+	bool valid = astc_decode_weight_grid(weights, weight_cost_bits, ccs, payload, block_mode, luts);
+
+	int num_endpoint_pairs = astc_compute_num_endpoint_pairs(block_mode.num_partitions, block_mode.cem);
+
+	// Error color must be emitted if we need more than 18 integer sequence encoded values of color.
+	if (num_endpoint_pairs > 9)
+		valid = false;
+
+	ASTCQuant endpoint_quant = {};
+	if (valid)
+	{
+		int available_endpoint_bits = std::max(128 - block_mode.config_bits - weight_cost_bits, 0);
+		const uint16_t *q = luts.color_endpoint.lut[num_endpoint_pairs - 1][available_endpoint_bits];
+		endpoint_quant = { q[0], q[1], q[2], q[3] };
+
+		// No space left for color endpoints.
+		if (endpoint_quant.bits == 0 && endpoint_quant.trits == 0 && endpoint_quant.quints == 0)
+			valid = false;
+	}
+
+	if (!valid)
+	{
+		for (int i = 0; i < num_texels; i++)
+			astc_emit_decode_error(block, i, ctx.decode_8bit);
+		return;
+	}
+
+	// Only read the bits we need for endpoints.
+	int num_endpoint_values = num_endpoint_pairs * 2;
+	int num_endpoint_bits =
+			endpoint_quant.bits * num_endpoint_values +
+			idiv5_ceil(endpoint_quant.trits * 8 * num_endpoint_values) +
+			idiv3_ceil(endpoint_quant.quints * 7 * num_endpoint_values);
+
+	uint32_t endpoint_payload[5];
+	memcpy(endpoint_payload, payload, sizeof(endpoint_payload));
+	astc_mask_payload(endpoint_payload, num_endpoint_bits + block_mode.primary_config_bits);
+
+	// Endpoints are decoded on first use, since not every partition has to be present in a block.
+	ASTCEndpoints endpoints[4];
+	bool endpoints_decoded[4] = {};
+
+	for (int y = 0; y < ctx.block_height; y++)
+	{
+		for (int x = 0; x < ctx.block_width; x++)
+		{
+			int index = y * ctx.block_width + x;
+
+			int partition_index = 0;
+			if (block_mode.num_partitions > 1)
+			{
+				auto &table = *ctx.partition_table;
+				int lut_x = x + ctx.block_width * (block_mode.seed & 31);
+				int lut_y = y + ctx.block_height * (block_mode.seed >> 5);
+				partition_index = table.lut_buffer[lut_y * table.lut_width + lut_x];
+				partition_index = (partition_index >> (2 * block_mode.num_partitions - 4)) & 3;
+			}
+
+			auto &ep = endpoints[partition_index];
+			if (!endpoints_decoded[partition_index])
+			{
+				int cem = block_mode.cem;
+				int base_endpoint_index;
+				astc_decode_cem_base_endpoint(payload, weight_cost_bits, cem, base_endpoint_index,
+				                              block_mode.num_partitions, partition_index);
+
+				ep = {};
+				astc_decode_endpoint(ep, endpoint_payload, block_mode.primary_config_bits, endpoint_quant,
+				                     cem, base_endpoint_index, luts);
+				ep.error = ctx.decode_8bit && ep.decode_mode != ASTC_MODE_LDR;
+				endpoints_decoded[partition_index] = true;
+			}
+
+			if (ep.error)
+			{
+				astc_emit_decode_error(block, index, ctx.decode_8bit);
+				continue;
+			}
+
+			// Scale the normalized coordinate to weight grid.
+			int weight_x_fixed_point = (ctx.normalize_x * x * (block_mode.weight_grid_width - 1) + 32) >> 6;
+			int weight_y_fixed_point = (ctx.normalize_y * y * (block_mode.weight_grid_height - 1) + 32) >> 6;
+			int weight_x = weight_x_fixed_point >> 4;
+			int weight_y = weight_y_fixed_point >> 4;
+			int fx = weight_x_fixed_point & 0xf;
+			int fy = weight_y_fixed_point & 0xf;
+
+			int primary_weight = astc_weight_bilinear(weights, weight_x, weight_y, block_mode.weight_grid_width,
+			                                          1 << int(block_mode.dual_plane), 0, fx, fy);
+			ivec4 weight(primary_weight);
+			if (block_mode.dual_plane)
+			{
+				weight[ccs] = astc_weight_bilinear(weights, weight_x, weight_y, block_mode.weight_grid_width,
+				                                   2, 1, fx, fy);
+			}
+
+			ivec4 color = astc_interpolate_endpoint(ep.ep0, ep.ep1, weight, ep.decode_mode, ctx.decode_8bit);
+			astc_emit_color(block, index, color, ep.decode_mode, false, ctx.decode_8bit);
+		}
+	}
+}
+
+namespace
+{
+enum class CPUDecoderType
+{
+	S3TC,
+	RGTC,
+	ETC2,
+	EAC,
+	BC6,
+	BC7,
+	ASTC
+};
+
+struct CPUDecoder
+{
+	CPUDecoderType type;
+	// BC version for S3TC, alpha bits for ETC2, component count for RGTC and EAC, signedness for BC6.
+	int variant;
+	bool use_alpha;
+	bool output_16bit;
+	unsigned block_width, block_height;
+	ASTCContext astc;
+
+	void decode_block(DecodedBlock &block, const uint32_t *payload) const;
+};
+
+void CPUDecoder::decode_block(DecodedBlock &block, const uint32_t *payload) const
+{
+	switch (type)
+	{
+	case CPUDecoderType::S3TC:
+		decode_s3tc_block(block, payload, use_alpha, variant);
+		break;
+
+	case CPUDecoderType::RGTC:
+		decode_rgtc_block(block, payload, variant == 2);
+		break;
+
+	case CPUDecoderType::ETC2:
+		decode_etc2_block(block, payload, variant);
+		break;
+
+	case CPUDecoderType::EAC:
+		decode_eac_block(block, payload, variant);
+		break;
+
+	case CPUDecoderType::BC6:
+		decode_bc6_block(block, payload, variant != 0);
+		break;
+
+	case CPUDecoderType::BC7:
+		decode_bc7_block(block, payload);
+		break;
+
+	case CPUDecoderType::ASTC:
+		decode_astc_block(block, payload, astc);
+		break;
+	}
+}
+}
+
+static bool setup_cpu_decoder(CPUDecoder &decoder, VkFormat format, VkFormat decoded_format)
+{
+	decoder = {};
+	Vulkan::TextureFormatLayout::format_block_dim(format, decoder.block_width, decoder.block_height);
+	decoder.output_16bit = decoded_format == VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::S3TC;
+		decoder.variant = 1;
+		break;
+
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::S3TC;
+		decoder.variant = 1;
+		decoder.use_alpha = true;
+		break;
+
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::S3TC;
+		decoder.variant = 2;
+		decoder.use_alpha = true;
+		break;
+
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::S3TC;
+		decoder.variant = 3;
+		decoder.use_alpha = true;
+		break;
+
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::RGTC;
+		decoder.variant = 1;
+		break;
+
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::RGTC;
+		decoder.variant = 2;
+		break;
+
+	case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::ETC2;
+		decoder.variant = 0;
+		break;
+
+	case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::ETC2;
+		decoder.variant = 1;
+		break;
+
+	case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::ETC2;
+		decoder.variant = 8;
+		break;
+
+	case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::EAC;
+		decoder.variant = 1;
+		break;
+
+	case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::EAC;
+		decoder.variant = 2;
+		break;
+
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		decoder.type = CPUDecoderType::BC6;
+		decoder.variant = 0;
+		break;
+
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		decoder.type = CPUDecoderType::BC6;
+		decoder.variant = 1;
+		break;
+
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		decoder.type = CPUDecoderType::BC7;
+		break;
+
+	default:
+	{
+		if (decoder.block_width < 4 || decoder.block_width > 12 ||
+		    decoder.block_height < 4 || decoder.block_height > 12)
+		{
+			return false;
+		}
+
+		// Everything else with a block size of 4x4 or larger that we can decode is ASTC.
+		auto &luts = get_astc_luts();
+		decoder.type = CPUDecoderType::ASTC;
+		decoder.astc.luts = &luts;
+		decoder.astc.partition_table = &luts.get_partition_table(decoder.block_width, decoder.block_height);
+		decoder.astc.block_width = int(decoder.block_width);
+		decoder.astc.block_height = int(decoder.block_height);
+		decoder.astc.normalize_x = int((float(1024 + (decoder.block_width >> 1)) + 0.5f) /
+		                               float(decoder.block_width - 1));
+		decoder.astc.normalize_y = int((float(1024 + (decoder.block_height >> 1)) + 0.5f) /
+		                               float(decoder.block_height - 1));
+		decoder.astc.decode_8bit = !decoder.output_16bit;
+		break;
+	}
+	}
+
+	return true;
+}
+
+static void decode_block_rows(const CPUDecoder &decoder, const Vulkan::TextureFormatLayout &layout,
+                              const Vulkan::TextureFormatLayout &output_layout,
+                              unsigned layer, unsigned level, unsigned start_row, unsigned num_rows)
+{
+	unsigned width = layout.get_width(level);
+	unsigned height = layout.get_height(level);
+	unsigned blocks_x = (width + decoder.block_width - 1) / decoder.block_width;
+	size_t block_size = Vulkan::TextureFormatLayout::format_block_size(layout.get_format(), VK_IMAGE_ASPECT_COLOR_BIT);
+	size_t texel_size = decoder.output_16bit ? sizeof(uint16_t) * 4 : sizeof(uint8_t) * 4;
+
+	DecodedBlock block;
+	BlockPayload payload = {};
+
+	for (unsigned block_y = start_row; block_y < start_row + num_rows; block_y++)
+	{
+		unsigned base_y = block_y * decoder.block_height;
+		unsigned rows = std::min(decoder.block_height, height - base_y);
+
+		for (unsigned block_x = 0; block_x < blocks_x; block_x++)
+		{
+			memcpy(payload.words, layout.data_opaque(block_x, block_y, layer, level), block_size);
+			decoder.decode_block(block, payload.words);
+
+			unsigned base_x = block_x * decoder.block_width;
+			unsigned cols = std::min(decoder.block_width, width - base_x);
+
+			for (unsigned y = 0; y < rows; y++)
+			{
+				const void *src = decoder.output_16bit ?
+				                  static_cast<const void *>(block.rgba16[y * decoder.block_width]) :
+				                  static_cast<const void *>(block.rgba8[y * decoder.block_width]);
+				memcpy(output_layout.data_opaque(base_x, base_y + y, layer, level), src, cols * texel_size);
+			}
+		}
+	}
+}
+
+VkFormat compressed_format_to_cpu_decoded_format(VkFormat format, VkFormat preferred_decode_format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+	case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+		LOGE("SNORM formats are not supported.\n");
+		return VK_FORMAT_UNDEFINED;
+
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+	case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+		return VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_5x4_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_6x5_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_8x5_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_8x6_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_10x5_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_10x6_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_10x8_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_10x10_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_12x10_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_12x12_UNORM_BLOCK:
+		return preferred_decode_format == VK_FORMAT_R16G16B16A16_SFLOAT ?
+		       preferred_decode_format : VK_FORMAT_R8G8B8A8_UNORM;
+
+	case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_5x4_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_6x5_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_8x5_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_8x6_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_10x5_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_10x6_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_10x8_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_10x10_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_12x10_SRGB_BLOCK:
+	case VK_FORMAT_ASTC_12x12_SRGB_BLOCK:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+
+	case VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_5x4_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_5x5_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_6x5_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_6x6_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_8x5_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_8x6_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_8x8_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_10x5_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_10x6_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_10x8_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_10x10_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_12x10_SFLOAT_BLOCK_EXT:
+	case VK_FORMAT_ASTC_12x12_SFLOAT_BLOCK_EXT:
+		return VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	default:
+		return VK_FORMAT_UNDEFINED;
+	}
+}
+
+bool decode_compressed_image_cpu(Vulkan::MemoryMappedTexture &output, const Vulkan::TextureFormatLayout &layout,
+                                 VkFormat preferred_decode_format, ThreadGroup *group)
+{
+	if (layout.get_image_type() != VK_IMAGE_TYPE_2D)
+	{
+		LOGE("Only 2D images can be decoded.\n");
+		return false;
+	}
+
+	uint32_t block_width, block_height;
+	Vulkan::TextureFormatLayout::format_block_dim(layout.get_format(), block_width, block_height);
+	if (block_width == 1 || block_height == 1)
+	{
+		LOGE("Not a compressed format.\n");
+		return false;
+	}
+
+	VkFormat decoded_format = compressed_format_to_cpu_decoded_format(layout.get_format(), preferred_decode_format);
+	if (decoded_format == VK_FORMAT_UNDEFINED)
+		return false;
+
+	CPUDecoder decoder;
+	if (!setup_cpu_decoder(decoder, layout.get_format(), decoded_format))
+		return false;
+
+	output.set_2d(decoded_format, layout.get_width(), layout.get_height(), layout.get_layers(), layout.get_levels());
+	if (!output.map_write_scratch())
+		return false;
+
+	auto &output_layout = output.get_layout();
+	TaskGroupHandle task;
+	if (group)
+		task = group->create_task();
+
+	for (unsigned level = 0; level < layout.get_levels(); level++)
+	{
+		unsigned blocks_x = (layout.get_width(level) + block_width - 1) / block_width;
+		unsigned blocks_y = (layout.get_height(level) + block_height - 1) / block_height;
+
+		// Enqueue strips of block rows rather than single blocks to keep task overhead down.
+		unsigned rows_per_task = std::max(1u, 1024u / blocks_x);
+
+		for (unsigned layer = 0; layer < layout.get_layers(); layer++)
+		{
+			for (unsigned y = 0; y < blocks_y; y += rows_per_task)
+			{
+				unsigned num_rows = std::min(rows_per_task, blocks_y - y);
+				if (task)
+				{
+					task->enqueue_task([&decoder, &layout, &output_layout, layer, level, y, num_rows]() {
+						decode_block_rows(decoder, layout, output_layout, layer, level, y, num_rows);
+					});
+				}
+				else
+					decode_block_rows(decoder, layout, output_layout, layer, level, y, num_rows);
+			}
+		}
+	}
+
+	if (task)
+	{
+		task->flush();
+		task->wait();
+	}
+
+	return true;
+}
+}
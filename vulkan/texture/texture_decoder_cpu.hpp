@@ -0,0 +1,45 @@
+/* Copyright (c) 2017-2026 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "texture_format.hpp"
+#include "memory_mapped_texture.hpp"
+
+namespace Granite
+{
+class ThreadGroup;
+
+// CPU fallback for decode_compressed_image(), for when the compute decoder cannot be used,
+// e.g. offline tools or devices without shaderStorageImageWriteWithoutFormat.
+// Results are bit-exact with the compute decoder, except for S3TC and RGTC,
+// where float rounding may differ by one ULP as it does between GPU implementations.
+// LDR formats decode to RGBA8 (sRGB if the input is sRGB), HDR formats decode to RGBA16F.
+// ASTC UNORM decodes to RGBA16F if preferred_decode_format is VK_FORMAT_R16G16B16A16_SFLOAT.
+// One and two component formats are expanded to RGBA as (r, 0, 0, 1) and (r, g, 0, 1).
+VkFormat compressed_format_to_cpu_decoded_format(VkFormat format, VkFormat preferred_decode_format);
+
+// Decodes all layers and mips of a 2D compressed layout into output, which is set up as a 2D texture backed by scratch memory.
+// If group is not null, block rows are decoded in parallel and the call returns when all work has completed.
+bool decode_compressed_image_cpu(Vulkan::MemoryMappedTexture &output, const Vulkan::TextureFormatLayout &layout,
+                                 VkFormat preferred_decode_format, ThreadGroup *group = nullptr);
+}
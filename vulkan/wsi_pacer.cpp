@@ -22,6 +22,8 @@
 
 #include "wsi_pacer.hpp"
 #include "timer.hpp"
+#include <algorithm>
+#include <functional>
 
 FixedRefreshRatePacer::FixedRefreshRatePacer()
 {
@@ -52,6 +54,33 @@ void FixedRefreshRatePacer::reset()
 		entry = {};
 	overall = {};
 	minimum_confidence_for_promotion = 0.0;
+	present_failures.clear();
+	last_gap_change_present_id = 0;
+}
+
+void FixedRefreshRatePacer::set_policy(Policy policy_)
+{
+	policy = policy_;
+}
+
+FixedRefreshRatePacer::Policy FixedRefreshRatePacer::get_policy() const
+{
+	return policy;
+}
+
+void FixedRefreshRatePacer::set_target_percentile(double percentile)
+{
+	target_percentile = std::min(std::max(percentile, 0.5), 1.0);
+}
+
+void FixedRefreshRatePacer::set_clock(Clock *clock_)
+{
+	clock = clock_;
+}
+
+uint64_t FixedRefreshRatePacer::center_in_quantum(uint64_t gap_ns)
+{
+	return (gap_ns / GapQuantumNS) * GapQuantumNS + (GapQuantumNS / 2);
 }
 
 void FixedRefreshRatePacer::discard_pacing_statistics(uint64_t present_id)
@@ -83,7 +112,7 @@ void FixedRefreshRatePacer::set_frame_time_ns(uint64_t frame_time)
 
 	// Stay in the center of the histogram range to avoid annoying rounding errors when quantizing results
 	// to histogram.
-	estimated_present_gap_ns = (estimated_present_gap_ns / GapQuantumNS) * GapQuantumNS + (GapQuantumNS / 2);
+	estimated_present_gap_ns = center_in_quantum(estimated_present_gap_ns);
 }
 
 void FixedRefreshRatePacer::override_gpu_done_time(uint64_t present_id, uint64_t queue_done_ns)
@@ -127,7 +156,11 @@ void FixedRefreshRatePacer::update_feedback(uint64_t present_id, uint64_t queue_
 
 		register_present_gap(present_id, present_gap_ns, true);
 
-		if (present_gap_ns <= estimated_present_gap_ns)
+		if (policy == Policy::LatencyPercentile)
+		{
+			update_percentile_success(present_id);
+		}
+		else if (present_gap_ns <= estimated_present_gap_ns)
 		{
 			// The compositor was able to deal with current tight timings, update our estimate accordingly (slowly).
 			uint64_t candidate_ns = std::max<uint64_t>(estimated_present_gap_ns, GapQuantumNS) - GapQuantumNS;
@@ -142,10 +175,13 @@ void FixedRefreshRatePacer::update_feedback(uint64_t present_id, uint64_t queue_
 	{
 		// The GPU was done in time, but we dropped a frame regardless.
 		// Likely the compositor has a queueing delay we need to consider.
-
-		estimated_present_gap_ns += GapQuantumNS;
 		uint64_t potential_present_gap_ns = feedback.estimated_complete_ns - queue_done_ns;
 
+		if (policy == Policy::LatencyPercentile)
+			update_percentile_failure(present_id, potential_present_gap_ns);
+		else
+			estimated_present_gap_ns += GapQuantumNS;
+
 		// If the present gap is over half a frame, it's likely the compositor just derping out for no good reason.
 		if (potential_present_gap_ns < frame_time_ns / 2)
 		{
@@ -299,6 +335,55 @@ bool FixedRefreshRatePacer::safe_to_lower_gap_to(uint64_t present_id, uint64_t o
 	return frames_since_last_observed_failure >= (60u << num_failures);
 }
 
+uint64_t FixedRefreshRatePacer::get_percentile_gap_floor_ns(uint64_t present_id)
+{
+	while (!present_failures.empty() &&
+	       present_failures.front().present_id + PercentileWindowFrames < present_id)
+	{
+		present_failures.pop_front();
+	}
+
+	// We may miss this many frames in the window and still hit the target percentile.
+	auto allowed_misses = size_t((1.0 - target_percentile) * double(PercentileWindowFrames));
+	if (present_failures.size() <= allowed_misses)
+		return 0;
+
+	// Any gap at or below a failed gap would have missed that frame again.
+	// The floor must clear every failure except the allowed number of worst offenders.
+	Util::SmallVector<uint64_t> gaps;
+	gaps.reserve(present_failures.size());
+	for (auto &failure : present_failures)
+		gaps.push_back(failure.gap_ns);
+	std::nth_element(gaps.begin(), gaps.begin() + allowed_misses, gaps.end(), std::greater<uint64_t>());
+	return gaps[allowed_misses] + GapQuantumNS;
+}
+
+void FixedRefreshRatePacer::update_percentile_success(uint64_t present_id)
+{
+	// Probe a lower gap now and then. Failures observed there will push us back up.
+	if (present_id < last_gap_change_present_id + PercentileProbeFrames)
+		return;
+
+	uint64_t candidate_ns = std::max<uint64_t>(estimated_present_gap_ns, GapQuantumNS) - GapQuantumNS;
+	if (candidate_ns >= get_percentile_gap_floor_ns(present_id))
+	{
+		estimated_present_gap_ns = center_in_quantum(candidate_ns);
+		last_gap_change_present_id = present_id;
+	}
+}
+
+void FixedRefreshRatePacer::update_percentile_failure(uint64_t present_id, uint64_t gap_ns)
+{
+	present_failures.push_back({ present_id, gap_ns });
+	uint64_t floor_ns = get_percentile_gap_floor_ns(present_id);
+
+	if (estimated_present_gap_ns < floor_ns)
+	{
+		estimated_present_gap_ns = std::min<uint64_t>(center_in_quantum(floor_ns), frame_time_ns / 2);
+		last_gap_change_present_id = present_id;
+	}
+}
+
 void FixedRefreshRatePacer::begin_frame_submission(uint64_t current_present_id)
 {
 	if (last_feedback.present_id == 0 || frame_time_ns == 0)
@@ -313,12 +398,16 @@ void FixedRefreshRatePacer::begin_frame_submission(uint64_t current_present_id)
 		uint64_t target_gap_ns = estimated_present_gap_ns;
 		target_gap_ns += estimated_frame_latency_ns;
 		int64_t sleep_target_ns = int64_t(estimated_complete_ns) - int64_t(target_gap_ns);
-		Util::sleep_until_nsecs(sleep_target_ns);
+		if (clock)
+			clock->sleep_until_ns(sleep_target_ns);
+		else
+			Util::sleep_until_nsecs(sleep_target_ns);
 	}
 
 	// Safety clear in case it's never polled.
 	if (feedbacks.size() > 16)
 		feedbacks.clear();
 
-	feedbacks.push_back({ current_present_id, uint64_t(Util::get_current_time_nsecs()), estimated_complete_ns });
+	int64_t now_ns = clock ? clock->get_time_ns() : Util::get_current_time_nsecs();
+	feedbacks.push_back({ current_present_id, uint64_t(now_ns), estimated_complete_ns });
 }
@@ -24,6 +24,7 @@
 
 #include "small_vector.hpp"
 #include <stdint.h>
+#include <deque>
 
 // Designed for lowest possible latency on fixed rate displays.
 // The GPU workload is expected to be very light and stable (e.g. video decoding).
@@ -47,6 +48,29 @@ public:
 
 	void reset();
 
+	enum class Policy
+	{
+		// Lowers the present gap once the histogram has built enough confidence in the lower band.
+		ConfidencePromotion,
+		// Picks the lowest present gap at which the given percentile of recent frames would have flipped in time.
+		LatencyPercentile
+	};
+
+	// Policy and clock persist across reset().
+	void set_policy(Policy policy);
+	Policy get_policy() const;
+	// Only used by LatencyPercentile, e.g. 0.99 accepts one compositor miss per 100 frames.
+	void set_target_percentile(double percentile);
+
+	// Allows driving the pacer from a simulated clock instead of the system timer.
+	struct Clock
+	{
+		virtual ~Clock() = default;
+		virtual int64_t get_time_ns() = 0;
+		virtual void sleep_until_ns(int64_t time_ns) = 0;
+	};
+	void set_clock(Clock *clock);
+
 	struct HistogramStats
 	{
 		double confidence = 0.0;
@@ -63,6 +87,10 @@ public:
 	double get_minimum_confidence_for_promotion() const;
 
 private:
+	Clock *clock = nullptr;
+	Policy policy = Policy::ConfidencePromotion;
+	double target_percentile = 0.99;
+
 	uint64_t frame_time_ns = 0;
 	uint64_t estimated_present_gap_ns = UINT64_MAX;
 	uint64_t estimated_frame_latency_ns = UINT64_MAX;
@@ -89,4 +117,19 @@ private:
 
 	void register_present_gap(uint64_t present_id, uint64_t gap_ns, bool success);
 	bool safe_to_lower_gap_to(uint64_t present_id, uint64_t observed_gap_ns, uint64_t to_ns) const;
+
+	// LatencyPercentile state. A missed flip proves the compositor needed more than the gap we gave it.
+	enum { PercentileWindowFrames = 600, PercentileProbeFrames = 30 };
+	struct PresentFailure
+	{
+		uint64_t present_id;
+		uint64_t gap_ns;
+	};
+	std::deque<PresentFailure> present_failures;
+	uint64_t last_gap_change_present_id = 0;
+
+	uint64_t get_percentile_gap_floor_ns(uint64_t present_id);
+	void update_percentile_success(uint64_t present_id);
+	void update_percentile_failure(uint64_t present_id, uint64_t gap_ns);
+	static uint64_t center_in_quantum(uint64_t gap_ns);
 };